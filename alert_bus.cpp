@@ -0,0 +1,196 @@
+#include "alert_bus.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+static void copy_text(char *dst, size_t cap, const char *src) {
+  size_t n = src ? strnlen(src, cap - 1) : 0;
+  if (n)
+    memcpy(dst, src, n);
+  memset(dst + n, 0, cap - n);
+}
+
+AlertBus::AlertBus()
+    : m_slots(ALERT_BUS_CAPACITY), m_published(0), m_waiters(0) {
+  for (Slot &slot : m_slots) {
+    slot.stamp.store(0);
+    memset(&slot.record, 0, sizeof(slot.record));
+  }
+  for (Subscriber &sub : m_subscribers) {
+    sub.active.store(false);
+    sub.next.store(0);
+    sub.delivered.store(0);
+    sub.dropped.store(0);
+  }
+}
+
+// --- Publishing ---
+
+uint64_t AlertBus::publish(int64_t ts_ms, const char *username,
+                           const char *alert_type, const char *severity,
+                           const char *ip_address, const char *description) {
+  AlertRecord rec;
+  rec.ts_ms = ts_ms;
+  rec.published_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now().time_since_epoch())
+                         .count();
+  copy_text(rec.username, sizeof(rec.username), username);
+  copy_text(rec.alert_type, sizeof(rec.alert_type), alert_type);
+  copy_text(rec.severity, sizeof(rec.severity), severity);
+  copy_text(rec.ip_address, sizeof(rec.ip_address), ip_address);
+  copy_text(rec.description, sizeof(rec.description), description);
+
+  uint64_t seq;
+  {
+    std::lock_guard<std::mutex> guard(m_publish_lock);
+    seq = m_published.load(std::memory_order_relaxed) + 1;
+    rec.sequence = seq;
+    Slot &slot = m_slots[seq & (ALERT_BUS_CAPACITY - 1)];
+    // Odd stamp first: a reader that copies across the overwrite sees the
+    // stamp change and discards what it read
+    slot.stamp.store(2 * seq - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&slot.record, &rec, sizeof(rec));
+    slot.stamp.store(2 * seq, std::memory_order_release);
+    m_published.store(seq);
+  }
+
+  if (m_waiters.load() > 0) {
+    std::lock_guard<std::mutex> guard(m_wait_lock);
+    m_wake.notify_all();
+  }
+  return seq;
+}
+
+// --- Subscribing ---
+
+int AlertBus::subscribe() {
+  std::lock_guard<std::mutex> guard(m_subscribe_lock);
+  for (size_t i = 0; i < ALERT_BUS_MAX_SUBSCRIBERS; i++) {
+    Subscriber &sub = m_subscribers[i];
+    if (sub.active.load())
+      continue;
+    sub.next.store(m_published.load() + 1);
+    sub.delivered.store(0);
+    sub.dropped.store(0);
+    sub.active.store(true);
+    return (int)i;
+  }
+  return -1;
+}
+
+void AlertBus::unsubscribe(int id) {
+  std::lock_guard<std::mutex> guard(m_subscribe_lock);
+  if (id >= 0 && (size_t)id < ALERT_BUS_MAX_SUBSCRIBERS)
+    m_subscribers[id].active.store(false);
+}
+
+bool AlertBus::read_slot(uint64_t seq, AlertRecord *out) const {
+  const Slot &slot = m_slots[seq & (ALERT_BUS_CAPACITY - 1)];
+  uint64_t before = slot.stamp.load(std::memory_order_acquire);
+  if (before != 2 * seq)
+    return false;
+  memcpy(out, &slot.record, sizeof(*out));
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot.stamp.load(std::memory_order_relaxed) == before;
+}
+
+size_t AlertBus::poll(int id, AlertRecord *out, size_t max, int timeout_ms) {
+  if (id < 0 || (size_t)id >= ALERT_BUS_MAX_SUBSCRIBERS || !max)
+    return 0;
+  Subscriber &sub = m_subscribers[id];
+  if (!sub.active.load())
+    return 0;
+
+  uint64_t next = sub.next.load(std::memory_order_relaxed);
+  if (m_published.load() < next && timeout_ms > 0) {
+    m_waiters.fetch_add(1);
+    {
+      std::unique_lock<std::mutex> guard(m_wait_lock);
+      m_wake.wait_for(guard, std::chrono::milliseconds(timeout_ms),
+                      [&] { return m_published.load() >= next; });
+    }
+    m_waiters.fetch_sub(1);
+  }
+
+  size_t n = 0;
+  while (n < max) {
+    uint64_t published = m_published.load(std::memory_order_acquire);
+    if (next > published)
+      break;
+    // Lapped: everything older than the ring is gone
+    if (published - next >= ALERT_BUS_CAPACITY) {
+      uint64_t oldest = published - ALERT_BUS_CAPACITY + 1;
+      sub.dropped.fetch_add(oldest - next, std::memory_order_relaxed);
+      next = oldest;
+    }
+    if (read_slot(next, &out[n])) {
+      n++;
+      next++;
+    } else {
+      // Being overwritten: once that finishes the check above skips it
+      std::this_thread::yield();
+    }
+  }
+  sub.next.store(next, std::memory_order_relaxed);
+  sub.delivered.fetch_add(n, std::memory_order_relaxed);
+  return n;
+}
+
+bool AlertBus::stats(int id, AlertBusStats *out) const {
+  if (id < 0 || (size_t)id >= ALERT_BUS_MAX_SUBSCRIBERS)
+    return false;
+  const Subscriber &sub = m_subscribers[id];
+  if (!sub.active.load())
+    return false;
+  out->published = m_published.load();
+  out->delivered = sub.delivered.load();
+  out->dropped = sub.dropped.load();
+  uint64_t next = sub.next.load();
+  out->lag = out->published >= next
+                 ? std::min<uint64_t>(out->published - next + 1,
+                                      ALERT_BUS_CAPACITY)
+                 : 0;
+  return true;
+}
+
+AlertBus &global_alert_bus() {
+  static AlertBus bus;
+  return bus;
+}
+
+// --- Exported Functions for Python ---
+
+extern "C" {
+
+// Fan an alert out to every subscriber; returns its sequence
+uint64_t alert_publish(const char *username, const char *alert_type,
+                       const char *severity, const char *ip_address,
+                       const char *description, int64_t ts_ms) {
+  if (!ts_ms)
+    ts_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count();
+  return global_alert_bus().publish(ts_ms, username, alert_type, severity,
+                                    ip_address, description);
+}
+
+// Subscriber ID for alerts published from now on, or -1
+int alert_subscribe() { return global_alert_bus().subscribe(); }
+
+void alert_unsubscribe(int id) { global_alert_bus().unsubscribe(id); }
+
+// Up to `max` alerts into `out`, waiting up to `timeout_ms` for the first.
+// Called without the GIL by ctypes, so a waiting consumer holds up no one.
+int alert_poll(int id, AlertRecord *out, int max, int timeout_ms) {
+  if (max <= 0)
+    return 0;
+  return (int)global_alert_bus().poll(id, out, (size_t)max, timeout_ms);
+}
+
+bool alert_bus_stats(int id, AlertBusStats *out) {
+  return global_alert_bus().stats(id, out);
+}
+}
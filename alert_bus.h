@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// --- Alert Bus ---
+// In-process fan-out of intrusion alerts. create_alert() publishes each new
+// alert once, and every subscriber (lockout enforcement, session
+// revocation, notification, persistence, ...) reads it independently at
+// its own pace instead of polling intrusion_alerts.
+//
+// A Disruptor-style broadcast ring: a sequence counter advanced by the
+// publisher, a cursor per subscriber, and slots overwritten in turn. The
+// publisher never reads the cursors, so a slow or stalled subscriber cannot
+// hold it up; one lapped by more than ALERT_BUS_CAPACITY alerts skips to
+// the oldest still in the ring and counts the rest as dropped. Each slot is
+// stamped with the sequence it holds (a seqlock), so a reader copying a
+// slot while it is being overwritten notices and never returns a torn
+// alert.
+//
+// Publishers are serialised by a lock among themselves; readers take no
+// lock unless they choose to sleep until the next alert. Each subscriber ID
+// is read from one thread at a time.
+
+const size_t ALERT_BUS_CAPACITY = 1024; // power of two
+const size_t ALERT_BUS_MAX_SUBSCRIBERS = 16;
+
+// Layout shared with Python (ctypes.Structure); text is NUL-terminated and
+// truncated to fit
+struct AlertRecord {
+  uint64_t sequence; // 1, 2, ... in publication order
+  int64_t ts_ms;
+  int64_t published_ns; // steady clock, for delivery latency
+  char username[64];
+  char alert_type[32];
+  char severity[16];
+  char ip_address[48]; // of the event that raised it, may be empty
+  char description[136];
+};
+
+// Layout shared with Python (ctypes.Structure) - keep fields 64-bit
+struct AlertBusStats {
+  uint64_t published;
+  uint64_t delivered; // read by this subscriber
+  uint64_t dropped;   // overwritten before this subscriber read them
+  uint64_t lag;       // published, not yet read or dropped
+};
+
+static_assert(sizeof(AlertRecord) == 320, "alert record layout");
+static_assert((ALERT_BUS_CAPACITY & (ALERT_BUS_CAPACITY - 1)) == 0,
+              "capacity must be a power of two");
+
+//
+// AlertBus - single-writer broadcast ring of alerts
+//
+class AlertBus {
+private:
+  struct Slot {
+    std::atomic<uint64_t> stamp; // 2 * sequence held, odd while writing
+    AlertRecord record;
+  };
+
+  struct Subscriber {
+    std::atomic<bool> active;
+    std::atomic<uint64_t> next; // sequence to read next
+    std::atomic<uint64_t> delivered;
+    std::atomic<uint64_t> dropped;
+  };
+
+  std::vector<Slot> m_slots;
+  std::atomic<uint64_t> m_published; // latest sequence
+  std::mutex m_publish_lock;
+  Subscriber m_subscribers[ALERT_BUS_MAX_SUBSCRIBERS];
+  std::mutex m_subscribe_lock;
+
+  // Only for subscribers that sleep; the publisher touches it only if
+  // someone is waiting
+  std::atomic<int> m_waiters;
+  std::mutex m_wait_lock;
+  std::condition_variable m_wake;
+
+  // Copy sequence `seq` out; false if it is not there (yet or any more)
+  bool read_slot(uint64_t seq, AlertRecord *out) const;
+
+public:
+  AlertBus();
+
+  AlertBus(const AlertBus &) = delete;
+  AlertBus &operator=(const AlertBus &) = delete;
+
+  // Publish an alert; returns its sequence
+  uint64_t publish(int64_t ts_ms, const char *username,
+                   const char *alert_type, const char *severity,
+                   const char *ip_address, const char *description);
+
+  // New subscriber reading from the next alert published; -1 if there are
+  // ALERT_BUS_MAX_SUBSCRIBERS already
+  int subscribe();
+  void unsubscribe(int id);
+
+  // Up to `max` alerts for subscriber `id`, oldest first, waiting up to
+  // `timeout_ms` for the first (0 = return at once). Returns how many.
+  size_t poll(int id, AlertRecord *out, size_t max, int timeout_ms);
+
+  bool stats(int id, AlertBusStats *out) const;
+  uint64_t published() const { return m_published.load(); }
+};
+
+// The process-wide bus behind the C API
+AlertBus &global_alert_bus();
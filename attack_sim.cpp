@@ -0,0 +1,651 @@
+/*
+ * Attack Simulator
+ *
+ * Mixes synthetic attacks into background login traffic and runs every
+ * event through the credential store (credential_store.h) and then the
+ * intrusion checks (intrusion_checks.h) on a virtual clock, as the service
+ * does for a login. Reports, per kind of attack, how many were caught and
+ * how long that took (virtual seconds and attempts from its first event);
+ * alerts on background users as the false positive rate; and the sustained
+ * events/s of the credential checks, the detection and both together.
+ *
+ * Traffic comes from a seeded generator, so for a seed (and time zone) the
+ * detection figures are identical from run to run and two commits can be
+ * compared directly; only the rates depend on the machine. Alerts during
+ * the warm-up days, while profiles are still learning, are not counted.
+ *
+ *   brute-force   one account, a password guess every 20 s
+ *   spraying      one password against 40 accounts from one address
+ *   rapid-fire    one account, a scripted guess every second
+ *   enumeration   logins as 40 usernames, most of which do not exist
+ *   mfa-guessing  a stolen password, then a TOTP guess every 10 s
+ *
+ * Usage: attack_sim [--users U] [--days D] [--warmup-days W] [--attacks N]
+ *            [--seed S] [--rules FILE] [--json FILE]
+ */
+
+#include "credential_store.h"
+#include "intrusion_checks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+const uint64_t SIM_STORE_BUDGET = 64ull << 20;
+const int64_t SIM_TOTP_PERIOD_MS = 30 * 1000;
+const unsigned SIM_TOTP_DIGITS = 6;
+const char SIM_GUESS[] = "Winter2026!"; // every attacker's password guess
+const char SIM_DEFAULT_RULES[] = "MFA_GUESSING: LOGIN:SUCCESS TOTP:FAILURE{3}\n";
+
+struct SimOptions {
+  uint32_t users;
+  uint32_t days;
+  uint32_t warmup_days;
+  uint32_t attacks; // of each kind
+  uint64_t seed;
+  std::string rules_path;
+  std::string json_path;
+  IntrusionThresholds thresholds;
+};
+
+enum SimAttackKind {
+  SIM_BRUTE_FORCE,
+  SIM_SPRAYING,
+  SIM_RAPID_FIRE,
+  SIM_ENUMERATION,
+  SIM_MFA_GUESSING,
+  SIM_KIND_COUNT
+};
+
+static const char *const SIM_KIND_NAMES[SIM_KIND_COUNT] = {
+    "brute-force", "spraying", "rapid-fire", "enumeration", "mfa-guessing"};
+
+struct SimEvent {
+  int64_t ts_ms;
+  uint32_t name;    // index into SimTraffic::names
+  uint32_t ip;      // index into SimTraffic::ips
+  bool totp;        // else a login
+  bool correct;     // right password (login)
+  int code;         // TOTP code entered
+  int totp_offset;  // step the code is for, relative to ts_ms
+  int32_t attack;   // index into SimTraffic::attacks, -1 for background
+};
+
+struct SimAttack {
+  SimAttackKind kind;
+  int64_t start_ms;
+  int64_t end_ms;
+  std::vector<int64_t> times; // of its events, sorted
+  int64_t detected_ms;        // first alert credited to it, or -1
+  std::string first_alert;
+};
+
+struct SimTraffic {
+  std::vector<std::string> names; // users first, then made-up usernames
+  std::vector<std::string> passwords; // of the users
+  std::vector<std::string> secrets;   // of the users, raw TOTP secret bytes
+  std::vector<HmacSha1Key> keys;      // ... with the HMAC pads absorbed
+  std::vector<std::string> ips;
+  std::vector<SimEvent> events;
+  std::vector<SimAttack> attacks;
+  int64_t start_ms;
+  int64_t warm_ms; // end of the warm-up
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// --- Traffic ---
+
+// The engine alone is specified exactly; std:: distributions are not, and
+// would give other traffic on another standard library
+class SimRandom {
+private:
+  std::mt19937_64 m_engine;
+
+public:
+  explicit SimRandom(uint64_t seed) : m_engine(seed) {}
+
+  uint64_t below(uint64_t n) { return m_engine() % n; }
+  double unit() { return (double)(m_engine() >> 11) / (double)(1ull << 53); }
+  bool chance(double p) { return unit() < p; }
+  // Roughly normal, from the sum of four uniforms
+  double normal(double mean, double sd) {
+    double sum = unit() + unit() + unit() + unit();
+    return mean + (sum - 2.0) * sd * 1.7320508;
+  }
+};
+
+static int totp_code(const SimTraffic &traffic, uint32_t user, int64_t ts_ms,
+                     int offset) {
+  uint64_t step = (uint64_t)(ts_ms / SIM_TOTP_PERIOD_MS) + offset;
+  return (int)hotp_sha1(traffic.keys[user], step, SIM_TOTP_DIGITS);
+}
+
+static uint32_t add_ip(SimTraffic *traffic, const std::string &ip) {
+  traffic->ips.push_back(ip);
+  return (uint32_t)traffic->ips.size() - 1;
+}
+
+static void add_login(SimTraffic *traffic, int64_t ts_ms, uint32_t name,
+                      uint32_t ip, bool correct, int32_t attack) {
+  traffic->events.push_back({ts_ms, name, ip, false, correct, 0, 0, attack});
+}
+
+static void add_totp(SimTraffic *traffic, int64_t ts_ms, uint32_t name,
+                     uint32_t ip, int code, int offset, int32_t attack) {
+  traffic->events.push_back({ts_ms, name, ip, true, false, code, offset,
+                             attack});
+}
+
+// Each user has a usual hour, a home network and two others they sometimes
+// use; most log in on most weekdays, mistype now and then, and enter the
+// TOTP code shortly after the password
+static void generate_background(const SimOptions &opts, SimRandom &rng,
+                                SimTraffic *traffic) {
+  std::vector<uint32_t> networks;
+  std::vector<double> usual_hours;
+  for (uint32_t u = 0; u < opts.users; u++) {
+    char name[32];
+    snprintf(name, sizeof(name), "user%05u", u);
+    traffic->names.push_back(name);
+    traffic->passwords.push_back("pw-" + std::to_string(rng.below(1u << 30)));
+    std::string secret(20, '\0');
+    for (char &b : secret)
+      b = (char)rng.below(256);
+    HmacSha1Key key;
+    hmac_sha1_precompute(&key, (const uint8_t *)secret.data(), secret.size());
+    traffic->secrets.push_back(secret);
+    traffic->keys.push_back(key);
+    for (int n = 0; n < 3; n++) {
+      char ip[32];
+      snprintf(ip, sizeof(ip), "10.%u.%u.%u", (unsigned)rng.below(256),
+               (unsigned)rng.below(256), 1 + (unsigned)rng.below(254));
+      networks.push_back(add_ip(traffic, ip));
+    }
+    usual_hours.push_back(rng.normal(10.5, 1.5));
+  }
+
+  for (uint32_t day = 0; day < opts.days; day++) {
+    struct tm t;
+    time_t start = (time_t)(traffic->start_ms / 1000);
+#ifdef _WIN32
+    localtime_s(&t, &start);
+#else
+    localtime_r(&start, &t);
+#endif
+    t.tm_mday += day;
+    t.tm_isdst = -1;
+    int64_t midnight = (int64_t)mktime(&t) * 1000;
+    bool weekend = t.tm_wday == 0 || t.tm_wday == 6;
+
+    for (uint32_t u = 0; u < opts.users; u++) {
+      if (!rng.chance(weekend ? 0.25 : 0.85))
+        continue;
+      double hour = std::min(std::max(rng.normal(usual_hours[u], 1.0), 0.0), 23.9);
+      int64_t ts = midnight + (int64_t)(hour * 3600 * 1000);
+      double where = rng.unit();
+      uint32_t ip = networks[u * 3 + (where < 0.8 ? 0 : where < 0.95 ? 1 : 2)];
+      if (rng.chance(0.002)) { // travelling
+        char addr[32];
+        snprintf(addr, sizeof(addr), "172.%u.%u.%u",
+                 16 + (unsigned)rng.below(16), (unsigned)rng.below(256),
+                 1 + (unsigned)rng.below(254));
+        ip = add_ip(traffic, addr);
+      }
+
+      uint64_t typos = rng.chance(0.05) ? 1 + rng.below(rng.chance(0.2) ? 3 : 1)
+                                        : 0;
+      for (uint64_t i = 0; i < typos; i++) {
+        add_login(traffic, ts, u, ip, false, -1);
+        ts += 4000 + (int64_t)rng.below(8000);
+      }
+      add_login(traffic, ts, u, ip, true, -1);
+      ts += 5000 + (int64_t)rng.below(20000);
+      if (rng.chance(0.01)) { // mistyped code
+        add_totp(traffic, ts, u, ip, (int)rng.below(1000000), 0, -1);
+        ts += 5000 + (int64_t)rng.below(10000);
+      }
+      int offset = rng.chance(0.03) ? -1 : 0; // slow to type
+      add_totp(traffic, ts, u, ip, totp_code(*traffic, u, ts, offset), offset,
+               -1);
+    }
+  }
+}
+
+static void launch_attack(SimAttackKind kind, int64_t start_ms,
+                          SimRandom &rng, SimTraffic *traffic) {
+  int32_t attack = (int32_t)traffic->attacks.size();
+  uint32_t users = (uint32_t)traffic->passwords.size();
+  char addr[32];
+  snprintf(addr, sizeof(addr), "203.0.113.%u", 1 + (unsigned)rng.below(254));
+  uint32_t ip = add_ip(traffic, addr);
+  uint32_t target = (uint32_t)rng.below(users);
+  int64_t ts = start_ms;
+
+  switch (kind) {
+  case SIM_BRUTE_FORCE:
+    for (int i = 0; i < 30; i++, ts += 20000)
+      add_login(traffic, ts, target, ip, false, attack);
+    break;
+  case SIM_SPRAYING:
+    for (int i = 0; i < 40; i++, ts += 5000)
+      add_login(traffic, ts, (uint32_t)rng.below(users), ip, false, attack);
+    break;
+  case SIM_RAPID_FIRE:
+    for (int i = 0; i < 20; i++, ts += 1000)
+      add_login(traffic, ts, target, ip, false, attack);
+    break;
+  case SIM_ENUMERATION:
+    for (int i = 0; i < 40; i++, ts += 3000) {
+      uint32_t name = (uint32_t)rng.below(users);
+      if (rng.chance(0.8)) {
+        traffic->names.push_back("probe" + std::to_string(rng.below(1u << 30)));
+        name = (uint32_t)traffic->names.size() - 1;
+      }
+      add_login(traffic, ts, name, ip, false, attack);
+    }
+    break;
+  case SIM_MFA_GUESSING:
+    add_login(traffic, ts, target, ip, true, attack);
+    for (int i = 0; i < 8; i++) {
+      ts += 10000;
+      add_totp(traffic, ts, target, ip, (int)rng.below(1000000), 0, attack);
+    }
+    break;
+  default:
+    break;
+  }
+  traffic->attacks.push_back({kind, start_ms, ts, {}, -1, std::string()});
+}
+
+static void generate_traffic(const SimOptions &opts, SimTraffic *traffic) {
+  SimRandom rng(opts.seed);
+  // A fixed Monday, local midnight
+  struct tm t;
+  memset(&t, 0, sizeof(t));
+  t.tm_year = 2026 - 1900;
+  t.tm_mon = 0;
+  t.tm_mday = 5;
+  t.tm_isdst = -1;
+  traffic->start_ms = (int64_t)mktime(&t) * 1000;
+  traffic->warm_ms = traffic->start_ms + (int64_t)opts.warmup_days * 86400000;
+  generate_background(opts, rng, traffic);
+
+  // Attacks at any hour after the warm-up
+  int64_t span = (int64_t)(opts.days - opts.warmup_days) * 86400000 - 3600000;
+  for (uint32_t i = 0; i < opts.attacks; i++)
+    for (int kind = 0; kind < SIM_KIND_COUNT; kind++)
+      launch_attack((SimAttackKind)kind,
+                    traffic->warm_ms + (int64_t)rng.below((uint64_t)span), rng,
+                    traffic);
+
+  std::stable_sort(traffic->events.begin(), traffic->events.end(),
+                   [](const SimEvent &a, const SimEvent &b) {
+                     return a.ts_ms < b.ts_ms;
+                   });
+  for (const SimEvent &ev : traffic->events)
+    if (ev.attack >= 0)
+      traffic->attacks[ev.attack].times.push_back(ev.ts_ms);
+}
+
+static bool write_snapshot(const SimTraffic &traffic, const std::string &path) {
+  std::vector<SnapshotRecord> records(traffic.passwords.size());
+  for (size_t u = 0; u < records.size(); u++) {
+    SnapshotRecord &rec = records[u];
+    memset(&rec, 0, sizeof(rec));
+    const std::string &name = traffic.names[u];
+    rec.key_hash = fnv1a64(name.data(), name.size());
+    rec.name_len = (uint8_t)name.size();
+    rec.rowid = (uint32_t)u + 1;
+    memcpy(rec.name, name.data(), name.size());
+    const std::string &password = traffic.passwords[u];
+    sha256((const uint8_t *)password.data(), password.size(),
+           rec.password_sha256);
+    const std::string &secret = traffic.secrets[u];
+    rec.secret_len = (uint8_t)secret.size();
+    memcpy(rec.totp_secret, secret.data(), secret.size());
+  }
+  return snapshot_write(path.c_str(), records, records.size());
+}
+
+// --- Report ---
+
+struct SimKindReport {
+  uint32_t launched;
+  uint32_t detected;
+  std::vector<double> latency_s;
+  std::vector<double> attempts;
+  std::map<std::string, uint32_t> first_alerts;
+};
+
+struct SimReport {
+  uint64_t events;
+  uint64_t attack_events;
+  uint64_t background_events; // after the warm-up
+  double auth_s;
+  double detect_s;
+  SimKindReport kinds[SIM_KIND_COUNT];
+  uint64_t false_alerts;
+  uint32_t false_users;
+  std::map<std::string, uint64_t> false_by_type;
+};
+
+static double percentile(std::vector<double> values, double p) {
+  if (values.empty())
+    return -1;
+  std::sort(values.begin(), values.end());
+  return values[(size_t)(p * (values.size() - 1) + 0.5)];
+}
+
+static void print_report(const SimOptions &opts, const SimReport &r) {
+  printf("attack_sim: %u users, %u days (%u warm-up), seed %llu\n", opts.users,
+         opts.days, opts.warmup_days, (unsigned long long)opts.seed);
+  printf("  thresholds: %u failures in %lld min, %u attempts in 1 min\n",
+         opts.thresholds.failed_attempts,
+         (long long)opts.thresholds.window_minutes,
+         opts.thresholds.rapid_attempts);
+  printf("  traffic: %llu events, %llu of them attacks\n",
+         (unsigned long long)r.events, (unsigned long long)r.attack_events);
+  printf("  throughput: credentials %.0f events/s, detection %.0f events/s, "
+         "together %.0f events/s\n",
+         r.events / std::max(r.auth_s, 1e-9),
+         r.events / std::max(r.detect_s, 1e-9),
+         r.events / std::max(r.auth_s + r.detect_s, 1e-9));
+  printf("\n  %-13s %8s %8s %10s %10s %9s  %s\n", "attack", "launched",
+         "detected", "median_s", "p90_s", "attempts", "first alert");
+  for (int k = 0; k < SIM_KIND_COUNT; k++) {
+    const SimKindReport &kr = r.kinds[k];
+    std::string first;
+    for (const auto &entry : kr.first_alerts)
+      first += (first.empty() ? "" : ", ") + entry.first + " x" +
+               std::to_string(entry.second);
+    if (!kr.detected) {
+      printf("  %-13s %8u %8u %10s %10s %9s  -\n", SIM_KIND_NAMES[k],
+             kr.launched, 0u, "-", "-", "-");
+      continue;
+    }
+    printf("  %-13s %8u %8u %10.0f %10.0f %9.0f  %s\n", SIM_KIND_NAMES[k],
+           kr.launched, kr.detected, percentile(kr.latency_s, 0.5),
+           percentile(kr.latency_s, 0.9), percentile(kr.attempts, 0.5),
+           first.c_str());
+  }
+  printf("\n  false positives: %llu alerts on %u users, %.3f per 1000 "
+         "background events\n",
+         (unsigned long long)r.false_alerts, r.false_users,
+         r.background_events ? 1000.0 * r.false_alerts / r.background_events
+                             : 0.0);
+  for (const auto &entry : r.false_by_type)
+    printf("    %-24s %llu\n", entry.first.c_str(),
+           (unsigned long long)entry.second);
+}
+
+static bool write_json(const SimOptions &opts, const SimReport &r,
+                       const std::string &path) {
+  FILE *f = fopen(path.c_str(), "w");
+  if (!f)
+    return false;
+  fprintf(f,
+          "{\"users\": %u, \"days\": %u, \"warmup_days\": %u, \"seed\": %llu, "
+          "\"events\": %llu, \"attack_events\": %llu,\n"
+          " \"credential_events_per_s\": %.0f, \"detection_events_per_s\": "
+          "%.0f, \"events_per_s\": %.0f,\n \"attacks\": {",
+          opts.users, opts.days, opts.warmup_days,
+          (unsigned long long)opts.seed, (unsigned long long)r.events,
+          (unsigned long long)r.attack_events,
+          r.events / std::max(r.auth_s, 1e-9),
+          r.events / std::max(r.detect_s, 1e-9),
+          r.events / std::max(r.auth_s + r.detect_s, 1e-9));
+  for (int k = 0; k < SIM_KIND_COUNT; k++) {
+    const SimKindReport &kr = r.kinds[k];
+    fprintf(f,
+            "%s\n  \"%s\": {\"launched\": %u, \"detected\": %u, "
+            "\"median_latency_s\": %.0f, \"p90_latency_s\": %.0f, "
+            "\"median_attempts\": %.0f}",
+            k ? "," : "", SIM_KIND_NAMES[k], kr.launched, kr.detected,
+            percentile(kr.latency_s, 0.5), percentile(kr.latency_s, 0.9),
+            percentile(kr.attempts, 0.5));
+  }
+  fprintf(f,
+          "},\n \"false_positives\": {\"alerts\": %llu, \"users\": %u, "
+          "\"per_1000_events\": %.3f, \"by_type\": {",
+          (unsigned long long)r.false_alerts, r.false_users,
+          r.background_events ? 1000.0 * r.false_alerts / r.background_events
+                              : 0.0);
+  bool first = true;
+  for (const auto &entry : r.false_by_type) {
+    fprintf(f, "%s\"%s\": %llu", first ? "" : ", ", entry.first.c_str(),
+            (unsigned long long)entry.second);
+    first = false;
+  }
+  fprintf(f, "}}}\n");
+  return fclose(f) == 0;
+}
+
+// --- Simulation ---
+
+// An alert is credited to the attack whose event raised it, or to the
+// latest attack on the user if it is still within the window (a legitimate
+// login tripping over the attacker's failures); otherwise it is false.
+static void attribute(const SimOptions &opts, SimTraffic &traffic,
+                      const std::vector<std::pair<size_t, IntrusionAlert>> &alerts,
+                      SimReport *r) {
+  std::unordered_map<uint32_t, int32_t> targets; // user name -> attack
+  std::unordered_map<uint32_t, bool> false_users;
+  int64_t window_ms = opts.thresholds.window_minutes * 60000;
+  size_t next = 0;
+  for (size_t i = 0; i < traffic.events.size(); i++) {
+    const SimEvent &ev = traffic.events[i];
+    if (ev.attack >= 0)
+      targets[ev.name] = ev.attack;
+    for (; next < alerts.size() && alerts[next].first == i; next++) {
+      const IntrusionAlert &alert = alerts[next].second;
+      int32_t credit = ev.attack;
+      auto it = targets.find(ev.name);
+      if (credit < 0 && it != targets.end() &&
+          alert.ts_ms <= traffic.attacks[it->second].end_ms + window_ms)
+        credit = it->second;
+      if (credit < 0) {
+        if (ev.ts_ms >= traffic.warm_ms) {
+          r->false_alerts++;
+          r->false_by_type[alert.type]++;
+          false_users[ev.name] = true;
+        }
+        continue;
+      }
+      SimAttack &attack = traffic.attacks[credit];
+      if (attack.detected_ms < 0) {
+        attack.detected_ms = alert.ts_ms;
+        attack.first_alert = alert.type;
+      }
+    }
+  }
+  r->false_users = (uint32_t)false_users.size();
+
+  for (const SimAttack &attack : traffic.attacks) {
+    SimKindReport &kr = r->kinds[attack.kind];
+    kr.launched++;
+    if (attack.detected_ms < 0)
+      continue;
+    kr.detected++;
+    kr.latency_s.push_back((attack.detected_ms - attack.start_ms) / 1000.0);
+    kr.attempts.push_back(
+        (double)(std::upper_bound(attack.times.begin(), attack.times.end(),
+                                  attack.detected_ms) -
+                 attack.times.begin()));
+    kr.first_alerts[attack.first_alert]++;
+  }
+}
+
+static int run(const SimOptions &opts, const std::string &rules) {
+  SimTraffic traffic;
+  generate_traffic(opts, &traffic);
+
+  std::string snapshot = "attack_sim." + std::to_string(getpid()) + ".snap";
+  if (!write_snapshot(traffic, snapshot)) {
+    fprintf(stderr, "Error: cannot write %s\n", snapshot.c_str());
+    return 1;
+  }
+  SimReport r;
+  r.events = traffic.events.size();
+  r.attack_events = 0;
+  r.background_events = 0;
+  r.false_alerts = 0;
+  r.false_users = 0;
+  for (SimKindReport &kr : r.kinds) {
+    kr.launched = 0;
+    kr.detected = 0;
+  }
+
+  // Credential checks, as the service makes them before logging. The store
+  // saves its warm list next to the snapshot when it closes, so both files
+  // go once it is gone.
+  std::vector<uint8_t> accepted(traffic.events.size());
+  bool opened;
+  {
+    TieredStore store(SIM_STORE_BUDGET);
+    opened = store.open(snapshot.c_str(), nullptr);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; opened && i < traffic.events.size(); i++) {
+      const SimEvent &ev = traffic.events[i];
+      const char *name = traffic.names[ev.name].c_str();
+      if (ev.totp)
+        accepted[i] =
+            store.verify_totp(name, ev.code, (time_t)(ev.ts_ms / 1000));
+      else
+        accepted[i] = store.verify_password(
+            name, ev.correct ? traffic.passwords[ev.name].c_str() : SIM_GUESS);
+    }
+    r.auth_s = seconds_since(start);
+  }
+  remove(snapshot.c_str());
+  remove((snapshot + ".warm").c_str());
+  if (!opened) {
+    fprintf(stderr, "Error: cannot open %s\n", snapshot.c_str());
+    return 1;
+  }
+
+  // Detection over the results
+  IntrusionChecks checks(opts.thresholds);
+  std::string error;
+  if (!checks.set_rules(rules, &error)) {
+    fprintf(stderr, "Error: rules: %s\n", error.c_str());
+    return 1;
+  }
+  SymbolTable &symbols = global_symbols();
+  uint32_t login = symbols.intern("LOGIN"), totp = symbols.intern("TOTP");
+  uint32_t success = symbols.intern("SUCCESS");
+  uint32_t failure = symbols.intern("FAILURE");
+  std::vector<IntrusionAlert> raised;
+  std::vector<std::pair<size_t, IntrusionAlert>> alerts;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < traffic.events.size(); i++) {
+    const SimEvent &ev = traffic.events[i];
+    IntrusionEvent in;
+    in.ts_ms = ev.ts_ms;
+    in.user = symbols.intern(traffic.names[ev.name]);
+    in.event_type = ev.totp ? totp : login;
+    in.status = accepted[i] ? success : failure;
+    in.ip_prefix = intrusion_ip_prefix(traffic.ips[ev.ip].c_str());
+    in.totp_offset = ev.totp && accepted[i] ? ev.totp_offset : PROFILE_NO_TOTP;
+    if (checks.check(in, &raised)) {
+      for (IntrusionAlert &alert : raised)
+        alerts.emplace_back(i, std::move(alert));
+      raised.clear();
+    }
+  }
+  r.detect_s = seconds_since(start);
+
+  for (const SimEvent &ev : traffic.events) {
+    if (ev.attack >= 0)
+      r.attack_events++;
+    else if (ev.ts_ms >= traffic.warm_ms)
+      r.background_events++;
+  }
+  attribute(opts, traffic, alerts, &r);
+  print_report(opts, r);
+  if (!opts.json_path.empty() && !write_json(opts, r, opts.json_path)) {
+    fprintf(stderr, "Error: cannot write %s\n", opts.json_path.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+// --- Main ---
+
+static int usage() {
+  fprintf(stderr,
+          "Usage: attack_sim [--users U] [--days D] [--warmup-days W] "
+          "[--attacks N]\n"
+          "           [--seed S] [--rules FILE] [--json FILE]\n");
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  SimOptions opts;
+  opts.users = 5000;
+  opts.days = 28;
+  opts.warmup_days = 14;
+  opts.attacks = 20;
+  opts.seed = 1;
+  opts.thresholds.failed_attempts = 5;
+  opts.thresholds.window_minutes = 15;
+  opts.thresholds.rapid_attempts = 10;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc)
+      return usage();
+    if (strcmp(argv[i], "--users") == 0)
+      opts.users = (uint32_t)std::max(1, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--days") == 0)
+      opts.days = (uint32_t)std::max(2, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--warmup-days") == 0)
+      opts.warmup_days = (uint32_t)std::max(0, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--attacks") == 0)
+      opts.attacks = (uint32_t)std::max(0, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--seed") == 0)
+      opts.seed = strtoull(argv[++i], nullptr, 10);
+    else if (strcmp(argv[i], "--rules") == 0)
+      opts.rules_path = argv[++i];
+    else if (strcmp(argv[i], "--json") == 0)
+      opts.json_path = argv[++i];
+    else
+      return usage();
+  }
+  if (opts.warmup_days >= opts.days)
+    return usage();
+
+  std::string rules = SIM_DEFAULT_RULES;
+  if (!opts.rules_path.empty()) {
+    FILE *f = fopen(opts.rules_path.c_str(), "rb");
+    if (!f) {
+      fprintf(stderr, "Error: cannot read %s\n", opts.rules_path.c_str());
+      return 1;
+    }
+    rules.clear();
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+      rules.append(buf, n);
+    fclose(f);
+  }
+  return run(opts, rules);
+}
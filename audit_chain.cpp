@@ -0,0 +1,269 @@
+#include "audit_chain.h"
+
+#include "crypto_core.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static bool truncate_file(FILE *f, long size) {
+#ifdef _WIN32
+  return _chsize(_fileno(f), size) == 0;
+#else
+  return ftruncate(fileno(f), (off_t)size) == 0;
+#endif
+}
+
+uint32_t audit_commit_check(const AuditCommit &commit) {
+  uint64_t h = fnv1a64(&commit, offsetof(AuditCommit, check));
+  return (uint32_t)(h ^ (h >> 32));
+}
+
+// --- Merkle Tree ---
+
+void audit_leaf_input(const void *body, size_t body_len, const char *payload,
+                      size_t payload_len, std::string *out) {
+  out->assign(1, '\0');
+  out->append((const char *)body, body_len);
+  out->append(payload, payload_len);
+}
+
+void audit_leaf_hashes(const std::vector<std::string> &inputs,
+                       std::vector<AuditDigest> *out) {
+  std::vector<const uint8_t *> data(inputs.size());
+  std::vector<size_t> len(inputs.size());
+  for (size_t i = 0; i < inputs.size(); i++) {
+    data[i] = (const uint8_t *)inputs[i].data();
+    len[i] = inputs[i].size();
+  }
+  out->resize(inputs.size());
+  sha256_many(data.data(), len.data(), inputs.size(),
+              (uint8_t(*)[32])out->data());
+}
+
+// Parents of one level; an odd last node moves up unchanged
+static void merkle_level(const std::vector<AuditDigest> &level,
+                         std::vector<AuditDigest> *next) {
+  size_t pairs = level.size() / 2;
+  std::vector<uint8_t> nodes(pairs * 65);
+  std::vector<const uint8_t *> data(pairs);
+  std::vector<size_t> len(pairs, 65);
+  for (size_t i = 0; i < pairs; i++) {
+    uint8_t *node = &nodes[i * 65];
+    node[0] = 0x01;
+    memcpy(node + 1, level[2 * i].bytes, 32);
+    memcpy(node + 33, level[2 * i + 1].bytes, 32);
+    data[i] = node;
+  }
+  next->resize((level.size() + 1) / 2);
+  sha256_many(data.data(), len.data(), pairs, (uint8_t(*)[32])next->data());
+  if (level.size() % 2)
+    next->back() = level.back();
+}
+
+void audit_merkle_root(const std::vector<AuditDigest> &leaves,
+                       AuditDigest *root) {
+  if (leaves.empty()) {
+    memset(root->bytes, 0, 32);
+    return;
+  }
+  std::vector<AuditDigest> level = leaves, next;
+  while (level.size() > 1) {
+    merkle_level(level, &next);
+    level.swap(next);
+  }
+  *root = level[0];
+}
+
+void audit_merkle_path(const std::vector<AuditDigest> &leaves, size_t index,
+                       std::vector<AuditDigest> *path) {
+  path->clear();
+  std::vector<AuditDigest> level = leaves, next;
+  while (level.size() > 1) {
+    if ((index ^ 1) < level.size())
+      path->push_back(level[index ^ 1]);
+    merkle_level(level, &next);
+    level.swap(next);
+    index >>= 1;
+  }
+}
+
+bool audit_merkle_verify(const AuditDigest &leaf, size_t index, size_t count,
+                         const AuditDigest *path, size_t path_len,
+                         const AuditDigest &root) {
+  if (index >= count)
+    return false;
+  AuditDigest h = leaf;
+  size_t used = 0;
+  for (size_t size = count; size > 1; size = (size + 1) / 2, index >>= 1) {
+    if ((index ^ 1) >= size)
+      continue;
+    if (used == path_len)
+      return false;
+    uint8_t node[65];
+    node[0] = 0x01;
+    const AuditDigest &left = index & 1 ? path[used] : h;
+    const AuditDigest &right = index & 1 ? h : path[used];
+    memcpy(node + 1, left.bytes, 32);
+    memcpy(node + 33, right.bytes, 32);
+    sha256(node, sizeof(node), h.bytes);
+    used++;
+  }
+  return used == path_len && memcmp(h.bytes, root.bytes, 32) == 0;
+}
+
+// --- Chain ---
+
+void audit_chain_link(const uint8_t prev_chain[32], AuditCommit *commit) {
+  uint8_t input[32 + 32 + 8 + 8 + 4];
+  memcpy(input, prev_chain, 32);
+  memcpy(input + 32, commit->root, 32);
+  memcpy(input + 64, &commit->batch, 8);
+  memcpy(input + 72, &commit->first_event_id, 8);
+  memcpy(input + 80, &commit->count, 4);
+  sha256(input, sizeof(input), commit->chain);
+}
+
+bool audit_proof_verify(const AuditProof &proof) {
+  AuditDigest leaf, root;
+  memcpy(leaf.bytes, proof.leaf, 32);
+  memcpy(root.bytes, proof.root, 32);
+  if (proof.path_len > AUDIT_PROOF_MAX_DEPTH ||
+      proof.event_id < proof.leaf_index ||
+      !audit_merkle_verify(leaf, proof.leaf_index, proof.leaf_count,
+                           (const AuditDigest *)proof.path, proof.path_len,
+                           root))
+    return false;
+
+  AuditCommit commit;
+  memset(&commit, 0, sizeof(commit));
+  commit.count = proof.leaf_count;
+  commit.batch = proof.batch;
+  commit.first_event_id = proof.event_id - proof.leaf_index;
+  memcpy(commit.root, proof.root, 32);
+  audit_chain_link(proof.prev_chain, &commit);
+  return memcmp(commit.chain, proof.chain, 32) == 0;
+}
+
+// --- AuditChain ---
+
+AuditChain::AuditChain()
+    : m_file(nullptr), m_pending_first(0), m_pending_segment(0) {}
+
+AuditChain::~AuditChain() { close(); }
+
+bool AuditChain::open(const char *path) {
+  close();
+  m_file = fopen(path, "r+b");
+  if (!m_file)
+    m_file = fopen(path, "w+b");
+  if (!m_file)
+    return false;
+
+  AuditCommit commit;
+  while (fread(&commit, 1, sizeof(commit), m_file) == sizeof(commit))
+    m_commits.push_back(commit);
+
+  long end = (long)(m_commits.size() * sizeof(AuditCommit));
+  if (fseek(m_file, 0, SEEK_END) == 0 && ftell(m_file) != end) {
+    fflush(m_file);
+    truncate_file(m_file, end);
+  }
+  return fseek(m_file, end, SEEK_SET) == 0;
+}
+
+void AuditChain::close() {
+  if (m_file)
+    fclose(m_file);
+  m_file = nullptr;
+  m_commits.clear();
+  m_pending.clear();
+}
+
+uint64_t AuditChain::next_event_id() const {
+  if (m_commits.empty())
+    return 1;
+  return m_commits.back().first_event_id + m_commits.back().count;
+}
+
+bool AuditChain::add(uint32_t segment, uint64_t event_id, const void *body,
+                     size_t body_len, const char *payload,
+                     size_t payload_len) {
+  bool ok = true;
+  if (!m_pending.empty() &&
+      (segment != m_pending_segment ||
+       event_id != m_pending_first + m_pending.size()))
+    ok = commit();
+  if (m_pending.empty()) {
+    m_pending_first = event_id;
+    m_pending_segment = segment;
+  }
+  m_pending.emplace_back();
+  audit_leaf_input(body, body_len, payload, payload_len, &m_pending.back());
+  if (m_pending.size() >= AUDIT_COMMIT_MAX_EVENTS)
+    ok &= commit();
+  return ok;
+}
+
+bool AuditChain::commit() {
+  if (m_pending.empty())
+    return true;
+  if (!m_file)
+    return false;
+
+  std::vector<AuditDigest> leaves;
+  audit_leaf_hashes(m_pending, &leaves);
+
+  AuditCommit commit;
+  memset(&commit, 0, sizeof(commit));
+  commit.marker = AUDIT_COMMIT_MARKER;
+  commit.count = (uint32_t)m_pending.size();
+  commit.batch = m_commits.size();
+  commit.first_event_id = m_pending_first;
+  AuditDigest root;
+  audit_merkle_root(leaves, &root);
+  memcpy(commit.root, root.bytes, 32);
+  uint8_t zero[32] = {0};
+  audit_chain_link(m_commits.empty() ? zero : m_commits.back().chain, &commit);
+  commit.check = audit_commit_check(commit);
+
+  long end = (long)(m_commits.size() * sizeof(AuditCommit));
+  if (fwrite(&commit, 1, sizeof(commit), m_file) != sizeof(commit) ||
+      fflush(m_file) != 0) {
+    // Keep the batch pending and the file on a commit boundary
+    fseek(m_file, end, SEEK_SET);
+    truncate_file(m_file, end);
+    return false;
+  }
+  m_commits.push_back(commit);
+  m_pending.clear();
+  return true;
+}
+
+bool AuditChain::sync() {
+  if (!commit() || !m_file || fflush(m_file) != 0)
+    return false;
+#ifndef _WIN32
+  return fsync(fileno(m_file)) == 0;
+#else
+  return true;
+#endif
+}
+
+const AuditCommit *AuditChain::find(uint64_t event_id) const {
+  auto it = std::upper_bound(
+      m_commits.begin(), m_commits.end(), event_id,
+      [](uint64_t id, const AuditCommit &c) { return id < c.first_event_id; });
+  if (it == m_commits.begin())
+    return nullptr;
+  --it;
+  if (event_id >= it->first_event_id + it->count)
+    return nullptr;
+  return &*it;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// --- Audit Hash Chain ---
+// Tamper evidence for the native audit log. Records are committed in
+// batches of up to AUDIT_COMMIT_MAX_EVENTS consecutive events (a batch
+// never spans segments). Each batch gets a Merkle root over its records,
+// and the commits are hash-chained:
+//
+//   leaf   = SHA-256(0x00 || record body || payload)
+//   node   = SHA-256(0x01 || left || right)   (an odd last node moves up)
+//   chain  = SHA-256(previous chain || root || batch || first id || count)
+//
+// Commits are appended to chain.log next to the segments. Editing,
+// removing or reordering a record changes its batch root and every chain
+// value after it; publishing the head chain value elsewhere pins the whole
+// log. Leaves and each tree level are hashed with sha256_many().
+
+const uint32_t AUDIT_COMMIT_MARKER = 0xA0D1C4A1;
+const size_t AUDIT_COMMIT_MAX_EVENTS = 1024;
+const size_t AUDIT_PROOF_MAX_DEPTH = 16; // log2(AUDIT_COMMIT_MAX_EVENTS) + slack
+
+struct AuditDigest {
+  uint8_t bytes[32];
+};
+
+struct AuditCommit {
+  uint32_t marker;
+  uint32_t count; // events in the batch
+  uint64_t batch; // 0-based position in chain.log
+  uint64_t first_event_id;
+  uint8_t root[32];
+  uint8_t chain[32];
+  uint32_t check; // over the fields above
+  uint32_t reserved;
+};
+
+// Layout shared with Python (ctypes.Structure)
+struct AuditProof {
+  uint64_t event_id;
+  uint64_t batch;
+  uint32_t leaf_index;
+  uint32_t leaf_count;
+  uint32_t path_len;
+  uint32_t reserved;
+  uint8_t leaf[32];
+  uint8_t path[AUDIT_PROOF_MAX_DEPTH][32];
+  uint8_t prev_chain[32]; // chain value of the batch before (zeros for 0)
+  uint8_t root[32];
+  uint8_t chain[32];
+};
+
+static_assert(sizeof(AuditCommit) == 96, "commit layout");
+
+uint32_t audit_commit_check(const AuditCommit &commit);
+
+// 0x00 || record, the input of a leaf hash
+void audit_leaf_input(const void *body, size_t body_len, const char *payload,
+                      size_t payload_len, std::string *out);
+
+void audit_leaf_hashes(const std::vector<std::string> &inputs,
+                       std::vector<AuditDigest> *out);
+
+void audit_merkle_root(const std::vector<AuditDigest> &leaves,
+                       AuditDigest *root);
+
+// Siblings from the leaf up; levels where the node has none are skipped
+void audit_merkle_path(const std::vector<AuditDigest> &leaves, size_t index,
+                       std::vector<AuditDigest> *path);
+
+bool audit_merkle_verify(const AuditDigest &leaf, size_t index, size_t count,
+                         const AuditDigest *path, size_t path_len,
+                         const AuditDigest &root);
+
+// Fill commit->chain from the previous batch's chain value
+void audit_chain_link(const uint8_t prev_chain[32], AuditCommit *commit);
+
+// Leaf -> root -> chain, all from the proof itself
+bool audit_proof_verify(const AuditProof &proof);
+
+//
+// AuditChain - batches record leaves and appends commits to chain.log
+//
+class AuditChain {
+private:
+  FILE *m_file;
+  std::vector<AuditCommit> m_commits;
+  std::vector<std::string> m_pending; // leaf inputs
+  uint64_t m_pending_first;
+  uint32_t m_pending_segment;
+
+public:
+  AuditChain();
+  ~AuditChain();
+
+  AuditChain(const AuditChain &) = delete;
+  AuditChain &operator=(const AuditChain &) = delete;
+
+  // Load chain.log; a partially written last commit is cut off. Links are
+  // not checked here - that is audit_verify's job.
+  bool open(const char *path);
+  void close();
+
+  // First event ID not covered by a commit
+  uint64_t next_event_id() const;
+
+  // Queue a record for the current batch. A new segment or a gap in IDs
+  // commits the batch first; a full batch is committed right away.
+  bool add(uint32_t segment, uint64_t event_id, const void *body,
+           size_t body_len, const char *payload, size_t payload_len);
+
+  bool commit();
+  bool sync();
+
+  size_t pending() const { return m_pending.size(); }
+  const std::vector<AuditCommit> &commits() const { return m_commits; }
+
+  // Commit whose batch holds `event_id`
+  const AuditCommit *find(uint64_t event_id) const;
+};
@@ -0,0 +1,296 @@
+#include "audit_compress.h"
+
+#include "credential_snapshot.h"
+#include "crypto_core.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+#ifdef SECUREAUTH_HAVE_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#ifdef SECUREAUTH_HAVE_ZSTD
+static uint64_t zheader_check(const AuditZHeader &header,
+                              const std::vector<AuditFrameEntry> &frames) {
+  uint64_t h = fnv1a64(&header, offsetof(AuditZHeader, check));
+  return h ^ (fnv1a64(frames.data(), frames.size() * sizeof(AuditFrameEntry)) *
+              0x9E3779B97F4A7C15ULL);
+}
+#endif
+
+bool audit_compression_available() {
+#ifdef SECUREAUTH_HAVE_ZSTD
+  return true;
+#else
+  return false;
+#endif
+}
+
+// --- Compression ---
+
+#ifdef SECUREAUTH_HAVE_ZSTD
+
+static bool read_file(const char *path, uint64_t size, std::vector<char> *out) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  out->resize(size);
+  bool ok = fread(out->data(), 1, size, f) == size;
+  fclose(f);
+  return ok;
+}
+
+bool audit_compress_segment(const char *aud_path, const char *z_path,
+                            uint32_t segment_id,
+                            const AuditSegmentFooter &footer,
+                            AuditCompressStats *stats) {
+  auto start = std::chrono::steady_clock::now();
+  const size_t data_start = sizeof(AuditSegmentHeader);
+  std::vector<char> raw;
+  if (footer.data_end < data_start ||
+      !read_file(aud_path, footer.data_end, &raw) ||
+      memcmp(raw.data(), AUDIT_SEGMENT_MAGIC, 8) != 0)
+    return false;
+
+  // Split into record-aligned frames; each record is also a training sample
+  std::vector<AuditFrameEntry> frames;
+  std::vector<size_t> sample_sizes;
+  for (size_t pos = data_start; pos < raw.size();) {
+    AuditRecordHeader rh;
+    if (raw.size() - pos < sizeof(rh))
+      return false;
+    memcpy(&rh, raw.data() + pos, sizeof(rh));
+    size_t len = sizeof(rh) + rh.length;
+    if (rh.marker != AUDIT_RECORD_MARKER || len > raw.size() - pos)
+      return false;
+
+    if (frames.empty() || frames.back().raw_size + len > AUDIT_FRAME_BYTES)
+      frames.push_back(AuditFrameEntry{pos, 0, 0, 0});
+    frames.back().raw_size += (uint32_t)len;
+    sample_sizes.push_back(len);
+    pos += len;
+  }
+
+  // Train on the most recent records (zstd suggests ~100x the dictionary)
+  size_t sample_bytes = 0;
+  size_t first_sample = sample_sizes.size();
+  while (first_sample > 0 && sample_bytes < AUDIT_DICT_BYTES * 100)
+    sample_bytes += sample_sizes[--first_sample];
+  std::vector<char> dict(AUDIT_DICT_BYTES);
+  size_t dict_size = 0;
+  if (sample_sizes.size() - first_sample >= 16) {
+    dict_size = ZDICT_trainFromBuffer(
+        dict.data(), dict.size(), raw.data() + raw.size() - sample_bytes,
+        sample_sizes.data() + first_sample,
+        (unsigned)(sample_sizes.size() - first_sample));
+    if (ZDICT_isError(dict_size))
+      dict_size = 0;
+  }
+  dict.resize(dict_size);
+
+  std::string tmp = std::string(z_path) + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (!f)
+    return false;
+
+  AuditZHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, AUDIT_ZSEGMENT_MAGIC, 8);
+  header.segment_id = segment_id;
+  header.dict_size = (uint32_t)dict_size;
+  header.frame_count = (uint32_t)frames.size();
+  header.footer = footer;
+
+  ZSTD_CCtx *cctx = ZSTD_createCCtx();
+  ZSTD_CDict *cdict =
+      dict_size ? ZSTD_createCDict(dict.data(), dict_size, AUDIT_ZSTD_LEVEL)
+                : nullptr;
+  std::vector<char> out(ZSTD_compressBound(AUDIT_FRAME_BYTES));
+  uint64_t offset = sizeof(header) + dict_size;
+  bool ok = cctx && (cdict || !dict_size) &&
+            fwrite(&header, 1, sizeof(header), f) == sizeof(header) &&
+            fwrite(dict.data(), 1, dict_size, f) == dict_size;
+
+  for (size_t i = 0; ok && i < frames.size(); i++) {
+    AuditFrameEntry &fr = frames[i];
+    out.resize(ZSTD_compressBound(fr.raw_size));
+    size_t n = cdict ? ZSTD_compress_usingCDict(cctx, out.data(), out.size(),
+                                                raw.data() + fr.raw_offset,
+                                                fr.raw_size, cdict)
+                     : ZSTD_compressCCtx(cctx, out.data(), out.size(),
+                                         raw.data() + fr.raw_offset,
+                                         fr.raw_size, AUDIT_ZSTD_LEVEL);
+    ok = !ZSTD_isError(n) && fwrite(out.data(), 1, n, f) == n;
+    fr.comp_offset = offset;
+    fr.comp_size = (uint32_t)n;
+    offset += n;
+  }
+  ZSTD_freeCDict(cdict);
+  ZSTD_freeCCtx(cctx);
+
+  header.index_offset = offset;
+  header.check = zheader_check(header, frames);
+  size_t index_bytes = frames.size() * sizeof(AuditFrameEntry);
+  ok = ok && fwrite(frames.data(), 1, index_bytes, f) == index_bytes &&
+       fseek(f, 0, SEEK_SET) == 0 &&
+       fwrite(&header, 1, sizeof(header), f) == sizeof(header) &&
+       fflush(f) == 0;
+#ifndef _WIN32
+  ok = ok && fsync(fileno(f)) == 0;
+#endif
+  ok = fclose(f) == 0 && ok;
+  if (!ok || !replace_file(tmp.c_str(), z_path)) {
+    remove(tmp.c_str());
+    return false;
+  }
+
+  if (stats) {
+    stats->raw_bytes = raw.size();
+    stats->compressed_bytes = offset + index_bytes;
+    stats->dict_bytes = dict_size;
+    stats->frames = frames.size();
+    stats->seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  }
+  return true;
+}
+
+#else
+
+bool audit_compress_segment(const char *, const char *, uint32_t,
+                            const AuditSegmentFooter &, AuditCompressStats *) {
+  return false;
+}
+
+#endif
+
+// --- CompressedSegment ---
+
+CompressedSegment::CompressedSegment()
+    : m_file(nullptr), m_dctx(nullptr), m_ddict(nullptr),
+      m_cached_frame(SIZE_MAX) {
+  memset(&m_header, 0, sizeof(m_header));
+}
+
+CompressedSegment::~CompressedSegment() { close(); }
+
+void CompressedSegment::close() {
+  if (m_file)
+    fclose(m_file);
+  m_file = nullptr;
+#ifdef SECUREAUTH_HAVE_ZSTD
+  ZSTD_freeDCtx((ZSTD_DCtx *)m_dctx);
+  ZSTD_freeDDict((ZSTD_DDict *)m_ddict);
+#endif
+  m_dctx = m_ddict = nullptr;
+  m_frames.clear();
+  m_cached_frame = SIZE_MAX;
+  m_cache.clear();
+}
+
+bool CompressedSegment::open(const char *path) {
+#ifdef SECUREAUTH_HAVE_ZSTD
+  close();
+  m_file = fopen(path, "rb");
+  if (!m_file)
+    return false;
+
+  std::vector<char> dict;
+  bool ok = fread(&m_header, 1, sizeof(m_header), m_file) == sizeof(m_header) &&
+            memcmp(m_header.magic, AUDIT_ZSEGMENT_MAGIC, 8) == 0 &&
+            m_header.dict_size <= AUDIT_DICT_BYTES &&
+            m_header.frame_count <= AUDIT_SEGMENT_MAX_BYTES / AUDIT_FRAME_BYTES * 2;
+  if (ok) {
+    dict.resize(m_header.dict_size);
+    m_frames.resize(m_header.frame_count);
+    size_t index_bytes = m_frames.size() * sizeof(AuditFrameEntry);
+    ok = fread(dict.data(), 1, dict.size(), m_file) == dict.size() &&
+         fseek(m_file, (long)m_header.index_offset, SEEK_SET) == 0 &&
+         fread(m_frames.data(), 1, index_bytes, m_file) == index_bytes &&
+         zheader_check(m_header, m_frames) == m_header.check;
+  }
+  for (size_t i = 0; ok && i < m_frames.size(); i++)
+    ok = m_frames[i].raw_size <= AUDIT_FRAME_BYTES &&
+         m_frames[i].comp_offset + m_frames[i].comp_size <=
+             m_header.index_offset;
+  if (ok) {
+    m_dctx = ZSTD_createDCtx();
+    if (!dict.empty())
+      m_ddict = ZSTD_createDDict(dict.data(), dict.size());
+    ok = m_dctx && (m_ddict || dict.empty());
+  }
+  if (!ok)
+    close();
+  return ok;
+#else
+  (void)path;
+  return false;
+#endif
+}
+
+uint64_t CompressedSegment::file_bytes() const {
+  return m_header.index_offset + m_frames.size() * sizeof(AuditFrameEntry);
+}
+
+bool CompressedSegment::load_frame(size_t i, const std::string **out) {
+#ifdef SECUREAUTH_HAVE_ZSTD
+  if (!m_file || i >= m_frames.size())
+    return false;
+  if (i != m_cached_frame) {
+    const AuditFrameEntry &fr = m_frames[i];
+    m_cached_frame = SIZE_MAX;
+    m_compressed.resize(fr.comp_size);
+    m_cache.resize(fr.raw_size);
+    if (fseek(m_file, (long)fr.comp_offset, SEEK_SET) != 0 ||
+        fread(m_compressed.data(), 1, fr.comp_size, m_file) != fr.comp_size)
+      return false;
+    size_t n =
+        m_ddict
+            ? ZSTD_decompress_usingDDict(
+                  (ZSTD_DCtx *)m_dctx, &m_cache[0], m_cache.size(),
+                  m_compressed.data(), fr.comp_size, (ZSTD_DDict *)m_ddict)
+            : ZSTD_decompressDCtx((ZSTD_DCtx *)m_dctx, &m_cache[0],
+                                  m_cache.size(), m_compressed.data(),
+                                  fr.comp_size);
+    if (ZSTD_isError(n) || n != fr.raw_size)
+      return false;
+    m_cached_frame = i;
+  }
+  *out = &m_cache;
+  return true;
+#else
+  (void)i;
+  (void)out;
+  return false;
+#endif
+}
+
+bool CompressedSegment::read(uint64_t raw_offset, size_t len, char *out) {
+  // Last frame starting at or before the offset
+  size_t lo = 0, hi = m_frames.size();
+  while (hi - lo > 1) {
+    size_t mid = (lo + hi) / 2;
+    if (m_frames[mid].raw_offset <= raw_offset)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  const std::string *frame;
+  if (m_frames.empty() || raw_offset < m_frames[lo].raw_offset ||
+      !load_frame(lo, &frame))
+    return false;
+  uint64_t rel = raw_offset - m_frames[lo].raw_offset;
+  if (rel + len > frame->size())
+    return false;
+  memcpy(out, frame->data() + rel, len);
+  return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "audit_store.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// --- Compressed Audit Segments ---
+// When a segment is sealed its records are cut into ~64 KB frames on record
+// boundaries, and each frame is compressed on its own with a zstd
+// dictionary trained on that segment's records. Audit events are small and
+// repetitive, so the dictionary does most of the work, and reading one
+// event decompresses only its frame. seg-N.aud is replaced by seg-N.z:
+//
+//   [AuditZHeader][dictionary][frames...][AuditFrameEntry x frame_count]
+//
+// Needs libzstd (build with SECUREAUTH_HAVE_ZSTD); without it sealed
+// segments stay uncompressed and .z segments cannot be opened.
+
+const char AUDIT_ZSEGMENT_MAGIC[8] = {'S', 'A', 'A', 'U', 'D', 'Z', '0', '1'};
+const size_t AUDIT_FRAME_BYTES = 64 << 10;
+const size_t AUDIT_DICT_BYTES = 16 << 10;
+const int AUDIT_ZSTD_LEVEL = 3;
+
+struct AuditZHeader {
+  char magic[8];
+  uint32_t segment_id;
+  uint32_t dict_size; // 0 if training failed (too few records)
+  uint32_t frame_count;
+  uint32_t reserved;
+  uint64_t index_offset;
+  AuditSegmentFooter footer; // copied from the .aud
+  uint64_t check;            // over the header above and the frame index
+};
+
+struct AuditFrameEntry {
+  uint64_t raw_offset; // offset of the frame's first record in the .aud
+  uint64_t comp_offset;
+  uint32_t raw_size;
+  uint32_t comp_size;
+};
+
+struct AuditCompressStats {
+  uint64_t raw_bytes;
+  uint64_t compressed_bytes; // frames + dictionary + index
+  uint64_t dict_bytes;
+  uint64_t frames;
+  double seconds;
+};
+
+bool audit_compression_available();
+
+// Compress sealed segment `aud_path` into `z_path` (temp file + rename).
+// The caller removes the .aud once this succeeds.
+bool audit_compress_segment(const char *aud_path, const char *z_path,
+                            uint32_t segment_id,
+                            const AuditSegmentFooter &footer,
+                            AuditCompressStats *stats);
+
+//
+// CompressedSegment - random access into a .z segment
+//
+class CompressedSegment {
+private:
+  FILE *m_file;
+  AuditZHeader m_header;
+  std::vector<AuditFrameEntry> m_frames;
+  void *m_dctx;  // ZSTD_DCtx
+  void *m_ddict; // ZSTD_DDict
+  size_t m_cached_frame;
+  std::string m_cache;
+  std::vector<char> m_compressed;
+
+public:
+  CompressedSegment();
+  ~CompressedSegment();
+
+  CompressedSegment(const CompressedSegment &) = delete;
+  CompressedSegment &operator=(const CompressedSegment &) = delete;
+
+  bool open(const char *path);
+  void close();
+
+  const AuditSegmentFooter &footer() const { return m_header.footer; }
+  size_t frame_count() const { return m_frames.size(); }
+  const AuditFrameEntry &frame(size_t i) const { return m_frames[i]; }
+  uint64_t file_bytes() const;
+
+  // Decompressed frame `i`, valid until the next call. Not thread-safe.
+  bool load_frame(size_t i, const std::string **out);
+
+  // Copy `len` bytes from `raw_offset` in the original segment. The range
+  // must lie within one record (records never span frames).
+  bool read(uint64_t raw_offset, size_t len, char *out);
+};
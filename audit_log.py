@@ -12,15 +12,107 @@ Tracks all authentication attempts and detects suspicious patterns:
 import sqlite3
 import datetime
 import json
+import ctypes
+import os
+import platform
 from collections import defaultdict
-from typing import List, Dict, Tuple
+from typing import List, Dict, Optional, Tuple
 
 AUDIT_DB = "audit_log.db"
+AUDIT_SEGMENT_DIR = "audit_segments"
 
 # Intrusion detection thresholds
 FAILED_ATTEMPTS_THRESHOLD = 5  # Max failed attempts before flagging
 TIME_WINDOW_MINUTES = 15       # Time window to check for patterns
 RAPID_ATTEMPTS_THRESHOLD = 10  # Attempts in short time = suspicious
+NATIVE_WINDOW_MINUTES = 15     # History held by the native intrusion windows
+
+# Per-user behavioural profiles (native only); scores are bits of surprise
+PROFILE_MIN_LOGINS = 10        # Successful logins before the profile is used
+PROFILE_MIN_TOTP = 5           # TOTP checks before offsets are judged
+UNUSUAL_HOUR_BITS = 3.0        # Hour 8x rarer for this user than uniform
+UNFAMILIAR_NETWORK_BITS = 4.0  # IP prefix outside the user's usual networks
+TOTP_DRIFT_SPREADS = 6.0       # TOTP offset far from the user's usual one
+PROFILE_NO_TOTP = -128         # No TOTP offset to score
+
+# Native audit writer queue and tail socket
+try:
+    from config import AUDIT_QUEUE_CAPACITY, AUDIT_OVERFLOW_POLICY, AUDIT_DEFAULT_POLICY
+except ImportError:
+    AUDIT_QUEUE_CAPACITY = 0
+    AUDIT_OVERFLOW_POLICY = {}
+    AUDIT_DEFAULT_POLICY = "SPILL"
+try:
+    from config import AUDIT_TAIL_SOCKET
+except ImportError:
+    AUDIT_TAIL_SOCKET = None
+
+# Event sequences alerted on by the native engine:
+# {alert type: (severity, steps, description)}
+try:
+    from config import INTRUSION_SEQUENCES
+except ImportError:
+    INTRUSION_SEQUENCES = {}
+
+# Native actions on alerts: {alert type: (actions, seconds blocked)}
+try:
+    from config import INTRUSION_ENFORCEMENT
+except ImportError:
+    INTRUSION_ENFORCEMENT = {}
+
+AUDIT_POLICIES = {"BLOCK": 0, "SPILL": 1, "SAMPLE": 2}  # AuditOverflowPolicy
+ENFORCE_ACTIONS = {"BLOCK_USER": 1, "BLOCK_IP": 2, "REVOKE": 4, "STEP_UP": 8}
+SESSION_STATUS = {0: "VALID", 1: "STEP_UP", 2: "REVOKED"}  # ENFORCE_SESSION_*
+
+
+class AuditQueueMetrics(ctypes.Structure):
+    """Mirror of AuditQueueMetrics in audit_queue.h"""
+    _fields_ = [(name, ctypes.c_uint64) for name in (
+        "depth", "capacity", "enqueued", "written", "spilled", "spill_bytes",
+        "drained", "sampled_out", "blocked", "write_errors", "drain_rate")]
+
+
+class AuditProof(ctypes.Structure):
+    """Mirror of AuditProof in audit_chain.h"""
+    _fields_ = [
+        ("event_id", ctypes.c_uint64), ("batch", ctypes.c_uint64),
+        ("leaf_index", ctypes.c_uint32), ("leaf_count", ctypes.c_uint32),
+        ("path_len", ctypes.c_uint32), ("reserved", ctypes.c_uint32),
+        ("leaf", ctypes.c_uint8 * 32), ("path", (ctypes.c_uint8 * 32) * 16),
+        ("prev_chain", ctypes.c_uint8 * 32), ("root", ctypes.c_uint8 * 32),
+        ("chain", ctypes.c_uint8 * 32)]
+
+
+class IntrusionScore(ctypes.Structure):
+    """Mirror of IntrusionScore in intrusion_state.h"""
+    _fields_ = [
+        ("hour", ctypes.c_double), ("day", ctypes.c_double),
+        ("network", ctypes.c_double), ("totp", ctypes.c_double),
+        ("logins", ctypes.c_uint32), ("totp_count", ctypes.c_uint32)]
+
+
+class AlertRecord(ctypes.Structure):
+    """Mirror of AlertRecord in alert_bus.h"""
+    _fields_ = [
+        ("sequence", ctypes.c_uint64), ("ts_ms", ctypes.c_int64),
+        ("published_ns", ctypes.c_int64),
+        ("username", ctypes.c_char * 64), ("alert_type", ctypes.c_char * 32),
+        ("severity", ctypes.c_char * 16), ("ip_address", ctypes.c_char * 48),
+        ("description", ctypes.c_char * 136)]
+
+
+class AlertBusStats(ctypes.Structure):
+    """Mirror of AlertBusStats in alert_bus.h"""
+    _fields_ = [(name, ctypes.c_uint64) for name in (
+        "published", "delivered", "dropped", "lag")]
+
+
+class EnforcementStats(ctypes.Structure):
+    """Mirror of EnforcementStats in enforcement.h"""
+    _fields_ = [(name, ctypes.c_uint64) for name in (
+        "alerts", "actions", "user_blocks", "ip_blocks", "revocations",
+        "step_ups", "table_full", "dropped", "last_latency_us",
+        "max_latency_us")]
 
 
 def init_audit_db():
@@ -59,6 +151,269 @@ def init_audit_db():
     conn.close()
 
 
+def load_native_audit():
+    """
+    Open the native segmented audit log (auth_lib) if the library is built.
+    Events are mirrored there through a bounded async queue and indexed for
+    fast filtered queries; audit_log.db remains the primary store.
+    """
+    lib_name = "auth_lib.dll" if platform.system() == "Windows" else "auth_lib.so"
+    lib_path = os.path.join(os.path.dirname(os.path.abspath(__file__)), lib_name)
+    if not os.path.exists(lib_path):
+        return None
+
+    try:
+        lib = ctypes.CDLL(lib_path)
+        c_str = ctypes.c_char_p
+        lib.audit_store_open.argtypes = [c_str]
+        lib.audit_store_open.restype = ctypes.c_bool
+        lib.audit_append.argtypes = [c_str, c_str, c_str, c_str, c_str, c_str,
+                                     ctypes.c_int64]
+        lib.audit_append.restype = ctypes.c_uint64
+        lib.audit_query.argtypes = [c_str, c_str, c_str, c_str, c_str,
+                                    ctypes.c_int64, ctypes.c_int64,
+                                    ctypes.POINTER(ctypes.c_uint64), ctypes.c_int]
+        lib.audit_query.restype = ctypes.c_int64
+        lib.audit_search.argtypes = [c_str, ctypes.c_int64, ctypes.c_int64,
+                                     ctypes.POINTER(ctypes.c_uint64), ctypes.c_int]
+        lib.audit_search.restype = ctypes.c_int64
+        lib.audit_count.argtypes = [c_str, c_str, c_str, c_str, c_str,
+                                    ctypes.c_int64, ctypes.c_int64]
+        lib.audit_count.restype = ctypes.c_int64
+        lib.audit_enqueue.argtypes = [c_str, c_str, c_str, c_str, c_str, c_str,
+                                      ctypes.c_int64]
+        lib.audit_enqueue.restype = ctypes.c_bool
+        lib.audit_queue_start.argtypes = [c_str, ctypes.c_int]
+        lib.audit_queue_start.restype = ctypes.c_bool
+        lib.audit_queue_policy.argtypes = [c_str, ctypes.c_int]
+        lib.audit_queue_policy.restype = ctypes.c_bool
+        lib.audit_queue_flush.restype = ctypes.c_bool
+        lib.audit_queue_metrics.argtypes = [ctypes.POINTER(AuditQueueMetrics)]
+        lib.audit_queue_metrics.restype = ctypes.c_bool
+        lib.audit_store_sync.restype = ctypes.c_bool
+        lib.audit_prove.argtypes = [ctypes.c_uint64, ctypes.POINTER(AuditProof)]
+        lib.audit_prove.restype = ctypes.c_bool
+        lib.audit_check_proof.argtypes = [ctypes.POINTER(AuditProof)]
+        lib.audit_check_proof.restype = ctypes.c_bool
+        lib.audit_chain_head.argtypes = [ctypes.c_char_p]
+        lib.audit_chain_head.restype = ctypes.c_int64
+        lib.audit_tail_start.argtypes = [c_str]
+        lib.audit_tail_start.restype = ctypes.c_bool
+        lib.audit_event_json.argtypes = [ctypes.c_uint64, c_str, ctypes.c_int]
+        lib.audit_event_json.restype = ctypes.c_int
+        lib.audit_window_count.argtypes = [c_str, c_str, ctypes.c_int64]
+        lib.audit_window_count.restype = ctypes.c_int64
+        lib.audit_profile_score.argtypes = [c_str, c_str, ctypes.c_int64,
+                                            ctypes.c_int,
+                                            ctypes.POINTER(IntrusionScore)]
+        lib.audit_profile_score.restype = ctypes.c_bool
+        lib.audit_sequence_rules.argtypes = [c_str, c_str, ctypes.c_int]
+        lib.audit_sequence_rules.restype = ctypes.c_bool
+        lib.audit_sequence_matches.argtypes = [c_str, c_str, c_str, ctypes.c_int]
+        lib.audit_sequence_matches.restype = ctypes.c_int
+        lib.alert_publish.argtypes = [c_str, c_str, c_str, c_str, c_str,
+                                      ctypes.c_int64]
+        lib.alert_publish.restype = ctypes.c_uint64
+        lib.alert_subscribe.restype = ctypes.c_int
+        lib.alert_unsubscribe.argtypes = [ctypes.c_int]
+        lib.alert_poll.argtypes = [ctypes.c_int, ctypes.POINTER(AlertRecord),
+                                   ctypes.c_int, ctypes.c_int]
+        lib.alert_poll.restype = ctypes.c_int
+        lib.alert_bus_stats.argtypes = [ctypes.c_int,
+                                        ctypes.POINTER(AlertBusStats)]
+        lib.alert_bus_stats.restype = ctypes.c_bool
+        lib.enforcement_start.restype = ctypes.c_bool
+        lib.enforcement_policy.argtypes = [c_str, ctypes.c_uint32, ctypes.c_int64]
+        lib.enforcement_policy.restype = ctypes.c_bool
+        lib.enforcement_blocked.argtypes = [c_str, c_str]
+        lib.enforcement_blocked.restype = ctypes.c_int64
+        lib.enforcement_unblock.argtypes = [c_str, c_str]
+        lib.enforcement_unblock.restype = ctypes.c_bool
+        lib.enforcement_session_epoch.argtypes = [c_str]
+        lib.enforcement_session_epoch.restype = ctypes.c_uint32
+        lib.enforcement_session_check.argtypes = [c_str, ctypes.c_uint32]
+        lib.enforcement_session_check.restype = ctypes.c_int
+        lib.enforcement_step_up_done.argtypes = [c_str]
+        lib.enforcement_stats.argtypes = [ctypes.POINTER(EnforcementStats)]
+        lib.enforcement_stats.restype = ctypes.c_bool
+
+        # Before opening, so events replayed on startup follow the rules
+        rules = "\n".join(f"{name}: {steps}" for name, (_, steps, _)
+                          in INTRUSION_SEQUENCES.items())
+        error = ctypes.create_string_buffer(256)
+        if not lib.audit_sequence_rules(rules.encode(), error, len(error)):
+            print(f"Warning: INTRUSION_SEQUENCES ignored: {error.value.decode()}")
+        if not lib.audit_store_open(AUDIT_SEGMENT_DIR.encode()):
+            return None
+
+        # Without the queue, audit_enqueue appends synchronously
+        spill_path = os.path.join(AUDIT_SEGMENT_DIR, "spill.dat")
+        if lib.audit_queue_start(spill_path.encode(), AUDIT_QUEUE_CAPACITY):
+            lib.audit_queue_policy(None, AUDIT_POLICIES[AUDIT_DEFAULT_POLICY])
+            for event_type, policy in AUDIT_OVERFLOW_POLICY.items():
+                lib.audit_queue_policy(event_type.encode(), AUDIT_POLICIES[policy])
+
+        # Fails quietly if another process already serves the socket
+        if AUDIT_TAIL_SOCKET and platform.system() != "Windows":
+            lib.audit_tail_start(AUDIT_TAIL_SOCKET.encode())
+
+        # Alerts act on logins and sessions as soon as they are raised
+        for alert_type, (actions, seconds) in INTRUSION_ENFORCEMENT.items():
+            bits = sum(ENFORCE_ACTIONS[action] for action in actions)
+            lib.enforcement_policy(alert_type.encode(), bits, int(seconds * 1000))
+        if INTRUSION_ENFORCEMENT and lib.enforcement_start():
+            import atexit
+            atexit.register(lib.enforcement_stop)
+        return lib
+    except (OSError, AttributeError):
+        return None
+
+
+def _encode(value):
+    return value.encode() if value else None
+
+
+def query_events(username: str = None, event_type: str = None,
+                 status: str = None, risk_level: str = None,
+                 ip_address: str = None, since: datetime.datetime = None,
+                 until: datetime.datetime = None, limit: int = 1000) -> List[Dict]:
+    """
+    Filter audit events through the native bitmap indexes.
+    Every given field must match. Returns [] without the native library.
+    """
+    if not _native:
+        return []
+
+    from_ms = int(since.timestamp() * 1000) if since else 0
+    to_ms = int(until.timestamp() * 1000) if until else 0
+    ids = (ctypes.c_uint64 * limit)()
+    total = _native.audit_query(_encode(username), _encode(event_type),
+                                _encode(status), _encode(risk_level),
+                                _encode(ip_address), from_ms, to_ms, ids, limit)
+
+    return _fetch_native_events(ids, total, limit)
+
+
+def count_events(username: str = None, event_type: str = None,
+                 status: str = None, ip_address: str = None,
+                 since: datetime.datetime = None,
+                 until: datetime.datetime = None) -> int:
+    """
+    Exact number of matching events in the native log. Repeats that were
+    aggregated into one record during a burst are each counted.
+    Returns -1 without the native library.
+    """
+    if not _native:
+        return -1
+
+    _native.audit_queue_flush()
+    from_ms = int(since.timestamp() * 1000) if since else 0
+    to_ms = int(until.timestamp() * 1000) if until else 0
+    return _native.audit_count(_encode(username), _encode(event_type),
+                               _encode(status), None, _encode(ip_address),
+                               from_ms, to_ms)
+
+
+def queue_metrics() -> Dict:
+    """
+    Native audit writer queue: depth, spill_bytes, drain_rate (events/s),
+    sampled_out, blocked, ... Returns {} without the native library.
+    """
+    metrics = AuditQueueMetrics()
+    if not _native or not _native.audit_queue_metrics(ctypes.byref(metrics)):
+        return {}
+    return {name: getattr(metrics, name) for name, _ in metrics._fields_}
+
+
+def chain_head() -> Optional[str]:
+    """
+    Hex chain value of the latest audit commit, after committing everything
+    logged so far. Record it outside the server: any later edit to the log
+    breaks the chain leading to it. None without the native library.
+    """
+    if not _native:
+        return None
+    _native.audit_queue_flush()
+    _native.audit_store_sync()
+    head = ctypes.create_string_buffer(32)
+    if _native.audit_chain_head(head) <= 0:
+        return None
+    return head.raw.hex()
+
+
+def verify_event(event_id: int) -> Dict:
+    """
+    Inclusion proof for one native event: its record hash, Merkle path to
+    the batch root and the chain value that commits the batch.
+    'valid' is False if the record no longer matches what was committed.
+    """
+    proof = AuditProof()
+    if not _native or not _native.audit_prove(event_id, ctypes.byref(proof)):
+        return {"event_id": event_id, "valid": False}
+    return {
+        "event_id": event_id,
+        "valid": bool(_native.audit_check_proof(ctypes.byref(proof))),
+        "batch": proof.batch,
+        "leaf": bytes(proof.leaf).hex(),
+        "path": [bytes(proof.path[i]).hex() for i in range(proof.path_len)],
+        "root": bytes(proof.root).hex(),
+        "chain": bytes(proof.chain).hex(),
+    }
+
+
+def tail_events(start="now", window: int = 256):
+    """
+    Follow the native audit log of the running application through its
+    tail socket, yielding event dicts as they are written. `start` is an
+    event ID or "now"; at most `window` events are sent ahead of the
+    caller, so a slow consumer never holds up logging.
+    """
+    import socket
+
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    try:
+        sock.connect(AUDIT_TAIL_SOCKET)
+        sock.sendall(f"SUBSCRIBE {start} ndjson {window}\n".encode())
+        stream = sock.makefile("rb")
+        if not stream.readline().startswith(b"OK"):
+            raise ConnectionError("audit tail subscription refused")
+        unacked = 0
+        for line in stream:
+            yield json.loads(line)
+            unacked += 1
+            if unacked >= max(window // 2, 1):
+                sock.sendall(f"CREDIT {unacked}\n".encode())
+                unacked = 0
+    finally:
+        sock.close()
+
+
+def search_events(terms: str, since: datetime.datetime = None,
+                  until: datetime.datetime = None, limit: int = 1000) -> List[Dict]:
+    """
+    Search event details through the native inverted index, e.g.
+    search_events("reason:database_error", since=last_month).
+    Every space-separated term must match. Returns [] without the native library.
+    """
+    if not _native:
+        return []
+
+    from_ms = int(since.timestamp() * 1000) if since else 0
+    to_ms = int(until.timestamp() * 1000) if until else 0
+    ids = (ctypes.c_uint64 * limit)()
+    total = _native.audit_search(terms.encode(), from_ms, to_ms, ids, limit)
+    return _fetch_native_events(ids, total, limit)
+
+
+def _fetch_native_events(ids, total: int, limit: int) -> List[Dict]:
+    events = []
+    buf = ctypes.create_string_buffer(8192)
+    for event_id in ids[:min(max(total, 0), limit)]:
+        if _native.audit_event_json(event_id, buf, len(buf)) > 0:
+            events.append(json.loads(buf.value.decode()))
+    return events
+
+
 def log_event(username: str, event_type: str, status: str, 
               ip_address: str = "127.0.0.1", details: dict = None):
     """
@@ -89,8 +444,18 @@ def log_event(username: str, event_type: str, status: str,
     conn.commit()
     conn.close()
     
+    # Scored before the native log sees the event: it learns from it on
+    # enqueue, and an event must not vouch for itself
+    profile = user_profile_score(username, ip_address,
+                                 _event_totp_offset(event_type, details))
+    if _native:
+        _native.audit_enqueue(_encode(username), _encode(event_type),
+                              _encode(status), _encode(ip_address),
+                              _encode(risk_level), _encode(details_json), 0)
+    
     # Check for intrusion patterns
-    check_intrusion_patterns(username)
+    check_intrusion_patterns(username, ip_address, event_type, status, details,
+                             profile)
 
 
 def calculate_risk_level(username: str, event_type: str, status: str) -> str:
@@ -137,50 +502,152 @@ def get_recent_failures(username: str, minutes: int = 15) -> List[Dict]:
             for r in results]
 
 
-def check_intrusion_patterns(username: str):
+def _window_count(username: str, status: str, minutes: int) -> Optional[int]:
+    """
+    Events of `username` (with `status` unless None) in the last `minutes`,
+    from the native intrusion windows, which the native log rebuilds on
+    startup. None without the native library or beyond the windows' span.
+    """
+    if not _native or minutes > NATIVE_WINDOW_MINUTES:
+        return None
+    since = datetime.datetime.now() - datetime.timedelta(minutes=minutes)
+    count = _native.audit_window_count(_encode(username), _encode(status),
+                                       int(since.timestamp() * 1000))
+    return count if count >= 0 else None
+
+
+def user_profile_score(username: str, ip_address: str = None,
+                       totp_offset: int = None) -> Optional[Dict]:
+    """
+    Scores of an event now against the user's native behavioural profile:
+    hour, day, network and totp surprise, plus the logins and totp_count
+    behind them. None without the native library or a profile.
+    """
+    if not _native:
+        return None
+    score = IntrusionScore()
+    offset = PROFILE_NO_TOTP if totp_offset is None else totp_offset
+    if not _native.audit_profile_score(_encode(username), _encode(ip_address),
+                                       0, offset, ctypes.byref(score)):
+        return None
+    return {name: getattr(score, name) for name, _ in IntrusionScore._fields_}
+
+
+def _sequence_matches(username: str, event_type: str) -> List[str]:
+    """
+    INTRUSION_SEQUENCES rules the user's latest `event_type` event completed,
+    from the native engine ([] without it)
+    """
+    if not _native or not event_type:
+        return []
+    buf = ctypes.create_string_buffer(1024)
+    if _native.audit_sequence_matches(_encode(username), _encode(event_type),
+                                      buf, len(buf)) <= 0:
+        return []
+    return buf.value.decode().split(",")
+
+
+def _event_totp_offset(event_type: str, details: dict) -> Optional[int]:
+    """TOTP step offset the event carries, if it is a TOTP event"""
+    return (details or {}).get("totp_offset") if event_type == "TOTP" else None
+
+
+_NOT_SCORED = object()
+
+
+def check_intrusion_patterns(username: str, ip_address: str = None,
+                             event_type: str = None, status: str = None,
+                             details: dict = None, profile=_NOT_SCORED):
     """
     Detect intrusion patterns and create alerts
     
+    `profile` is user_profile_score() for the event taken before it was
+    logged (log_event() passes it); scored here if not given.
+    
     Detects:
     1. Brute force attacks (multiple failed logins)
     2. Rapid-fire attempts (automated attacks)
     3. Account enumeration (testing multiple usernames)
-    4. Time-based patterns (attacks at unusual hours)
+    4. Time-based patterns (attacks at hours unusual for the user)
+    5. Logins from networks and TOTP clock offsets unusual for the user
+    6. Event sequences from INTRUSION_SEQUENCES (e.g. MFA code guessing)
     """
     conn = sqlite3.connect(AUDIT_DB)
     cursor = conn.cursor()
     
-    # Check for brute force
-    recent_failures = get_recent_failures(username, TIME_WINDOW_MINUTES)
+    # Check for brute force (native windows first, the database otherwise)
+    failure_count = _window_count(username, "FAILURE", TIME_WINDOW_MINUTES)
+    if failure_count is None:
+        failure_count = len(get_recent_failures(username, TIME_WINDOW_MINUTES))
     
-    if len(recent_failures) >= FAILED_ATTEMPTS_THRESHOLD:
+    if failure_count >= FAILED_ATTEMPTS_THRESHOLD:
         create_alert(
             username,
             "BRUTE_FORCE",
             "HIGH",
-            f"Detected {len(recent_failures)} failed login attempts in {TIME_WINDOW_MINUTES} minutes"
+            f"Detected {failure_count} failed login attempts in {TIME_WINDOW_MINUTES} minutes",
+            ip_address
         )
     
     # Check for rapid-fire attempts
-    rapid_attempts = get_attempts_in_window(username, minutes=1)
-    if len(rapid_attempts) >= RAPID_ATTEMPTS_THRESHOLD:
+    rapid_count = _window_count(username, None, 1)
+    if rapid_count is None:
+        rapid_count = len(get_attempts_in_window(username, minutes=1))
+    if rapid_count >= RAPID_ATTEMPTS_THRESHOLD:
         create_alert(
             username,
             "RAPID_FIRE",
             "CRITICAL",
-            f"Detected {len(rapid_attempts)} attempts in 1 minute - possible automated attack"
+            f"Detected {rapid_count} attempts in 1 minute - possible automated attack",
+            ip_address
         )
     
-    # Check for unusual timing
+    # Check for unusual timing: against the user's own hours once their
+    # profile has enough history, otherwise the fixed night rule
     current_hour = datetime.datetime.now().hour
-    if current_hour < 6 or current_hour > 22:  # Between 10 PM and 6 AM
-        if len(recent_failures) >= 2:
-            create_alert(
-                username,
-                "UNUSUAL_TIMING",
-                "MEDIUM",
-                f"Multiple failed attempts detected at unusual hour ({current_hour}:00)"
-            )
+    offset = _event_totp_offset(event_type, details)
+    if profile is _NOT_SCORED:
+        profile = user_profile_score(username, ip_address, offset)
+    known = profile is not None and profile["logins"] >= PROFILE_MIN_LOGINS
+    if known:
+        unusual_hour = profile["hour"] >= UNUSUAL_HOUR_BITS
+    else:
+        unusual_hour = current_hour < 6 or current_hour > 22  # 10 PM - 6 AM
+    if unusual_hour and failure_count >= 2:
+        create_alert(
+            username,
+            "UNUSUAL_TIMING",
+            "MEDIUM",
+            f"Multiple failed attempts detected at unusual hour ({current_hour}:00)",
+            ip_address
+        )
+    
+    if known and status == "SUCCESS" and event_type == "LOGIN" and \
+            profile["network"] >= UNFAMILIAR_NETWORK_BITS:
+        create_alert(
+            username,
+            "UNFAMILIAR_NETWORK",
+            "MEDIUM",
+            f"Successful login from a network unusual for this user ({ip_address})",
+            ip_address
+        )
+    
+    if profile and offset is not None and \
+            profile["totp_count"] >= PROFILE_MIN_TOTP and \
+            profile["totp"] >= TOTP_DRIFT_SPREADS:
+        create_alert(
+            username,
+            "TOTP_DRIFT",
+            "LOW",
+            f"TOTP code accepted at step offset {offset}, unusual for this user's device",
+            ip_address
+        )
+    
+    # Sequences matched by this event
+    for alert_type in _sequence_matches(username, event_type):
+        if alert_type in INTRUSION_SEQUENCES:
+            severity, _, description = INTRUSION_SEQUENCES[alert_type]
+            create_alert(username, alert_type, severity, description, ip_address)
     
     conn.close()
 
@@ -208,8 +675,12 @@ def get_attempts_in_window(username: str, minutes: int = 1) -> List[Dict]:
             for r in results]
 
 
-def create_alert(username: str, alert_type: str, severity: str, description: str):
-    """Create an intrusion detection alert"""
+def create_alert(username: str, alert_type: str, severity: str, description: str,
+                 ip_address: str = None):
+    """
+    Create an intrusion detection alert. The native enforcer acts on it at
+    once per INTRUSION_ENFORCEMENT, using `ip_address` for IP blocks.
+    """
     conn = sqlite3.connect(AUDIT_DB)
     cursor = conn.cursor()
     
@@ -233,10 +704,127 @@ def create_alert(username: str, alert_type: str, severity: str, description: str
         """, (timestamp, username, alert_type, severity, description))
         
         conn.commit()
+
+        # Fan out to in-process consumers (see follow_alerts)
+        if _native:
+            _native.alert_publish(username.encode(), alert_type.encode(),
+                                  severity.encode(), _encode(ip_address),
+                                  description.encode(), 0)
     
     conn.close()
 
 
+def follow_alerts(poll_ms: int = 500, batch: int = 64):
+    """
+    Yield new intrusion alerts as create_alert() raises them in this
+    process, as dicts with 'sequence' and 'dropped' (alerts this consumer
+    has missed so far by falling more than the ring behind). Every consumer gets
+    every alert; a slow one never delays logins or the others. Yields None
+    after `poll_ms` without an alert so the caller can check for shutdown.
+    Returns at once without the native library.
+    """
+    if not _native:
+        return
+    sub = _native.alert_subscribe()
+    if sub < 0:
+        raise RuntimeError("too many alert subscribers")
+    records = (AlertRecord * batch)()
+    stats = AlertBusStats()
+    try:
+        while True:
+            n = _native.alert_poll(sub, records, batch, poll_ms)
+            if n == 0:
+                yield None
+                continue
+            _native.alert_bus_stats(sub, ctypes.byref(stats))
+            for rec in records[:n]:
+                yield {
+                    "sequence": rec.sequence,
+                    "timestamp": datetime.datetime.fromtimestamp(
+                        rec.ts_ms / 1000).isoformat(),
+                    "username": rec.username.decode(errors="replace"),
+                    "alert_type": rec.alert_type.decode(errors="replace"),
+                    "severity": rec.severity.decode(errors="replace"),
+                    "ip_address": rec.ip_address.decode(errors="replace") or None,
+                    "description": rec.description.decode(errors="replace"),
+                    "dropped": stats.dropped,
+                }
+    finally:
+        _native.alert_unsubscribe(sub)
+
+
+def start_alert_consumer(handler, name: str = "alert-consumer"):
+    """
+    Call handler(alert) for every new alert on a daemon thread (see
+    follow_alerts). Returns the thread, or None without the native library.
+    """
+    if not _native:
+        return None
+    import threading
+
+    def run():
+        for alert in follow_alerts():
+            if alert is not None:
+                try:
+                    handler(alert)
+                except Exception as e:
+                    print(f"Warning: {name} failed on alert: {e}")
+
+    thread = threading.Thread(target=run, name=name, daemon=True)
+    thread.start()
+    return thread
+
+
+def login_blocked(username: str, ip_address: str = None) -> float:
+    """
+    Seconds until a login by `username` from `ip_address` may be attempted
+    after an enforced block, 0 if neither is blocked (or without the native
+    library)
+    """
+    if not _native:
+        return 0.0
+    return _native.enforcement_blocked(_encode(username), _encode(ip_address)) / 1000
+
+
+def unblock(username: str = None, ip_address: str = None) -> bool:
+    """Lift an enforced block early; False if there was none to lift"""
+    if not _native:
+        return False
+    return bool(_native.enforcement_unblock(_encode(username), _encode(ip_address)))
+
+
+def session_epoch(username: str) -> int:
+    """
+    Revocation epoch to store with a new session of the user; pass it back
+    to session_status() to check the session is still good
+    """
+    return _native.enforcement_session_epoch(_encode(username)) if _native else 0
+
+
+def session_status(username: str, epoch: int) -> str:
+    """
+    "VALID", "STEP_UP" (the user must pass a TOTP check first) or "REVOKED"
+    for a session issued under `epoch`
+    """
+    if not _native:
+        return "VALID"
+    return SESSION_STATUS[_native.enforcement_session_check(_encode(username), epoch)]
+
+
+def step_up_completed(username: str):
+    """The user passed a TOTP check: pending step-up demands are met"""
+    if _native:
+        _native.enforcement_step_up_done(_encode(username))
+
+
+def enforcement_stats() -> Dict:
+    """Counters of the native enforcer (empty without it)"""
+    stats = EnforcementStats()
+    if not _native or not _native.enforcement_stats(ctypes.byref(stats)):
+        return {}
+    return {name: getattr(stats, name) for name, _ in EnforcementStats._fields_}
+
+
 def get_active_alerts() -> List[Dict]:
     """Get all unresolved intrusion alerts"""
     conn = sqlite3.connect(AUDIT_DB)
@@ -394,3 +982,4 @@ def export_audit_log(filename: str = "audit_export.json"):
 
 # Initialize database on import
 init_audit_db()
+_native = load_native_audit()
@@ -0,0 +1,335 @@
+#include "audit_queue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static int64_t steady_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static bool truncate_file(FILE *f, long size) {
+#ifdef _WIN32
+  return _chsize(_fileno(f), size) == 0;
+#else
+  return ftruncate(fileno(f), (off_t)size) == 0;
+#endif
+}
+
+// --- AuditQueue ---
+
+AuditQueue::AuditQueue()
+    : m_store(nullptr), m_head(0), m_size(0), m_stop(false), m_writing(false),
+      m_spill(nullptr), m_spill_reader(nullptr), m_spill_read(0),
+      m_spill_end(0), m_default_policy(AUDIT_POLICY_SPILL), m_sample_tick(0),
+      m_rate_written(0), m_rate_start_ms(0) {
+  memset(&m_metrics, 0, sizeof(m_metrics));
+}
+
+AuditQueue::~AuditQueue() { stop(); }
+
+bool AuditQueue::start(AuditStore *store, const char *spill_path,
+                       size_t capacity) {
+  stop();
+  m_spill = fopen(spill_path, "ab");
+  m_spill_reader = m_spill ? fopen(spill_path, "r+b") : nullptr;
+  if (!m_spill_reader) {
+    if (m_spill)
+      fclose(m_spill);
+    m_spill = nullptr;
+    return false;
+  }
+  m_spill_path = spill_path;
+
+  // A crash can leave undrained events behind
+  AuditSpillHeader header;
+  fseek(m_spill_reader, 0, SEEK_END);
+  m_spill_end = (uint64_t)ftell(m_spill_reader);
+  rewind(m_spill_reader);
+  if (m_spill_end >= sizeof(header) &&
+      fread(&header, 1, sizeof(header), m_spill_reader) == sizeof(header) &&
+      memcmp(header.magic, AUDIT_SPILL_MAGIC, 8) == 0) {
+    m_spill_read = std::min(std::max(header.drained_to,
+                                     (uint64_t)sizeof(header)),
+                            m_spill_end);
+  } else {
+    m_spill_read = m_spill_end = sizeof(header);
+    if (!truncate_file(m_spill, 0) || !save_spill_header()) {
+      fclose(m_spill);
+      fclose(m_spill_reader);
+      m_spill = m_spill_reader = nullptr;
+      return false;
+    }
+  }
+
+  // Their events count towards the intrusion state before they are
+  // written, like events pushed from now on
+  std::vector<Pending> batch;
+  for (uint64_t pos = m_spill_read; pos < m_spill_end;) {
+    pos = read_spill(pos, m_spill_end, &batch);
+    for (const Pending &ev : batch)
+      store->replay(ev.attr, ev.ts_ms, ev.flags, ev.details.data(),
+                    ev.details.size());
+  }
+
+  m_store = store;
+  m_ring.assign(capacity ? capacity : AUDIT_QUEUE_CAPACITY, Pending());
+  m_head = m_size = 0;
+  m_stop = false;
+  memset(&m_metrics, 0, sizeof(m_metrics));
+  m_rate_written = 0;
+  m_rate_start_ms = steady_ms();
+  m_writer = std::thread(&AuditQueue::write_loop, this);
+  return true;
+}
+
+void AuditQueue::stop() {
+  if (!m_writer.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_stop = true;
+  }
+  m_wake_writer.notify_one();
+  m_writer.join();
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_not_full.notify_all();
+  fclose(m_spill);
+  fclose(m_spill_reader);
+  m_spill = m_spill_reader = nullptr;
+  if (m_spill_end == sizeof(AuditSpillHeader))
+    remove(m_spill_path.c_str());
+  m_store = nullptr;
+}
+
+void AuditQueue::set_policy(const char *event_type,
+                            AuditOverflowPolicy policy) {
+  uint32_t type =
+      event_type ? global_symbols().intern(event_type) : SymbolTable::NO_SYMBOL;
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (event_type)
+    m_policies[type] = policy;
+  else
+    m_default_policy = policy;
+}
+
+AuditOverflowPolicy AuditQueue::policy_for(uint32_t event_type) const {
+  auto it = m_policies.find(event_type);
+  return it == m_policies.end() ? m_default_policy : it->second;
+}
+
+bool AuditQueue::save_spill_header() {
+  AuditSpillHeader header;
+  memcpy(header.magic, AUDIT_SPILL_MAGIC, 8);
+  header.drained_to = m_spill_read;
+  return fseek(m_spill_reader, 0, SEEK_SET) == 0 &&
+         fwrite(&header, 1, sizeof(header), m_spill_reader) ==
+             sizeof(header) &&
+         fflush(m_spill_reader) == 0;
+}
+
+// Append one event to the overflow file. Caller holds m_lock.
+bool AuditQueue::spill_locked(int64_t ts_ms,
+                              const uint32_t attr[AUDIT_ATTR_COUNT],
+                              uint16_t flags, const char *details,
+                              size_t details_len) {
+  AuditRecordBody body;
+  memset(&body, 0, sizeof(body));
+  body.ts_ms = ts_ms;
+  memcpy(body.attr, attr, sizeof(body.attr));
+  body.flags = flags;
+  body.details_len = (uint16_t)details_len;
+
+  AuditRecordHeader rh;
+  rh.marker = AUDIT_SPILL_MARKER;
+  rh.length = (uint32_t)(sizeof(body) + details_len);
+  rh.check = audit_record_check(body, details);
+  rh.reserved = 0;
+
+  if (fwrite(&rh, 1, sizeof(rh), m_spill) != sizeof(rh) ||
+      fwrite(&body, 1, sizeof(body), m_spill) != sizeof(body) ||
+      fwrite(details, 1, details_len, m_spill) != details_len ||
+      fflush(m_spill) != 0) {
+    // Drop the partial record so the file stays readable
+    truncate_file(m_spill, (long)m_spill_end);
+    return false;
+  }
+  m_spill_end += sizeof(rh) + rh.length;
+  m_metrics.spilled++;
+  return true;
+}
+
+// Up to AUDIT_WRITE_BATCH spilled events from [from, end). Returns where
+// the next read starts; a damaged record ends the file.
+uint64_t AuditQueue::read_spill(uint64_t from, uint64_t end,
+                                std::vector<Pending> *out) {
+  out->clear();
+  if (fseek(m_spill_reader, (long)from, SEEK_SET) != 0)
+    return end;
+
+  std::vector<char> details(AUDIT_MAX_DETAILS);
+  while (from < end && out->size() < AUDIT_WRITE_BATCH) {
+    AuditRecordHeader rh;
+    AuditRecordBody body;
+    if (fread(&rh, 1, sizeof(rh), m_spill_reader) != sizeof(rh) ||
+        fread(&body, 1, sizeof(body), m_spill_reader) != sizeof(body) ||
+        rh.marker != AUDIT_SPILL_MARKER ||
+        body.details_len > AUDIT_MAX_DETAILS ||
+        rh.length != sizeof(body) + body.details_len ||
+        fread(details.data(), 1, body.details_len, m_spill_reader) !=
+            body.details_len ||
+        audit_record_check(body, details.data()) != rh.check)
+      return end;
+
+    Pending ev;
+    ev.ts_ms = body.ts_ms;
+    memcpy(ev.attr, body.attr, sizeof(ev.attr));
+    ev.flags = body.flags;
+    ev.details.assign(details.data(), body.details_len);
+    out->push_back(std::move(ev));
+    from += sizeof(rh) + rh.length;
+  }
+  return from;
+}
+
+bool AuditQueue::push(int64_t ts_ms, const uint32_t attr[AUDIT_ATTR_COUNT],
+                      uint16_t flags, const char *details,
+                      size_t details_len) {
+  if (details_len > AUDIT_MAX_DETAILS)
+    details_len = 0; // as AuditStore::append()
+
+  std::unique_lock<std::mutex> guard(m_lock);
+  if (!m_store || m_stop)
+    return false;
+  m_metrics.enqueued++;
+
+  if (m_size == m_ring.size()) {
+    AuditOverflowPolicy policy = policy_for(attr[AUDIT_ATTR_EVENT_TYPE]);
+    if (policy == AUDIT_POLICY_SAMPLE &&
+        m_sample_tick++ % AUDIT_SAMPLE_EVERY != 0) {
+      m_metrics.sampled_out++;
+      return false;
+    }
+    if (policy != AUDIT_POLICY_BLOCK &&
+        spill_locked(ts_ms, attr, flags, details, details_len)) {
+      m_wake_writer.notify_one();
+      return true;
+    }
+
+    // BLOCK, or the spill file cannot be written: wait for the writer
+    m_metrics.blocked++;
+    m_not_full.wait(guard,
+                    [&] { return m_size < m_ring.size() || m_stop; });
+    if (m_size == m_ring.size())
+      return false;
+  }
+
+  Pending &slot = m_ring[(m_head + m_size) % m_ring.size()];
+  slot.ts_ms = ts_ms;
+  memcpy(slot.attr, attr, sizeof(slot.attr));
+  slot.flags = flags;
+  slot.details.assign(details, details_len);
+  m_size++;
+  m_wake_writer.notify_one();
+  return true;
+}
+
+// Alternates between ring and spill batches so neither starves the other.
+// Exits on stop() only once both are empty.
+void AuditQueue::write_loop() {
+  std::vector<Pending> batch;
+  bool spill_turn = false;
+  std::unique_lock<std::mutex> guard(m_lock);
+  for (;;) {
+    int64_t now = steady_ms();
+    if (now - m_rate_start_ms >= 1000) {
+      m_metrics.drain_rate = (m_metrics.written - m_rate_written) * 1000 /
+                             (uint64_t)(now - m_rate_start_ms);
+      m_rate_written = m_metrics.written;
+      m_rate_start_ms = now;
+    }
+
+    bool spill_pending = m_spill_read < m_spill_end;
+    if (m_size == 0 && !spill_pending) {
+      m_idle.notify_all();
+      if (m_stop)
+        break;
+      m_wake_writer.wait_for(guard, std::chrono::milliseconds(200), [&] {
+        return m_size > 0 || m_spill_read < m_spill_end || m_stop;
+      });
+      continue;
+    }
+
+    m_writing = true;
+    bool from_spill = spill_pending && (m_size == 0 || spill_turn);
+    spill_turn = !spill_turn;
+    uint64_t next = 0;
+    if (from_spill) {
+      uint64_t from = m_spill_read, end = m_spill_end;
+      guard.unlock();
+      next = read_spill(from, end, &batch);
+    } else {
+      batch.resize(std::min(m_size, AUDIT_WRITE_BATCH));
+      for (Pending &ev : batch) {
+        Pending &slot = m_ring[m_head];
+        ev.ts_ms = slot.ts_ms;
+        memcpy(ev.attr, slot.attr, sizeof(ev.attr));
+        ev.flags = slot.flags;
+        ev.details.swap(slot.details);
+        m_head = (m_head + 1) % m_ring.size();
+      }
+      m_size -= batch.size();
+      m_not_full.notify_all();
+      guard.unlock();
+    }
+
+    uint64_t ok = 0;
+    for (const Pending &ev : batch)
+      ok += m_store->append(ev.ts_ms, ev.attr, ev.flags, ev.details.data(),
+                            ev.details.size()) != 0;
+
+    guard.lock();
+    m_metrics.written += ok;
+    m_metrics.write_errors += batch.size() - ok;
+    if (from_spill) {
+      m_metrics.drained += ok;
+      m_spill_read = next;
+      if (m_spill_read >= m_spill_end) {
+        // Fully drained: start the file over. Cut it first, so a crash in
+        // between cannot make drained records look pending again.
+        truncate_file(m_spill, sizeof(AuditSpillHeader));
+        m_spill_read = m_spill_end = sizeof(AuditSpillHeader);
+      }
+      save_spill_header();
+    }
+    m_writing = false;
+  }
+}
+
+bool AuditQueue::flush() {
+  std::unique_lock<std::mutex> guard(m_lock);
+  if (!m_store)
+    return false;
+  m_wake_writer.notify_one();
+  m_idle.wait(guard, [&] {
+    return m_size == 0 && m_spill_read >= m_spill_end && !m_writing;
+  });
+  return true;
+}
+
+void AuditQueue::metrics(AuditQueueMetrics *out) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  *out = m_metrics;
+  out->depth = m_size;
+  out->capacity = m_ring.size();
+  out->spill_bytes = m_spill_end - m_spill_read;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "audit_store.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// --- Async Audit Queue ---
+// log_event() hands events to a fixed-capacity ring; one writer thread
+// appends them to the AuditStore, so a slow or stalled disk does not stall
+// logins and memory stays bounded. What happens when the ring is full is
+// chosen per event type:
+//
+//   BLOCK   the caller waits for room
+//   SPILL   the event goes to an append-only overflow file, drained in
+//           turn with the ring once the writer catches up
+//   SAMPLE  one in AUDIT_SAMPLE_EVERY is spilled, the rest are counted as
+//           sampled out and dropped
+//
+// Spill file: [AuditSpillHeader][record]... Records use the segment record
+// layout with event_id 0 and their own marker. The header tracks how far
+// the file has been drained, so a spill file left by a crash is drained
+// from there on the next start (at most the batch in flight is written
+// twice).
+
+const size_t AUDIT_QUEUE_CAPACITY = 8192;
+const uint32_t AUDIT_SAMPLE_EVERY = 16;
+const uint32_t AUDIT_SPILL_MARKER = 0xA0D15B11;
+const size_t AUDIT_WRITE_BATCH = 256;
+
+const char AUDIT_SPILL_MAGIC[8] = {'S', 'A', 'S', 'P', 'I', 'L', 'L', '1'};
+
+struct AuditSpillHeader {
+  char magic[8];
+  uint64_t drained_to; // offset of the first record not yet in the store
+};
+
+enum AuditOverflowPolicy : int {
+  AUDIT_POLICY_BLOCK,
+  AUDIT_POLICY_SPILL,
+  AUDIT_POLICY_SAMPLE
+};
+
+// Layout shared with Python (ctypes.Structure) - keep fields 64-bit
+struct AuditQueueMetrics {
+  uint64_t depth; // events in the ring
+  uint64_t capacity;
+  uint64_t enqueued;
+  uint64_t written; // appended to the store, ring and spill
+  uint64_t spilled;
+  uint64_t spill_bytes; // not yet drained
+  uint64_t drained;     // written from the spill file
+  uint64_t sampled_out;
+  uint64_t blocked; // callers that had to wait
+  uint64_t write_errors;
+  uint64_t drain_rate; // events/s over the last second
+};
+
+//
+// AuditQueue - bounded ring plus spill file in front of an AuditStore
+//
+class AuditQueue {
+private:
+  struct Pending {
+    int64_t ts_ms;
+    uint32_t attr[AUDIT_ATTR_COUNT];
+    uint16_t flags;
+    std::string details;
+  };
+
+  AuditStore *m_store;
+  std::vector<Pending> m_ring;
+  size_t m_head;
+  size_t m_size;
+
+  std::mutex m_lock;
+  std::condition_variable m_wake_writer;
+  std::condition_variable m_not_full;
+  std::condition_variable m_idle;
+  std::thread m_writer;
+  bool m_stop;
+  bool m_writing; // writer holds a batch outside the lock
+
+  std::string m_spill_path;
+  FILE *m_spill;        // appends, under m_lock
+  FILE *m_spill_reader; // reads records, updates the header
+  uint64_t m_spill_read;
+  uint64_t m_spill_end;
+
+  std::unordered_map<uint32_t, AuditOverflowPolicy> m_policies; // by type
+  AuditOverflowPolicy m_default_policy;
+  uint64_t m_sample_tick;
+
+  AuditQueueMetrics m_metrics;
+  uint64_t m_rate_written;
+  int64_t m_rate_start_ms;
+
+  AuditOverflowPolicy policy_for(uint32_t event_type) const;
+  bool spill_locked(int64_t ts_ms, const uint32_t attr[AUDIT_ATTR_COUNT],
+                    uint16_t flags, const char *details, size_t details_len);
+  bool save_spill_header();
+  uint64_t read_spill(uint64_t from, uint64_t end, std::vector<Pending> *out);
+  void write_loop();
+
+public:
+  AuditQueue();
+  ~AuditQueue();
+
+  AuditQueue(const AuditQueue &) = delete;
+  AuditQueue &operator=(const AuditQueue &) = delete;
+
+  // Start the writer. Leftovers in `spill_path` are drained first.
+  bool start(AuditStore *store, const char *spill_path, size_t capacity);
+
+  // Write out everything queued or spilled, then stop the writer
+  void stop();
+
+  // `event_type` nullptr sets the default (SPILL unless changed)
+  void set_policy(const char *event_type, AuditOverflowPolicy policy);
+
+  // False if the event was sampled out or could not be queued
+  bool push(int64_t ts_ms, const uint32_t attr[AUDIT_ATTR_COUNT],
+            uint16_t flags, const char *details, size_t details_len);
+
+  // Wait until the ring and the spill file are empty
+  bool flush();
+
+  void metrics(AuditQueueMetrics *out);
+};
@@ -0,0 +1,449 @@
+/*
+ * Audit Replay
+ *
+ * Streams a recorded audit log through the intrusion checks (see
+ * intrusion_checks.h) under a virtual clock: each event's own timestamp is
+ * "now" for the checks audit_log.check_intrusion_patterns() makes when it
+ * is logged, so new thresholds can be tried against months of history in
+ * seconds. Reads audit_log.db, or a native audit directory without opening
+ * it for writing.
+ *
+ * Prints how many alerts of each type would have fired and the replay
+ * rate; --alerts writes every alert as a JSON line. Alerts are
+ * de-duplicated per user and type for an hour, as create_alert() does for
+ * unresolved ones. Sequence rules (--rules, sequence_detector.h syntax)
+ * are reported under their names with a null severity.
+ *
+ * Usage: audit_replay <audit_log.db | audit_dir> [--failed-threshold N]
+ *            [--window-minutes M] [--rapid-threshold N] [--rules FILE]
+ *            [--alerts FILE]
+ */
+
+#include "audit_compress.h"
+#include "audit_store.h"
+#include "details_codec.h"
+#include "intrusion_checks.h"
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ReplayOptions {
+  std::string source;
+  std::string rules_path;
+  std::string alerts_path;
+  IntrusionThresholds thresholds;
+};
+
+typedef std::function<void(const IntrusionEvent &)> ReplaySink;
+
+static bool get_varint(const uint8_t *&p, const uint8_t *end, uint64_t *v) {
+  uint64_t result = 0;
+  for (int shift = 0; shift < 64 && p < end; shift += 7) {
+    uint8_t b = *p++;
+    result |= (uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      *v = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void local_tm(int64_t ts_ms, struct tm *out) {
+  time_t secs = (time_t)(ts_ms / 1000);
+#ifdef _WIN32
+  localtime_s(out, &secs);
+#else
+  localtime_r(&secs, out);
+#endif
+}
+
+static void json_string(const std::string &s, std::string *out) {
+  *out += '"';
+  for (unsigned char c : s) {
+    if (c == '"' || c == '\\') {
+      *out += '\\';
+      *out += (char)c;
+    } else if (c < 0x20) {
+      char esc[8];
+      snprintf(esc, sizeof(esc), "\\u%04x", c);
+      *out += esc;
+    } else {
+      *out += (char)c;
+    }
+  }
+  *out += '"';
+}
+
+static int totp_offset_of(const std::vector<DetailsField> &fields) {
+  for (const DetailsField &f : fields)
+    if (f.key == "totp_offset" && f.type == DETAILS_INT)
+      return (int)f.ival;
+  return PROFILE_NO_TOTP;
+}
+
+//
+// ReplayReport - alerts counted by type, and optionally written out
+//
+class ReplayReport {
+private:
+  std::map<std::string, uint64_t> m_counts; // alerts by type
+  std::unordered_map<uint32_t, bool> m_users;
+  FILE *m_alerts;
+
+public:
+  ReplayReport() : m_alerts(nullptr) {}
+  ~ReplayReport() {
+    if (m_alerts)
+      fclose(m_alerts);
+  }
+
+  bool open_alerts(const char *path) {
+    m_alerts = fopen(path, "w");
+    return m_alerts != nullptr;
+  }
+
+  void add(const IntrusionAlert &alert) {
+    m_counts[alert.type]++;
+    m_users[alert.user] = true;
+    if (!m_alerts)
+      return;
+
+    struct tm t;
+    local_tm(alert.ts_ms, &t);
+    char stamp[40];
+    size_t n = strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &t);
+    snprintf(stamp + n, sizeof(stamp) - n, ".%03d",
+             (int)(alert.ts_ms % 1000));
+    const std::string *user = global_symbols().name(alert.user);
+    std::string line = "{\"timestamp\": \"" + std::string(stamp) +
+                       "\", \"username\": ";
+    json_string(user ? *user : std::string(), &line);
+    line += ", \"alert_type\": ";
+    json_string(alert.type, &line);
+    line += ", \"severity\": ";
+    if (alert.severity)
+      json_string(alert.severity, &line);
+    else
+      line += "null";
+    line += ", \"description\": ";
+    json_string(alert.description, &line);
+    line += "}\n";
+    fwrite(line.data(), 1, line.size(), m_alerts);
+  }
+
+  const std::map<std::string, uint64_t> &counts() const { return m_counts; }
+  size_t users() const { return m_users.size(); }
+};
+
+// --- audit_log.db ---
+
+// datetime.isoformat() in local time -> ms. mktime() is slow, so it runs
+// once per hour of log.
+static int64_t parse_timestamp(const char *s) {
+  static char hour_key[14];
+  static int64_t hour_ms = 0;
+  int year, month, day, hour, min, sec;
+  char frac[8] = {0};
+  int n = sscanf(s, "%4d-%2d-%2dT%2d:%2d:%2d.%6[0-9]", &year, &month, &day,
+                 &hour, &min, &sec, frac);
+  if (n < 6 || strlen(s) < 13)
+    return 0;
+  if (memcmp(hour_key, s, 13) != 0) {
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    t.tm_year = year - 1900;
+    t.tm_mon = month - 1;
+    t.tm_mday = day;
+    t.tm_hour = hour;
+    t.tm_isdst = -1;
+    hour_ms = (int64_t)mktime(&t) * 1000;
+    memcpy(hour_key, s, 13);
+  }
+  int ms = n == 7 ? atoi((std::string(frac) + "000").substr(0, 3).c_str()) : 0;
+  return hour_ms + (min * 60 + sec) * 1000 + ms;
+}
+
+static bool read_database(const std::string &path, const ReplaySink &sink,
+                          uint64_t *events) {
+  sqlite3 *db;
+  if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) !=
+      SQLITE_OK) {
+    sqlite3_close(db);
+    return false;
+  }
+  sqlite3_stmt *stmt;
+  bool ok = sqlite3_prepare_v2(db,
+                               "SELECT timestamp, username, event_type, "
+                               "status, ip_address, details FROM audit_log "
+                               "ORDER BY id",
+                               -1, &stmt, nullptr) == SQLITE_OK;
+  SymbolTable &symbols = global_symbols();
+  uint32_t totp = symbols.intern("TOTP"), success = symbols.intern("SUCCESS");
+  std::unordered_map<std::string, uint32_t> prefixes;
+  std::vector<DetailsField> fields;
+  auto text = [&](int col) {
+    const unsigned char *s = sqlite3_column_text(stmt, col);
+    return s ? (const char *)s : "";
+  };
+
+  int rc;
+  while (ok && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    IntrusionEvent ev;
+    ev.ts_ms = parse_timestamp(text(0));
+    ev.user = symbols.intern(text(1));
+    ev.event_type = symbols.intern(text(2));
+    ev.status = symbols.intern(text(3));
+    auto prefix = prefixes.find(text(4));
+    if (prefix == prefixes.end())
+      prefix = prefixes.emplace(text(4), intrusion_ip_prefix(text(4))).first;
+    ev.ip_prefix = prefix->second;
+    ev.totp_offset = PROFILE_NO_TOTP;
+    const char *details = text(5);
+    if (ev.event_type == totp && ev.status == success && *details &&
+        details_parse_json(details, strlen(details), &fields))
+      ev.totp_offset = totp_offset_of(fields);
+    sink(ev);
+    (*events)++;
+  }
+  ok = ok && rc == SQLITE_DONE;
+  sqlite3_finalize(stmt);
+  sqlite3_close(db);
+  return ok;
+}
+
+// --- Native Segments ---
+
+// Every event of an intact raw segment image, repeats in aggregate records
+// at their own times
+static void read_records(const char *data, size_t size, size_t pos,
+                         const ReplaySink &sink, uint64_t *events) {
+  SymbolTable &symbols = global_symbols();
+  uint32_t totp = symbols.intern("TOTP"), success = symbols.intern("SUCCESS");
+  std::unordered_map<uint32_t, uint32_t> prefixes; // by IP symbol
+  std::vector<DetailsField> fields;
+  std::vector<int64_t> times;
+
+  while (size - pos >= sizeof(AuditRecordHeader) + sizeof(AuditRecordBody)) {
+    AuditRecordHeader rh;
+    AuditRecordBody body;
+    memcpy(&rh, data + pos, sizeof(rh));
+    memcpy(&body, data + pos + sizeof(rh), sizeof(body));
+    if (rh.marker != AUDIT_RECORD_MARKER ||
+        rh.length != sizeof(body) + body.details_len ||
+        rh.length > size - pos - sizeof(rh))
+      return;
+    const char *details = data + pos + sizeof(rh) + sizeof(body);
+    size_t len = body.details_len;
+    pos += sizeof(rh) + rh.length;
+
+    times.assign(1, body.ts_ms);
+    if (body.flags & AUDIT_FLAG_AGGREGATE) {
+      AuditAggregate agg;
+      if (len < sizeof(agg))
+        continue;
+      memcpy(&agg, details, sizeof(agg));
+      if (agg.deltas_len > len - sizeof(agg))
+        continue;
+      const uint8_t *p = (const uint8_t *)details + sizeof(agg);
+      const uint8_t *end = p + agg.deltas_len;
+      uint64_t delta;
+      while (p < end && get_varint(p, end, &delta))
+        times.push_back(times.back() + (int64_t)delta);
+      details += sizeof(agg) + agg.deltas_len;
+      len -= sizeof(agg) + agg.deltas_len;
+    }
+
+    IntrusionEvent ev;
+    ev.user = body.attr[AUDIT_ATTR_USER];
+    ev.event_type = body.attr[AUDIT_ATTR_EVENT_TYPE];
+    ev.status = body.attr[AUDIT_ATTR_STATUS];
+    uint32_t ip = body.attr[AUDIT_ATTR_IP];
+    auto prefix = prefixes.find(ip);
+    if (prefix == prefixes.end()) {
+      const std::string *name = symbols.name(ip);
+      prefix = prefixes
+                   .emplace(ip, name ? intrusion_ip_prefix(name->c_str()) : 0)
+                   .first;
+    }
+    ev.ip_prefix = prefix->second;
+    ev.totp_offset = PROFILE_NO_TOTP;
+    if (ev.event_type == totp && ev.status == success && len &&
+        ((body.flags & AUDIT_FLAG_BINARY_DETAILS)
+             ? details_decode(details, len, &fields)
+             : details_parse_json(details, len, &fields)))
+      ev.totp_offset = totp_offset_of(fields);
+    for (int64_t ts : times) {
+      ev.ts_ms = ts;
+      sink(ev);
+      (*events)++;
+    }
+  }
+}
+
+// Symbol IDs in the records are those of dir/symbols.dat, loaded first
+static bool read_segments(const std::string &dir, const ReplaySink &sink,
+                          uint64_t *events) {
+  // Segments are numbered from 1 without gaps, each .z or .aud
+  for (uint32_t id = 1;; id++) {
+    char name[32];
+    snprintf(name, sizeof(name), "/seg-%08u.z", id);
+    CompressedSegment z;
+    if (z.open((dir + name).c_str())) {
+      for (size_t i = 0; i < z.frame_count(); i++) {
+        const std::string *frame;
+        if (!z.load_frame(i, &frame))
+          return false;
+        read_records(frame->data(), frame->size(), 0, sink, events);
+      }
+      continue;
+    }
+
+    snprintf(name, sizeof(name), "/seg-%08u.aud", id);
+    FILE *f = fopen((dir + name).c_str(), "rb");
+    if (!f)
+      return id > 1;
+    std::vector<char> data;
+    fseek(f, 0, SEEK_END);
+    data.resize((size_t)std::max(0L, ftell(f)));
+    rewind(f);
+    bool read = fread(data.data(), 1, data.size(), f) == data.size();
+    fclose(f);
+    if (!read || data.size() < sizeof(AuditSegmentHeader) ||
+        memcmp(data.data(), AUDIT_SEGMENT_MAGIC, 8) != 0)
+      return false;
+    read_records(data.data(), data.size(), sizeof(AuditSegmentHeader), sink,
+                 events);
+  }
+}
+
+// --- Main ---
+
+static int usage() {
+  fprintf(stderr,
+          "Usage: audit_replay <audit_log.db | audit_dir> "
+          "[--failed-threshold N]\n"
+          "           [--window-minutes M] [--rapid-threshold N] "
+          "[--rules FILE] [--alerts FILE]\n");
+  return 2;
+}
+
+static bool read_file(const std::string &path, std::string *out) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    out->append(buf, n);
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2)
+    return usage();
+
+  ReplayOptions opts;
+  opts.source = argv[1];
+  opts.thresholds.failed_attempts = 5;
+  opts.thresholds.window_minutes = 15;
+  opts.thresholds.rapid_attempts = 10;
+  for (int i = 2; i < argc; i++) {
+    if (i + 1 >= argc)
+      return usage();
+    if (strcmp(argv[i], "--failed-threshold") == 0)
+      opts.thresholds.failed_attempts = (uint32_t)std::max(1, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--window-minutes") == 0)
+      opts.thresholds.window_minutes = std::max(1, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--rapid-threshold") == 0)
+      opts.thresholds.rapid_attempts = (uint32_t)std::max(1, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--rules") == 0)
+      opts.rules_path = argv[++i];
+    else if (strcmp(argv[i], "--alerts") == 0)
+      opts.alerts_path = argv[++i];
+    else
+      return usage();
+  }
+
+  // The checks and rules intern names, so a native directory's symbol
+  // table must be in place first
+  bool native = global_symbols().load((opts.source + "/symbols.dat").c_str());
+  IntrusionChecks checks(opts.thresholds);
+  ReplayReport report;
+  std::string rules, error;
+  if (!opts.rules_path.empty() &&
+      (!read_file(opts.rules_path, &rules) ||
+       !checks.set_rules(rules, &error))) {
+    fprintf(stderr, "Error: rules in %s: %s\n", opts.rules_path.c_str(),
+            error.empty() ? "cannot read" : error.c_str());
+    return 1;
+  }
+  if (!opts.alerts_path.empty() &&
+      !report.open_alerts(opts.alerts_path.c_str())) {
+    fprintf(stderr, "Error: cannot write %s\n", opts.alerts_path.c_str());
+    return 1;
+  }
+
+  int64_t first_ms = 0, last_ms = 0;
+  std::vector<IntrusionAlert> alerts;
+  ReplaySink sink = [&](const IntrusionEvent &ev) {
+    if (!first_ms)
+      first_ms = ev.ts_ms;
+    last_ms = ev.ts_ms;
+    if (checks.check(ev, &alerts)) {
+      for (const IntrusionAlert &alert : alerts)
+        report.add(alert);
+      alerts.clear();
+    }
+  };
+  uint64_t events = 0;
+  auto start = std::chrono::steady_clock::now();
+  bool ok = native ? read_segments(opts.source, sink, &events)
+                   : read_database(opts.source, sink, &events);
+  double secs = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  if (!ok) {
+    fprintf(stderr, "Error: cannot read %s\n", opts.source.c_str());
+    return 1;
+  }
+
+  char from[16] = "-", to[16] = "-";
+  struct tm t;
+  if (events) {
+    local_tm(first_ms, &t);
+    strftime(from, sizeof(from), "%Y-%m-%d", &t);
+    local_tm(last_ms, &t);
+    strftime(to, sizeof(to), "%Y-%m-%d", &t);
+  }
+  uint64_t total = 0;
+  for (const auto &entry : report.counts())
+    total += entry.second;
+  printf("audit_replay: %llu events (%s .. %s) from %s, %.2fs (%.0f "
+         "events/s)\n",
+         (unsigned long long)events, from, to,
+         native ? "native segments" : "audit_log.db", secs,
+         events / std::max(secs, 1e-9));
+  printf("  thresholds: %u failures in %lld min, %u attempts in 1 min\n",
+         opts.thresholds.failed_attempts,
+         (long long)opts.thresholds.window_minutes,
+         opts.thresholds.rapid_attempts);
+  printf("  alerts: %llu for %zu users\n", (unsigned long long)total,
+         report.users());
+  for (const auto &entry : report.counts())
+    printf("    %-24s %llu\n", entry.first.c_str(),
+           (unsigned long long)entry.second);
+  return 0;
+}
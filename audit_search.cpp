@@ -0,0 +1,252 @@
+#include "audit_search.h"
+
+#include "credential_snapshot.h"
+#include "crypto_core.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+const uint32_t POSTINGS_MAGIC = 0x58494153; // "SAIX"
+
+// --- Tokenizer ---
+
+std::string details_normalize_term(const char *term, size_t len) {
+  std::string out;
+  out.reserve(std::min(len, DETAILS_MAX_TERM));
+  for (size_t i = 0; i < len && out.size() < DETAILS_MAX_TERM; i++) {
+    char c = term[i];
+    if (c >= 'A' && c <= 'Z')
+      c = (char)(c - 'A' + 'a');
+    else if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+      c = '_';
+    out += c;
+  }
+  return out;
+}
+
+static bool is_word_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+static void add_value_terms(const std::string &key, const std::string &value,
+                            std::vector<std::string> *terms) {
+  std::string prefix = details_normalize_term(key.data(), key.size()) + ":";
+  terms->push_back(prefix + details_normalize_term(value.data(), value.size()));
+
+  for (size_t i = 0; i < value.size();) {
+    if (!is_word_char(value[i])) {
+      i++;
+      continue;
+    }
+    size_t start = i;
+    while (i < value.size() && is_word_char(value[i]))
+      i++;
+    if (i - start < 2)
+      continue;
+    std::string word = details_normalize_term(value.data() + start, i - start);
+    terms->push_back(prefix + word);
+    terms->push_back(word);
+  }
+}
+
+static void add_field_terms(const std::string &key, const DetailsField &field,
+                            std::vector<std::string> *terms, int depth) {
+  std::vector<DetailsField> nested;
+  if (field.type == DETAILS_JSON && depth < 8 &&
+      details_parse_json(field.text.data(), field.text.size(), &nested)) {
+    for (const DetailsField &n : nested)
+      add_field_terms(key + "." + n.key, n, terms, depth + 1);
+    return;
+  }
+  // Arrays (and anything unparsable) are searchable by their words
+  add_value_terms(key, details_value_text(field), terms);
+}
+
+void details_terms(const std::vector<DetailsField> &fields,
+                   std::vector<std::string> *terms) {
+  terms->clear();
+  for (const DetailsField &f : fields)
+    add_field_terms(f.key, f, terms, 0);
+  std::sort(terms->begin(), terms->end());
+  terms->erase(std::unique(terms->begin(), terms->end()), terms->end());
+}
+
+// --- Bit Packing ---
+
+static uint32_t bit_width(uint32_t v) {
+  return v ? 32 - (uint32_t)__builtin_clz(v) : 0;
+}
+
+static void pack_block(const uint32_t *ids, size_t n,
+                       std::vector<uint8_t> *out) {
+  uint32_t bits = 0;
+  for (size_t i = 1; i < n; i++)
+    bits = std::max(bits, bit_width(ids[i] - ids[i - 1]));
+
+  uint8_t head[5];
+  memcpy(head, &ids[0], 4);
+  head[4] = (uint8_t)bits;
+  out->insert(out->end(), head, head + 5);
+
+  uint64_t acc = 0;
+  uint32_t filled = 0;
+  for (size_t i = 1; i < n; i++) {
+    acc |= (uint64_t)(ids[i] - ids[i - 1]) << filled;
+    filled += bits;
+    while (filled >= 8) {
+      out->push_back((uint8_t)acc);
+      acc >>= 8;
+      filled -= 8;
+    }
+  }
+  if (filled)
+    out->push_back((uint8_t)acc);
+}
+
+// Returns the position after the block, or nullptr if it overruns `end`
+static const uint8_t *unpack_block(const uint8_t *p, const uint8_t *end,
+                                   size_t n, std::vector<uint32_t> *out) {
+  if (end - p < 5)
+    return nullptr;
+  uint32_t id;
+  memcpy(&id, p, 4);
+  uint32_t bits = p[4];
+  p += 5;
+  size_t packed = ((n - 1) * bits + 7) / 8;
+  if (bits > 32 || (size_t)(end - p) < packed)
+    return nullptr;
+
+  out->push_back(id);
+  uint64_t acc = 0;
+  uint32_t filled = 0;
+  uint64_t mask = bits == 32 ? 0xFFFFFFFFull : (uint64_t(1) << bits) - 1;
+  for (size_t i = 1; i < n; i++) {
+    while (filled < bits) {
+      acc |= (uint64_t)*p++ << filled;
+      filled += 8;
+    }
+    id += (uint32_t)(acc & mask);
+    acc >>= bits;
+    filled -= bits;
+    out->push_back(id);
+  }
+  return p;
+}
+
+// --- PostingsBuilder ---
+
+void PostingsBuilder::add(uint32_t term, uint32_t event_id) {
+  std::vector<uint32_t> &ids = m_postings[term];
+  if (ids.empty() || ids.back() != event_id)
+    ids.push_back(event_id);
+}
+
+void PostingsBuilder::find(uint32_t term, std::vector<uint32_t> *out) const {
+  auto it = m_postings.find(term);
+  if (it == m_postings.end())
+    out->clear();
+  else
+    *out = it->second;
+}
+
+// [magic][term_count][(term, count, offset) x term_count][blocks][checksum]
+void PostingsBuilder::encode(std::vector<uint8_t> *out) const {
+  std::vector<uint32_t> terms;
+  terms.reserve(m_postings.size());
+  for (const auto &entry : m_postings)
+    terms.push_back(entry.first);
+  std::sort(terms.begin(), terms.end());
+
+  size_t dir_size = 8 + terms.size() * 12;
+  out->assign(dir_size, 0);
+  uint32_t count = (uint32_t)terms.size();
+  memcpy(out->data(), &POSTINGS_MAGIC, 4);
+  memcpy(out->data() + 4, &count, 4);
+
+  for (size_t t = 0; t < terms.size(); t++) {
+    const std::vector<uint32_t> &ids = m_postings.at(terms[t]);
+    uint32_t entry[3] = {terms[t], (uint32_t)ids.size(),
+                         (uint32_t)out->size()};
+    memcpy(out->data() + 8 + t * 12, entry, 12);
+    for (size_t i = 0; i < ids.size(); i += POSTINGS_BLOCK)
+      pack_block(ids.data() + i, std::min<size_t>(POSTINGS_BLOCK, ids.size() - i),
+                 out);
+  }
+
+  uint64_t check = fnv1a64(out->data(), out->size());
+  out->insert(out->end(), (uint8_t *)&check, (uint8_t *)&check + 8);
+}
+
+// --- PackedPostings ---
+
+PackedPostings::PackedPostings() : m_terms(nullptr), m_term_count(0) {}
+
+bool PackedPostings::assign(std::vector<uint8_t> data) {
+  m_data.clear();
+  m_terms = nullptr;
+  m_term_count = 0;
+
+  uint32_t magic, count;
+  uint64_t check;
+  if (data.size() < 16)
+    return false;
+  memcpy(&magic, data.data(), 4);
+  memcpy(&count, data.data() + 4, 4);
+  memcpy(&check, data.data() + data.size() - 8, 8);
+  if (magic != POSTINGS_MAGIC || (data.size() - 16) / 12 < count ||
+      fnv1a64(data.data(), data.size() - 8) != check)
+    return false;
+
+  m_data = std::move(data);
+  m_terms = (const TermEntry *)(m_data.data() + 8);
+  m_term_count = count;
+  return true;
+}
+
+bool PackedPostings::load(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  std::vector<uint8_t> data;
+  uint8_t buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    data.insert(data.end(), buf, buf + n);
+  fclose(f);
+  return assign(std::move(data));
+}
+
+bool PackedPostings::save(const char *path) const {
+  std::string tmp = std::string(path) + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (!f)
+    return false;
+  bool ok = fwrite(m_data.data(), 1, m_data.size(), f) == m_data.size();
+  ok = fclose(f) == 0 && ok;
+  if (!ok || !replace_file(tmp.c_str(), path)) {
+    remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+void PackedPostings::find(uint32_t term, std::vector<uint32_t> *out) const {
+  out->clear();
+  const TermEntry *end = m_terms + m_term_count;
+  const TermEntry *it = std::lower_bound(
+      m_terms, end, term,
+      [](const TermEntry &e, uint32_t t) { return e.term < t; });
+  if (it == end || it->term != term || it->offset >= m_data.size())
+    return;
+
+  const uint8_t *p = m_data.data() + it->offset;
+  const uint8_t *data_end = m_data.data() + m_data.size() - 8;
+  out->reserve(it->count);
+  for (uint32_t left = it->count; left > 0 && p;) {
+    size_t n = std::min(left, POSTINGS_BLOCK);
+    p = unpack_block(p, data_end, n, out);
+    left -= (uint32_t)n;
+  }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "details_codec.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// --- Audit Details Search ---
+// Inverted index from details tokens to event IDs, one per audit segment.
+//
+// Each key/value pair of the details (see details_codec.h) yields "key:value" for the whole
+// value, plus "key:word" and "word" for every word in it, so
+// {"reason": "database_error"} is found by "reason:database_error" and by
+// "database_error". Nested keys are joined with '.'. Terms are lowercased
+// and interned through the symbol table, so postings key on term IDs.
+//
+// While a segment is open its postings are plain vectors; when it is sealed
+// they are packed into blocks of 128 IDs (first ID, then deltas bit-packed
+// at the block's widest delta) and saved next to the segment as .idx.
+
+const uint32_t POSTINGS_BLOCK = 128;
+const size_t DETAILS_MAX_TERM = 64;
+
+// Terms for one event's details (duplicates removed)
+void details_terms(const std::vector<DetailsField> &fields,
+                   std::vector<std::string> *terms);
+
+// Normalise a search token the same way ("Reason:Database_Error" etc.)
+std::string details_normalize_term(const char *term, size_t len);
+
+//
+// PostingsBuilder - postings for the open segment
+//
+class PostingsBuilder {
+private:
+  std::unordered_map<uint32_t, std::vector<uint32_t>> m_postings;
+
+public:
+  // Event IDs must be added in increasing order
+  void add(uint32_t term, uint32_t event_id);
+  void find(uint32_t term, std::vector<uint32_t> *out) const;
+  void clear() { m_postings.clear(); }
+  bool empty() const { return m_postings.empty(); }
+
+  void encode(std::vector<uint8_t> *out) const;
+};
+
+//
+// PackedPostings - read-only view of an encoded index
+//
+class PackedPostings {
+private:
+  struct TermEntry {
+    uint32_t term;
+    uint32_t count;
+    uint32_t offset;
+  };
+
+  std::vector<uint8_t> m_data;
+  const TermEntry *m_terms;
+  uint32_t m_term_count;
+
+public:
+  PackedPostings();
+
+  // Validates the layout; false leaves the index empty
+  bool assign(std::vector<uint8_t> data);
+  bool load(const char *path);
+  bool save(const char *path) const;
+
+  bool empty() const { return m_term_count == 0; }
+  size_t bytes() const { return m_data.size(); }
+
+  // Decoded IDs for `term`, ascending
+  void find(uint32_t term, std::vector<uint32_t> *out) const;
+};
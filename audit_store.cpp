@@ -0,0 +1,2193 @@
+#include "audit_store.h"
+
+#include "audit_compress.h"
+#include "audit_queue.h"
+#include "audit_tail.h"
+#include "credential_snapshot.h"
+#include "crypto_core.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static int64_t now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+static bool make_dir(const char *path) {
+#ifdef _WIN32
+  return _mkdir(path) == 0 || errno == EEXIST;
+#else
+  return mkdir(path, 0700) == 0 || errno == EEXIST;
+#endif
+}
+
+static bool truncate_file(FILE *f, long size) {
+#ifdef _WIN32
+  return _chsize(_fileno(f), size) == 0;
+#else
+  return ftruncate(fileno(f), (off_t)size) == 0;
+#endif
+}
+
+static uint64_t attr_key(uint32_t attr, uint32_t symbol) {
+  return ((uint64_t)attr << 32) | symbol;
+}
+
+static int64_t bucket_of(int64_t ts_ms) {
+  return ts_ms >= 0 ? ts_ms / AUDIT_BUCKET_MS
+                    : (ts_ms - AUDIT_BUCKET_MS + 1) / AUDIT_BUCKET_MS;
+}
+
+uint32_t audit_record_check(const AuditRecordBody &body, const char *details) {
+  uint64_t h = fnv1a64(&body, sizeof(body));
+  h ^= fnv1a64(details, body.details_len) * 0x9E3779B97F4A7C15ULL;
+  return (uint32_t)(h ^ (h >> 32));
+}
+
+static void put_varint(std::string *out, uint64_t v) {
+  while (v >= 0x80) {
+    out->push_back((char)(v | 0x80));
+    v >>= 7;
+  }
+  out->push_back((char)v);
+}
+
+static bool get_varint(const uint8_t *&p, const uint8_t *end, uint64_t *v) {
+  uint64_t result = 0;
+  for (int shift = 0; shift < 64 && p < end; shift += 7) {
+    uint8_t b = *p++;
+    result |= (uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      *v = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+static size_t varint_size(uint64_t v) {
+  size_t n = 1;
+  while (v >= 0x80) {
+    v >>= 7;
+    n++;
+  }
+  return n;
+}
+
+// Step past an aggregate record's prefix to its details. `times` (optional)
+// receives the timestamp of every event the record stands for.
+static bool split_aggregate(uint16_t flags, int64_t ts_ms,
+                            const char **details, size_t *len,
+                            uint32_t *count, std::vector<int64_t> *times) {
+  *count = 1;
+  if (times)
+    times->clear();
+  if (!(flags & AUDIT_FLAG_AGGREGATE))
+    return true;
+
+  AuditAggregate agg;
+  if (*len < sizeof(agg))
+    return false;
+  memcpy(&agg, *details, sizeof(agg));
+  if (agg.count == 0 || agg.deltas_len > *len - sizeof(agg))
+    return false;
+  if (times) {
+    const uint8_t *p = (const uint8_t *)*details + sizeof(agg);
+    const uint8_t *end = p + agg.deltas_len;
+    times->push_back(ts_ms);
+    while (p < end) {
+      uint64_t delta;
+      if (!get_varint(p, end, &delta))
+        return false;
+      times->push_back(times->back() + (int64_t)delta);
+    }
+    if (times->size() != agg.count)
+      return false;
+  }
+  *count = agg.count;
+  *details += sizeof(agg) + agg.deltas_len;
+  *len -= sizeof(agg) + agg.deltas_len;
+  return true;
+}
+
+static uint64_t burst_key(const uint32_t attr[AUDIT_ATTR_COUNT],
+                          uint16_t flags, const char *details, size_t len) {
+  uint64_t h = fnv1a64(attr, sizeof(uint32_t) * AUDIT_ATTR_COUNT);
+  return (h ^ (fnv1a64(details, len) * 0x9E3779B97F4A7C15ULL)) + flags;
+}
+
+static uint32_t footer_check(const AuditSegmentFooter &footer) {
+  uint64_t h = fnv1a64(&footer, offsetof(AuditSegmentFooter, check));
+  return (uint32_t)(h ^ (h >> 32));
+}
+
+// --- AuditStore ---
+
+AuditStore::AuditStore()
+    : m_writer(nullptr), m_next_event_id(1), m_aggregate_bursts(true),
+      m_last_sweep_ms(0), m_login_symbol(SymbolTable::NO_SYMBOL),
+      m_totp_symbol(SymbolTable::NO_SYMBOL),
+      m_success_symbol(SymbolTable::NO_SYMBOL),
+      m_enforcement_symbol(SymbolTable::NO_SYMBOL), m_raw_bytes(0),
+      m_compressed_bytes(0), m_finish_busy(false), m_finish_stop(false) {}
+
+AuditStore::~AuditStore() { close(); }
+
+std::string AuditStore::segment_path(uint32_t id) const {
+  char name[32];
+  snprintf(name, sizeof(name), "/seg-%08u.aud", id);
+  return m_dir + name;
+}
+
+std::string AuditStore::index_path(uint32_t id) const {
+  char name[32];
+  snprintf(name, sizeof(name), "/seg-%08u.idx", id);
+  return m_dir + name;
+}
+
+// Binary details, or JSON text from records written before the codec
+static bool decode_details(uint16_t flags, const char *details, size_t len,
+                           std::vector<DetailsField> *fields) {
+  if (flags & AUDIT_FLAG_BINARY_DETAILS)
+    return details_decode(details, len, fields);
+  return details_parse_json(details, len, fields);
+}
+
+std::string AuditStore::zsegment_path(uint32_t id) const {
+  char name[32];
+  snprintf(name, sizeof(name), "/seg-%08u.z", id);
+  return m_dir + name;
+}
+
+std::string AuditStore::record_index_path(uint32_t id) const {
+  char name[32];
+  snprintf(name, sizeof(name), "/seg-%08u.rix", id);
+  return m_dir + name;
+}
+
+// Interned search terms of a record's details
+static void record_terms(uint16_t flags, const char *details, size_t len,
+                         std::vector<uint32_t> *out) {
+  std::vector<DetailsField> fields;
+  std::vector<std::string> terms;
+  uint32_t count;
+  out->clear();
+  if (!split_aggregate(flags, 0, &details, &len, &count, nullptr) ||
+      len == 0 || !decode_details(flags, details, len, &fields))
+    return;
+  details_terms(fields, &terms);
+  for (const std::string &term : terms) {
+    uint32_t id = global_symbols().intern(term);
+    if (id != SymbolTable::NO_SYMBOL)
+      out->push_back(id);
+  }
+}
+
+void AuditStore::index_terms(Segment *seg, uint32_t event_id, uint16_t flags,
+                             const char *details, size_t len) {
+  std::vector<uint32_t> terms;
+  record_terms(flags, details, len, &terms);
+  for (uint32_t term : terms)
+    seg->live_terms.add(term, event_id);
+}
+
+// Freeze a sealed segment's postings and save them next to it
+bool AuditStore::pack_terms(Segment *seg) const {
+  std::vector<uint8_t> packed;
+  seg->live_terms.encode(&packed);
+  seg->live_terms.clear();
+  if (!seg->packed_terms.assign(std::move(packed)))
+    return false;
+  // Symbols referenced by the index must be on disk before it is
+  global_symbols().sync();
+  return seg->packed_terms.save(index_path(seg->id).c_str());
+}
+
+void AuditStore::index_event(const AuditRecordBody &body, uint32_t segment,
+                             uint32_t offset) {
+  uint32_t id = (uint32_t)body.event_id;
+  for (uint32_t a = 0; a < AUDIT_ATTR_COUNT; a++)
+    if (body.attr[a] != SymbolTable::NO_SYMBOL)
+      m_attr_index[attr_key(a, body.attr[a])].add(id);
+  m_time_index[bucket_of(body.ts_ms)].add(id);
+  if (body.flags & AUDIT_FLAG_AGGREGATE)
+    m_aggregates.add(id);
+
+  if (m_locations.size() < body.event_id)
+    m_locations.resize(body.event_id, Location{UINT32_MAX, 0, 0});
+  m_locations[body.event_id - 1] = Location{segment, offset, body.ts_ms};
+
+  Segment *seg = m_segments[segment].get();
+  if (seg->record_count++ == 0) {
+    seg->first_event_id = body.event_id;
+    seg->min_ts_ms = seg->max_ts_ms = body.ts_ms;
+  }
+  seg->last_event_id = body.event_id;
+  if (body.ts_ms < seg->min_ts_ms)
+    seg->min_ts_ms = body.ts_ms;
+  if (body.ts_ms > seg->max_ts_ms)
+    seg->max_ts_ms = body.ts_ms;
+  if (body.event_id >= m_next_event_id)
+    m_next_event_id = body.event_id + 1;
+}
+
+// --- Recovery ---
+
+struct AuditStore::RecordIndex {
+  AuditRecordIndexHeader header;
+  std::vector<AuditRecordIndexEntry> entries;
+  RoaringBitmap aggregates;
+  std::vector<std::pair<uint64_t, RoaringBitmap>> attrs; // by attr_key()
+  std::vector<std::pair<int64_t, RoaringBitmap>> buckets;
+
+  void build(uint32_t segment_id, const SegmentScan &scan);
+  bool save(const std::string &path) const;
+  // False unless intact and in agreement with the segment's footer
+  bool load(const std::string &path, uint32_t segment_id,
+            const AuditSegmentFooter &footer);
+};
+
+struct AuditStore::SegmentScan {
+  bool ok;
+  bool sealed;           // footer (or .z) found and consistent
+  uint64_t good;         // end of the last intact record
+  uint32_t footer_count; // records the footer claims
+  AuditSegmentFooter footer;
+  std::vector<char> data; // records back to back
+  std::vector<std::pair<uint64_t, size_t>> records; // file offset, in data
+  std::unique_ptr<CompressedSegment> zfile;
+  std::unique_ptr<RecordIndex> index; // stands in for indexing `records`
+
+  SegmentScan() : ok(false), sealed(false), good(0), footer_count(0) {
+    memset(&footer, 0, sizeof(footer));
+  }
+};
+
+// Records that are structurally sound (marker, lengths, ID) from the start
+// of `data`; stops at the first that is not. Returns the bytes they span.
+static size_t walk_records(const char *data, size_t size, uint64_t offset,
+                           size_t at,
+                           std::vector<std::pair<uint64_t, size_t>> *out) {
+  size_t pos = 0;
+  while (size - pos >= sizeof(AuditRecordHeader) + sizeof(AuditRecordBody)) {
+    AuditRecordHeader rh;
+    AuditRecordBody body;
+    memcpy(&rh, data + pos, sizeof(rh));
+    memcpy(&body, data + pos + sizeof(rh), sizeof(body));
+    if (rh.marker != AUDIT_RECORD_MARKER ||
+        body.details_len > AUDIT_MAX_DETAILS ||
+        rh.length != sizeof(body) + body.details_len ||
+        rh.length > size - pos - sizeof(rh) || body.event_id == 0 ||
+        body.event_id > UINT32_MAX)
+      break;
+    out->emplace_back(offset + pos, at + pos);
+    pos += sizeof(rh) + rh.length;
+  }
+  return pos;
+}
+
+// Checksums of an unsealed segment's records and, without a term index,
+// their terms, in parallel chunks. Returns the first record that fails;
+// `terms` gets (term, event) pairs of the records before it, in order.
+static size_t check_records(
+    const std::vector<char> &data,
+    const std::vector<std::pair<uint64_t, size_t>> &records, bool verify,
+    bool want_terms, std::vector<std::pair<uint32_t, uint32_t>> *terms) {
+  size_t n = records.size();
+  size_t chunks = std::max<size_t>(
+      1, std::min<size_t>(std::thread::hardware_concurrency(),
+                          n / AUDIT_RECOVERY_CHUNK));
+  std::vector<size_t> first_bad(chunks, n);
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> chunk_terms(chunks);
+
+  auto run = [&](size_t c) {
+    std::vector<uint32_t> ids;
+    for (size_t i = n * c / chunks; i < n * (c + 1) / chunks; i++) {
+      AuditRecordHeader rh;
+      AuditRecordBody body;
+      const char *p = data.data() + records[i].second;
+      memcpy(&rh, p, sizeof(rh));
+      memcpy(&body, p + sizeof(rh), sizeof(body));
+      const char *details = p + sizeof(rh) + sizeof(body);
+      if (verify && audit_record_check(body, details) != rh.check) {
+        first_bad[c] = i;
+        return;
+      }
+      if (want_terms) {
+        record_terms(body.flags, details, body.details_len, &ids);
+        for (uint32_t term : ids)
+          chunk_terms[c].emplace_back(term, (uint32_t)body.event_id);
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t c = 1; c < chunks; c++)
+    workers.emplace_back(run, c);
+  run(0);
+  for (std::thread &w : workers)
+    w.join();
+
+  size_t bad = *std::min_element(first_bad.begin(), first_bad.end());
+  for (size_t c = 0; c < chunks && n * c / chunks < bad; c++)
+    terms->insert(terms->end(), chunk_terms[c].begin(), chunk_terms[c].end());
+  return bad;
+}
+
+// A sealed segment's footer without its records: from the .z header, or
+// the end of the .aud. False if it has no valid one.
+bool AuditStore::read_footer(Segment *seg, bool compressed,
+                             SegmentScan *out) const {
+  if (compressed) {
+    std::unique_ptr<CompressedSegment> z(new CompressedSegment());
+    if (!z->open(zsegment_path(seg->id).c_str()))
+      return false;
+    out->footer = z->footer();
+    out->zfile = std::move(z);
+    return true;
+  }
+
+  FILE *f = fopen(seg->path.c_str(), "rb");
+  if (!f)
+    return false;
+  AuditSegmentHeader header;
+  AuditSegmentFooter &footer = out->footer;
+  long size = -1;
+  if (fread(&header, 1, sizeof(header), f) == sizeof(header) &&
+      memcmp(header.magic, AUDIT_SEGMENT_MAGIC, 8) == 0 &&
+      header.version == AUDIT_SEGMENT_VERSION && fseek(f, 0, SEEK_END) == 0)
+    size = ftell(f);
+  bool ok = size >= (long)(sizeof(header) + sizeof(footer)) &&
+            fseek(f, size - (long)sizeof(footer), SEEK_SET) == 0 &&
+            fread(&footer, 1, sizeof(footer), f) == sizeof(footer);
+  fclose(f);
+  return ok && footer.marker == AUDIT_FOOTER_MARKER &&
+         footer.check == footer_check(footer) &&
+         footer.data_end == (uint64_t)size - sizeof(footer);
+}
+
+// Read all of a segment's records. Touches nothing but `out`, so it runs on
+// recovery workers and the finisher thread.
+bool AuditStore::read_segment(Segment *seg, bool compressed,
+                              SegmentScan *out) const {
+  out->sealed = false;
+  out->good = 0;
+  out->footer_count = 0;
+  out->data.clear();
+  out->records.clear();
+
+  if (compressed) {
+    if (!out->zfile) {
+      std::unique_ptr<CompressedSegment> z(new CompressedSegment());
+      if (!z->open(zsegment_path(seg->id).c_str()))
+        return false;
+      out->zfile = std::move(z);
+    }
+    CompressedSegment *z = out->zfile.get();
+    for (size_t i = 0; i < z->frame_count(); i++) {
+      const std::string *frame;
+      if (!z->load_frame(i, &frame) ||
+          walk_records(frame->data(), frame->size(), z->frame(i).raw_offset,
+                       out->data.size(), &out->records) != frame->size())
+        return false;
+      out->data.insert(out->data.end(), frame->begin(), frame->end());
+    }
+    out->sealed = true;
+    out->footer = z->footer();
+    out->good = z->footer().data_end;
+    out->footer_count = z->footer().record_count;
+    return true;
+  }
+
+  FILE *f = fopen(seg->path.c_str(), "rb");
+  if (!f)
+    return false;
+  fseek(f, 0, SEEK_END);
+  out->data.resize((size_t)ftell(f));
+  rewind(f);
+  bool read = fread(out->data.data(), 1, out->data.size(), f) ==
+              out->data.size();
+  fclose(f);
+
+  AuditSegmentHeader header;
+  if (!read || out->data.size() < sizeof(header))
+    return false;
+  memcpy(&header, out->data.data(), sizeof(header));
+  if (memcmp(header.magic, AUDIT_SEGMENT_MAGIC, 8) != 0 ||
+      header.version != AUDIT_SEGMENT_VERSION)
+    return false;
+
+  // A valid footer at the very end vouches for everything before it
+  size_t size = out->data.size(), limit = size;
+  AuditSegmentFooter footer;
+  if (size >= sizeof(header) + sizeof(footer)) {
+    memcpy(&footer, out->data.data() + size - sizeof(footer), sizeof(footer));
+    if (footer.marker == AUDIT_FOOTER_MARKER &&
+        footer.check == footer_check(footer) &&
+        footer.data_end == size - sizeof(footer)) {
+      out->sealed = true;
+      out->footer = footer;
+      out->footer_count = footer.record_count;
+      limit = (size_t)footer.data_end;
+    }
+  }
+  out->good = sizeof(header) + walk_records(out->data.data() + sizeof(header),
+                                            limit - sizeof(header),
+                                            sizeof(header), sizeof(header),
+                                            &out->records);
+  if (out->sealed &&
+      (out->good != limit || out->records.size() != out->footer_count))
+    out->sealed = false;
+  return true;
+}
+
+// Read one segment off the lock (recovery worker). Touches only `seg`'s
+// term index and flags. A sealed segment whose record index agrees with
+// its footer is not read at all unless it holds events the intrusion
+// checkpoint does not cover, which must be replayed.
+void AuditStore::scan_segment(Segment *seg, bool compressed,
+                              SegmentScan *out) {
+  if (read_footer(seg, compressed, out)) {
+    std::unique_ptr<RecordIndex> index(new RecordIndex());
+    if (index->load(record_index_path(seg->id), seg->id, out->footer))
+      out->index = std::move(index);
+  }
+
+  if (out->index && m_intrusion.covers(out->index->header.last_event_id,
+                                       out->index->header.latest_ts_ms)) {
+    out->sealed = true;
+    out->good = out->footer.data_end;
+    out->footer_count = out->footer.record_count;
+  } else if (!read_segment(seg, compressed, out)) {
+    return;
+  }
+  if (!out->sealed)
+    out->index.reset();
+  seg->record_index = out->index != nullptr;
+
+  // A saved term index spares re-tokenising a sealed segment's details;
+  // without one it is built later (see load_terms()). Indexes next to a
+  // segment without a valid footer are not trusted.
+  if (out->sealed) {
+    seg->terms_pending = !seg->packed_terms.load(index_path(seg->id).c_str());
+  } else {
+    remove(index_path(seg->id).c_str());
+    remove(record_index_path(seg->id).c_str());
+  }
+
+  std::vector<std::pair<uint32_t, uint32_t>> terms;
+  size_t bad = check_records(out->data, out->records, !out->sealed,
+                             !out->sealed, &terms);
+  if (bad < out->records.size()) {
+    out->good = out->records[bad].first;
+    out->records.resize(bad);
+  }
+  for (const auto &t : terms)
+    seg->live_terms.add(t.first, t.second);
+  out->ok = true;
+}
+
+// --- Record Index ---
+
+void AuditStore::RecordIndex::build(uint32_t segment_id,
+                                    const SegmentScan &scan) {
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, AUDIT_RECORD_INDEX_MAGIC, 8);
+  header.version = AUDIT_RECORD_INDEX_VERSION;
+  header.segment_id = segment_id;
+  header.record_count = scan.footer.record_count;
+  header.first_event_id = scan.footer.first_event_id;
+  header.last_event_id = scan.footer.last_event_id;
+  header.min_ts_ms = scan.footer.min_ts_ms;
+  header.max_ts_ms = scan.footer.max_ts_ms;
+  header.data_end = scan.footer.data_end;
+  header.latest_ts_ms = scan.footer.max_ts_ms;
+
+  std::unordered_map<uint64_t, RoaringBitmap> by_attr;
+  std::map<int64_t, RoaringBitmap> by_bucket;
+  entries.clear();
+  entries.reserve(scan.records.size());
+  aggregates.clear();
+  for (const auto &rec : scan.records) {
+    const char *p = scan.data.data() + rec.second + sizeof(AuditRecordHeader);
+    AuditRecordBody body;
+    memcpy(&body, p, sizeof(body));
+    uint32_t id = (uint32_t)body.event_id;
+    entries.push_back(
+        AuditRecordIndexEntry{id, (uint32_t)rec.first, body.ts_ms});
+    for (uint32_t a = 0; a < AUDIT_ATTR_COUNT; a++)
+      if (body.attr[a] != SymbolTable::NO_SYMBOL)
+        by_attr[attr_key(a, body.attr[a])].add(id);
+    by_bucket[bucket_of(body.ts_ms)].add(id);
+    if (!(body.flags & AUDIT_FLAG_AGGREGATE))
+      continue;
+    aggregates.add(id);
+    AuditAggregate agg;
+    if (body.details_len >= sizeof(agg)) {
+      memcpy(&agg, p + sizeof(body), sizeof(agg));
+      header.latest_ts_ms = std::max(header.latest_ts_ms, agg.last_ts_ms);
+    }
+  }
+
+  attrs.assign(std::make_move_iterator(by_attr.begin()),
+               std::make_move_iterator(by_attr.end()));
+  std::sort(attrs.begin(), attrs.end(),
+            [](const std::pair<uint64_t, RoaringBitmap> &a,
+               const std::pair<uint64_t, RoaringBitmap> &b) {
+              return a.first < b.first;
+            });
+  buckets.assign(std::make_move_iterator(by_bucket.begin()),
+                 std::make_move_iterator(by_bucket.end()));
+  header.attr_count = (uint32_t)attrs.size();
+  header.bucket_count = (uint32_t)buckets.size();
+}
+
+bool AuditStore::RecordIndex::save(const std::string &path) const {
+  std::vector<uint8_t> body;
+  const uint8_t *p = (const uint8_t *)entries.data();
+  body.insert(body.end(), p, p + entries.size() * sizeof(entries[0]));
+  aggregates.encode(&body);
+  for (const auto &entry : attrs) {
+    p = (const uint8_t *)&entry.first;
+    body.insert(body.end(), p, p + sizeof(entry.first));
+    entry.second.encode(&body);
+  }
+  for (const auto &entry : buckets) {
+    p = (const uint8_t *)&entry.first;
+    body.insert(body.end(), p, p + sizeof(entry.first));
+    entry.second.encode(&body);
+  }
+
+  AuditRecordIndexHeader h = header;
+  h.body_bytes = body.size();
+  h.check = fnv1a64(body.data(), body.size());
+
+  std::string tmp = path + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (!f)
+    return false;
+  bool ok = fwrite(&h, 1, sizeof(h), f) == sizeof(h) &&
+            fwrite(body.data(), 1, body.size(), f) == body.size();
+  ok = fclose(f) == 0 && ok;
+  if (!ok || !replace_file(tmp.c_str(), path.c_str())) {
+    remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool AuditStore::RecordIndex::load(const std::string &path,
+                                   uint32_t segment_id,
+                                   const AuditSegmentFooter &footer) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  std::vector<uint8_t> body;
+  bool ok = fread(&header, 1, sizeof(header), f) == sizeof(header) &&
+            memcmp(header.magic, AUDIT_RECORD_INDEX_MAGIC, 8) == 0 &&
+            header.version == AUDIT_RECORD_INDEX_VERSION &&
+            header.segment_id == segment_id &&
+            header.record_count == footer.record_count &&
+            header.first_event_id == footer.first_event_id &&
+            header.last_event_id == footer.last_event_id &&
+            header.min_ts_ms == footer.min_ts_ms &&
+            header.max_ts_ms == footer.max_ts_ms &&
+            header.data_end == footer.data_end &&
+            header.last_event_id <= UINT32_MAX &&
+            header.body_bytes / sizeof(AuditRecordIndexEntry) >=
+                header.record_count &&
+            header.body_bytes <= AUDIT_SEGMENT_MAX_BYTES * 4;
+  if (ok) {
+    body.resize((size_t)header.body_bytes);
+    ok = fread(body.data(), 1, body.size(), f) == body.size() &&
+         fgetc(f) == EOF && fnv1a64(body.data(), body.size()) == header.check;
+  }
+  fclose(f);
+  if (!ok)
+    return false;
+
+  // Everything must stay within the footer's IDs and data
+  uint32_t first = (uint32_t)header.first_event_id;
+  uint32_t last = (uint32_t)header.last_event_id;
+  auto in_range = [first, last](const RoaringBitmap &b) {
+    return b.empty() || (b.minimum() >= first && b.maximum() <= last);
+  };
+  entries.resize(header.record_count);
+  memcpy(entries.data(), body.data(), entries.size() * sizeof(entries[0]));
+  for (size_t i = 0; i < entries.size(); i++) {
+    const AuditRecordIndexEntry &e = entries[i];
+    if (e.event_id < first || e.event_id > last ||
+        e.offset < sizeof(AuditSegmentHeader) || e.offset >= header.data_end ||
+        (i > 0 && (e.event_id <= entries[i - 1].event_id ||
+                   e.offset <= entries[i - 1].offset)))
+      return false;
+  }
+
+  const uint8_t *p = body.data() + entries.size() * sizeof(entries[0]);
+  const uint8_t *end = body.data() + body.size();
+  p = aggregates.decode(p, end);
+  if (!p || !in_range(aggregates))
+    return false;
+  attrs.resize(header.attr_count);
+  for (auto &entry : attrs) {
+    if (end - p < 8)
+      return false;
+    memcpy(&entry.first, p, 8);
+    p = entry.second.decode(p + 8, end);
+    if (!p || !in_range(entry.second))
+      return false;
+  }
+  buckets.resize(header.bucket_count);
+  for (auto &entry : buckets) {
+    if (end - p < 8)
+      return false;
+    memcpy(&entry.first, p, 8);
+    p = entry.second.decode(p + 8, end);
+    if (!p || !in_range(entry.second))
+      return false;
+  }
+  return p == end;
+}
+
+static void merge_bitmap(RoaringBitmap *into, RoaringBitmap *from) {
+  if (into->empty())
+    std::swap(*into, *from);
+  else
+    into->unite_with(*from);
+}
+
+// Merge a segment's record index into the store's indexes, as indexing
+// each of its records would
+void AuditStore::apply_record_index(uint32_t segment, RecordIndex *index) {
+  const AuditRecordIndexHeader &h = index->header;
+  if (m_locations.size() < h.last_event_id)
+    m_locations.resize(h.last_event_id, Location{UINT32_MAX, 0, 0});
+  for (const AuditRecordIndexEntry &e : index->entries)
+    m_locations[e.event_id - 1] = Location{segment, e.offset, e.ts_ms};
+  for (auto &entry : index->attrs)
+    merge_bitmap(&m_attr_index[entry.first], &entry.second);
+  for (auto &entry : index->buckets)
+    merge_bitmap(&m_time_index[entry.first], &entry.second);
+  merge_bitmap(&m_aggregates, &index->aggregates);
+
+  Segment *seg = m_segments[segment].get();
+  seg->record_count = h.record_count;
+  seg->first_event_id = h.first_event_id;
+  seg->last_event_id = h.last_event_id;
+  seg->min_ts_ms = h.min_ts_ms;
+  seg->max_ts_ms = h.max_ts_ms;
+  if (h.record_count > 0 && h.last_event_id >= m_next_event_id)
+    m_next_event_id = h.last_event_id + 1;
+}
+
+// Index a scanned segment and settle its files: cut a torn tail, seal an
+// earlier segment that never was, keep the last one open for appends.
+// Events newer than the intrusion checkpoint are replayed into it.
+bool AuditStore::recover_segment(uint32_t index, bool last,
+                                 SegmentScan *scan) {
+  Segment *seg = m_segments[index].get();
+  if (!scan->ok)
+    return false;
+  if (scan->index)
+    apply_record_index(index, scan->index.get());
+
+  int64_t recent = now_ms() - INTRUSION_WINDOW_MS;
+  std::vector<int64_t> times;
+  for (const auto &rec : scan->records) {
+    const char *p = scan->data.data() + rec.second + sizeof(AuditRecordHeader);
+    AuditRecordBody body;
+    memcpy(&body, p, sizeof(body));
+    const char *details = p + sizeof(body);
+    if (!scan->index)
+      index_event(body, index, (uint32_t)rec.first);
+
+    uint32_t user = body.attr[AUDIT_ATTR_USER];
+    uint32_t status = body.attr[AUDIT_ATTR_STATUS];
+    if (!(body.flags & AUDIT_FLAG_AGGREGATE)) {
+      if (m_intrusion.covers(body.event_id, body.ts_ms))
+        continue;
+      if (body.ts_ms >= recent)
+        m_intrusion.note(user, status, body.ts_ms);
+      learn(body.attr, body.ts_ms, body.flags, details, body.details_len);
+      continue;
+    }
+    AuditAggregate agg;
+    size_t len = body.details_len;
+    uint32_t count;
+    if (len < sizeof(agg))
+      continue;
+    memcpy(&agg, details, sizeof(agg));
+    if (!m_intrusion.covers(body.event_id, agg.last_ts_ms) &&
+        split_aggregate(body.flags, body.ts_ms, &details, &len, &count,
+                        &times))
+      for (int64_t ts : times) {
+        if (m_intrusion.covers(body.event_id, ts))
+          continue;
+        if (ts >= recent)
+          m_intrusion.note(user, status, ts);
+        learn(body.attr, ts, body.flags, details, len);
+      }
+  }
+
+  if (scan->zfile) {
+    if (seg->record_count != scan->footer_count)
+      return false;
+    seg->sealed = true;
+    seg->data_end = scan->good;
+    m_raw_bytes += seg->data_end;
+    m_compressed_bytes += scan->zfile->file_bytes();
+    seg->zfile = std::move(scan->zfile);
+    // Left behind if we stopped between writing the .z and removing it
+    remove(seg->path.c_str());
+    return true;
+  }
+
+  seg->sealed = scan->sealed;
+  seg->data_end = scan->good;
+
+  FILE *f = nullptr;
+  if (!seg->sealed) {
+    f = fopen(seg->path.c_str(), "r+b");
+    if (!f)
+      return false;
+    if (fseek(f, 0, SEEK_END) == 0 && ftell(f) != (long)seg->data_end) {
+      fflush(f);
+      truncate_file(f, (long)seg->data_end);
+    }
+    fseek(f, (long)seg->data_end, SEEK_SET);
+    if (!last && (!seal_segment(seg, f) || !pack_terms(seg))) {
+      fclose(f);
+      return false;
+    }
+  }
+  if (last && !seg->sealed)
+    m_writer = f;
+  else if (f)
+    fclose(f);
+
+  seg->reader = fopen(seg->path.c_str(), "rb");
+  return seg->reader != nullptr;
+}
+
+bool AuditStore::seal_segment(Segment *seg, FILE *f) {
+  AuditSegmentFooter footer;
+  memset(&footer, 0, sizeof(footer));
+  footer.marker = AUDIT_FOOTER_MARKER;
+  footer.record_count = seg->record_count;
+  footer.first_event_id = seg->first_event_id;
+  footer.last_event_id = seg->last_event_id;
+  footer.min_ts_ms = seg->min_ts_ms;
+  footer.max_ts_ms = seg->max_ts_ms;
+  footer.data_end = seg->data_end;
+  footer.check = footer_check(footer);
+
+  if (fseek(f, (long)seg->data_end, SEEK_SET) != 0 ||
+      fwrite(&footer, 1, sizeof(footer), f) != sizeof(footer) ||
+      fflush(f) != 0)
+    return false;
+#ifndef _WIN32
+  fsync(fileno(f));
+#endif
+  seg->sealed = true;
+  return true;
+}
+
+bool AuditStore::start_segment(int64_t now) {
+  uint32_t id = m_segments.empty() ? 1 : m_segments.back()->id + 1;
+  std::unique_ptr<Segment> seg(new Segment());
+  seg->id = id;
+  seg->path = segment_path(id);
+  seg->sealed = false;
+  seg->data_end = sizeof(AuditSegmentHeader);
+  seg->record_count = 0;
+  seg->first_event_id = seg->last_event_id = 0;
+  seg->min_ts_ms = seg->max_ts_ms = 0;
+  seg->terms_pending = false;
+  seg->record_index = false;
+
+  FILE *f = fopen(seg->path.c_str(), "w+b");
+  if (!f)
+    return false;
+
+  AuditSegmentHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, AUDIT_SEGMENT_MAGIC, 8);
+  header.version = AUDIT_SEGMENT_VERSION;
+  header.segment_id = id;
+  header.first_event_id = m_next_event_id;
+  header.created_ms = now;
+  if (fwrite(&header, 1, sizeof(header), f) != sizeof(header) ||
+      fflush(f) != 0) {
+    fclose(f);
+    remove(seg->path.c_str());
+    return false;
+  }
+
+  seg->reader = fopen(seg->path.c_str(), "rb");
+  if (!seg->reader) {
+    fclose(f);
+    return false;
+  }
+
+  Segment *sealed = nullptr;
+  if (m_writer) {
+    if (seal_segment(m_segments.back().get(), m_writer) &&
+        pack_terms(m_segments.back().get()))
+      sealed = m_segments.back().get();
+    fclose(m_writer);
+  }
+  m_writer = f;
+  m_segments.push_back(std::move(seg));
+  if (sealed)
+    queue_finish(sealed);
+  return true;
+}
+
+// --- Background Finishing ---
+
+void AuditStore::queue_finish(Segment *seg) {
+  std::lock_guard<std::mutex> lock(m_finish_lock);
+  if (!m_finisher.joinable()) {
+    m_finish_stop = false;
+    m_finisher = std::thread(&AuditStore::finish_loop, this);
+  }
+  m_finish_queue.push_back(seg);
+  m_finish_ready.notify_one();
+}
+
+void AuditStore::finish_loop() {
+  std::unique_lock<std::mutex> lock(m_finish_lock);
+  for (;;) {
+    m_finish_ready.wait(lock, [this] {
+      return m_finish_stop || !m_finish_queue.empty();
+    });
+    if (m_finish_stop)
+      break;
+    Segment *seg = m_finish_queue.front();
+    m_finish_queue.pop_front();
+    m_finish_busy = true;
+    lock.unlock();
+    finish_segment(seg);
+    lock.lock();
+    m_finish_busy = false;
+    if (m_finish_queue.empty())
+      m_finish_idle.notify_all();
+  }
+  m_finish_idle.notify_all();
+}
+
+// Segments still queued stay as they are; the next open() queues them again
+void AuditStore::stop_finisher() {
+  {
+    std::lock_guard<std::mutex> lock(m_finish_lock);
+    m_finish_stop = true;
+    m_finish_queue.clear();
+    m_finish_ready.notify_all();
+  }
+  if (m_finisher.joinable())
+    m_finisher.join();
+}
+
+void AuditStore::wait_finished() {
+  std::unique_lock<std::mutex> lock(m_finish_lock);
+  m_finish_idle.wait(lock, [this] {
+    return m_finish_stop || (m_finish_queue.empty() && !m_finish_busy);
+  });
+}
+
+// Everything a sealed segment still lacks (finisher thread): its record
+// index, its term index, its compressed form
+void AuditStore::finish_segment(Segment *seg) {
+  if (!seg->record_index) {
+    SegmentScan scan;
+    RecordIndex index;
+    if (read_segment(seg, seg->zfile != nullptr, &scan) && scan.sealed) {
+      index.build(seg->id, scan);
+      seg->record_index = index.save(record_index_path(seg->id));
+    }
+  }
+  if (seg->terms_pending)
+    load_terms(seg);
+  compress_segment(seg);
+}
+
+// Build a sealed segment's missing term index from its records, on the
+// finisher thread or in the first search that gets there before it
+void AuditStore::load_terms(Segment *seg) const {
+  std::lock_guard<std::mutex> read_guard(seg->read_lock);
+  if (!seg->terms_pending)
+    return;
+  SegmentScan scan;
+  std::vector<std::pair<uint32_t, uint32_t>> terms;
+  if (read_segment(seg, seg->zfile != nullptr, &scan))
+    check_records(scan.data, scan.records, false, true, &terms);
+  for (const auto &t : terms)
+    seg->live_terms.add(t.first, t.second);
+  pack_terms(seg);
+  seg->terms_pending = false;
+}
+
+// Swap a sealed .aud for its compressed form (finisher thread). Only the
+// swap itself holds the segment's read lock; failure just leaves the .aud.
+void AuditStore::compress_segment(Segment *seg) {
+  if (seg->zfile || !audit_compression_available())
+    return;
+
+  AuditSegmentFooter footer;
+  memset(&footer, 0, sizeof(footer));
+  footer.marker = AUDIT_FOOTER_MARKER;
+  footer.record_count = seg->record_count;
+  footer.first_event_id = seg->first_event_id;
+  footer.last_event_id = seg->last_event_id;
+  footer.min_ts_ms = seg->min_ts_ms;
+  footer.max_ts_ms = seg->max_ts_ms;
+  footer.data_end = seg->data_end;
+  footer.check = footer_check(footer);
+
+  std::string zpath = zsegment_path(seg->id);
+  std::unique_ptr<CompressedSegment> z(new CompressedSegment());
+  if (!audit_compress_segment(seg->path.c_str(), zpath.c_str(), seg->id,
+                              footer, nullptr) ||
+      !z->open(zpath.c_str())) {
+    remove(zpath.c_str());
+    return;
+  }
+
+  std::lock_guard<std::mutex> read_guard(seg->read_lock);
+  m_raw_bytes += seg->data_end;
+  m_compressed_bytes += z->file_bytes();
+  if (seg->reader)
+    fclose(seg->reader);
+  seg->reader = nullptr;
+  seg->zfile = std::move(z);
+  remove(seg->path.c_str());
+}
+
+bool AuditStore::rotate() {
+  std::unique_lock<std::shared_mutex> guard(m_lock);
+  return m_writer && flush_bursts() && m_chain.commit() &&
+         start_segment(now_ms());
+}
+
+void AuditStore::storage_bytes(uint64_t *raw, uint64_t *stored) const {
+  std::shared_lock<std::shared_mutex> guard(m_lock);
+  *raw = m_raw_bytes;
+  *stored = m_compressed_bytes;
+}
+
+bool AuditStore::open(const char *dir, const char *sequence_rules) {
+  close();
+  std::unique_lock<std::shared_mutex> guard(m_lock);
+
+  m_dir = dir;
+  if (!make_dir(dir))
+    return false;
+  if (!global_symbols().open((m_dir + "/symbols.dat").c_str()))
+    return false;
+  // Missing or damaged: rebuilt from the log alone
+  m_intrusion.load((m_dir + "/intrusion.ckpt").c_str());
+  // Not before the symbol log is open: the rules intern their event types
+  // and statuses, and IDs interned earlier would never be saved
+  if (sequence_rules) {
+    std::string error;
+    m_intrusion.set_sequences(sequence_rules, &error);
+  }
+  m_login_symbol = global_symbols().intern("LOGIN");
+  m_totp_symbol = global_symbols().intern("TOTP");
+  m_success_symbol = global_symbols().intern("SUCCESS");
+  m_enforcement_symbol = global_symbols().intern("ENFORCEMENT");
+
+  // Segments are numbered from 1 without gaps
+  std::vector<bool> compressed;
+  for (uint32_t id = 1;; id++) {
+    std::string path = segment_path(id);
+    FILE *probe = fopen(zsegment_path(id).c_str(), "rb");
+    compressed.push_back(probe != nullptr);
+    if (!probe)
+      probe = fopen(path.c_str(), "rb");
+    if (!probe)
+      break;
+    fclose(probe);
+
+    std::unique_ptr<Segment> seg(new Segment());
+    seg->id = id;
+    seg->path = path;
+    seg->reader = nullptr;
+    seg->sealed = false;
+    seg->data_end = 0;
+    seg->record_count = 0;
+    seg->first_event_id = seg->last_event_id = 0;
+    seg->min_ts_ms = seg->max_ts_ms = 0;
+    seg->terms_pending = false;
+    seg->record_index = false;
+    m_segments.push_back(std::move(seg));
+  }
+
+  // Workers read segments ahead; this thread indexes them in order. They
+  // stay at most `threads` segments ahead, which bounds the memory held.
+  size_t count = m_segments.size();
+  std::vector<std::unique_ptr<SegmentScan>> scans(count);
+  std::mutex scan_lock;
+  std::condition_variable scan_ready;
+  size_t next = 0, merged = 0;
+  unsigned threads = (unsigned)std::min<size_t>(
+      std::max(1u, std::thread::hardware_concurrency()), count);
+  auto work = [&] {
+    std::unique_lock<std::mutex> lock(scan_lock);
+    for (;;) {
+      scan_ready.wait(
+          lock, [&] { return next >= count || next <= merged + threads; });
+      if (next >= count)
+        return;
+      size_t i = next++;
+      lock.unlock();
+      std::unique_ptr<SegmentScan> scan(new SegmentScan());
+      scan_segment(m_segments[i].get(), compressed[i], scan.get());
+      lock.lock();
+      scans[i] = std::move(scan);
+      scan_ready.notify_all();
+    }
+  };
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++)
+    workers.emplace_back(work);
+
+  bool recovered = true;
+  for (size_t i = 0; i < count && recovered; i++) {
+    std::unique_ptr<SegmentScan> scan;
+    {
+      std::unique_lock<std::mutex> lock(scan_lock);
+      scan_ready.wait(lock, [&] { return scans[i] != nullptr; });
+      scan = std::move(scans[i]);
+      merged = i + 1;
+    }
+    scan_ready.notify_all();
+    recovered = recover_segment((uint32_t)i, i + 1 == count, scan.get());
+  }
+  {
+    std::lock_guard<std::mutex> lock(scan_lock);
+    next = count; // stop early on failure
+  }
+  scan_ready.notify_all();
+  for (std::thread &w : workers)
+    w.join();
+  if (!recovered)
+    return false;
+  // Once recovery no longer needs the CPU
+  for (auto &seg : m_segments)
+    if (seg->sealed &&
+        (!seg->record_index || seg->terms_pending || !seg->zfile))
+      queue_finish(seg.get());
+
+  // Commit records written after the last commit (crash, or a log from
+  // before the chain existed)
+  if (!m_chain.open((m_dir + "/chain.log").c_str()))
+    return false;
+  // IDs of committed records that are gone (cut off as damaged) stay used
+  if (m_chain.next_event_id() > m_next_event_id) {
+    m_next_event_id = m_chain.next_event_id();
+    m_locations.resize(m_next_event_id - 1, Location{UINT32_MAX, 0, 0});
+  }
+  AuditRecordBody body;
+  std::string payload;
+  for (uint64_t id = m_chain.next_event_id(); id < m_next_event_id; id++)
+    if (m_locations[id - 1].segment != UINT32_MAX &&
+        read_raw(id, &body, &payload))
+      m_chain.add(m_locations[id - 1].segment, id, &body, sizeof(body),
+                  payload.data(), payload.size());
+  if (!m_chain.commit())
+    return false;
+
+  if (!m_writer && !start_segment(now_ms()))
+    return false;
+  m_intrusion.set_written(m_next_event_id - 1); // replayed above
+  m_intrusion.start_checkpoints((m_dir + "/intrusion.ckpt").c_str());
+  return true;
+}
+
+void AuditStore::close() {
+  stop_finisher(); // finishes the segment it is on
+  {
+    std::unique_lock<std::shared_mutex> guard(m_lock);
+    if (m_writer)
+      flush_bursts();
+  }
+  // After the bursts, so the last checkpoint covers their records
+  m_intrusion.stop_checkpoints(); // writes a last checkpoint
+  std::unique_lock<std::shared_mutex> guard(m_lock);
+  if (m_writer) {
+    fflush(m_writer);
+    fclose(m_writer);
+    m_writer = nullptr;
+  }
+  m_chain.commit();
+  m_chain.close();
+  for (auto &seg : m_segments)
+    if (seg->reader)
+      fclose(seg->reader);
+  m_segments.clear();
+  m_locations.clear();
+  m_attr_index.clear();
+  m_time_index.clear();
+  m_aggregates.clear();
+  m_bursts.clear();
+  m_last_sweep_ms = 0;
+  m_next_event_id = 1;
+  m_raw_bytes = m_compressed_bytes = 0;
+  m_intrusion.clear();
+}
+
+// Caller holds m_lock exclusively
+uint64_t AuditStore::write_record(int64_t ts_ms,
+                                  const uint32_t attr[AUDIT_ATTR_COUNT],
+                                  uint16_t flags, const char *details,
+                                  size_t details_len) {
+  if (!m_writer || m_next_event_id > UINT32_MAX)
+    return 0;
+
+  size_t record_size =
+      sizeof(AuditRecordHeader) + sizeof(AuditRecordBody) + details_len;
+  if (m_segments.back()->data_end + record_size +
+              sizeof(AuditSegmentFooter) >
+          AUDIT_SEGMENT_MAX_BYTES &&
+      m_segments.back()->record_count > 0 && !start_segment(now_ms()))
+    return 0;
+
+  AuditRecordBody body;
+  memset(&body, 0, sizeof(body));
+  body.event_id = m_next_event_id;
+  body.ts_ms = ts_ms;
+  memcpy(body.attr, attr, sizeof(body.attr));
+  body.flags = flags;
+  body.details_len = (uint16_t)details_len;
+
+  AuditRecordHeader rh;
+  rh.marker = AUDIT_RECORD_MARKER;
+  rh.length = (uint32_t)(sizeof(body) + details_len);
+  rh.check = audit_record_check(body, details);
+  rh.reserved = 0;
+
+  Segment *seg = m_segments.back().get();
+  if (fwrite(&rh, 1, sizeof(rh), m_writer) != sizeof(rh) ||
+      fwrite(&body, 1, sizeof(body), m_writer) != sizeof(body) ||
+      fwrite(details, 1, details_len, m_writer) != details_len ||
+      fflush(m_writer) != 0) {
+    // Drop the partial record so the next append starts on a boundary
+    fseek(m_writer, (long)seg->data_end, SEEK_SET);
+    truncate_file(m_writer, (long)seg->data_end);
+    return 0;
+  }
+
+  uint32_t segment = (uint32_t)(m_segments.size() - 1);
+  index_event(body, segment, (uint32_t)seg->data_end);
+  index_terms(seg, (uint32_t)body.event_id, flags, details, details_len);
+  seg->data_end += record_size;
+  m_chain.add(segment, body.event_id, &body, sizeof(body), details,
+              details_len);
+  m_intrusion.set_written(body.event_id);
+  return body.event_id;
+}
+
+// --- Burst Aggregation ---
+
+// Fold an exact repeat into its open burst and return the burst's first
+// event ID, or 0 if the event has to be written
+uint64_t AuditStore::absorb_repeat(int64_t ts_ms,
+                                   const uint32_t attr[AUDIT_ATTR_COUNT],
+                                   uint16_t flags, const char *details,
+                                   size_t len) {
+  auto it = m_bursts.find(burst_key(attr, flags, details, len));
+  if (it == m_bursts.end())
+    return 0;
+
+  Burst &burst = it->second;
+  int64_t last =
+      burst.times_ms.empty() ? burst.leader_ts_ms : burst.times_ms.back();
+  size_t delta_len = burst.times_ms.empty() ? 0 : varint_size(ts_ms - last);
+  bool same = memcmp(burst.attr, attr, sizeof(burst.attr)) == 0 &&
+              burst.flags == flags && burst.details.size() == len &&
+              (len == 0 || memcmp(burst.details.data(), details, len) == 0);
+  if (same && ts_ms >= last && ts_ms - last <= AUDIT_BURST_GAP_MS &&
+      ts_ms - burst.leader_ts_ms <= AUDIT_BURST_SPAN_MS &&
+      sizeof(AuditAggregate) + burst.deltas_len + delta_len + len <=
+          AUDIT_MAX_DETAILS) {
+    burst.times_ms.push_back(ts_ms);
+    burst.deltas_len += delta_len;
+    return burst.leader_id;
+  }
+
+  // Burst over (or a key collision): write it out, this event starts anew
+  flush_burst(burst);
+  m_bursts.erase(it);
+  return 0;
+}
+
+void AuditStore::start_burst(uint64_t event_id, int64_t ts_ms,
+                             const uint32_t attr[AUDIT_ATTR_COUNT],
+                             uint16_t flags, const char *details, size_t len) {
+  Burst &burst = m_bursts[burst_key(attr, flags, details, len)];
+  memcpy(burst.attr, attr, sizeof(burst.attr));
+  burst.flags = flags;
+  burst.details.assign(details, len);
+  burst.leader_id = event_id;
+  burst.leader_ts_ms = ts_ms;
+  burst.times_ms.clear();
+  burst.deltas_len = 0;
+}
+
+// One AUDIT_FLAG_AGGREGATE record for the burst's repeats, if any
+bool AuditStore::flush_burst(const Burst &burst) {
+  if (burst.times_ms.empty())
+    return true;
+
+  AuditAggregate agg;
+  memset(&agg, 0, sizeof(agg));
+  agg.count = (uint32_t)burst.times_ms.size();
+  agg.deltas_len = (uint16_t)burst.deltas_len;
+  agg.last_ts_ms = burst.times_ms.back();
+  std::string payload((const char *)&agg, sizeof(agg));
+  for (size_t i = 1; i < burst.times_ms.size(); i++)
+    put_varint(&payload, burst.times_ms[i] - burst.times_ms[i - 1]);
+  payload += burst.details;
+  return write_record(burst.times_ms[0], burst.attr,
+                      burst.flags | AUDIT_FLAG_AGGREGATE, payload.data(),
+                      payload.size()) != 0;
+}
+
+// Write out bursts that went quiet, or all of them once too many are open
+void AuditStore::sweep_bursts(int64_t now) {
+  bool full = m_bursts.size() >= AUDIT_MAX_BURSTS;
+  if (!full && now - m_last_sweep_ms < AUDIT_BURST_GAP_MS)
+    return;
+  m_last_sweep_ms = now;
+  for (auto it = m_bursts.begin(); it != m_bursts.end();) {
+    const Burst &burst = it->second;
+    int64_t last =
+        burst.times_ms.empty() ? burst.leader_ts_ms : burst.times_ms.back();
+    if (full || now - last > AUDIT_BURST_GAP_MS) {
+      flush_burst(burst);
+      it = m_bursts.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+bool AuditStore::flush_bursts() {
+  bool ok = true;
+  for (const auto &entry : m_bursts)
+    ok &= flush_burst(entry.second);
+  m_bursts.clear();
+  return ok;
+}
+
+void AuditStore::set_aggregation(bool enabled) {
+  std::unique_lock<std::shared_mutex> guard(m_lock);
+  if (!enabled)
+    flush_bursts();
+  m_aggregate_bursts = enabled;
+}
+
+uint64_t AuditStore::append(int64_t ts_ms,
+                            const uint32_t attr[AUDIT_ATTR_COUNT],
+                            uint16_t flags, const char *details,
+                            size_t details_len) {
+  if (details_len > AUDIT_MAX_DETAILS)
+    details_len = 0; // a cut payload would not decode
+
+  std::unique_lock<std::shared_mutex> guard(m_lock);
+  if (!m_aggregate_bursts || (flags & AUDIT_FLAG_AGGREGATE))
+    return write_record(ts_ms, attr, flags, details, details_len);
+
+  sweep_bursts(ts_ms);
+  uint64_t id = absorb_repeat(ts_ms, attr, flags, details, details_len);
+  if (id)
+    return id;
+  id = write_record(ts_ms, attr, flags, details, details_len);
+  if (id)
+    start_burst(id, ts_ms, attr, flags, details, details_len);
+  return id;
+}
+
+static uint32_t intern_or_none(const char *s) {
+  return s && *s ? global_symbols().intern(s) : SymbolTable::NO_SYMBOL;
+}
+
+void audit_prepare_event(const char *username, const char *event_type,
+                         const char *status, const char *ip_address,
+                         const char *risk_level, const char *details_json,
+                         uint32_t attr[AUDIT_ATTR_COUNT], uint16_t *flags,
+                         std::string *details) {
+  attr[AUDIT_ATTR_USER] = intern_or_none(username);
+  attr[AUDIT_ATTR_EVENT_TYPE] = intern_or_none(event_type);
+  attr[AUDIT_ATTR_STATUS] = intern_or_none(status);
+  attr[AUDIT_ATTR_RISK] = intern_or_none(risk_level);
+  attr[AUDIT_ATTR_IP] = intern_or_none(ip_address);
+
+  std::vector<DetailsField> fields;
+  details->assign(details_json ? details_json : "");
+  *flags = 0;
+  if (!details->empty() &&
+      details_parse_json(details->data(), details->size(), &fields) &&
+      details_encode(fields, details))
+    *flags = AUDIT_FLAG_BINARY_DETAILS;
+}
+
+uint64_t AuditStore::append_text(int64_t ts_ms, const char *username,
+                                 const char *event_type, const char *status,
+                                 const char *ip_address,
+                                 const char *risk_level,
+                                 const char *details_json) {
+  uint32_t attr[AUDIT_ATTR_COUNT];
+  uint16_t flags;
+  std::string details;
+  audit_prepare_event(username, event_type, status, ip_address, risk_level,
+                      details_json, attr, &flags, &details);
+  return append(ts_ms, attr, flags, details.data(), details.size());
+}
+
+void AuditStore::query(const AuditQuery &q, RoaringBitmap *out) const {
+  std::shared_lock<std::shared_mutex> guard(m_lock);
+  query_locked(q, out);
+}
+
+void AuditStore::query_locked(const AuditQuery &q, RoaringBitmap *out) const {
+  out->clear();
+
+  // Attribute predicates, smallest bitmap first
+  std::vector<const RoaringBitmap *> terms;
+  for (uint32_t a = 0; a < AUDIT_ATTR_COUNT; a++) {
+    if (q.attr[a] == SymbolTable::NO_SYMBOL)
+      continue;
+    auto it = m_attr_index.find(attr_key(a, q.attr[a]));
+    if (it == m_attr_index.end())
+      return;
+    terms.push_back(&it->second);
+  }
+
+  // Time predicate: union of the covered hour buckets
+  int64_t from = q.from_ms;
+  int64_t to = q.to_ms ? q.to_ms : INT64_MAX;
+  RoaringBitmap window;
+  bool has_window = q.from_ms != 0 || q.to_ms != 0;
+  if (has_window) {
+    auto it = q.from_ms ? m_time_index.lower_bound(bucket_of(from))
+                        : m_time_index.begin();
+    auto end = q.to_ms ? m_time_index.upper_bound(bucket_of(to))
+                       : m_time_index.end();
+    RoaringBitmap merged;
+    for (; it != end; ++it) {
+      RoaringBitmap::unite(window, it->second, &merged);
+      std::swap(window, merged);
+    }
+    terms.push_back(&window);
+  }
+
+  if (terms.empty()) {
+    for (uint64_t id = 1; id < m_next_event_id; id++)
+      out->add((uint32_t)id);
+    return;
+  }
+
+  std::sort(terms.begin(), terms.end(),
+            [](const RoaringBitmap *a, const RoaringBitmap *b) {
+              return a->cardinality() < b->cardinality();
+            });
+  *out = *terms[0];
+  RoaringBitmap next;
+  for (size_t i = 1; i < terms.size() && !out->empty(); i++) {
+    RoaringBitmap::intersect(*out, *terms[i], &next);
+    std::swap(*out, next);
+  }
+
+  // Edge buckets may hold events just outside the range
+  if (has_window) {
+    RoaringBitmap exact;
+    out->for_each([&](uint32_t id) {
+      int64_t ts = m_locations[id - 1].ts_ms;
+      if (ts >= from && ts <= to)
+        exact.add(id);
+    });
+    std::swap(*out, exact);
+  }
+}
+
+uint64_t AuditStore::count_events(const AuditQuery &q) const {
+  std::shared_lock<std::shared_mutex> guard(m_lock);
+  int64_t from = q.from_ms ? q.from_ms : INT64_MIN;
+  int64_t to = q.to_ms ? q.to_ms : INT64_MAX;
+
+  // An aggregate's repeats trail its timestamp by up to a burst span
+  AuditQuery wide = q;
+  if (wide.from_ms)
+    wide.from_ms -= AUDIT_BURST_SPAN_MS;
+  RoaringBitmap ids;
+  query_locked(wide, &ids);
+
+  uint64_t n = 0;
+  AuditEvent ev;
+  ids.for_each([&](uint32_t id) {
+    if (!m_aggregates.contains(id)) {
+      int64_t ts = m_locations[id - 1].ts_ms;
+      n += ts >= from && ts <= to;
+    } else if (read_locked(id, &ev)) {
+      for (int64_t ts : ev.times_ms)
+        n += ts >= from && ts <= to;
+    }
+  });
+
+  for (const auto &entry : m_bursts) {
+    const Burst &burst = entry.second;
+    bool match = true;
+    for (uint32_t a = 0; a < AUDIT_ATTR_COUNT; a++)
+      match &= q.attr[a] == SymbolTable::NO_SYMBOL || q.attr[a] == burst.attr[a];
+    if (match)
+      for (int64_t ts : burst.times_ms)
+        n += ts >= from && ts <= to;
+  }
+  return n;
+}
+
+void AuditStore::search(const char *terms, int64_t from_ms, int64_t to_ms,
+                        RoaringBitmap *out) const {
+  std::shared_lock<std::shared_mutex> guard(m_lock);
+  out->clear();
+
+  std::vector<uint32_t> term_ids;
+  for (const char *p = terms; *p;) {
+    while (*p == ' ')
+      p++;
+    const char *start = p;
+    while (*p && *p != ' ')
+      p++;
+    if (p == start)
+      continue;
+    uint32_t id =
+        global_symbols().find(details_normalize_term(start, p - start));
+    if (id == SymbolTable::NO_SYMBOL)
+      return;
+    term_ids.push_back(id);
+  }
+  if (term_ids.empty())
+    return;
+
+  int64_t to = to_ms ? to_ms : INT64_MAX;
+  std::vector<uint32_t> ids, postings, merged;
+  for (const auto &seg : m_segments) {
+    if (seg->record_count == 0 || seg->max_ts_ms < from_ms ||
+        seg->min_ts_ms > to)
+      continue;
+    if (seg->terms_pending)
+      load_terms(seg.get());
+
+    for (size_t t = 0; t < term_ids.size(); t++) {
+      if (seg->packed_terms.empty())
+        seg->live_terms.find(term_ids[t], &postings);
+      else
+        seg->packed_terms.find(term_ids[t], &postings);
+      if (t == 0) {
+        ids.swap(postings);
+      } else {
+        merged.clear();
+        std::set_intersection(ids.begin(), ids.end(), postings.begin(),
+                              postings.end(), std::back_inserter(merged));
+        ids.swap(merged);
+      }
+      if (ids.empty())
+        break;
+    }
+
+    for (uint32_t id : ids) {
+      int64_t ts = m_locations[id - 1].ts_ms;
+      if (ts >= from_ms && ts <= to)
+        out->add(id);
+    }
+  }
+}
+
+// Caller holds seg->read_lock
+bool AuditStore::read_at(Segment *seg, uint64_t offset, size_t len,
+                         char *out) const {
+  if (seg->zfile)
+    return seg->zfile->read(offset, len, out);
+  return fseek(seg->reader, (long)offset, SEEK_SET) == 0 &&
+         fread(out, 1, len, seg->reader) == len;
+}
+
+// Body and payload of one record, checksum verified
+bool AuditStore::read_raw(uint64_t event_id, AuditRecordBody *body,
+                          std::string *payload) const {
+  if (event_id == 0 || event_id > m_locations.size())
+    return false;
+  const Location &loc = m_locations[event_id - 1];
+  if (loc.segment == UINT32_MAX)
+    return false;
+
+  Segment *seg = m_segments[loc.segment].get();
+  char buf[sizeof(AuditRecordHeader) + sizeof(AuditRecordBody) +
+           AUDIT_MAX_DETAILS];
+  AuditRecordHeader rh;
+  const char *details = buf + sizeof(rh) + sizeof(*body);
+  {
+    std::lock_guard<std::mutex> read_guard(seg->read_lock);
+    if (!read_at(seg, loc.offset, sizeof(rh) + sizeof(*body), buf))
+      return false;
+    memcpy(&rh, buf, sizeof(rh));
+    memcpy(body, buf + sizeof(rh), sizeof(*body));
+    if (body->details_len > AUDIT_MAX_DETAILS ||
+        !read_at(seg, loc.offset + sizeof(rh) + sizeof(*body),
+                 body->details_len, buf + sizeof(rh) + sizeof(*body)))
+      return false;
+  }
+  if (rh.marker != AUDIT_RECORD_MARKER || body->event_id != event_id ||
+      audit_record_check(*body, details) != rh.check)
+    return false;
+  payload->assign(details, body->details_len);
+  return true;
+}
+
+bool AuditStore::read_locked(uint64_t event_id, AuditEvent *out) const {
+  AuditRecordBody body;
+  std::string payload;
+  if (!read_raw(event_id, &body, &payload))
+    return false;
+
+  out->event_id = body.event_id;
+  out->ts_ms = body.ts_ms;
+  memcpy(out->attr, body.attr, sizeof(out->attr));
+  out->flags = body.flags;
+  const char *details = payload.data();
+  size_t len = payload.size();
+  if (!split_aggregate(body.flags, body.ts_ms, &details, &len, &out->count,
+                       &out->times_ms))
+    return false;
+  out->details.assign(details, len);
+  return true;
+}
+
+bool AuditStore::read(uint64_t event_id, AuditEvent *out) const {
+  std::shared_lock<std::shared_mutex> guard(m_lock);
+  return read_locked(event_id, out);
+}
+
+static void json_string(std::string *out, const std::string *s) {
+  if (!s) {
+    *out += "null";
+    return;
+  }
+  *out += '"';
+  for (unsigned char c : *s) {
+    if (c == '"' || c == '\\') {
+      *out += '\\';
+      *out += (char)c;
+    } else if (c < 0x20) {
+      char esc[8];
+      snprintf(esc, sizeof(esc), "\\u%04x", c);
+      *out += esc;
+    } else {
+      *out += (char)c;
+    }
+  }
+  *out += '"';
+}
+
+// Local time, like datetime.now().isoformat() in audit_log.py
+static void iso_timestamp(int64_t ts_ms, std::string *out) {
+  time_t secs = (time_t)(ts_ms / 1000);
+  struct tm tm_local;
+#ifdef _WIN32
+  localtime_s(&tm_local, &secs);
+#else
+  localtime_r(&secs, &tm_local);
+#endif
+  char buf[40];
+  size_t n = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm_local);
+  snprintf(buf + n, sizeof(buf) - n, ".%03d", (int)(ts_ms % 1000));
+  *out += buf;
+}
+
+bool AuditStore::event_json(uint64_t event_id, std::string *out) const {
+  AuditEvent ev;
+  if (!read(event_id, &ev))
+    return false;
+
+  SymbolTable &symbols = global_symbols();
+  out->clear();
+  *out += "{\"id\": " + std::to_string(ev.event_id) + ", \"timestamp\": \"";
+  iso_timestamp(ev.ts_ms, out);
+  *out += "\", \"username\": ";
+  json_string(out, symbols.name(ev.attr[AUDIT_ATTR_USER]));
+  *out += ", \"event_type\": ";
+  json_string(out, symbols.name(ev.attr[AUDIT_ATTR_EVENT_TYPE]));
+  *out += ", \"status\": ";
+  json_string(out, symbols.name(ev.attr[AUDIT_ATTR_STATUS]));
+  *out += ", \"ip_address\": ";
+  json_string(out, symbols.name(ev.attr[AUDIT_ATTR_IP]));
+  *out += ", \"details\": ";
+  std::vector<DetailsField> fields;
+  std::string details;
+  if (!ev.details.empty() &&
+      decode_details(ev.flags, ev.details.data(), ev.details.size(), &fields))
+    details_to_json(fields, &details);
+  *out += details.empty() ? "null" : details;
+  *out += ", \"risk_level\": ";
+  json_string(out, symbols.name(ev.attr[AUDIT_ATTR_RISK]));
+  if (ev.flags & AUDIT_FLAG_AGGREGATE) {
+    *out += ", \"count\": " + std::to_string(ev.count) +
+            ", \"last_timestamp\": \"";
+    iso_timestamp(ev.times_ms.back(), out);
+    *out += "\"";
+  }
+  *out += "}";
+  return true;
+}
+
+bool AuditStore::prove(uint64_t event_id, AuditProof *out) const {
+  std::shared_lock<std::shared_mutex> guard(m_lock);
+  const AuditCommit *commit = m_chain.find(event_id);
+  if (!commit)
+    return false;
+
+  // Rebuild the batch's leaves from its records
+  std::vector<std::string> inputs(commit->count);
+  AuditRecordBody body;
+  std::string payload;
+  for (uint32_t i = 0; i < commit->count; i++) {
+    if (!read_raw(commit->first_event_id + i, &body, &payload))
+      return false;
+    audit_leaf_input(&body, sizeof(body), payload.data(), payload.size(),
+                     &inputs[i]);
+  }
+  std::vector<AuditDigest> leaves, path;
+  audit_leaf_hashes(inputs, &leaves);
+  size_t index = event_id - commit->first_event_id;
+  audit_merkle_path(leaves, index, &path);
+  if (path.size() > AUDIT_PROOF_MAX_DEPTH)
+    return false;
+
+  memset(out, 0, sizeof(*out));
+  out->event_id = event_id;
+  out->batch = commit->batch;
+  out->leaf_index = (uint32_t)index;
+  out->leaf_count = commit->count;
+  out->path_len = (uint32_t)path.size();
+  memcpy(out->leaf, leaves[index].bytes, 32);
+  for (size_t i = 0; i < path.size(); i++)
+    memcpy(out->path[i], path[i].bytes, 32);
+  if (commit->batch > 0)
+    memcpy(out->prev_chain, m_chain.commits()[commit->batch - 1].chain, 32);
+  memcpy(out->root, commit->root, 32);
+  memcpy(out->chain, commit->chain, 32);
+  return true;
+}
+
+bool AuditStore::chain_head(AuditCommit *out) const {
+  std::shared_lock<std::shared_mutex> guard(m_lock);
+  if (m_chain.commits().empty())
+    return false;
+  *out = m_chain.commits().back();
+  return true;
+}
+
+uint64_t AuditStore::count() const {
+  std::shared_lock<std::shared_mutex> guard(m_lock);
+  return m_next_event_id - 1;
+}
+
+bool AuditStore::tail_range(uint64_t event_id, uint64_t max_events,
+                            AuditTailRange *out) const {
+  std::shared_lock<std::shared_mutex> guard(m_lock);
+  if (event_id == 0 || event_id >= m_next_event_id || max_events == 0)
+    return false;
+
+  const Location &loc = m_locations[event_id - 1];
+  out->path.clear();
+  out->offset = loc.offset;
+  out->length = 0;
+  out->events = 1;
+  if (loc.segment == UINT32_MAX)
+    return true;
+
+  // Records of a segment are in ID order with no gaps
+  uint64_t limit = std::min(event_id + max_events, m_next_event_id);
+  uint64_t end = event_id + 1;
+  while (end < limit && m_locations[end - 1].segment == loc.segment)
+    end++;
+  out->events = end - event_id;
+
+  Segment *seg = m_segments[loc.segment].get();
+  {
+    std::lock_guard<std::mutex> read_guard(seg->read_lock);
+    if (seg->zfile)
+      return true;
+  }
+  out->path = seg->path;
+  bool more = end < m_next_event_id &&
+              m_locations[end - 1].segment == loc.segment;
+  out->length = (more ? m_locations[end - 1].offset : seg->data_end) -
+                loc.offset;
+  return true;
+}
+
+bool AuditStore::record_bytes(uint64_t event_id, std::string *out) const {
+  std::shared_lock<std::shared_mutex> guard(m_lock);
+  AuditRecordBody body;
+  std::string payload;
+  if (!read_raw(event_id, &body, &payload))
+    return false;
+
+  AuditRecordHeader rh;
+  rh.marker = AUDIT_RECORD_MARKER;
+  rh.length = (uint32_t)(sizeof(body) + payload.size());
+  rh.check = audit_record_check(body, payload.data());
+  rh.reserved = 0;
+  out->assign((const char *)&rh, sizeof(rh));
+  out->append((const char *)&body, sizeof(body));
+  out->append(payload);
+  return true;
+}
+
+size_t AuditStore::index_bytes() const {
+  std::shared_lock<std::shared_mutex> guard(m_lock);
+  size_t n = m_locations.capacity() * sizeof(Location);
+  for (const auto &entry : m_attr_index)
+    n += entry.second.bytes();
+  for (const auto &entry : m_time_index)
+    n += entry.second.bytes();
+  n += m_aggregates.bytes();
+  for (const auto &seg : m_segments)
+    n += seg->packed_terms.bytes();
+  return n;
+}
+
+bool AuditStore::sync() {
+  std::unique_lock<std::shared_mutex> guard(m_lock);
+  bool ok = flush_bursts();
+  // Records reference symbol IDs, so symbols must be durable first
+  if (!global_symbols().sync())
+    return false;
+  if (!ok || !m_writer || fflush(m_writer) != 0)
+    return false;
+#ifndef _WIN32
+  if (fsync(fileno(m_writer)) != 0)
+    return false;
+#endif
+  // Commits after the records they cover
+  return m_chain.sync();
+}
+
+// --- Intrusion State ---
+
+// Everything but the windows. Only successes teach a profile what is
+// normal for its user. `details` are without an aggregate prefix.
+void AuditStore::learn(const uint32_t attr[AUDIT_ATTR_COUNT], int64_t ts_ms,
+                       uint16_t flags, const char *details, size_t len) {
+  uint32_t user = attr[AUDIT_ATTR_USER];
+  m_intrusion.advance(user, attr[AUDIT_ATTR_EVENT_TYPE],
+                      attr[AUDIT_ATTR_STATUS], ts_ms);
+  if (user == SymbolTable::NO_SYMBOL ||
+      attr[AUDIT_ATTR_STATUS] != m_success_symbol)
+    return;
+  if (attr[AUDIT_ATTR_EVENT_TYPE] == m_login_symbol) {
+    const std::string *ip = global_symbols().name(attr[AUDIT_ATTR_IP]);
+    m_intrusion.learn_login(user, ts_ms,
+                            ip ? intrusion_ip_prefix(ip->c_str()) : 0);
+    return;
+  }
+  std::vector<DetailsField> fields;
+  if (attr[AUDIT_ATTR_EVENT_TYPE] != m_totp_symbol || len == 0 ||
+      !decode_details(flags, details, len, &fields))
+    return;
+  for (const DetailsField &f : fields)
+    if (f.key == "totp_offset" && f.type == DETAILS_INT)
+      m_intrusion.learn_totp(user, (int)f.ival);
+}
+
+void AuditStore::observe(const uint32_t attr[AUDIT_ATTR_COUNT], int64_t ts_ms,
+                         uint16_t flags, const char *details, size_t len) {
+  // Blocks and revocations are not attempts: counting them would feed the
+  // windows that raised them
+  if (attr[AUDIT_ATTR_EVENT_TYPE] == m_enforcement_symbol)
+    return;
+  m_intrusion.note(attr[AUDIT_ATTR_USER], attr[AUDIT_ATTR_STATUS], ts_ms);
+  learn(attr, ts_ms, flags, details, len);
+}
+
+void AuditStore::replay(const uint32_t attr[AUDIT_ATTR_COUNT], int64_t ts_ms,
+                        uint16_t flags, const char *details, size_t len) {
+  if (!m_intrusion.covers(0, ts_ms))
+    observe(attr, ts_ms, flags, details, len);
+}
+
+// --- Exported Functions for Python ---
+
+static std::unique_ptr<AuditStore> g_audit;
+static std::unique_ptr<AuditQueue> g_audit_queue; // writes into g_audit
+static std::unique_ptr<AuditTailServer> g_audit_tail; // reads g_audit
+static std::shared_mutex g_audit_lock;
+static std::string g_sequence_rules; // for stores opened from now on
+
+// Query terms must already be interned; an unknown value matches nothing
+static bool lookup_term(const char *s, uint32_t *out) {
+  *out = SymbolTable::NO_SYMBOL;
+  if (!s || !*s)
+    return true;
+  *out = global_symbols().find(s);
+  return *out != SymbolTable::NO_SYMBOL;
+}
+
+// Open bursts are written on close. At exit that has to happen before the
+// symbol table (a function-local static created after g_audit) is destroyed.
+static void close_at_exit() {
+  std::unique_lock<std::shared_mutex> guard(g_audit_lock);
+  g_audit_tail.reset();
+  g_audit_queue.reset();
+  g_audit.reset();
+}
+
+extern "C" {
+
+// Open the native audit log in `dir` (e.g. "audit_segments")
+bool audit_store_open(const char *dir) {
+  std::unique_ptr<AuditStore> store(new AuditStore());
+  std::string rules;
+  {
+    std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+    rules = g_sequence_rules;
+  }
+  if (!store->open(dir, rules.c_str()))
+    return false;
+
+  static bool close_registered = std::atexit(close_at_exit) == 0;
+  (void)close_registered;
+
+  std::unique_lock<std::shared_mutex> guard(g_audit_lock);
+  g_audit_tail.reset();
+  g_audit_queue.reset();
+  g_audit = std::move(store);
+  return true;
+}
+
+void audit_store_close() {
+  std::unique_lock<std::shared_mutex> guard(g_audit_lock);
+  g_audit_tail.reset();
+  g_audit_queue.reset();
+  g_audit.reset();
+}
+
+bool audit_store_sync() {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  return g_audit && g_audit->sync();
+}
+
+// Mirrors audit_log.log_event(). `ts_ms` = 0 uses the current time.
+// Returns the event ID, or 0 on failure.
+uint64_t audit_append(const char *username, const char *event_type,
+                      const char *status, const char *ip_address,
+                      const char *risk_level, const char *details_json,
+                      int64_t ts_ms) {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  if (!g_audit)
+    return 0;
+
+  uint32_t attr[AUDIT_ATTR_COUNT];
+  uint16_t flags;
+  std::string details;
+  audit_prepare_event(username, event_type, status, ip_address, risk_level,
+                      details_json, attr, &flags, &details);
+  if (!ts_ms)
+    ts_ms = now_ms();
+  g_audit->observe(attr, ts_ms, flags, details.data(), details.size());
+  return g_audit->append(ts_ms, attr, flags, details.data(), details.size());
+}
+
+// Start the async writer in front of the open store; events that overflow
+// the ring go to `spill_path`. `capacity` 0 = AUDIT_QUEUE_CAPACITY.
+bool audit_queue_start(const char *spill_path, int capacity) {
+  std::unique_lock<std::shared_mutex> guard(g_audit_lock);
+  if (!g_audit || !spill_path)
+    return false;
+  g_audit_queue.reset();
+  std::unique_ptr<AuditQueue> queue(new AuditQueue());
+  if (!queue->start(g_audit.get(), spill_path,
+                    capacity > 0 ? (size_t)capacity : 0))
+    return false;
+  g_audit_queue = std::move(queue);
+  return true;
+}
+
+// Drain the ring and spill file into the store, then stop the writer
+void audit_queue_stop() {
+  std::unique_lock<std::shared_mutex> guard(g_audit_lock);
+  g_audit_queue.reset();
+}
+
+// Serve tail subscriptions for the open store on a Unix socket
+bool audit_tail_start(const char *socket_path) {
+  std::unique_lock<std::shared_mutex> guard(g_audit_lock);
+  if (!g_audit)
+    return false;
+  g_audit_tail.reset();
+  std::unique_ptr<AuditTailServer> tail(new AuditTailServer());
+  if (!tail->start(g_audit.get(), socket_path))
+    return false;
+  g_audit_tail = std::move(tail);
+  return true;
+}
+
+void audit_tail_stop() {
+  std::unique_lock<std::shared_mutex> guard(g_audit_lock);
+  g_audit_tail.reset();
+}
+
+// AuditOverflowPolicy for `event_type` (NULL = every other type)
+bool audit_queue_policy(const char *event_type, int policy) {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  if (!g_audit_queue || policy < AUDIT_POLICY_BLOCK ||
+      policy > AUDIT_POLICY_SAMPLE)
+    return false;
+  g_audit_queue->set_policy(event_type, (AuditOverflowPolicy)policy);
+  return true;
+}
+
+// audit_append() through the queue (straight to the store if it is not
+// running). False if the event was sampled out or could not be written.
+bool audit_enqueue(const char *username, const char *event_type,
+                   const char *status, const char *ip_address,
+                   const char *risk_level, const char *details_json,
+                   int64_t ts_ms) {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  if (!g_audit)
+    return false;
+
+  uint32_t attr[AUDIT_ATTR_COUNT];
+  uint16_t flags;
+  std::string details;
+  audit_prepare_event(username, event_type, status, ip_address, risk_level,
+                      details_json, attr, &flags, &details);
+  if (!ts_ms)
+    ts_ms = now_ms();
+  // Counted even if the queue samples it out: detection sees every attempt
+  g_audit->observe(attr, ts_ms, flags, details.data(), details.size());
+  if (g_audit_queue)
+    return g_audit_queue->push(ts_ms, attr, flags, details.data(),
+                               details.size());
+  return g_audit->append(ts_ms, attr, flags, details.data(),
+                         details.size()) != 0;
+}
+
+// Wait until everything queued so far is in the store
+bool audit_queue_flush() {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  return !g_audit_queue || g_audit_queue->flush();
+}
+
+bool audit_queue_metrics(AuditQueueMetrics *out) {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  if (!g_audit_queue || !out)
+    return false;
+  g_audit_queue->metrics(out);
+  return true;
+}
+
+// Events matching every non-NULL term within [from_ms, to_ms] (0 = open).
+// Writes up to `max_ids` IDs (ascending) and returns the total match count.
+int64_t audit_query(const char *username, const char *event_type,
+                    const char *status, const char *risk_level,
+                    const char *ip_address, int64_t from_ms, int64_t to_ms,
+                    uint64_t *ids_out, int max_ids) {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  if (!g_audit)
+    return -1;
+
+  AuditQuery q;
+  q.from_ms = from_ms;
+  q.to_ms = to_ms;
+  if (!lookup_term(username, &q.attr[AUDIT_ATTR_USER]) ||
+      !lookup_term(event_type, &q.attr[AUDIT_ATTR_EVENT_TYPE]) ||
+      !lookup_term(status, &q.attr[AUDIT_ATTR_STATUS]) ||
+      !lookup_term(risk_level, &q.attr[AUDIT_ATTR_RISK]) ||
+      !lookup_term(ip_address, &q.attr[AUDIT_ATTR_IP]))
+    return 0;
+
+  RoaringBitmap result;
+  g_audit->query(q, &result);
+  int written = 0;
+  if (ids_out)
+    result.for_each([&](uint32_t id) {
+      if (written < max_ids)
+        ids_out[written++] = id;
+    });
+  return (int64_t)result.cardinality();
+}
+
+// JSON for one event. Returns its length, or -1 if missing or `buf` is too
+// small.
+int audit_event_json(uint64_t event_id, char *buf, int buf_size) {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  std::string json;
+  if (!g_audit || !g_audit->event_json(event_id, &json) ||
+      (int)json.size() >= buf_size)
+    return -1;
+  memcpy(buf, json.data(), json.size());
+  buf[json.size()] = '\0';
+  return (int)json.size();
+}
+
+// Full-text search over details, e.g. "reason:database_error". Same
+// output convention as audit_query().
+int64_t audit_search(const char *terms, int64_t from_ms, int64_t to_ms,
+                     uint64_t *ids_out, int max_ids) {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  if (!g_audit || !terms)
+    return -1;
+
+  RoaringBitmap result;
+  g_audit->search(terms, from_ms, to_ms, &result);
+  int written = 0;
+  if (ids_out)
+    result.for_each([&](uint32_t id) {
+      if (written < max_ids)
+        ids_out[written++] = id;
+    });
+  return (int64_t)result.cardinality();
+}
+
+// Number of events matching every non-NULL term within [from_ms, to_ms],
+// with each repeat folded into an aggregate record counted on its own
+int64_t audit_count(const char *username, const char *event_type,
+                    const char *status, const char *risk_level,
+                    const char *ip_address, int64_t from_ms, int64_t to_ms) {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  if (!g_audit)
+    return -1;
+
+  AuditQuery q;
+  q.from_ms = from_ms;
+  q.to_ms = to_ms;
+  if (!lookup_term(username, &q.attr[AUDIT_ATTR_USER]) ||
+      !lookup_term(event_type, &q.attr[AUDIT_ATTR_EVENT_TYPE]) ||
+      !lookup_term(status, &q.attr[AUDIT_ATTR_STATUS]) ||
+      !lookup_term(risk_level, &q.attr[AUDIT_ATTR_RISK]) ||
+      !lookup_term(ip_address, &q.attr[AUDIT_ATTR_IP]))
+    return 0;
+  return (int64_t)g_audit->count_events(q);
+}
+
+// Inclusion proof for `event_id`, after committing the open batch
+bool audit_prove(uint64_t event_id, AuditProof *out) {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  if (!g_audit || !out || (g_audit_queue && !g_audit_queue->flush()))
+    return false;
+  return g_audit->sync() && g_audit->prove(event_id, out);
+}
+
+// Check a proof from audit_prove(): leaf -> batch root -> chain value
+bool audit_check_proof(const AuditProof *proof) {
+  return proof && audit_proof_verify(*proof);
+}
+
+// Chain value of the latest commit, for anchoring outside the log.
+// Returns the number of committed batches, or -1.
+int64_t audit_chain_head(uint8_t out[32]) {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  AuditCommit head;
+  if (!g_audit)
+    return -1;
+  if (!g_audit->chain_head(&head))
+    return 0;
+  if (out)
+    memcpy(out, head.chain, 32);
+  return (int64_t)head.batch + 1;
+}
+
+// Events of `username` (with `status` unless NULL) at or after `since_ms`,
+// from the in-memory intrusion state; covers the last INTRUSION_WINDOW_MS
+int64_t audit_window_count(const char *username, const char *status,
+                           int64_t since_ms) {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  if (!g_audit)
+    return -1;
+  uint32_t user, status_id;
+  if (!username || !*username || !lookup_term(username, &user) ||
+      !lookup_term(status, &status_id))
+    return 0;
+  return (int64_t)g_audit->intrusion().count(user, status_id, since_ms);
+}
+
+// Sequence rules (see sequence_detector.h) for the open store and any
+// opened later; call before audit_store_open() so replay on startup follows
+// them. False if they do not compile, with the reason in `error`.
+bool audit_sequence_rules(const char *rules, char *error, int error_len) {
+  std::string spec = rules ? rules : "", why;
+  if (!SequenceDetector::validate(spec, &why)) {
+    if (error && error_len > 0)
+      snprintf(error, (size_t)error_len, "%s", why.c_str());
+    return false;
+  }
+  std::unique_lock<std::shared_mutex> guard(g_audit_lock);
+  g_sequence_rules = spec;
+  return !g_audit || g_audit->intrusion().set_sequences(spec, &why);
+}
+
+// Rules that the latest `event_type` event of `username` completed, as
+// comma-separated names in `out`. Returns how many (-1 without a store).
+int audit_sequence_matches(const char *username, const char *event_type,
+                           char *out, int out_len) {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  if (!g_audit)
+    return -1;
+  if (out && out_len > 0)
+    *out = 0;
+  uint32_t user, type;
+  if (!username || !*username || !lookup_term(username, &user) ||
+      !event_type || !lookup_term(event_type, &type))
+    return 0;
+  std::vector<std::string> names;
+  g_audit->intrusion().sequence_matches(user, type, &names);
+  std::string joined;
+  for (const std::string &name : names)
+    joined += (joined.empty() ? "" : ",") + name;
+  if (out && out_len > 0)
+    snprintf(out, (size_t)out_len, "%s", joined.c_str());
+  return (int)names.size();
+}
+
+// Score an event of `username` at `ts_ms` (0 = now) from `ip_address` (may
+// be NULL) against their behavioural profile; `totp_offset`
+// PROFILE_NO_TOTP leaves out the TOTP score. False if they have none yet.
+bool audit_profile_score(const char *username, const char *ip_address,
+                         int64_t ts_ms, int totp_offset, IntrusionScore *out) {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  uint32_t user;
+  if (!g_audit || !out || !username || !*username ||
+      !lookup_term(username, &user))
+    return false;
+  return g_audit->intrusion().score(user, ts_ms ? ts_ms : now_ms(),
+                                   intrusion_ip_prefix(ip_address),
+                                   totp_offset, out);
+}
+
+uint64_t audit_event_count() {
+  std::shared_lock<std::shared_mutex> guard(g_audit_lock);
+  return g_audit ? g_audit->count() : 0;
+}
+}
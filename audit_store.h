@@ -0,0 +1,439 @@
+#pragma once
+
+#include "audit_chain.h"
+#include "audit_search.h"
+#include "intrusion_state.h"
+#include "roaring_bitmap.h"
+#include "symbol_table.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// --- Native Audit Log ---
+// Append-only audit trail kept as numbered segment files in one directory
+// (normally "audit_segments/"), next to the symbol log. Username, event
+// type, status, risk level and IP are interned (see symbol_table.h), so a
+// record is a fixed 40-byte body plus its details payload (binary, see
+// details_codec.h).
+//
+// Segment: [AuditSegmentHeader][record]...[AuditSegmentFooter once sealed]
+// Record:  [AuditRecordHeader][AuditRecordBody][details bytes]
+//
+// Each appended event is also added to roaring bitmaps keyed by attribute
+// value and by hour, so multi-predicate queries are answered by bitmap
+// intersection before any record is read. The bitmaps are rebuilt from the
+// segments on open. Sealed segments are compressed into independently
+// decodable frames (see audit_compress.h). Details text is searchable through a per-segment
+// inverted index (see audit_search.h).
+//
+// Bursts of identical events (same attributes and details, e.g. one user's
+// invalid_credentials failures from one IP during a brute-force wave) are
+// run-length aggregated: the first event is written as usual, repeats are
+// held in memory and written as one AUDIT_FLAG_AGGREGATE record once the
+// burst goes quiet, fills up or the store is synced. Its payload is
+//
+//   [AuditAggregate][varint timestamp deltas][details]
+//
+// so every repeat keeps its timestamp and counts stay exact.
+//
+// Records are committed in hash-chained Merkle batches (see audit_chain.h).
+//
+// Once a segment is sealed, a background thread saves its share of the
+// bitmaps and its record locations as seg-N.rix (the record index), then
+// compresses it.
+//
+// Recovery on open reads segments on worker threads and indexes them in
+// order. A sealed segment's valid footer vouches for its records: if its
+// record index agrees with the footer, the bitmaps are merged from it and
+// no record is read or decompressed. The intrusion state (see
+// intrusion_state.h) is restored from its checkpoint first, so only the
+// tail segments holding records written after the checkpoint are read in
+// full; their events are replayed into it, recent ones into the windows and all
+// of them into the user profiles and sequence states. The unsealed tail has
+// its checksums verified (in parallel chunks) and is cut at the first torn
+// record. A sealed segment without a term index gets one built in the
+// background, or by the first search that needs it.
+
+const char AUDIT_SEGMENT_MAGIC[8] = {'S', 'A', 'A', 'U', 'D', 'S', '0', '1'};
+const uint32_t AUDIT_SEGMENT_VERSION = 1;
+const char AUDIT_RECORD_INDEX_MAGIC[8] = {'S', 'A', 'A', 'U',
+                                          'D', 'R', 'X', '1'};
+const uint32_t AUDIT_RECORD_INDEX_VERSION = 1;
+const uint32_t AUDIT_RECORD_MARKER = 0xA0D17EC0;
+const uint32_t AUDIT_FOOTER_MARKER = 0xA0D1F00F;
+const uint64_t AUDIT_SEGMENT_MAX_BYTES = 64ull << 20;
+const uint32_t AUDIT_MAX_DETAILS = 4096;
+const int64_t AUDIT_BUCKET_MS = 3600 * 1000; // time index granularity
+const size_t AUDIT_RECOVERY_CHUNK = 16384;   // records per checksum worker
+
+// AuditRecordBody::flags
+const uint16_t AUDIT_FLAG_BINARY_DETAILS = 1; // details_codec.h, else JSON
+const uint16_t AUDIT_FLAG_AGGREGATE = 2;      // payload starts with AuditAggregate
+
+// Burst aggregation limits
+const int64_t AUDIT_BURST_GAP_MS = 60 * 1000;       // quiet time that ends a burst
+const int64_t AUDIT_BURST_SPAN_MS = 15 * 60 * 1000; // from its first event
+const size_t AUDIT_MAX_BURSTS = 4096;               // open bursts held in memory
+
+enum AuditAttribute {
+  AUDIT_ATTR_USER,
+  AUDIT_ATTR_EVENT_TYPE,
+  AUDIT_ATTR_STATUS,
+  AUDIT_ATTR_RISK,
+  AUDIT_ATTR_IP,
+  AUDIT_ATTR_COUNT
+};
+
+struct AuditSegmentHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t segment_id;
+  uint64_t first_event_id;
+  int64_t created_ms;
+  uint8_t reserved[32];
+};
+
+struct AuditRecordHeader {
+  uint32_t marker;
+  uint32_t length; // body + details
+  uint32_t check;  // over body + details
+  uint32_t reserved;
+};
+
+struct AuditRecordBody {
+  uint64_t event_id;
+  int64_t ts_ms;
+  uint32_t attr[AUDIT_ATTR_COUNT]; // symbol IDs
+  uint16_t flags;
+  uint16_t details_len;
+};
+
+struct AuditSegmentFooter {
+  uint32_t marker;
+  uint32_t record_count;
+  uint64_t first_event_id;
+  uint64_t last_event_id;
+  int64_t min_ts_ms;
+  int64_t max_ts_ms;
+  uint64_t data_end; // offset of this footer
+  uint32_t check;
+  uint32_t reserved;
+};
+
+// Repeats of an earlier event; the record's ts_ms is the first repeat's
+struct AuditAggregate {
+  uint32_t count;      // events in this record
+  uint16_t deltas_len; // bytes of varint deltas (count - 1 of them)
+  uint16_t reserved;
+  int64_t last_ts_ms;
+};
+
+// seg-N.rix: [AuditRecordIndexHeader][AuditRecordIndexEntry x record_count]
+// [aggregates][uint64 attribute key, bitmap x attr_count]
+// [int64 hour bucket, bitmap x bucket_count], bitmaps as
+// RoaringBitmap::encode() writes them
+struct AuditRecordIndexHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t segment_id;
+  uint32_t record_count;
+  uint32_t attr_count;
+  uint32_t bucket_count;
+  uint32_t reserved;
+  uint64_t first_event_id; // footer fields, which it must match
+  uint64_t last_event_id;
+  int64_t min_ts_ms;
+  int64_t max_ts_ms;
+  uint64_t data_end;
+  int64_t latest_ts_ms; // newest event, counting aggregated repeats
+  uint64_t body_bytes;
+  uint64_t check; // fnv1a64 of everything after the header
+};
+
+struct AuditRecordIndexEntry {
+  uint32_t event_id;
+  uint32_t offset;
+  int64_t ts_ms;
+};
+
+static_assert(sizeof(AuditSegmentHeader) == 64, "segment header layout");
+static_assert(sizeof(AuditRecordHeader) == 16, "record header layout");
+static_assert(sizeof(AuditRecordBody) == 40, "record body layout");
+static_assert(sizeof(AuditSegmentFooter) == 56, "segment footer layout");
+static_assert(sizeof(AuditAggregate) == 16, "aggregate layout");
+static_assert(sizeof(AuditRecordIndexHeader) == 96, "record index layout");
+static_assert(sizeof(AuditRecordIndexEntry) == 16, "record index entry");
+
+struct AuditEvent {
+  uint64_t event_id;
+  int64_t ts_ms;
+  uint32_t attr[AUDIT_ATTR_COUNT];
+  uint16_t flags;
+  std::string details;           // without the aggregate prefix
+  uint32_t count;                // events this record stands for
+  std::vector<int64_t> times_ms; // their timestamps, if an aggregate
+};
+
+// Zero attribute = any value; zero bound = unbounded
+struct AuditQuery {
+  uint32_t attr[AUDIT_ATTR_COUNT];
+  int64_t from_ms;
+  int64_t to_ms;
+};
+
+// Consecutive records of one segment, for streaming them as stored
+struct AuditTailRange {
+  std::string path; // the .aud file; empty if compressed or not on disk
+  uint64_t offset;  // of the first record
+  uint64_t length;  // bytes of all `events` records (0 without a path)
+  uint64_t events;
+};
+
+uint32_t audit_record_check(const AuditRecordBody &body, const char *details);
+
+// log_event() fields as AuditStore::append() takes them: text interned,
+// details JSON encoded (text the codec cannot parse is kept as it is)
+void audit_prepare_event(const char *username, const char *event_type,
+                         const char *status, const char *ip_address,
+                         const char *risk_level, const char *details_json,
+                         uint32_t attr[AUDIT_ATTR_COUNT], uint16_t *flags,
+                         std::string *details);
+
+class CompressedSegment;
+struct AuditCompressStats;
+
+//
+// AuditStore - segment files plus in-memory attribute/time indexes
+//
+class AuditStore {
+private:
+  struct Segment {
+    uint32_t id;
+    std::string path;
+    FILE *reader;
+    std::mutex read_lock;
+    bool sealed;
+    uint64_t data_end;
+    uint32_t record_count;
+    uint64_t first_event_id;
+    uint64_t last_event_id;
+    int64_t min_ts_ms;
+    int64_t max_ts_ms;
+    PostingsBuilder live_terms;  // details postings while open
+    PackedPostings packed_terms; // once sealed (also saved as .idx)
+    // Sealed, but packed_terms not built yet (see load_terms())
+    std::atomic<bool> terms_pending;
+    bool record_index; // seg-N.rix saved (finisher thread once queued)
+    // Replaces the .aud once sealed; set by the finisher under read_lock
+    std::unique_ptr<CompressedSegment> zfile;
+  };
+
+  // Repeats of a written event that are not on disk yet
+  struct Burst {
+    uint32_t attr[AUDIT_ATTR_COUNT];
+    uint16_t flags;
+    std::string details;
+    uint64_t leader_id; // the written event
+    int64_t leader_ts_ms;
+    std::vector<int64_t> times_ms;
+    size_t deltas_len;
+  };
+
+  struct Location {
+    uint32_t segment; // index into m_segments
+    uint32_t offset;
+    int64_t ts_ms;
+  };
+
+  struct SegmentScan; // one segment read by a recovery worker
+  struct RecordIndex; // contents of a seg-N.rix
+
+  std::string m_dir;
+  std::vector<std::unique_ptr<Segment>> m_segments;
+  FILE *m_writer; // appends to m_segments.back()
+  uint64_t m_next_event_id;
+  std::vector<Location> m_locations; // by event_id - 1
+
+  std::unordered_map<uint64_t, RoaringBitmap> m_attr_index;
+  std::map<int64_t, RoaringBitmap> m_time_index; // by ts_ms / AUDIT_BUCKET_MS
+  RoaringBitmap m_aggregates;                    // AUDIT_FLAG_AGGREGATE records
+
+  bool m_aggregate_bursts;
+  std::unordered_map<uint64_t, Burst> m_bursts; // by burst_key()
+  int64_t m_last_sweep_ms;
+
+  AuditChain m_chain;
+
+  IntrusionState m_intrusion; // own lock: fed ahead of the queue
+  // Symbols of the events profiles learn from, set by open()
+  uint32_t m_login_symbol, m_totp_symbol, m_success_symbol;
+  uint32_t m_enforcement_symbol; // the enforcer's own actions, not attempts
+
+  std::atomic<uint64_t> m_raw_bytes;        // sealed segments before compression
+  std::atomic<uint64_t> m_compressed_bytes; // ... and after
+
+  // Sealed segments wait here for the finisher thread (record index, term
+  // index, compression), so appends never wait on that work
+  std::mutex m_finish_lock;
+  std::condition_variable m_finish_ready; // queued work, or stop
+  std::condition_variable m_finish_idle;  // queue drained
+  std::deque<Segment *> m_finish_queue;
+  bool m_finish_busy;
+  bool m_finish_stop;
+  std::thread m_finisher;
+
+  mutable std::shared_mutex m_lock;
+
+  std::string segment_path(uint32_t id) const;
+  std::string index_path(uint32_t id) const;
+  std::string zsegment_path(uint32_t id) const;
+  std::string record_index_path(uint32_t id) const;
+  bool read_footer(Segment *seg, bool compressed, SegmentScan *out) const;
+  bool read_segment(Segment *seg, bool compressed, SegmentScan *out) const;
+  void scan_segment(Segment *seg, bool compressed, SegmentScan *out);
+  bool recover_segment(uint32_t index, bool last, SegmentScan *scan);
+  void apply_record_index(uint32_t segment, RecordIndex *index);
+  void finish_segment(Segment *seg);
+  void compress_segment(Segment *seg);
+  void queue_finish(Segment *seg);
+  void finish_loop();
+  void stop_finisher();
+  bool start_segment(int64_t now_ms);
+  bool seal_segment(Segment *seg, FILE *f);
+  void index_event(const AuditRecordBody &body, uint32_t segment,
+                   uint32_t offset);
+  void index_terms(Segment *seg, uint32_t event_id, uint16_t flags,
+                   const char *details, size_t len);
+  bool pack_terms(Segment *seg) const;
+  void load_terms(Segment *seg) const;
+  void learn(const uint32_t attr[AUDIT_ATTR_COUNT], int64_t ts_ms,
+             uint16_t flags, const char *details, size_t len);
+  uint64_t write_record(int64_t ts_ms, const uint32_t attr[AUDIT_ATTR_COUNT],
+                        uint16_t flags, const char *payload, size_t len);
+  uint64_t absorb_repeat(int64_t ts_ms, const uint32_t attr[AUDIT_ATTR_COUNT],
+                         uint16_t flags, const char *details, size_t len);
+  void start_burst(uint64_t event_id, int64_t ts_ms,
+                   const uint32_t attr[AUDIT_ATTR_COUNT], uint16_t flags,
+                   const char *details, size_t len);
+  bool flush_burst(const Burst &burst);
+  void sweep_bursts(int64_t now);
+  bool flush_bursts();
+  void query_locked(const AuditQuery &q, RoaringBitmap *out) const;
+  bool read_at(Segment *seg, uint64_t offset, size_t len, char *out) const;
+  bool read_raw(uint64_t event_id, AuditRecordBody *body,
+                std::string *payload) const;
+  bool read_locked(uint64_t event_id, AuditEvent *out) const;
+
+public:
+  AuditStore();
+  ~AuditStore();
+
+  AuditStore(const AuditStore &) = delete;
+  AuditStore &operator=(const AuditStore &) = delete;
+
+  // Create `dir` if needed, open its symbol log and rebuild the indexes from
+  // existing segments. A torn record at the tail is truncated. Events are
+  // replayed under `sequence_rules` (see sequence_detector.h) if given,
+  // else under the rules the intrusion checkpoint was saved with.
+  bool open(const char *dir, const char *sequence_rules = nullptr);
+  void close();
+
+  // Returns the new event ID, or 0 on failure. Details larger than
+  // AUDIT_MAX_DETAILS are dropped. A repeat folded into an open burst
+  // returns the ID of the burst's first event.
+  uint64_t append(int64_t ts_ms, const uint32_t attr[AUDIT_ATTR_COUNT],
+                  uint16_t flags, const char *details, size_t details_len);
+
+  // append() for text fields, see audit_prepare_event()
+  uint64_t append_text(int64_t ts_ms, const char *username,
+                       const char *event_type, const char *status,
+                       const char *ip_address, const char *risk_level,
+                       const char *details_json);
+
+  // Matching event IDs, ascending. An aggregate record is one ID.
+  void query(const AuditQuery &q, RoaringBitmap *out) const;
+
+  // Number of matching events, counting each repeat in aggregate records and
+  // open bursts at its own timestamp
+  uint64_t count_events(const AuditQuery &q) const;
+
+  // Burst aggregation is on by default; turning it off flushes open bursts
+  void set_aggregation(bool enabled);
+
+  bool read(uint64_t event_id, AuditEvent *out) const;
+
+  // Events whose details contain every space-separated term of `terms`
+  // ("reason:database_error timeout") within [from_ms, to_ms] (0 = open)
+  void search(const char *terms, int64_t from_ms, int64_t to_ms,
+              RoaringBitmap *out) const;
+
+  // One event as a JSON object in the shape export_audit_log() writes
+  bool event_json(uint64_t event_id, std::string *out) const;
+
+  // Records written (an aggregate counts once)
+  uint64_t count() const;
+
+  // Up to `max_events` records from `event_id` on that follow each other
+  // in one segment. False if `event_id` has not been written yet.
+  bool tail_range(uint64_t event_id, uint64_t max_events,
+                  AuditTailRange *out) const;
+
+  // One record as stored: [AuditRecordHeader][AuditRecordBody][payload]
+  bool record_bytes(uint64_t event_id, std::string *out) const;
+  size_t index_bytes() const;
+
+  // Seal the current segment and start a new one. The sealed segment's
+  // record index is saved in the background, and it is compressed there
+  // when zstd is available.
+  bool rotate();
+
+  // Wait until the segments sealed so far are finished that way (or given
+  // up on)
+  void wait_finished();
+
+  // Sealed-segment bytes before and after compression
+  void storage_bytes(uint64_t *raw, uint64_t *stored) const;
+
+  // Inclusion proof for a committed event (sync() commits the open batch)
+  bool prove(uint64_t event_id, AuditProof *out) const;
+
+  // Latest commit; false if nothing is committed yet
+  bool chain_head(AuditCommit *out) const;
+
+  // Write open bursts, flush symbols, then segment data and commits
+  bool sync();
+
+  // Logging calls note events here as they are accepted, ahead of the
+  // async queue. Checkpointed to intrusion.ckpt while the store is open.
+  IntrusionState &intrusion() { return m_intrusion; }
+
+  // Feed an accepted event to the intrusion state: its windows, the user's
+  // sequence state, and their profile for a successful login or TOTP
+  // check. `details` as audit_prepare_event() encodes them.
+  void observe(const uint32_t attr[AUDIT_ATTR_COUNT], int64_t ts_ms,
+               uint16_t flags, const char *details, size_t len);
+
+  // observe() for an event replayed from the spill file on startup, before
+  // it is written; skipped if the restored checkpoint already covers it
+  void replay(const uint32_t attr[AUDIT_ATTR_COUNT], int64_t ts_ms,
+              uint16_t flags, const char *details, size_t len);
+};
+
+// audit_log.log_event()'s native half (see audit_store.cpp), for modules
+// that audit their own actions the same way
+extern "C" bool audit_enqueue(const char *username, const char *event_type,
+                              const char *status, const char *ip_address,
+                              const char *risk_level, const char *details_json,
+                              int64_t ts_ms);
@@ -0,0 +1,319 @@
+#include "audit_tail.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+AuditTailServer::AuditTailServer()
+    : m_store(nullptr), m_listen(-1), m_stop(false) {
+  m_wake[0] = m_wake[1] = -1;
+}
+
+AuditTailServer::~AuditTailServer() { stop(); }
+
+#ifdef _WIN32
+
+bool AuditTailServer::start(AuditStore *, const char *) { return false; }
+
+void AuditTailServer::stop() {}
+
+#else
+
+static bool set_nonblocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static bool would_block() {
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+// Send from [*off, end) of `file_fd` as much as the socket takes
+static ssize_t send_range(int sock, int file_fd, uint64_t *off,
+                          uint64_t end) {
+  size_t len = (size_t)std::min<uint64_t>(end - *off, 1 << 20);
+#ifdef __linux__
+  off_t pos = (off_t)*off;
+  ssize_t n = sendfile(sock, file_fd, &pos, len);
+#else
+  char buf[64 << 10];
+  ssize_t n = pread(file_fd, buf, std::min(len, sizeof(buf)), (off_t)*off);
+  if (n > 0)
+    n = send(sock, buf, (size_t)n, MSG_NOSIGNAL);
+#endif
+  if (n > 0)
+    *off += (uint64_t)n;
+  return n;
+}
+
+bool AuditTailServer::start(AuditStore *store, const char *socket_path) {
+  stop();
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (!store || !socket_path || strlen(socket_path) >= sizeof(addr.sun_path))
+    return false;
+  strcpy(addr.sun_path, socket_path);
+
+  // Replace a socket left by a crash, but not one another process is
+  // serving, and never some other file
+  struct stat st;
+  if (lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool live = probe >= 0 && connect(probe, (sockaddr *)&addr,
+                                      sizeof(addr)) == 0;
+    if (probe >= 0)
+      close(probe);
+    if (live)
+      return false;
+    unlink(socket_path);
+  }
+
+  m_listen = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (m_listen < 0 || bind(m_listen, (sockaddr *)&addr, sizeof(addr)) != 0) {
+    stop();
+    return false;
+  }
+  m_path = socket_path;
+  // Nobody can connect before listen(), so this leaves no window
+  if (chmod(socket_path, 0600) != 0 || listen(m_listen, 16) != 0 ||
+      !set_nonblocking(m_listen) || pipe(m_wake) != 0 ||
+      !set_nonblocking(m_wake[0])) {
+    stop();
+    return false;
+  }
+
+  m_store = store;
+  m_stop = false;
+  m_thread = std::thread(&AuditTailServer::serve, this);
+  return true;
+}
+
+void AuditTailServer::stop() {
+  if (m_thread.joinable()) {
+    m_stop = true;
+    ssize_t woken = write(m_wake[1], "x", 1);
+    (void)woken;
+    m_thread.join();
+  }
+  for (auto &sub : m_subs)
+    drop(sub.get());
+  m_subs.clear();
+  for (int fd : {m_listen, m_wake[0], m_wake[1]})
+    if (fd >= 0)
+      close(fd);
+  m_listen = m_wake[0] = m_wake[1] = -1;
+  if (!m_path.empty())
+    unlink(m_path.c_str());
+  m_path.clear();
+  m_store = nullptr;
+}
+
+void AuditTailServer::drop(Subscriber *sub) {
+  if (sub->fd >= 0)
+    close(sub->fd);
+  if (sub->file_fd >= 0)
+    close(sub->file_fd);
+  sub->fd = sub->file_fd = -1;
+}
+
+void AuditTailServer::serve() {
+  std::vector<pollfd> fds;
+  while (!m_stop) {
+    // Subscribers with credit and nothing in flight need new events: right
+    // away if they are behind, otherwise after a short wait
+    uint64_t written_end = m_store->count() + 1;
+    int timeout = -1;
+    fds.clear();
+    fds.push_back(pollfd{m_wake[0], POLLIN, 0});
+    fds.push_back(pollfd{m_listen, POLLIN, 0});
+    for (auto &sub : m_subs) {
+      bool sending =
+          sub->out_sent < sub->out.size() || sub->file_off < sub->file_end;
+      fds.push_back(
+          pollfd{sub->fd, (short)(POLLIN | (sending ? POLLOUT : 0)), 0});
+      if (!sending && sub->subscribed && sub->credit > 0)
+        timeout = sub->next_id < written_end
+                      ? 0
+                      : (timeout < 0 ? AUDIT_TAIL_POLL_MS : timeout);
+    }
+
+    if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR)
+      break;
+    if (fds[0].revents & POLLIN) {
+      char buf[64];
+      while (read(m_wake[0], buf, sizeof(buf)) > 0) {
+      }
+    }
+
+    // fds[i + 2] belongs to m_subs[i]
+    for (size_t i = 0; i < m_subs.size(); i++) {
+      Subscriber *sub = m_subs[i].get();
+      bool ok = true;
+      if (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR))
+        ok = read_commands(sub);
+      if (!ok || !pump(sub))
+        drop(sub);
+    }
+    m_subs.erase(std::remove_if(m_subs.begin(), m_subs.end(),
+                                [](const std::unique_ptr<Subscriber> &sub) {
+                                  return sub->fd < 0;
+                                }),
+                 m_subs.end());
+
+    if (fds[1].revents & POLLIN) {
+      int fd;
+      while ((fd = accept(m_listen, nullptr, nullptr)) >= 0) {
+        if (m_subs.size() >= AUDIT_TAIL_MAX_CLIENTS || !set_nonblocking(fd)) {
+          close(fd);
+          continue;
+        }
+        std::unique_ptr<Subscriber> sub(new Subscriber());
+        sub->fd = fd;
+        sub->subscribed = sub->binary = false;
+        sub->next_id = sub->credit = 0;
+        sub->out_sent = 0;
+        sub->file_fd = -1;
+        sub->file_off = sub->file_end = 0;
+        m_subs.push_back(std::move(sub));
+      }
+    }
+  }
+}
+
+// False if the peer hung up or sent something that is not a command
+bool AuditTailServer::read_commands(Subscriber *sub) {
+  char buf[512];
+  ssize_t n = recv(sub->fd, buf, sizeof(buf), 0);
+  if (n == 0)
+    return false;
+  if (n < 0)
+    return would_block();
+
+  sub->request.append(buf, (size_t)n);
+  size_t newline;
+  while ((newline = sub->request.find('\n')) != std::string::npos) {
+    std::string line = sub->request.substr(0, newline);
+    sub->request.erase(0, newline + 1);
+    if (!command(sub, line)) {
+      send(sub->fd, "ERR\n", 4, MSG_NOSIGNAL);
+      return false;
+    }
+  }
+  return sub->request.size() <= 256;
+}
+
+bool AuditTailServer::command(Subscriber *sub, const std::string &line) {
+  char from[32], format[16];
+  unsigned long long n;
+  if (sub->subscribed && sscanf(line.c_str(), "CREDIT %llu", &n) == 1) {
+    sub->credit = std::min<uint64_t>(sub->credit + n, 1ull << 40);
+    return true;
+  }
+  if (sub->subscribed ||
+      sscanf(line.c_str(), "SUBSCRIBE %31s %15s %llu", from, format, &n) != 3)
+    return false;
+
+  if (strcmp(format, "binary") == 0)
+    sub->binary = true;
+  else if (strcmp(format, "ndjson") != 0)
+    return false;
+  if (strcmp(from, "now") == 0) {
+    sub->next_id = m_store->count() + 1;
+  } else {
+    char *end;
+    sub->next_id = strtoull(from, &end, 10);
+    if (*end || sub->next_id == 0)
+      return false;
+  }
+  sub->credit = std::min<uint64_t>(n, 1ull << 40);
+  sub->subscribed = true;
+  sub->out = "OK " + std::to_string(sub->next_id) + "\n";
+  sub->out_sent = 0;
+  return true;
+}
+
+// Take the next batch off the store; false when caught up
+bool AuditTailServer::fill(Subscriber *sub) {
+  AuditTailRange range;
+  if (!m_store->tail_range(sub->next_id,
+                           std::min<uint64_t>(sub->credit, AUDIT_TAIL_BATCH),
+                           &range))
+    return false;
+  uint64_t first = sub->next_id;
+  sub->next_id += range.events;
+
+  if (sub->binary && !range.path.empty() && sub->file_path != range.path) {
+    if (sub->file_fd >= 0)
+      close(sub->file_fd);
+    sub->file_fd = open(range.path.c_str(), O_RDONLY);
+    sub->file_path = sub->file_fd >= 0 ? range.path : std::string();
+  }
+  if (sub->binary && !range.path.empty() && sub->file_path == range.path) {
+    // The fd keeps the data readable even if the segment is compressed
+    // and removed meanwhile
+    sub->file_off = range.offset;
+    sub->file_end = range.offset + range.length;
+    sub->credit -= range.events;
+    return true;
+  }
+
+  // NDJSON, or records that are only in a compressed segment
+  sub->out.clear();
+  sub->out_sent = 0;
+  std::string event;
+  for (uint64_t id = first; id < sub->next_id; id++) {
+    if (sub->binary ? m_store->record_bytes(id, &event)
+                    : m_store->event_json(id, &event)) {
+      sub->out += event;
+      if (!sub->binary)
+        sub->out += '\n';
+      sub->credit--;
+    }
+  }
+  return true;
+}
+
+// Send what is pending and refill a few times; false if the peer is gone
+bool AuditTailServer::pump(Subscriber *sub) {
+  for (int round = 0; round < 4; round++) {
+    while (sub->out_sent < sub->out.size()) {
+      ssize_t n = send(sub->fd, sub->out.data() + sub->out_sent,
+                       sub->out.size() - sub->out_sent, MSG_NOSIGNAL);
+      if (n < 0)
+        return would_block();
+      sub->out_sent += (size_t)n;
+    }
+    while (sub->file_off < sub->file_end) {
+      ssize_t n =
+          send_range(sub->fd, sub->file_fd, &sub->file_off, sub->file_end);
+      if (n < 0)
+        return would_block();
+      if (n == 0)
+        return false; // shorter than the store says
+    }
+    if (!sub->subscribed || sub->credit == 0 || !fill(sub))
+      return true;
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "audit_store.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// --- Audit Tail Subscriptions ---
+// Local consumers (a SIEM forwarder, `audit_viewer.py tail`) follow the
+// native audit log over a Unix socket instead of polling. A client sends
+//
+//   SUBSCRIBE <event_id|now> <ndjson|binary> <credit>\n
+//
+// and gets "OK <first event id>\n", then one event per record written
+// from there on. Each record uses up one credit; "CREDIT <n>\n" grants more.
+// Records are read back from the segment files, so a consumer out of
+// credit just falls behind: the writer never waits for it and nothing is
+// held for it beyond one batch.
+//
+//   ndjson  one event_json() object per line
+//   binary  records as stored, [AuditRecordHeader][AuditRecordBody][payload]
+//           (attributes are symbol IDs from symbols.dat, details per
+//           details_codec.h), sent with sendfile() straight from the .aud
+//           file; compressed segments are decoded first
+//
+// POSIX only. The socket is created with owner-only permissions.
+// sendfile() to a peer that has gone away raises SIGPIPE, which Python
+// ignores.
+
+const size_t AUDIT_TAIL_BATCH = 1024;  // records per read from the store
+const int AUDIT_TAIL_POLL_MS = 20;     // new-event check while caught up
+const size_t AUDIT_TAIL_MAX_CLIENTS = 64;
+
+//
+// AuditTailServer - streams an AuditStore to socket subscribers
+//
+class AuditTailServer {
+private:
+  struct Subscriber {
+    int fd;
+    bool subscribed;
+    bool binary;
+    uint64_t next_id;
+    uint64_t credit;
+    std::string request; // partial command line
+    std::string out;     // copied bytes not yet sent
+    size_t out_sent;
+    int file_fd; // segment being sent from with sendfile()
+    std::string file_path;
+    uint64_t file_off;
+    uint64_t file_end;
+  };
+
+  AuditStore *m_store;
+  std::string m_path;
+  int m_listen;
+  int m_wake[2];
+  std::thread m_thread;
+  std::atomic<bool> m_stop;
+  std::vector<std::unique_ptr<Subscriber>> m_subs;
+
+  void serve();
+  void drop(Subscriber *sub);
+  bool read_commands(Subscriber *sub);
+  bool command(Subscriber *sub, const std::string &line);
+  bool fill(Subscriber *sub);
+  bool pump(Subscriber *sub);
+
+public:
+  AuditTailServer();
+  ~AuditTailServer();
+
+  AuditTailServer(const AuditTailServer &) = delete;
+  AuditTailServer &operator=(const AuditTailServer &) = delete;
+
+  // Listen on `socket_path`, replacing a stale socket left there
+  bool start(AuditStore *store, const char *socket_path);
+
+  // Disconnect subscribers and remove the socket
+  void stop();
+};
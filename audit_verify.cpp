@@ -0,0 +1,333 @@
+/*
+ * Audit Log Verifier
+ *
+ * Checks a native audit directory (see audit_store.h) against its hash
+ * chain (see audit_chain.h) without opening it for writing. The chain.log
+ * links are checked first; then segments are spread across threads, each
+ * reading its records (.aud or compressed .z), rebuilding every batch's
+ * Merkle root with sha256_many() and comparing it with the commit. Every
+ * committed batch must be found exactly once.
+ *
+ * Usage: audit_verify <audit_dir> [--threads N]
+ */
+
+#include "audit_chain.h"
+#include "audit_compress.h"
+#include "audit_store.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct VerifyOptions {
+  std::string dir;
+  unsigned threads;
+};
+
+struct SegmentFile {
+  uint32_t id;
+  std::string path;
+  bool compressed;
+};
+
+struct VerifyResult {
+  uint64_t records;
+  uint64_t uncommitted; // newer than the last commit
+  uint64_t bytes;
+  std::vector<uint64_t> good_batches;
+  std::vector<std::string> errors;
+};
+
+static std::string hex32(const uint8_t *bytes) {
+  static const char digits[] = "0123456789abcdef";
+  std::string out;
+  for (int i = 0; i < 32; i++) {
+    out += digits[bytes[i] >> 4];
+    out += digits[bytes[i] & 15];
+  }
+  return out;
+}
+
+// --- Chain ---
+
+static bool load_commits(const std::string &path,
+                         std::vector<AuditCommit> *out) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  AuditCommit commit;
+  while (fread(&commit, 1, sizeof(commit), f) == sizeof(commit))
+    out->push_back(commit);
+  fclose(f);
+  return true;
+}
+
+// Index of the first commit that does not follow from the one before, or
+// commits.size() if the chain is intact
+static size_t check_links(const std::vector<AuditCommit> &commits) {
+  uint8_t prev[32] = {0};
+  uint64_t next_id = 0;
+  for (size_t i = 0; i < commits.size(); i++) {
+    AuditCommit c = commits[i];
+    if (c.marker != AUDIT_COMMIT_MARKER || c.batch != i || c.count == 0 ||
+        c.count > AUDIT_COMMIT_MAX_EVENTS || c.first_event_id < next_id ||
+        audit_commit_check(c) != c.check)
+      return i;
+    audit_chain_link(prev, &c);
+    if (memcmp(c.chain, commits[i].chain, 32) != 0)
+      return i;
+    memcpy(prev, c.chain, 32);
+    next_id = c.first_event_id + c.count;
+  }
+  return commits.size();
+}
+
+// --- Segments ---
+
+// Calls `fn(body, payload)` for each intact record of a raw segment image
+template <typename Fn>
+static void for_each_record(const char *data, size_t size, size_t pos,
+                            Fn fn) {
+  while (size - pos >= sizeof(AuditRecordHeader) + sizeof(AuditRecordBody)) {
+    AuditRecordHeader rh;
+    AuditRecordBody body;
+    memcpy(&rh, data + pos, sizeof(rh));
+    memcpy(&body, data + pos + sizeof(rh), sizeof(body));
+    if (rh.marker != AUDIT_RECORD_MARKER ||
+        rh.length != sizeof(body) + body.details_len ||
+        rh.length > size - pos - sizeof(rh))
+      return;
+    fn(body, data + pos + sizeof(rh) + sizeof(body));
+    pos += sizeof(rh) + rh.length;
+  }
+}
+
+//
+// BatchChecker - regroups a segment's records into their commit batches
+//
+class BatchChecker {
+private:
+  const std::vector<AuditCommit> &m_commits;
+  uint64_t m_committed_end; // first ID past the last commit
+  VerifyResult *m_result;
+  const AuditCommit *m_batch;
+  std::vector<std::string> m_inputs;
+
+  const AuditCommit *find(uint64_t event_id) const {
+    auto it = std::upper_bound(
+        m_commits.begin(), m_commits.end(), event_id,
+        [](uint64_t id, const AuditCommit &c) { return id < c.first_event_id; });
+    if (it == m_commits.begin() || event_id >= (it - 1)->first_event_id +
+                                                   (it - 1)->count)
+      return nullptr;
+    return &*(it - 1);
+  }
+
+  void error(const char *what, uint64_t event_id) {
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%s (event %llu)", what,
+             (unsigned long long)event_id);
+    m_result->errors.push_back(msg);
+  }
+
+public:
+  BatchChecker(const std::vector<AuditCommit> &commits, VerifyResult *result)
+      : m_commits(commits), m_result(result), m_batch(nullptr) {
+    m_committed_end =
+        commits.empty() ? 1 : commits.back().first_event_id + commits.back().count;
+  }
+
+  void add(const AuditRecordBody &body, const char *payload) {
+    m_result->records++;
+    const AuditCommit *batch = find(body.event_id);
+    if (batch != m_batch)
+      finish();
+    if (!batch) {
+      if (body.event_id >= m_committed_end)
+        m_result->uncommitted++;
+      else
+        error("record outside every batch", body.event_id);
+      return;
+    }
+    // A record in the wrong place still counts, so its batch fails once
+    m_batch = batch;
+    m_inputs.emplace_back();
+    audit_leaf_input(&body, sizeof(body), payload, body.details_len,
+                     &m_inputs.back());
+  }
+
+  void finish() {
+    if (!m_batch)
+      return;
+    std::vector<AuditDigest> leaves;
+    AuditDigest root;
+    audit_leaf_hashes(m_inputs, &leaves);
+    audit_merkle_root(leaves, &root);
+    if (m_inputs.size() != m_batch->count)
+      error("batch incomplete", m_batch->first_event_id);
+    else if (memcmp(root.bytes, m_batch->root, 32) != 0)
+      error("batch root mismatch", m_batch->first_event_id);
+    else
+      m_result->good_batches.push_back(m_batch->batch);
+    m_batch = nullptr;
+    m_inputs.clear();
+  }
+};
+
+static void verify_segment(const SegmentFile &seg,
+                           const std::vector<AuditCommit> &commits,
+                           VerifyResult *result) {
+  BatchChecker checker(commits, result);
+  auto add = [&](const AuditRecordBody &body, const char *payload) {
+    checker.add(body, payload);
+  };
+
+  if (seg.compressed) {
+    CompressedSegment z;
+    if (!z.open(seg.path.c_str())) {
+      result->errors.push_back("cannot open " + seg.path);
+      return;
+    }
+    result->bytes += z.file_bytes();
+    for (size_t i = 0; i < z.frame_count(); i++) {
+      const std::string *frame;
+      if (!z.load_frame(i, &frame)) {
+        result->errors.push_back("damaged frame in " + seg.path);
+        break;
+      }
+      for_each_record(frame->data(), frame->size(), 0, add);
+    }
+  } else {
+    FILE *f = fopen(seg.path.c_str(), "rb");
+    std::vector<char> data;
+    if (f) {
+      fseek(f, 0, SEEK_END);
+      data.resize((size_t)ftell(f));
+      rewind(f);
+      if (fread(data.data(), 1, data.size(), f) != data.size())
+        data.clear();
+      fclose(f);
+    }
+    if (data.size() < sizeof(AuditSegmentHeader) ||
+        memcmp(data.data(), AUDIT_SEGMENT_MAGIC, 8) != 0) {
+      result->errors.push_back("cannot read " + seg.path);
+      return;
+    }
+    result->bytes += data.size();
+    for_each_record(data.data(), data.size(), sizeof(AuditSegmentHeader), add);
+  }
+  checker.finish();
+}
+
+// --- Main ---
+
+static int usage() {
+  fprintf(stderr, "Usage: audit_verify <audit_dir> [--threads N]\n");
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2)
+    return usage();
+
+  VerifyOptions opts;
+  opts.dir = argv[1];
+  opts.threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+      opts.threads = (unsigned)std::max(1, atoi(argv[++i]));
+    else
+      return usage();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<AuditCommit> commits;
+  if (!load_commits(opts.dir + "/chain.log", &commits)) {
+    fprintf(stderr, "Error: cannot read %s/chain.log\n", opts.dir.c_str());
+    return 1;
+  }
+  size_t broken = check_links(commits);
+
+  // Segments are numbered from 1 without gaps, each .z or .aud
+  std::vector<SegmentFile> segments;
+  for (uint32_t id = 1;; id++) {
+    char name[32];
+    SegmentFile seg;
+    seg.id = id;
+    seg.compressed = true;
+    snprintf(name, sizeof(name), "/seg-%08u.z", id);
+    seg.path = opts.dir + name;
+    FILE *probe = fopen(seg.path.c_str(), "rb");
+    if (!probe) {
+      seg.compressed = false;
+      snprintf(name, sizeof(name), "/seg-%08u.aud", id);
+      seg.path = opts.dir + name;
+      probe = fopen(seg.path.c_str(), "rb");
+    }
+    if (!probe)
+      break;
+    fclose(probe);
+    segments.push_back(seg);
+  }
+
+  std::vector<VerifyResult> results(segments.size());
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  unsigned threads = (unsigned)std::min<size_t>(opts.threads, segments.size());
+  for (unsigned t = 0; t < threads; t++)
+    workers.emplace_back([&] {
+      for (size_t i; (i = next++) < segments.size();)
+        verify_segment(segments[i], commits, &results[i]);
+    });
+  for (std::thread &w : workers)
+    w.join();
+
+  uint64_t records = 0, uncommitted = 0, bytes = 0, good = 0;
+  std::vector<uint8_t> seen(commits.size(), 0);
+  std::vector<std::string> errors;
+  for (const VerifyResult &r : results) {
+    records += r.records;
+    uncommitted += r.uncommitted;
+    bytes += r.bytes;
+    for (uint64_t b : r.good_batches)
+      if (b < seen.size() && seen[b]++ == 0)
+        good++;
+    errors.insert(errors.end(), r.errors.begin(), r.errors.end());
+  }
+  for (size_t b = 0; b < commits.size(); b++)
+    if (seen[b] != 1 && b < broken)
+      errors.push_back("batch " + std::to_string(b) +
+                       (seen[b] ? " found twice" : " not verified"));
+
+  double secs = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  printf("audit_verify: %zu segments, %.1f MB, %u threads, %.2fs (%.0f MB/s)\n",
+         segments.size(), bytes / 1048576.0, threads, secs,
+         bytes / 1048576.0 / std::max(secs, 1e-9));
+  if (broken < commits.size())
+    printf("  chain: BROKEN at batch %zu of %zu\n", broken, commits.size());
+  else if (!commits.empty())
+    printf("  chain: %zu batches, head %s\n", commits.size(),
+           hex32(commits.back().chain).c_str());
+  else
+    printf("  chain: empty\n");
+  printf("  records: %llu, %llu of %zu batches verified, %llu uncommitted\n",
+         (unsigned long long)records, (unsigned long long)good,
+         commits.size(), (unsigned long long)uncommitted);
+  for (size_t i = 0; i < errors.size() && i < 20; i++)
+    printf("  error: %s\n", errors[i].c_str());
+  if (errors.size() > 20)
+    printf("  ... %zu more errors\n", errors.size() - 20);
+
+  bool ok = broken == commits.size() && errors.empty();
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
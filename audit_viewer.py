@@ -5,7 +5,12 @@ Command-line tool to view and analyze audit logs and intrusion alerts.
 """
 
 import audit_log
+import json
+import os
+import platform
+import subprocess
 import sys
+import tempfile
 from datetime import datetime
 
 
@@ -165,6 +170,55 @@ def resolve_alert_interactive():
         print_colored("\n❌ Invalid input!", "red")
 
 
+def replay_history(source=None, alerts_file=None,
+                   failed_threshold=audit_log.FAILED_ATTEMPTS_THRESHOLD,
+                   window_minutes=audit_log.TIME_WINDOW_MINUTES,
+                   rapid_threshold=audit_log.RAPID_ATTEMPTS_THRESHOLD):
+    """Replay recorded history through intrusion detection with the given
+    thresholds (see audit_replay.cpp) and print the alerts that would have
+    fired. `source` defaults to the native segments if present, else the
+    database. Returns False if the tool is missing or fails."""
+    if source is None:
+        native = os.path.isdir(audit_log.AUDIT_SEGMENT_DIR)
+        source = audit_log.AUDIT_SEGMENT_DIR if native else audit_log.AUDIT_DB
+    exe = "audit_replay.exe" if platform.system() == "Windows" else "audit_replay"
+    exe = os.path.join(os.path.dirname(os.path.abspath(__file__)), exe)
+    if not os.path.exists(exe):
+        print_colored("audit_replay not built - run build.py", "red")
+        return False
+
+    cmd = [exe, source, "--failed-threshold", str(failed_threshold),
+           "--window-minutes", str(window_minutes),
+           "--rapid-threshold", str(rapid_threshold)]
+    rules_path = None
+    if audit_log.INTRUSION_SEQUENCES:
+        with tempfile.NamedTemporaryFile("w", suffix=".rules",
+                                         delete=False) as f:
+            for name, (_, steps, _) in audit_log.INTRUSION_SEQUENCES.items():
+                f.write(f"{name}: {steps}\n")
+            rules_path = f.name
+        cmd += ["--rules", rules_path]
+    if alerts_file:
+        cmd += ["--alerts", alerts_file]
+    try:
+        ok = subprocess.call(cmd) == 0
+    finally:
+        if rules_path:
+            os.remove(rules_path)
+
+    # Sequence rules come back without a severity; take it from the config
+    if ok and alerts_file:
+        with open(alerts_file) as f:
+            alerts = [json.loads(line) for line in f]
+        with open(alerts_file, "w") as f:
+            for alert in alerts:
+                rule = audit_log.INTRUSION_SEQUENCES.get(alert["alert_type"])
+                if alert["severity"] is None and rule:
+                    alert["severity"] = rule[0]
+                f.write(json.dumps(alert) + "\n")
+    return ok
+
+
 def main_menu():
     """Main interactive menu"""
     while True:
@@ -209,16 +263,37 @@ if __name__ == "__main__":
             show_alerts()
         elif command == "user" and len(sys.argv) > 2:
             show_user_activity(sys.argv[2])
+        elif command == "tail":
+            start = sys.argv[2] if len(sys.argv) > 2 else "now"
+            try:
+                for event in audit_log.tail_events(start):
+                    print(f"{event['timestamp']}  {event['username']:<16} "
+                          f"{event['event_type']:<14} {event['status']:<8} "
+                          f"{event.get('ip_address') or ''}")
+            except KeyboardInterrupt:
+                pass
         elif command == "export":
             filename = sys.argv[2] if len(sys.argv) > 2 else "audit_export.json"
             audit_log.export_audit_log(filename)
             print(f"Exported to: {filename}")
+        elif command == "replay":
+            # replay [source] [failed_threshold] [window_minutes] [alerts_file]
+            args = sys.argv[2:]
+            ok = replay_history(
+                args[0] if len(args) > 0 else None,
+                args[3] if len(args) > 3 else None,
+                int(args[1]) if len(args) > 1 else audit_log.FAILED_ATTEMPTS_THRESHOLD,
+                int(args[2]) if len(args) > 2 else audit_log.TIME_WINDOW_MINUTES)
+            sys.exit(0 if ok else 1)
         else:
             print("Usage:")
             print("  python audit_viewer.py summary")
             print("  python audit_viewer.py alerts")
             print("  python audit_viewer.py user <username>")
             print("  python audit_viewer.py export [filename]")
+            print("  python audit_viewer.py tail [event_id]")
+            print("  python audit_viewer.py replay [db_or_dir] [failed_threshold] "
+                  "[window_minutes] [alerts_file]")
     else:
         # Interactive mode
         main_menu()
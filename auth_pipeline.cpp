@@ -0,0 +1,114 @@
+#include "auth_pipeline.h"
+
+#include <memory>
+#include <shared_mutex>
+
+template class AuthPipeline<SqliteBackend>;
+template class AuthPipeline<ShmIndexBackend>;
+template class AuthPipeline<SnapshotBackend>;
+template class AuthPipeline<TieredBackend>;
+
+// --- Exported Functions for Python ---
+
+// The open pipeline: at most one of these is set, the one g_backend names.
+// Calls share the lock; only open/close replace the pipeline.
+static int g_backend = -1;
+static std::unique_ptr<AuthPipeline<SqliteBackend>> g_sqlite;
+static std::unique_ptr<AuthPipeline<ShmIndexBackend>> g_shm_index;
+static std::unique_ptr<AuthPipeline<SnapshotBackend>> g_snapshot;
+static std::unique_ptr<AuthPipeline<TieredBackend>> g_tiered;
+static std::shared_mutex g_pipeline_lock;
+
+static void reset_pipelines() {
+  g_backend = -1;
+  g_sqlite.reset();
+  g_shm_index.reset();
+  g_snapshot.reset();
+  g_tiered.reset();
+}
+
+// Run `fn` on the open pipeline's own instantiation (caller holds the lock)
+template <typename Fn> static bool with_pipeline(Fn &&fn) {
+  switch (g_backend) {
+  case AUTH_BACKEND_SQLITE:
+    return fn(*g_sqlite);
+  case AUTH_BACKEND_SHM_INDEX:
+    return fn(*g_shm_index);
+  case AUTH_BACKEND_SNAPSHOT:
+    return fn(*g_snapshot);
+  case AUTH_BACKEND_TIERED:
+    return fn(*g_tiered);
+  }
+  return false;
+}
+
+extern "C" {
+
+bool auth_pipeline_open(int backend, const char *source, const char *db_path,
+                        uint64_t budget_bytes) {
+  // Opened outside the lock: mapping and indexing can take a while
+  std::unique_ptr<AuthPipeline<SqliteBackend>> sqlite;
+  std::unique_ptr<AuthPipeline<ShmIndexBackend>> shm_index;
+  std::unique_ptr<AuthPipeline<SnapshotBackend>> snapshot;
+  std::unique_ptr<AuthPipeline<TieredBackend>> tiered;
+
+  switch (backend) {
+  case AUTH_BACKEND_SQLITE:
+    sqlite.reset(new AuthPipeline<SqliteBackend>());
+    if (!db_path || !sqlite->store().open(db_path))
+      return false;
+    break;
+  case AUTH_BACKEND_SHM_INDEX:
+    shm_index.reset(new AuthPipeline<ShmIndexBackend>());
+    if (!source || !shm_index->store().open(source))
+      return false;
+    break;
+  case AUTH_BACKEND_SNAPSHOT:
+    snapshot.reset(new AuthPipeline<SnapshotBackend>());
+    if (!source || !snapshot->store().open(source))
+      return false;
+    break;
+  case AUTH_BACKEND_TIERED:
+    tiered.reset(new AuthPipeline<TieredBackend>(budget_bytes));
+    if ((!source && !db_path) || !tiered->store().open(source, db_path))
+      return false;
+    break;
+  default:
+    return false;
+  }
+
+  std::unique_lock<std::shared_mutex> guard(g_pipeline_lock);
+  reset_pipelines();
+  g_sqlite = std::move(sqlite);
+  g_shm_index = std::move(shm_index);
+  g_snapshot = std::move(snapshot);
+  g_tiered = std::move(tiered);
+  g_backend = backend;
+  return true;
+}
+
+void auth_pipeline_close() {
+  std::unique_lock<std::shared_mutex> guard(g_pipeline_lock);
+  reset_pipelines();
+}
+
+int auth_pipeline_backend() {
+  std::shared_lock<std::shared_mutex> guard(g_pipeline_lock);
+  return g_backend;
+}
+
+bool pipeline_validate_login(const char *username, const char *password) {
+  std::shared_lock<std::shared_mutex> guard(g_pipeline_lock);
+  return with_pipeline([username, password](auto &pipeline) {
+    return pipeline.validate_login(username, password);
+  });
+}
+
+bool pipeline_validate_totp(const char *username, int user_code) {
+  time_t now = std::time(0);
+  std::shared_lock<std::shared_mutex> guard(g_pipeline_lock);
+  return with_pipeline([username, user_code, now](auto &pipeline) {
+    return pipeline.validate_totp(username, user_code, now);
+  });
+}
+}
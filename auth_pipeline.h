@@ -0,0 +1,218 @@
+#pragma once
+
+#include "credential_loader.h"
+#include "credential_snapshot.h"
+#include "credential_store.h"
+#include "shm_index.h"
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <type_traits>
+#include <utility>
+
+// --- Auth Pipeline ---
+// One native login path over any credential backend. AuthPipeline is a
+// template on the backend, constrained by the CredentialStore concept: it
+// bounds and hashes the username, fetches the user's credentials, checks
+// the password or TOTP code and wipes what it fetched. Each backend gets
+// its own instantiation, so every call below is resolved at compile time -
+// no virtual dispatch; the adapter is inlined and calls the backend
+// directly.
+//
+// The instantiations for the four backends are compiled once in
+// auth_pipeline.cpp and exported behind one C API; it switches on the open
+// backend once per call, the way totp_verify() switches on a policy.
+
+// Same limit as validate_login() in auth_core.cpp
+const size_t AUTH_MAX_INPUT_LENGTH = 50;
+
+enum AuthBackend : int {
+  AUTH_BACKEND_SQLITE = 0,    // users.db through the lazy key index
+  AUTH_BACKEND_SHM_INDEX = 1, // shared-memory index published by a writer
+  AUTH_BACKEND_SNAPSHOT = 2,  // memory-mapped snapshot file
+  AUTH_BACKEND_TIERED = 3,    // hot tier in front of a snapshot or users.db
+  AUTH_BACKEND_COUNT
+};
+
+//
+// CredentialStore - what the pipeline needs from a backend
+//
+// `Credential` is whatever a lookup hands out: a copy of the user's
+// SnapshotRecord, or a HotEntry with the TOTP key already precomputed. It
+// is wiped after each check, so it must be trivially copyable.
+//
+template <typename S>
+concept CredentialStore =
+    std::is_trivially_copyable_v<typename S::Credential> &&
+    requires(S &store, const char *username, size_t len, uint64_t key_hash,
+             typename S::Credential *out, const typename S::Credential &cred,
+             const char *password, int code, time_t now) {
+      // `username` is `len` bytes, key_hash is fnv1a64 of them
+      { store.lookup(username, len, key_hash, out) } -> std::same_as<bool>;
+      { S::password_ok(cred, password) } -> std::same_as<bool>;
+      { S::totp_ok(cred, code, now) } -> std::same_as<bool>;
+    };
+
+// --- Backends ---
+
+// Checks shared by the backends that hand out a SnapshotRecord
+struct RecordCredentials {
+  typedef SnapshotRecord Credential;
+
+  static bool password_ok(const SnapshotRecord &rec, const char *password) {
+    return password_matches(rec.password_sha256, password);
+  }
+  static bool totp_ok(const SnapshotRecord &rec, int code, time_t now) {
+    return totp_matches(rec, code, now);
+  }
+};
+
+struct SqliteBackend : RecordCredentials {
+  SqliteCredentialSource source;
+
+  bool open(const char *db_path) { return source.open(db_path); }
+  bool lookup(const char *username, size_t len, uint64_t key_hash,
+              SnapshotRecord *out) {
+    return source.fetch(username, len, key_hash, out);
+  }
+};
+
+struct ShmIndexBackend : RecordCredentials {
+  ShmCredentialIndex index;
+
+  // Read-only view of a segment some writer process publishes
+  bool open(const char *segment_name) { return index.attach(segment_name); }
+  bool lookup(const char *username, size_t len, uint64_t key_hash,
+              SnapshotRecord *out) {
+    return index.find(username, len, key_hash, out);
+  }
+};
+
+struct SnapshotBackend : RecordCredentials {
+  SnapshotView view;
+
+  bool open(const char *snapshot_path) {
+    return view.open(snapshot_path, true);
+  }
+  bool lookup(const char *username, size_t len, uint64_t key_hash,
+              SnapshotRecord *out) const {
+    const SnapshotRecord *rec = view.find(username, len, key_hash);
+    if (!rec)
+      return false;
+    *out = *rec;
+    return true;
+  }
+};
+
+struct TieredBackend {
+  typedef HotEntry Credential;
+  TieredStore store;
+
+  explicit TieredBackend(uint64_t budget_bytes) : store(budget_bytes) {}
+
+  // Over a snapshot (with users.db, if given, for newer registrations), or
+  // over users.db alone when there is no snapshot
+  bool open(const char *snapshot_path, const char *db_path) {
+    return snapshot_path ? store.open(snapshot_path, db_path)
+                         : store.open_db(db_path);
+  }
+  bool lookup(const char *username, size_t len, uint64_t key_hash,
+              HotEntry *out) {
+    return store.lookup(username, len, key_hash, out);
+  }
+  static bool password_ok(const HotEntry &entry, const char *password) {
+    return password_matches(entry.password_sha256, password);
+  }
+  static bool totp_ok(const HotEntry &entry, int code, time_t now) {
+    return totp_verify(entry.totp_key, code, now);
+  }
+};
+
+static_assert(CredentialStore<SqliteBackend>);
+static_assert(CredentialStore<ShmIndexBackend>);
+static_assert(CredentialStore<SnapshotBackend>);
+static_assert(CredentialStore<TieredBackend>);
+
+//
+// AuthPipeline - login and TOTP checks against one backend
+//
+template <CredentialStore Store> class AuthPipeline {
+private:
+  typedef typename Store::Credential Credential;
+
+  Store m_store;
+
+  static void wipe(Credential *cred) {
+    volatile uint8_t *v = (volatile uint8_t *)cred;
+    for (size_t i = 0; i < sizeof(*cred); i++)
+      v[i] = 0;
+  }
+
+  // Look the user up and apply `check` to their credentials
+  template <typename Check>
+  bool check_user(const char *username, Check &&check) {
+    size_t len = strnlen(username, AUTH_MAX_INPUT_LENGTH);
+    if (len == 0 || len > SNAPSHOT_MAX_USERNAME)
+      return false;
+    Credential cred;
+    bool ok = m_store.lookup(username, len, fnv1a64(username, len), &cred);
+    if (!ok)
+      return false;
+    ok = check(cred);
+    wipe(&cred);
+    return ok;
+  }
+
+public:
+  template <typename... Args>
+  explicit AuthPipeline(Args &&...args)
+      : m_store(std::forward<Args>(args)...) {}
+
+  AuthPipeline(const AuthPipeline &) = delete;
+  AuthPipeline &operator=(const AuthPipeline &) = delete;
+
+  Store &store() { return m_store; }
+
+  bool validate_login(const char *username, const char *password) {
+    return check_user(username, [password](const Credential &cred) {
+      return Store::password_ok(cred, password);
+    });
+  }
+
+  bool validate_totp(const char *username, int code, time_t now) {
+    return check_user(username, [code, now](const Credential &cred) {
+      return Store::totp_ok(cred, code, now);
+    });
+  }
+};
+
+// Compiled once, in auth_pipeline.cpp
+extern template class AuthPipeline<SqliteBackend>;
+extern template class AuthPipeline<ShmIndexBackend>;
+extern template class AuthPipeline<SnapshotBackend>;
+extern template class AuthPipeline<TieredBackend>;
+
+// --- Exported Functions ---
+
+extern "C" {
+
+// Open (or reopen) the pipeline over one backend, replacing any other:
+//   AUTH_BACKEND_SQLITE     `db_path`
+//   AUTH_BACKEND_SHM_INDEX  `source` is the segment name (see shm_index.h)
+//   AUTH_BACKEND_SNAPSHOT   `source` is the snapshot file
+//   AUTH_BACKEND_TIERED     `source` is the snapshot file, or NULL to read
+//                           users.db at `db_path`; `budget_bytes` bounds
+//                           the hot tier
+bool auth_pipeline_open(int backend, const char *source, const char *db_path,
+                        uint64_t budget_bytes);
+void auth_pipeline_close();
+
+// AuthBackend of the open pipeline, -1 if none
+int auth_pipeline_backend();
+
+bool pipeline_validate_login(const char *username, const char *password);
+bool pipeline_validate_totp(const char *username, int user_code);
+}
@@ -0,0 +1,915 @@
+/*
+ * Benchmark Suite
+ *
+ * Standalone measurements of the native backends on synthetic data. Each
+ * subcommand builds its own fixture in a scratch directory and removes it
+ * afterwards.
+ *
+ *   audit-compression  append rate, dictionary-compressed segment size and
+ *                      per-user lookup throughput before/after compression
+ *   audit-bursts       records and bytes written during a brute-force wave,
+ *                      with and without burst aggregation
+ *   audit-recovery     time to reopen the log after a crash left a torn
+ *                      record, and the rebuilt intrusion window
+ *   intrusion-checkpoint  size, save and restore time of a checkpoint of
+ *                      15 minutes of intrusion state
+ *   intrusion-profiles learn and score rate of per-user behavioural
+ *                      profiles, and their checkpointed size per user
+ *   intrusion-sequences  per-event cost of the sequence rules with 3 and 48
+ *                      rules, and how many times they matched
+ *   alert-bus          publish cost of the alert ring alone and with a
+ *                      draining, a slow and a stalled subscriber, and what
+ *                      each of them received
+ *   enforcement        cost of the login-path block check, and time from
+ *                      an alert being published to its block applying
+ *   totp-policies      TOTP check cost for each compiled-in policy, and for
+ *                      the default one with its parameters at run time
+ *   credential-backends  login, TOTP and unknown-user check cost of the auth
+ *                      pipeline over each credential backend (users.db,
+ *                      shared-memory index, snapshot, tiered store), all
+ *                      holding the same users and given the same requests
+ *
+ * Usage: bench_suite <subcommand> [--events N] [--users U]
+ */
+
+#include "alert_bus.h"
+#include "audit_compress.h"
+#include "audit_store.h"
+#include "auth_pipeline.h"
+#include "enforcement.h"
+#include "intrusion_state.h"
+#include "totp_policy.h"
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#define rmdir _rmdir
+#else
+#include <unistd.h>
+#endif
+
+struct BenchOptions {
+  uint64_t events;
+  uint32_t users;
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+static void remove_store_dir(const std::string &dir) {
+  const char *suffixes[] = {"aud", "z", "idx", "rix"};
+  for (uint32_t id = 1;; id++) {
+    bool any = false;
+    for (const char *suffix : suffixes) {
+      char name[32];
+      snprintf(name, sizeof(name), "/seg-%08u.%s", id, suffix);
+      any |= remove((dir + name).c_str()) == 0;
+    }
+    if (!any)
+      break;
+  }
+  remove((dir + "/symbols.dat").c_str());
+  remove((dir + "/chain.log").c_str());
+  remove((dir + "/intrusion.ckpt").c_str());
+  rmdir(dir.c_str());
+}
+
+static uint64_t store_dir_bytes(const std::string &dir) {
+  const char *suffixes[] = {"aud", "z"};
+  uint64_t total = 0;
+  for (uint32_t id = 1;; id++) {
+    bool any = false;
+    for (const char *suffix : suffixes) {
+      char name[32];
+      snprintf(name, sizeof(name), "/seg-%08u.%s", id, suffix);
+      FILE *f = fopen((dir + name).c_str(), "rb");
+      if (!f)
+        continue;
+      fseek(f, 0, SEEK_END);
+      total += (uint64_t)ftell(f);
+      fclose(f);
+      any = true;
+    }
+    if (!any)
+      break;
+  }
+  return total;
+}
+
+// --- Audit Compression ---
+
+// Per-user lookups: query the user's bitmap, then read every event
+static void bench_lookups(AuditStore &store, const BenchOptions &opts,
+                          const char *label) {
+  std::mt19937 rng(7);
+  const int lookups = 1000;
+  uint64_t events = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < lookups; i++) {
+    std::string user = "user" + std::to_string(rng() % opts.users);
+    AuditQuery q;
+    memset(&q, 0, sizeof(q));
+    q.attr[AUDIT_ATTR_USER] = global_symbols().find(user);
+    RoaringBitmap ids;
+    store.query(q, &ids);
+    AuditEvent ev;
+    ids.for_each([&](uint32_t id) { events += store.read(id, &ev); });
+  }
+  double secs = seconds_since(start);
+  printf("  lookups (%s): %.0f users/s, %.0f events/s (%.1f events/user)\n",
+         label, lookups / secs, events / secs, (double)events / lookups);
+}
+
+static int bench_audit_compression(const BenchOptions &opts) {
+  std::string dir = "bench_audit." + std::to_string(getpid());
+  AuditStore store;
+  if (!store.open(dir.c_str())) {
+    fprintf(stderr, "Error: cannot create %s\n", dir.c_str());
+    return 1;
+  }
+
+  // Brute-force waves and normal traffic, shaped like user_db.py's events
+  static const char *const details[] = {
+      "{\"reason\": \"invalid_credentials\"}",
+      "{\"reason\": \"invalid_totp_code\"}",
+      "{\"stage\": \"password_verified\"}",
+      "{\"mfa_completed\": true}",
+      "{\"reason\": \"database_error\", \"error\": \"database is locked\"}",
+  };
+  static const char *const types[] = {"LOGIN", "TOTP"};
+  static const char *const statuses[] = {"FAILURE", "SUCCESS", "FAILURE"};
+  static const char *const risks[] = {"LOW", "MEDIUM", "HIGH"};
+  std::mt19937 rng(42);
+  int64_t ts = 1700000000000;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < opts.events; i++) {
+    std::string user = "user" + std::to_string(rng() % opts.users);
+    std::string ip = "10.0." + std::to_string(rng() % 8) + "." +
+                     std::to_string(rng() % 256);
+    ts += rng() % 2000;
+    if (!store.append_text(ts, user.c_str(), types[rng() % 2],
+                           statuses[rng() % 3], ip.c_str(), risks[rng() % 3],
+                           details[rng() % 5])) {
+      fprintf(stderr, "Error: append failed\n");
+      remove_store_dir(dir);
+      return 1;
+    }
+  }
+  double append_secs = seconds_since(start);
+  printf("audit-compression: %llu events, %u users\n",
+         (unsigned long long)opts.events, opts.users);
+  printf("  append: %.0f events/s\n", opts.events / append_secs);
+  bench_lookups(store, opts, "uncompressed");
+
+  start = std::chrono::steady_clock::now();
+  bool rotated = store.rotate();
+  double rotate_secs = seconds_since(start);
+  store.wait_finished();
+  double seal_secs = seconds_since(start);
+  uint64_t raw = 0, stored = 0;
+  store.storage_bytes(&raw, &stored);
+
+  if (!rotated || !audit_compression_available() || stored == 0) {
+    printf("  compression: unavailable (build with SECUREAUTH_HAVE_ZSTD)\n");
+  } else {
+    printf("  compression: %.2f MB -> %.2f MB (ratio %.1fx), seal %.0f MB/s "
+           "in the background, rotate() %.2f ms\n",
+           raw / 1048576.0, stored / 1048576.0, (double)raw / stored,
+           raw / 1048576.0 / seal_secs, rotate_secs * 1000);
+    bench_lookups(store, opts, "compressed");
+  }
+
+  store.close();
+  remove_store_dir(dir);
+  return 0;
+}
+
+// --- Audit Bursts ---
+
+// 90% of events come from a few attackers each hammering one account from
+// one IP with identical failures; the rest is normal traffic
+static bool run_burst_wave(const BenchOptions &opts, bool aggregate,
+                           const std::string &dir) {
+  AuditStore store;
+  if (!store.open(dir.c_str())) {
+    fprintf(stderr, "Error: cannot create %s\n", dir.c_str());
+    return false;
+  }
+  store.set_aggregation(aggregate);
+
+  const uint32_t attackers = 20;
+  std::mt19937 rng(42);
+  int64_t ts = 1700000000000;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < opts.events; i++) {
+    ts += rng() % 20;
+    bool ok;
+    if (rng() % 10 != 0) {
+      uint32_t a = rng() % attackers;
+      std::string user = "user" + std::to_string(a % opts.users);
+      std::string ip = "203.0.113." + std::to_string(a);
+      ok = store.append_text(ts, user.c_str(), "LOGIN", "FAILURE", ip.c_str(),
+                             "HIGH", "{\"reason\": \"invalid_credentials\"}");
+    } else {
+      std::string user = "user" + std::to_string(rng() % opts.users);
+      std::string ip = "10.0.0." + std::to_string(rng() % 256);
+      ok = store.append_text(ts, user.c_str(), "LOGIN", "SUCCESS", ip.c_str(),
+                             "LOW", "{\"stage\": \"password_verified\"}");
+    }
+    if (!ok) {
+      fprintf(stderr, "Error: append failed\n");
+      return false;
+    }
+  }
+  store.sync();
+  double secs = seconds_since(start);
+
+  AuditQuery q;
+  memset(&q, 0, sizeof(q));
+  uint64_t counted = store.count_events(q);
+  printf("  %-14s %.0f events/s, %llu records, %.2f MB, %llu events counted\n",
+         aggregate ? "aggregated:" : "one per event:", opts.events / secs,
+         (unsigned long long)store.count(),
+         store_dir_bytes(dir) / 1048576.0, (unsigned long long)counted);
+  store.close();
+  return counted == opts.events;
+}
+
+static int bench_audit_bursts(const BenchOptions &opts) {
+  printf("audit-bursts: %llu events, 20 attackers\n",
+         (unsigned long long)opts.events);
+  bool ok = true;
+  for (bool aggregate : {false, true}) {
+    std::string dir = "bench_audit." + std::to_string(getpid());
+    ok &= run_burst_wave(opts, aggregate, dir);
+    remove_store_dir(dir);
+  }
+  if (!ok)
+    fprintf(stderr, "Error: event count mismatch\n");
+  return ok ? 0 : 1;
+}
+
+// --- Audit Recovery ---
+
+static int bench_audit_recovery(const BenchOptions &opts) {
+  std::string dir = "bench_audit." + std::to_string(getpid());
+  int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch())
+                    .count();
+  // One event every 5 ms, ending now, so the last 15 minutes are recent
+  int64_t ts = now - (int64_t)opts.events * 5;
+  {
+    AuditStore store;
+    if (!store.open(dir.c_str())) {
+      fprintf(stderr, "Error: cannot create %s\n", dir.c_str());
+      return 1;
+    }
+    std::mt19937 rng(7);
+    for (uint64_t i = 0; i < opts.events; i++, ts += 5) {
+      std::string user = "user" + std::to_string(rng() % opts.users);
+      std::string details = "{\"attempt\": " + std::to_string(i) + "}";
+      if (!store.append_text(ts, user.c_str(), "LOGIN",
+                             i % 3 ? "FAILURE" : "SUCCESS", "10.0.0.1", "LOW",
+                             details.c_str())) {
+        fprintf(stderr, "Error: append failed\n");
+        remove_store_dir(dir);
+        return 1;
+      }
+    }
+  }
+
+  // A crash halfway through an append: a record header, half a body
+  uint32_t segments = 0;
+  for (char name[32];; segments++) {
+    snprintf(name, sizeof(name), "/seg-%08u", segments + 1);
+    FILE *f = fopen((dir + name + ".aud").c_str(), "rb");
+    if (!f && !(f = fopen((dir + name + ".z").c_str(), "rb")))
+      break;
+    fclose(f);
+  }
+  char name[32];
+  snprintf(name, sizeof(name), "/seg-%08u.aud", segments);
+  FILE *tail = fopen((dir + name).c_str(), "ab");
+  if (tail) {
+    AuditRecordHeader rh = {AUDIT_RECORD_MARKER, 200, 0, 0};
+    fwrite(&rh, 1, sizeof(rh), tail);
+    fwrite("torn", 1, 4, tail);
+    fclose(tail);
+  }
+
+  AuditStore store;
+  auto start = std::chrono::steady_clock::now();
+  bool ok = store.open(dir.c_str());
+  double secs = seconds_since(start);
+  printf("audit-recovery: %llu events, %u segments, %.1f MB\n",
+         (unsigned long long)opts.events, segments,
+         store_dir_bytes(dir) / 1048576.0);
+  if (ok) {
+    printf("  open: %.0f ms (%.0f events/s), %llu records\n", secs * 1000,
+           opts.events / secs, (unsigned long long)store.count());
+    printf("  user0 window: %llu events in the last 15 min\n",
+           (unsigned long long)store.intrusion().count(
+               global_symbols().find("user0"), SymbolTable::NO_SYMBOL,
+               now - INTRUSION_WINDOW_MS));
+    ok = store.count() == opts.events;
+  }
+  store.close();
+  remove_store_dir(dir);
+  if (!ok)
+    fprintf(stderr, "Error: recovery lost or invented records\n");
+  return ok ? 0 : 1;
+}
+
+static int bench_intrusion_checkpoint(const BenchOptions &opts) {
+  std::string path = "bench_intrusion." + std::to_string(getpid()) + ".ckpt";
+  int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch())
+                    .count();
+  // Events spread evenly over the window, a third of them failures
+  uint32_t failure = 1, success = 2;
+  IntrusionState state;
+  std::mt19937 rng(7);
+  for (uint64_t i = 0; i < opts.events; i++)
+    state.note(100 + rng() % opts.users, i % 3 ? failure : success,
+               now - INTRUSION_WINDOW_MS +
+                   (int64_t)(i * INTRUSION_WINDOW_MS / opts.events));
+
+  auto start = std::chrono::steady_clock::now();
+  bool ok = state.save(path.c_str());
+  double save_secs = seconds_since(start);
+  FILE *f = fopen(path.c_str(), "rb");
+  long bytes = 0;
+  if (f) {
+    fseek(f, 0, SEEK_END);
+    bytes = ftell(f);
+    fclose(f);
+  }
+
+  IntrusionState restored;
+  start = std::chrono::steady_clock::now();
+  ok = ok && restored.load(path.c_str());
+  double load_secs = seconds_since(start);
+  remove(path.c_str());
+
+  printf("intrusion-checkpoint: %llu events, %u users\n",
+         (unsigned long long)opts.events, opts.users);
+  printf("  checkpoint: %.1f KB (%.2f bytes/event)\n", bytes / 1024.0,
+         (double)bytes / opts.events);
+  printf("  save: %.1f ms, restore: %.1f ms\n", save_secs * 1000,
+         load_secs * 1000);
+  for (uint32_t user = 100; ok && user < 100 + opts.users; user++)
+    ok = restored.count(user, failure, 0) == state.count(user, failure, 0) &&
+         restored.count(user, SymbolTable::NO_SYMBOL, 0) ==
+             state.count(user, SymbolTable::NO_SYMBOL, 0);
+  if (!ok)
+    fprintf(stderr, "Error: restored state differs\n");
+  return ok ? 0 : 1;
+}
+
+static int bench_intrusion_profiles(const BenchOptions &opts) {
+  std::string path = "bench_intrusion." + std::to_string(getpid()) + ".ckpt";
+  int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch())
+                    .count();
+  // A month of logins, each user at their own usual hour and from one of
+  // a few networks, with a TOTP check after every fourth
+  const int64_t hour_ms = 3600 * 1000;
+  std::vector<uint32_t> prefixes;
+  for (uint32_t i = 0; i < 4; i++)
+    prefixes.push_back(intrusion_ip_prefix(
+        ("10.0." + std::to_string(i) + ".1").c_str()));
+  IntrusionState state;
+  std::mt19937 rng(7);
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < opts.events; i++) {
+    uint32_t user = rng() % opts.users;
+    int64_t day = (int64_t)(i * 30 / opts.events);
+    int64_t ts = now - (30 - day) * 24 * hour_ms +
+                 (int64_t)(user % 24 + rng() % 3) * hour_ms;
+    state.learn_login(100 + user, ts, prefixes[(user + rng() % 8 / 7) % 4]);
+    if (i % 4 == 0)
+      state.learn_totp(100 + user, (int)(rng() % 5 == 0));
+  }
+  double learn_secs = seconds_since(start);
+
+  IntrusionScore score;
+  uint64_t scored = 0, unusual = 0;
+  start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < opts.events; i++) {
+    uint32_t user = rng() % opts.users;
+    if (state.score(100 + user, now + (int64_t)(rng() % 24) * hour_ms,
+                    prefixes[rng() % 4], PROFILE_NO_TOTP, &score)) {
+      scored++;
+      unusual += score.hour >= 3.0;
+    }
+  }
+  double score_secs = seconds_since(start);
+
+  bool ok = state.save(path.c_str());
+  FILE *f = fopen(path.c_str(), "rb");
+  long bytes = 0;
+  if (f) {
+    fseek(f, 0, SEEK_END);
+    bytes = ftell(f);
+    fclose(f);
+  }
+  remove(path.c_str());
+
+  printf("intrusion-profiles: %llu events, %u users\n",
+         (unsigned long long)opts.events, opts.users);
+  printf("  learn: %.0f ns/event, score: %.0f ns/event\n",
+         learn_secs * 1e9 / opts.events, score_secs * 1e9 / opts.events);
+  printf("  random hours scored unusual: %.1f%%\n",
+         scored ? 100.0 * unusual / scored : 0.0);
+  printf("  checkpoint: %.1f KB (%.1f bytes/user)\n", bytes / 1024.0,
+         (double)bytes / opts.users);
+  if (!ok)
+    fprintf(stderr, "Error: checkpoint not written\n");
+  return ok ? 0 : 1;
+}
+
+// Random LOGIN/TOTP/REGISTRATION events through `rules`; ns per event
+static double run_sequences(const BenchOptions &opts, const std::string &rules,
+                            uint64_t *matched, size_t *states) {
+  IntrusionState state;
+  std::string error;
+  if (!state.set_sequences(rules, &error)) {
+    fprintf(stderr, "Error: %s\n", error.c_str());
+    return -1;
+  }
+  SequenceDetector detector;
+  detector.compile(rules, &error);
+  *states = detector.state_count();
+
+  SymbolTable &symbols = global_symbols();
+  uint32_t types[3] = {symbols.intern("LOGIN"), symbols.intern("TOTP"),
+                       symbols.intern("REGISTRATION")};
+  uint32_t statuses[2] = {symbols.intern("SUCCESS"),
+                          symbols.intern("FAILURE")};
+  std::mt19937 rng(7);
+  int64_t now = 1700000000000;
+  *matched = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < opts.events; i++) {
+    uint32_t r = rng();
+    *matched += state.advance(100 + r % opts.users, types[(r >> 16) % 3],
+                              statuses[(r >> 20) & 1],
+                              now + (int64_t)i) != 0;
+  }
+  return seconds_since(start) * 1e9 / opts.events;
+}
+
+static int bench_intrusion_sequences(const BenchOptions &opts) {
+  std::string rules = "MFA_GUESSING: LOGIN:SUCCESS TOTP:FAILURE{3}\n"
+                      "MFA_GUESSING_RELOGIN: (LOGIN:SUCCESS TOTP:FAILURE){3}\n"
+                      "NEW_ACCOUNT_PROBING: REGISTRATION:SUCCESS "
+                      "LOGIN:FAILURE{3}\n";
+  std::string many = rules;
+  const char *steps[] = {"LOGIN:SUCCESS", "LOGIN:FAILURE", "TOTP:FAILURE",
+                         "TOTP:*", "*:FAILURE"};
+  std::mt19937 rng(11);
+  for (int i = 0; i < 45; i++) {
+    many += "RULE_" + std::to_string(i) + ":";
+    for (int k = 0; k < 4; k++)
+      many += std::string(" ") + steps[rng() % 5];
+    many += "\n";
+  }
+
+  printf("intrusion-sequences: %llu events, %u users\n",
+         (unsigned long long)opts.events, opts.users);
+  for (const std::string *spec : {&rules, &many}) {
+    uint64_t matched = 0;
+    size_t states = 0;
+    double ns = run_sequences(opts, *spec, &matched, &states);
+    if (ns < 0)
+      return 1;
+    printf("  %zu rules, %zu states: %.0f ns/event, %llu matches\n",
+           (size_t)std::count(spec->begin(), spec->end(), '\n'), states, ns,
+           (unsigned long long)matched);
+  }
+  return 0;
+}
+
+// --- Alert Bus ---
+
+static double publish_alerts(AlertBus &bus, const BenchOptions &opts) {
+  char user[32];
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < opts.events; i++) {
+    snprintf(user, sizeof(user), "user%u", (unsigned)(i % opts.users));
+    bus.publish(1700000000000 + (int64_t)i, user, "BRUTE_FORCE", "HIGH",
+                "192.0.2.1", "Detected 5 failed login attempts in 15 minutes");
+  }
+  return seconds_since(start) * 1e9 / opts.events;
+}
+
+static int bench_alert_bus(const BenchOptions &opts) {
+  printf("alert-bus: %llu alerts, ring of %zu\n",
+         (unsigned long long)opts.events, ALERT_BUS_CAPACITY);
+  {
+    AlertBus bus;
+    printf("  no subscribers: %.0f ns/publish\n", publish_alerts(bus, opts));
+  }
+
+  // Draining, slow (sleeps between batches) and stalled (never reads)
+  AlertBus bus;
+  int ids[3] = {bus.subscribe(), bus.subscribe(), bus.subscribe()};
+  std::atomic<bool> done(false);
+  uint64_t torn[2] = {0, 0};
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 2; r++)
+    readers.emplace_back([&, r] {
+      std::vector<AlertRecord> batch(64);
+      char user[32];
+      for (;;) {
+        bool finished = done.load();
+        size_t n = bus.poll(ids[r], batch.data(), batch.size(), 10);
+        for (size_t i = 0; i < n; i++) {
+          snprintf(user, sizeof(user), "user%u",
+                   (unsigned)((batch[i].sequence - 1) % opts.users));
+          torn[r] += strcmp(batch[i].username, user) != 0 ||
+                     batch[i].ts_ms != 1700000000000 +
+                                           (int64_t)batch[i].sequence - 1;
+        }
+        if (!n && finished)
+          break;
+        if (r == 1)
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+  double ns = publish_alerts(bus, opts);
+  done = true;
+  for (std::thread &t : readers)
+    t.join();
+
+  printf("  3 subscribers:  %.0f ns/publish\n", ns);
+  const char *names[3] = {"draining", "slow", "stalled"};
+  for (int r = 0; r < 3; r++) {
+    AlertBusStats stats;
+    bus.stats(ids[r], &stats);
+    printf("    %-8s delivered %llu, dropped %llu, behind %llu%s\n", names[r],
+           (unsigned long long)stats.delivered,
+           (unsigned long long)stats.dropped, (unsigned long long)stats.lag,
+           r < 2 && torn[r] ? " - TORN RECORDS" : "");
+  }
+  return torn[0] || torn[1];
+}
+
+// --- Enforcement ---
+
+static int bench_enforcement(const BenchOptions &opts) {
+  printf("enforcement: %u users, %llu checks\n", opts.users,
+         (unsigned long long)opts.events);
+  AlertBus bus;
+  Enforcer enforcer(bus);
+  enforcer.set_policy("BRUTE_FORCE", {ENFORCE_BLOCK_USER, 15 * 60 * 1000});
+
+  // Every other user blocked, applied directly (no audit log is open)
+  std::vector<std::string> users(opts.users);
+  AlertRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  strcpy(rec.alert_type, "BRUTE_FORCE");
+  for (uint32_t u = 0; u < opts.users; u++) {
+    users[u] = "user" + std::to_string(u);
+    if (u % 2 == 0) {
+      snprintf(rec.username, sizeof(rec.username), "%s", users[u].c_str());
+      enforcer.enforce(rec);
+    }
+  }
+  int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch())
+                    .count();
+  uint64_t blocked = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < opts.events; i++)
+    blocked += enforcer.blocked_ms(users[i % opts.users].c_str(), "192.0.2.1",
+                                   now) > 0;
+  printf("  block check: %.0f ns (%llu of %llu blocked)\n",
+         seconds_since(start) * 1e9 / opts.events,
+         (unsigned long long)blocked, (unsigned long long)opts.events);
+
+  // Publish for a user not yet blocked and wait for the block to show
+  if (!enforcer.start()) {
+    printf("  could not subscribe to the bus\n");
+    return 1;
+  }
+  size_t samples = (size_t)std::min<uint64_t>(opts.events, 2000);
+  std::vector<double> us;
+  for (size_t i = 0; i < samples; i++) {
+    std::string user = "probe" + std::to_string(i);
+    auto sent = std::chrono::steady_clock::now();
+    bus.publish(now, user.c_str(), "BRUTE_FORCE", "HIGH", nullptr, "bench");
+    while (!enforcer.blocked_ms(user.c_str(), nullptr, now)) {
+      if (seconds_since(sent) > 1.0)
+        break;
+      std::this_thread::yield();
+    }
+    us.push_back(seconds_since(sent) * 1e6);
+  }
+  enforcer.stop();
+  std::sort(us.begin(), us.end());
+  EnforcementStats stats;
+  enforcer.stats(&stats);
+  printf("  alert to block: p50 %.1f us, p99 %.1f us, max %.1f us "
+         "(%zu alerts)\n",
+         us[us.size() / 2], us[us.size() * 99 / 100], us.back(), samples);
+  printf("  table full %llu\n", (unsigned long long)stats.table_full);
+  return us.back() > 1e6;
+}
+
+// --- TOTP Policies ---
+
+// Window loop with the parameters as values, as before policies were
+// templates; the baseline for the default policy
+static bool totp_runtime_check(const HmacSha1Key &key, int code, time_t now,
+                               unsigned digits, time_t period, int window) {
+  uint64_t step = (uint64_t)(now / period);
+  bool ok = false;
+  for (int w = -window; w <= window; w++)
+    ok |= hotp_sha1(key, step + w, digits) == (uint32_t)code;
+  return ok;
+}
+
+static int bench_totp_policies(const BenchOptions &opts) {
+  const uint8_t secret[20] = {'1', '2', '3', '4', '5', '6', '7', '8', '9', '0',
+                              '1', '2', '3', '4', '5', '6', '7', '8', '9', '0'};
+  uint64_t checks = std::max<uint64_t>(opts.events / 4, 1);
+  printf("totp-policies: %llu checks each\n", (unsigned long long)checks);
+  time_t now = 1700000000;
+  uint64_t accepted = 0;
+
+  HmacSha1Key runtime_key;
+  hmac_sha1_precompute(&runtime_key, secret, sizeof(secret));
+  volatile unsigned digits = 6, window = 1;
+  volatile time_t period = 30;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < checks; i++)
+    accepted += totp_runtime_check(runtime_key, (int)(i % 1000000),
+                                   now + (time_t)i, digits, period, window);
+  printf("  run-time parameters  %.0f ns\n",
+         seconds_since(start) * 1e9 / checks);
+
+  for (int p = 0; p < TOTP_POLICY_COUNT; p++) {
+    TotpPolicyInfo info;
+    TotpKey key;
+    totp_policy_info((uint8_t)p, &info);
+    totp_key_init(&key, (uint8_t)p, secret, sizeof(secret));
+    start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < checks; i++)
+      accepted += totp_verify(key, (int)(i % 1000000), now + (time_t)i);
+    printf("  %-6s %u digits %2us  %.0f ns\n",
+           info.hash == TOTP_HASH_SHA256 ? "SHA256" : "SHA1", info.digits,
+           info.period, seconds_since(start) * 1e9 / checks);
+  }
+  // Keeps the checks from being optimised away
+  printf("  (%llu codes accepted)\n", (unsigned long long)accepted);
+  return 0;
+}
+
+// --- Credential Backends ---
+
+extern "C" bool shm_index_unlink(const char *name); // shm_index.cpp
+
+// The same users in every backend's form
+struct BackendFixture {
+  std::string db_path;
+  std::string snapshot_path;
+  std::string segment;
+  std::vector<std::string> names;
+  std::vector<std::string> passwords;
+  std::vector<int> codes; // each user's current TOTP code
+};
+
+// users.db with the schema and text encodings user_db.py uses
+static bool write_users_db(const std::string &path,
+                           const std::vector<SnapshotRecord> &records,
+                           const std::vector<std::string> &hashes,
+                           const std::vector<std::string> &secrets) {
+  sqlite3 *db = nullptr;
+  if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+    sqlite3_close(db);
+    return false;
+  }
+  sqlite3_stmt *insert = nullptr;
+  bool ok = sqlite3_exec(db,
+                         "CREATE TABLE users (username TEXT PRIMARY KEY, "
+                         "password_hash TEXT, totp_secret TEXT); BEGIN",
+                         nullptr, nullptr, nullptr) == SQLITE_OK &&
+            sqlite3_prepare_v2(db, "INSERT INTO users VALUES (?, ?, ?)", -1,
+                               &insert, nullptr) == SQLITE_OK;
+  for (size_t u = 0; ok && u < records.size(); u++) {
+    sqlite3_bind_text(insert, 1, records[u].name, records[u].name_len,
+                      SQLITE_STATIC);
+    sqlite3_bind_text(insert, 2, hashes[u].c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(insert, 3, secrets[u].c_str(), -1, SQLITE_STATIC);
+    ok = sqlite3_step(insert) == SQLITE_DONE;
+    sqlite3_reset(insert);
+  }
+  sqlite3_finalize(insert);
+  ok = ok && sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr) == SQLITE_OK;
+  sqlite3_close(db);
+  return ok;
+}
+
+static bool build_backend_fixture(const BenchOptions &opts, BackendFixture *fx,
+                                  ShmCredentialIndex *shm) {
+  const char base32[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+  std::string tag = std::to_string(getpid());
+  fx->db_path = "bench_users." + tag + ".db";
+  fx->snapshot_path = "bench_users." + tag + ".snap";
+  fx->segment = "secureauth_bench." + tag;
+
+  std::mt19937_64 rng(11);
+  std::vector<SnapshotRecord> records(opts.users);
+  std::vector<std::string> hashes(opts.users), secrets(opts.users);
+  int64_t step = (int64_t)std::time(0) / 30;
+  for (uint32_t u = 0; u < opts.users; u++) {
+    fx->names.push_back("user" + std::to_string(u));
+    fx->passwords.push_back("pw-" + std::to_string(rng()));
+    uint8_t digest[32];
+    sha256((const uint8_t *)fx->passwords[u].data(), fx->passwords[u].size(),
+           digest);
+    char hex[65];
+    for (int i = 0; i < 32; i++)
+      snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+    hashes[u] = hex;
+    for (int i = 0; i < 32; i++) // pyotp.random_base32(): 160 bits
+      secrets[u] += base32[rng() % 32];
+    if (!snapshot_fill_record(&records[u], u + 1, fx->names[u].c_str(),
+                              hashes[u].c_str(), secrets[u].c_str()))
+      return false;
+    TotpKey key;
+    totp_key_init(&key, TOTP_POLICY_DEFAULT, records[u].totp_secret,
+                  records[u].secret_len);
+    fx->codes.push_back((int)totp_code(key, (uint64_t)step));
+  }
+
+  if (!write_users_db(fx->db_path, records, hashes, secrets) ||
+      !shm->create(fx->segment.c_str(), opts.users))
+    return false;
+  for (const SnapshotRecord &rec : records)
+    if (!shm->publish(rec))
+      return false;
+  return snapshot_write(fx->snapshot_path.c_str(), records, opts.users);
+}
+
+static void remove_backend_fixture(const BackendFixture &fx,
+                                   ShmCredentialIndex *shm) {
+  shm->detach();
+  shm_index_unlink(fx.segment.c_str());
+  remove(fx.db_path.c_str());
+  remove(fx.snapshot_path.c_str());
+  remove((fx.snapshot_path + ".warm").c_str());
+}
+
+static int bench_credential_backends(const BenchOptions &opts) {
+  // The hot tier holds about a fifth of the users - the busy ones
+  uint64_t budget = (uint64_t)opts.users * sizeof(HotEntry) / 2;
+  uint64_t totp_checks = std::max<uint64_t>(opts.events / 4, 1);
+  printf("credential-backends: %u users, %llu logins and %llu TOTP checks "
+         "each, 80%% of them for 20%% of the users; hot tier %llu KB\n",
+         opts.users, (unsigned long long)opts.events,
+         (unsigned long long)totp_checks, (unsigned long long)budget >> 10);
+
+  BackendFixture fx;
+  ShmCredentialIndex shm;
+  if (!build_backend_fixture(opts, &fx, &shm)) {
+    printf("  could not build the fixture\n");
+    remove_backend_fixture(fx, &shm);
+    return 1;
+  }
+
+  std::mt19937 rng(5);
+  std::vector<uint32_t> picks(opts.events);
+  for (uint32_t &u : picks)
+    u = rng() % 5 ? rng() % std::max(opts.users / 5, 1u) : rng() % opts.users;
+  std::vector<std::string> unknown(1000);
+  for (size_t i = 0; i < unknown.size(); i++)
+    unknown[i] = "nobody" + std::to_string(i);
+
+  struct {
+    const char *label;
+    int backend;
+    const char *source;
+    const char *db_path;
+  } backends[] = {
+      {"sqlite", AUTH_BACKEND_SQLITE, nullptr, fx.db_path.c_str()},
+      {"shm-index", AUTH_BACKEND_SHM_INDEX, fx.segment.c_str(), nullptr},
+      {"snapshot", AUTH_BACKEND_SNAPSHOT, fx.snapshot_path.c_str(), nullptr},
+      {"tiered", AUTH_BACKEND_TIERED, fx.snapshot_path.c_str(),
+       fx.db_path.c_str()},
+  };
+
+  int failed = 0;
+  for (const auto &b : backends) {
+    if (!auth_pipeline_open(b.backend, b.source, b.db_path, budget)) {
+      printf("  %-9s  could not open\n", b.label);
+      failed = 1;
+      continue;
+    }
+    // One untimed pass first: page cache, mappings and the hot tier
+    uint64_t accepted = 0;
+    for (uint32_t u : picks)
+      accepted += pipeline_validate_login(fx.names[u].c_str(),
+                                          fx.passwords[u].c_str());
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t u : picks)
+      accepted += pipeline_validate_login(fx.names[u].c_str(),
+                                          fx.passwords[u].c_str());
+    double login_ns = seconds_since(start) * 1e9 / picks.size();
+
+    start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < totp_checks; i++) {
+      uint32_t u = picks[i];
+      accepted += pipeline_validate_totp(fx.names[u].c_str(), fx.codes[u]);
+    }
+    double totp_ns = seconds_since(start) * 1e9 / totp_checks;
+
+    uint64_t rejected = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < opts.events; i++)
+      rejected += !pipeline_validate_login(
+          unknown[i % unknown.size()].c_str(), "pw");
+    double unknown_ns = seconds_since(start) * 1e9 / opts.events;
+    auth_pipeline_close();
+
+    // Every check was for a real user with their own password or code
+    uint64_t expected = 2 * picks.size() + totp_checks;
+    bool correct = accepted == expected && rejected == opts.events;
+    printf("  %-9s  login %6.0f ns  totp %6.0f ns  unknown user %6.0f ns%s\n",
+           b.label, login_ns, totp_ns, unknown_ns,
+           correct ? "" : "  - WRONG RESULTS");
+    failed |= !correct;
+  }
+
+  remove_backend_fixture(fx, &shm);
+  return failed;
+}
+
+// --- Main ---
+
+struct BenchCommand {
+  const char *name;
+  int (*run)(const BenchOptions &);
+};
+
+static const BenchCommand COMMANDS[] = {
+    {"audit-compression", bench_audit_compression},
+    {"audit-bursts", bench_audit_bursts},
+    {"audit-recovery", bench_audit_recovery},
+    {"intrusion-checkpoint", bench_intrusion_checkpoint},
+    {"intrusion-profiles", bench_intrusion_profiles},
+    {"intrusion-sequences", bench_intrusion_sequences},
+    {"alert-bus", bench_alert_bus},
+    {"enforcement", bench_enforcement},
+    {"totp-policies", bench_totp_policies},
+    {"credential-backends", bench_credential_backends},
+};
+
+static int usage() {
+  fprintf(stderr, "Usage: bench_suite <subcommand> [--events N] [--users U]\n"
+                  "Subcommands:");
+  for (const BenchCommand &cmd : COMMANDS)
+    fprintf(stderr, " %s", cmd.name);
+  fprintf(stderr, "\n");
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2)
+    return usage();
+
+  BenchOptions opts;
+  opts.events = 200000;
+  opts.users = 5000;
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--events") == 0 && i + 1 < argc)
+      opts.events = (uint64_t)std::max(1LL, atoll(argv[++i]));
+    else if (strcmp(argv[i], "--users") == 0 && i + 1 < argc)
+      opts.users = (uint32_t)std::max(1, atoi(argv[++i]));
+    else
+      return usage();
+  }
+
+  for (const BenchCommand &cmd : COMMANDS)
+    if (strcmp(argv[1], cmd.name) == 0)
+      return cmd.run(opts);
+  return usage();
+}
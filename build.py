@@ -12,20 +12,92 @@ def main():
     print(f"Detected OS: {system}")
     
     # 2. Determine Compiler Command
-    src_file = "auth_core.cpp"
+    src_files = [
+        "auth_core.cpp",
+        "crypto_core.cpp",
+        "totp_policy.cpp",
+        "credential_snapshot.cpp",
+        "credential_loader.cpp",
+        "epoch_reclaim.cpp",
+        "credential_store.cpp",
+        "shm_index.cpp",
+        "symbol_table.cpp",
+        "roaring_bitmap.cpp",
+        "details_codec.cpp",
+        "audit_search.cpp",
+        "audit_compress.cpp",
+        "audit_queue.cpp",
+        "audit_chain.cpp",
+        "audit_tail.cpp",
+        "sequence_detector.cpp",
+        "intrusion_state.cpp",
+        "audit_store.cpp",
+        "alert_bus.cpp",
+        "enforcement.cpp",
+        "auth_pipeline.cpp",
+    ]
+    cxx_flags = ["-std=c++20", "-O2", "-pthread"]
+    libs = ["-lsqlite3"]
+    
+    # Optional: zstd-compressed audit segments (needs libzstd and its headers)
+    if os.environ.get("SECUREAUTH_ZSTD") == "1":
+        cxx_flags.append("-DSECUREAUTH_HAVE_ZSTD")
+        libs.append("-lzstd")
+    
+    # Command-line tools: (output name, sources)
+    tools = [
+        ("snapshot_builder", ["snapshot_builder.cpp", "crypto_core.cpp",
+                              "credential_snapshot.cpp"]),
+        ("bench_suite", ["bench_suite.cpp", "crypto_core.cpp",
+                         "totp_policy.cpp", "credential_snapshot.cpp",
+                         "symbol_table.cpp", "roaring_bitmap.cpp",
+                         "details_codec.cpp", "audit_search.cpp",
+                         "audit_compress.cpp", "audit_queue.cpp",
+                         "audit_chain.cpp", "audit_tail.cpp",
+                         "sequence_detector.cpp", "intrusion_state.cpp",
+                         "audit_store.cpp", "alert_bus.cpp",
+                         "enforcement.cpp", "auth_pipeline.cpp",
+                         "credential_store.cpp", "credential_loader.cpp",
+                         "epoch_reclaim.cpp", "shm_index.cpp"]),
+        ("check_suite", ["check_suite.cpp", "crypto_core.cpp",
+                         "totp_policy.cpp", "credential_snapshot.cpp",
+                         "symbol_table.cpp", "roaring_bitmap.cpp",
+                         "details_codec.cpp", "audit_search.cpp",
+                         "audit_compress.cpp", "audit_queue.cpp",
+                         "audit_chain.cpp", "audit_tail.cpp",
+                         "sequence_detector.cpp", "intrusion_state.cpp",
+                         "audit_store.cpp", "alert_bus.cpp",
+                         "enforcement.cpp", "auth_pipeline.cpp",
+                         "credential_store.cpp", "credential_loader.cpp",
+                         "epoch_reclaim.cpp", "shm_index.cpp"]),
+        ("audit_verify", ["audit_verify.cpp", "audit_chain.cpp",
+                          "audit_compress.cpp", "crypto_core.cpp",
+                          "credential_snapshot.cpp"]),
+        ("audit_replay", ["audit_replay.cpp", "intrusion_checks.cpp",
+                          "audit_compress.cpp", "crypto_core.cpp",
+                          "credential_snapshot.cpp", "symbol_table.cpp",
+                          "details_codec.cpp", "sequence_detector.cpp",
+                          "intrusion_state.cpp"]),
+        ("attack_sim", ["attack_sim.cpp", "intrusion_checks.cpp",
+                        "credential_store.cpp", "credential_loader.cpp",
+                        "epoch_reclaim.cpp", "crypto_core.cpp",
+                        "totp_policy.cpp", "credential_snapshot.cpp",
+                        "symbol_table.cpp", "sequence_detector.cpp",
+                        "intrusion_state.cpp"]),
+    ]
     
     if system == "Windows":
         out_file = "auth_lib.dll"
         # Ensure we use g++
-        cmd = ["g++", "-shared", "-o", out_file, src_file]
+        cmd = ["g++", "-shared", *cxx_flags, "-o", out_file, *src_files, *libs]
     elif system == "Linux" or system == "Darwin": # Darwin is Mac
         out_file = "auth_lib.so"
-        cmd = ["g++", "-shared", "-o", out_file, "-fPIC", src_file]
+        cmd = ["g++", "-shared", *cxx_flags, "-o", out_file, "-fPIC", *src_files, *libs]
     else:
         print(f"Unsupported OS: {system}")
         sys.exit(1)
         
-    print(f"Compiling {src_file} -> {out_file}...")
+    print(f"Compiling {', '.join(src_files)} -> {out_file}...")
     print(f"Command: {' '.join(cmd)}")
     
     # 3. Execute Compilation
@@ -49,7 +121,18 @@ def main():
         print("Error: Library file not found after compilation.")
         sys.exit(1)
 
-    # 5. Launch GUI
+    # 5. Build command-line tools
+    exe_suffix = ".exe" if system == "Windows" else ""
+    for tool_name, tool_srcs in tools:
+        tool_cmd = ["g++", *cxx_flags, "-o", tool_name + exe_suffix, *tool_srcs, *libs]
+        print(f"Building tool {tool_name}...")
+        try:
+            subprocess.check_call(tool_cmd, cwd=cwd)
+        except subprocess.CalledProcessError:
+            print(f"Error: Failed to build {tool_name}.")
+            sys.exit(1)
+
+    # 6. Launch GUI
     print("Launching GUI...")
     gui_script = "main_gui.py"
     try:
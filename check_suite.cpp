@@ -0,0 +1,614 @@
+/*
+ * Check Suite
+ *
+ * Behaviour checks for the native backends. Each subcommand builds its own
+ * fixture in a scratch directory, removes it afterwards, prints one line
+ * per check and exits non-zero if any failed. Without a subcommand every
+ * group runs.
+ *
+ *   audit-proofs       Merkle inclusion proofs verify, and stop verifying
+ *                      once a committed record is edited on disk
+ *   audit-recovery     Reopening rebuilds the same indexes from record
+ *                      indexes, from a damaged record index, and after a
+ *                      torn tail record
+ *   intrusion-replay   After a crash, replay adds exactly the events the
+ *                      last checkpoint missed
+ *   sequence-dfa       Compiled sequence rules match overlapping and
+ *                      interleaved sequences
+ *   sequence-symbols   Symbols the rules name are saved with the store, so
+ *                      events decode the same under other rules
+ *   enforcement        Blocks key on whole names, and entries whose block
+ *                      has expired are reused once the table is full
+ *
+ * Usage: check_suite [subcommand]
+ */
+
+#include "audit_chain.h"
+#include "audit_store.h"
+#include "enforcement.h"
+#include "sequence_detector.h"
+#include "symbol_table.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#include <process.h>
+#define getpid _getpid
+#define rmdir _rmdir
+#else
+#include <unistd.h>
+#endif
+
+// audit_store.cpp exports, as the Python layer calls them
+extern "C" bool audit_store_open(const char *dir);
+extern "C" void audit_store_close();
+extern "C" uint64_t audit_append(const char *username, const char *event_type,
+                                 const char *status, const char *ip_address,
+                                 const char *risk_level,
+                                 const char *details_json, int64_t ts_ms);
+extern "C" int audit_event_json(uint64_t event_id, char *buf, int buf_size);
+extern "C" bool audit_sequence_rules(const char *rules, char *error,
+                                     int error_len);
+
+static int g_failures = 0;
+
+static void check(bool ok, const char *what) {
+  printf("  %-4s %s\n", ok ? "ok" : "FAIL", what);
+  if (!ok)
+    g_failures++;
+}
+
+static bool truncate_path(const std::string &path, long size) {
+  FILE *f = fopen(path.c_str(), "r+b");
+  if (!f)
+    return false;
+#ifdef _WIN32
+  bool ok = _chsize(_fileno(f), size) == 0;
+#else
+  bool ok = ftruncate(fileno(f), (off_t)size) == 0;
+#endif
+  return fclose(f) == 0 && ok;
+}
+
+static bool flip_byte(const std::string &path, long offset) {
+  FILE *f = fopen(path.c_str(), "r+b");
+  if (!f)
+    return false;
+  int c = fseek(f, offset, SEEK_SET) == 0 ? fgetc(f) : EOF;
+  bool ok = c != EOF && fseek(f, offset, SEEK_SET) == 0 &&
+            fputc(c ^ 0x20, f) != EOF;
+  return fclose(f) == 0 && ok;
+}
+
+static bool read_file(const std::string &path, std::string *out) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  out->clear();
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    out->append(buf, n);
+  fclose(f);
+  return true;
+}
+
+static bool write_file(const std::string &path, const std::string &data) {
+  FILE *f = fopen(path.c_str(), "wb");
+  if (!f)
+    return false;
+  bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  return fclose(f) == 0 && ok;
+}
+
+static bool file_exists(const std::string &path) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f)
+    fclose(f);
+  return f != nullptr;
+}
+
+static std::string scratch_dir(const char *name) {
+  return std::string("check_") + name + "." + std::to_string(getpid());
+}
+
+static void remove_store_dir(const std::string &dir) {
+  const char *suffixes[] = {"aud", "z", "idx", "rix"};
+  for (uint32_t id = 1;; id++) {
+    bool any = false;
+    for (const char *suffix : suffixes) {
+      char name[32];
+      snprintf(name, sizeof(name), "/seg-%08u.%s", id, suffix);
+      any |= remove((dir + name).c_str()) == 0;
+    }
+    if (!any)
+      break;
+  }
+  remove((dir + "/symbols.dat").c_str());
+  remove((dir + "/chain.log").c_str());
+  remove((dir + "/intrusion.ckpt").c_str());
+  rmdir(dir.c_str());
+}
+
+// `count` distinct events (no two aggregate), one second apart
+static void append_events(AuditStore &store, int64_t ts_ms, int count) {
+  for (int i = 0; i < count; i++) {
+    std::string user = "user" + std::to_string(i % 13);
+    std::string details = "{\"attempt\": " + std::to_string(i) + "}";
+    store.append_text(ts_ms + i * 1000, user.c_str(), "LOGIN",
+                      i % 4 ? "SUCCESS" : "FAILURE", "10.0.0.1", "LOW",
+                      details.c_str());
+  }
+}
+
+// Rewrite one stored record's details in place, with a fresh checksum, the
+// way someone covering their tracks would
+static bool edit_record(AuditStore &store, uint64_t event_id) {
+  AuditTailRange range;
+  if (!store.tail_range(event_id, 1, &range) || range.path.empty())
+    return false;
+  FILE *f = fopen(range.path.c_str(), "r+b");
+  if (!f)
+    return false;
+  AuditRecordHeader rh;
+  AuditRecordBody body;
+  std::vector<char> details;
+  bool ok = fseek(f, (long)range.offset, SEEK_SET) == 0 &&
+            fread(&rh, 1, sizeof(rh), f) == sizeof(rh) &&
+            fread(&body, 1, sizeof(body), f) == sizeof(body);
+  if (ok && body.details_len > 0) {
+    details.resize(body.details_len);
+    ok = fread(details.data(), 1, details.size(), f) == details.size();
+    details.back() ^= 1;
+    rh.check = audit_record_check(body, details.data());
+    ok = ok && fseek(f, (long)range.offset, SEEK_SET) == 0 &&
+         fwrite(&rh, 1, sizeof(rh), f) == sizeof(rh) &&
+         fseek(f, (long)(range.offset + sizeof(rh) + sizeof(body)),
+               SEEK_SET) == 0 &&
+         fwrite(details.data(), 1, details.size(), f) == details.size();
+  }
+  return fclose(f) == 0 && ok && !details.empty();
+}
+
+// --- Audit Proofs ---
+
+static void check_audit_proofs() {
+  printf("audit-proofs\n");
+  std::string dir = scratch_dir("proofs");
+  const int64_t start = 1700000000000LL;
+  {
+    AuditStore store;
+    check(store.open(dir.c_str()), "open a new store");
+    store.set_aggregation(false);
+    append_events(store, start, 200);
+    store.rotate(); // second batch in its own segment
+    append_events(store, start + 200000, 200);
+    check(store.sync(), "commit both batches");
+
+    AuditProof proof;
+    check(store.prove(250, &proof) && audit_proof_verify(proof),
+          "proof for a committed event verifies");
+    AuditCommit head;
+    check(store.chain_head(&head) &&
+              memcmp(head.chain, proof.chain, 32) == 0,
+          "proof ends at the chain head");
+
+    AuditProof bad = proof;
+    bad.leaf[0] ^= 1;
+    check(!audit_proof_verify(bad), "altered leaf is rejected");
+    bad = proof;
+    bad.path[0][5] ^= 0x80;
+    check(!audit_proof_verify(bad), "altered sibling is rejected");
+    bad = proof;
+    bad.leaf_index ^= 1;
+    check(!audit_proof_verify(bad), "wrong leaf position is rejected");
+    bad = proof;
+    bad.prev_chain[31] ^= 1;
+    check(!audit_proof_verify(bad), "wrong previous chain is rejected");
+
+    check(edit_record(store, 250), "edit event 250 on disk");
+  }
+  {
+    AuditStore store;
+    check(store.open(dir.c_str()), "reopen the edited store");
+    AuditProof proof;
+    check(store.prove(250, &proof) && !audit_proof_verify(proof),
+          "proof for the edited event fails");
+    check(store.prove(50, &proof) && audit_proof_verify(proof),
+          "proof for an event in an untouched batch still verifies");
+  }
+  remove_store_dir(dir);
+}
+
+// --- Audit Recovery ---
+
+// What a reopened store must agree on with the one that wrote the events
+struct StoreView {
+  uint64_t records;
+  uint64_t user_events;
+  uint64_t failures;
+  std::string first, middle, last;
+};
+
+static StoreView view_of(const AuditStore &store, uint64_t last_id) {
+  StoreView v;
+  v.records = store.count();
+  AuditQuery q = {};
+  q.attr[AUDIT_ATTR_USER] = global_symbols().find("user3");
+  v.user_events = store.count_events(q);
+  q = {};
+  q.attr[AUDIT_ATTR_STATUS] = global_symbols().find("FAILURE");
+  v.failures = store.count_events(q);
+  store.event_json(1, &v.first);
+  store.event_json(last_id / 2, &v.middle);
+  store.event_json(last_id, &v.last);
+  return v;
+}
+
+static bool same_view(const StoreView &a, const StoreView &b) {
+  return a.records == b.records && a.user_events == b.user_events &&
+         a.failures == b.failures && a.first == b.first &&
+         a.middle == b.middle && a.last == b.last;
+}
+
+static void check_audit_recovery() {
+  printf("audit-recovery\n");
+  std::string dir = scratch_dir("recovery");
+  const int64_t start = 1700000000000LL;
+  const uint64_t total = 700;
+  StoreView written;
+  {
+    AuditStore store;
+    check(store.open(dir.c_str()), "open a new store");
+    store.set_aggregation(false);
+    append_events(store, start, 300);
+    store.rotate();
+    append_events(store, start + 300000, 300);
+    store.rotate();
+    append_events(store, start + 600000, 100); // unsealed tail
+    store.wait_finished();
+    check(store.sync(), "write two sealed segments and a tail");
+    written = view_of(store, total);
+    check(written.records == total && !written.last.empty(),
+          "every event is readable before reopening");
+  }
+  check(file_exists(dir + "/seg-00000001.rix") &&
+            file_exists(dir + "/seg-00000002.rix"),
+        "sealed segments have record indexes");
+  {
+    AuditStore store;
+    check(store.open(dir.c_str()), "reopen from record indexes");
+    check(same_view(view_of(store, total), written),
+          "indexes and events match what was written");
+  }
+
+  check(flip_byte(dir + "/seg-00000001.rix",
+                  (long)sizeof(AuditRecordIndexHeader) + 8),
+        "damage the first record index");
+  {
+    AuditStore store;
+    check(store.open(dir.c_str()), "reopen with a damaged record index");
+    check(same_view(view_of(store, total), written),
+          "the damaged segment is read in full instead");
+  }
+
+  AuditTailRange range = {};
+  {
+    AuditStore store;
+    check(store.open(dir.c_str()) && store.tail_range(total, 1, &range) &&
+              !range.path.empty(),
+          "locate the last record");
+  }
+  check(truncate_path(range.path, (long)(range.offset + range.length / 2)),
+        "cut the last record in half");
+  {
+    AuditStore store;
+    check(store.open(dir.c_str()), "reopen after a torn tail");
+    // The commit made on close covers the torn record, so its ID stays
+    // used (see AuditChain) and the next append gets the one after it
+    StoreView v = view_of(store, total);
+    check(v.last.empty() && v.first == written.first &&
+              v.middle == written.middle && v.user_events > 0,
+          "the torn record is dropped and the rest kept");
+    store.set_aggregation(false);
+    check(store.append_text(start + 800000, "user3", "LOGIN", "SUCCESS",
+                            "10.0.0.2", "LOW", "{\"after\": 1}") ==
+              total + 1,
+          "appending resumes after the torn record's ID");
+  }
+  {
+    AuditStore store;
+    std::string json;
+    check(store.open(dir.c_str()) && store.event_json(total + 1, &json) &&
+              json.find("after") != std::string::npos,
+          "the new tail record survives another reopen");
+  }
+  remove_store_dir(dir);
+}
+
+// --- Intrusion Replay ---
+
+// Logged the way audit_append() does it: noted, then written
+static uint64_t log_failure(AuditStore &store, int64_t ts_ms) {
+  uint32_t attr[AUDIT_ATTR_COUNT];
+  uint16_t flags;
+  std::string details;
+  audit_prepare_event("mallory", "LOGIN", "FAILURE", "10.9.9.9", "HIGH",
+                      "{\"reason\": \"invalid_credentials\"}", attr, &flags,
+                      &details);
+  store.observe(attr, ts_ms, flags, details.data(), details.size());
+  return store.append(ts_ms, attr, flags, details.data(), details.size());
+}
+
+static void check_intrusion_replay() {
+  printf("intrusion-replay\n");
+  std::string dir = scratch_dir("replay");
+  std::string ckpt = dir + "/intrusion.ckpt", saved;
+  int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch())
+                    .count();
+  uint32_t attr[AUDIT_ATTR_COUNT];
+  uint16_t flags;
+  std::string queued;
+  {
+    AuditStore store;
+    check(store.open(dir.c_str()), "open a new store");
+    store.set_aggregation(false);
+    log_failure(store, now - 2000);
+    // Noted but still queued when the checkpoint is taken
+    audit_prepare_event("mallory", "LOGIN", "FAILURE", "10.9.9.9", "HIGH",
+                        "{\"reason\": \"queued\"}", attr, &flags, &queued);
+    store.observe(attr, now - 1000, flags, queued.data(), queued.size());
+    log_failure(store, now);
+    check(store.intrusion().save(ckpt.c_str()) && read_file(ckpt, &saved),
+          "checkpoint three noted failures");
+    store.append(now - 1000, attr, flags, queued.data(), queued.size());
+    log_failure(store, now); // same millisecond, after the checkpoint
+  }
+  // As if the process had died before its last checkpoint
+  check(write_file(ckpt, saved), "put the earlier checkpoint back");
+  {
+    AuditStore store;
+    check(store.open(dir.c_str()), "reopen after the crash");
+    uint32_t user = global_symbols().find("mallory");
+    uint32_t failure = global_symbols().find("FAILURE");
+    uint64_t count = store.intrusion().count(user, failure, now - 5000);
+    if (count != 4)
+      printf("       counted %llu failures\n", (unsigned long long)count);
+    check(count == 4, "each failure counts once, including the one in the "
+                      "checkpoint's millisecond");
+  }
+  remove_store_dir(dir);
+}
+
+// --- Sequence Rules ---
+
+// Rules matched by each event in turn, as "rule,rule;" per event; as
+// IntrusionState::advance() does, events of types no rule names match none
+static std::string run_rules(const SequenceDetector &rules,
+                             const char *const events[][2], size_t count) {
+  SymbolTable &symbols = global_symbols();
+  std::string out;
+  uint16_t state = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t type = symbols.intern(events[i][0]);
+    state = rules.step(state, type, symbols.intern(events[i][1]));
+    uint64_t matched = rules.consumes(type) ? rules.accepted(state) : 0;
+    for (size_t r = 0; r < rules.rule_count(); r++)
+      if (matched >> r & 1)
+        out += rules.rule_name(r) + ",";
+    out += ";";
+  }
+  return out;
+}
+
+static void check_sequence_dfa() {
+  printf("sequence-dfa\n");
+  SequenceDetector rules;
+  std::string error;
+  check(rules.compile("DFA_ALTERNATING: DFA_LOGIN:DFA_BAD DFA_LOGIN:DFA_OK "
+                      "DFA_LOGIN:DFA_BAD DFA_LOGIN:DFA_OK\n"
+                      "DFA_GUESSING: DFA_LOGIN:DFA_OK DFA_TOTP:DFA_BAD{3}\n"
+                      "DFA_TOTP_PAIR: DFA_TOTP:DFA_BAD{2}\n",
+                      &error),
+        "compile three rules into one DFA");
+
+  // The second half of one alternation is the first half of the next
+  const char *const alternating[][2] = {
+      {"DFA_LOGIN", "DFA_BAD"}, {"DFA_LOGIN", "DFA_OK"},
+      {"DFA_LOGIN", "DFA_BAD"}, {"DFA_LOGIN", "DFA_OK"},
+      {"DFA_LOGIN", "DFA_BAD"}, {"DFA_LOGIN", "DFA_OK"}};
+  check(run_rules(rules, alternating, 6) == ";;;DFA_ALTERNATING,;;"
+                                            "DFA_ALTERNATING,;",
+        "a self-overlapping rule matches at every repeat");
+
+  // A restarted login abandons the first guessing run; the pair rule runs
+  // alongside and matches on every consecutive failure
+  const char *const guessing[][2] = {
+      {"DFA_LOGIN", "DFA_OK"}, {"DFA_TOTP", "DFA_BAD"},
+      {"DFA_LOGIN", "DFA_OK"}, {"DFA_TOTP", "DFA_BAD"},
+      {"DFA_TOTP", "DFA_BAD"}, {"DFA_TOTP", "DFA_BAD"},
+      {"DFA_TOTP", "DFA_BAD"}};
+  check(run_rules(rules, guessing, 7) ==
+            ";;;;DFA_TOTP_PAIR,;DFA_GUESSING,DFA_TOTP_PAIR,;DFA_TOTP_PAIR,;",
+        "overlapping rules match together on one event");
+
+  // Types no rule names pass through without resetting progress
+  const char *const interleaved[][2] = {
+      {"DFA_LOGIN", "DFA_OK"}, {"DFA_TOTP", "DFA_BAD"},
+      {"DFA_OTHER", "DFA_OK"}, {"DFA_TOTP", "DFA_BAD"},
+      {"DFA_OTHER", "DFA_BAD"}, {"DFA_TOTP", "DFA_BAD"}};
+  check(run_rules(rules, interleaved, 6) ==
+            ";;;DFA_TOTP_PAIR,;;DFA_GUESSING,DFA_TOTP_PAIR,;",
+        "events of other types do not break a sequence");
+}
+
+// The Python layer sets rules before it opens the store. Whatever they
+// intern has to end up in the store's symbol log, or the IDs records were
+// written with mean something else (or nothing) after a restart.
+static void check_sequence_symbols() {
+  printf("sequence-symbols\n");
+  std::string dir = scratch_dir("symbols");
+  char json[2][1024], again[1024], error[256];
+  check(audit_sequence_rules("SYM_GUESSING: SYM_LOGIN:SYM_OK SYM_TOTP:SYM_BAD",
+                             error, sizeof(error)),
+        "set rules before opening the store");
+  check(audit_store_open(dir.c_str()), "open a new store");
+  uint64_t ids[2] = {
+      audit_append("sym_user", "SYM_LOGIN", "SYM_OK", "10.7.7.7", "SYM_LOW",
+                   nullptr, 1700000000000LL),
+      audit_append("sym_user", "SYM_TOTP", "SYM_BAD", "10.7.7.7", "SYM_LOW",
+                   nullptr, 1700000001000LL)};
+  check(ids[0] && ids[1] && audit_event_json(ids[0], json[0], 1024) > 0 &&
+            audit_event_json(ids[1], json[1], 1024) > 0,
+        "log one event of each type the rules name");
+  audit_store_close();
+
+  // What another process would read back
+  std::unique_ptr<SymbolTable> saved(new SymbolTable());
+  bool same = saved->load((dir + "/symbols.dat").c_str());
+  for (const char *name : {"SYM_LOGIN", "SYM_TOTP", "SYM_OK", "SYM_BAD"})
+    same = same && saved->find(name) != SymbolTable::NO_SYMBOL &&
+           saved->find(name) == global_symbols().find(name);
+  check(same, "the symbol log holds the rules' names under their IDs");
+
+  check(audit_sequence_rules("SYM_OTHER: SYM_TOTP:SYM_BAD{2}", error,
+                             sizeof(error)) &&
+            audit_store_open(dir.c_str()),
+        "reopen under different rules");
+  check(audit_event_json(ids[0], again, sizeof(again)) > 0 &&
+            strcmp(again, json[0]) == 0 &&
+            audit_event_json(ids[1], again, sizeof(again)) > 0 &&
+            strcmp(again, json[1]) == 0,
+        "stored events decode the same");
+  audit_store_close();
+  audit_sequence_rules("", error, sizeof(error));
+  remove_store_dir(dir);
+}
+
+// --- Enforcement ---
+
+static int64_t wall_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// An alert as the bus delivers it, text cut to fit
+static AlertRecord make_alert(const std::string &username, const char *ip) {
+  AlertRecord rec = {};
+  snprintf(rec.username, sizeof(rec.username), "%s", username.c_str());
+  snprintf(rec.alert_type, sizeof(rec.alert_type), "BRUTE_FORCE");
+  snprintf(rec.severity, sizeof(rec.severity), "HIGH");
+  snprintf(rec.ip_address, sizeof(rec.ip_address), "%s", ip ? ip : "");
+  return rec;
+}
+
+static void check_enforcement() {
+  printf("enforcement\n");
+  std::unique_ptr<AlertBus> bus(new AlertBus());
+  std::unique_ptr<Enforcer> enforcer(new Enforcer(*bus));
+  enforcer->set_policy("BRUTE_FORCE",
+                       {ENFORCE_BLOCK_USER | ENFORCE_BLOCK_IP, 60000});
+
+  // Two names longer than an alert holds, alike for its whole length
+  std::string prefix(ENFORCEMENT_MAX_NAME, 'a');
+  std::string first = prefix + "-first", second = prefix + "-second";
+  enforcer->enforce(make_alert(first, "10.5.5.5"));
+  int64_t now = wall_ms();
+  check(enforcer->blocked_ms(second.c_str(), nullptr, now) == 0,
+        "a long name's block does not cover another with its prefix");
+  check(enforcer->blocked_ms(prefix.c_str(), nullptr, now) == 0 &&
+            enforcer->blocked_ms(first.substr(0, 63).c_str(), nullptr,
+                                 now) == 0,
+        "nor the names its alert was cut to");
+  check(enforcer->blocked_ms(first.c_str(), "10.5.5.5", now) > 0,
+        "its IP is still blocked");
+
+  enforcer->enforce(make_alert(prefix, nullptr));
+  check(enforcer->blocked_ms(prefix.c_str(), nullptr, now) > 0 &&
+            enforcer->blocked_ms((prefix + "b").c_str(), nullptr, now) == 0 &&
+            enforcer->blocked_ms(prefix.substr(1).c_str(), nullptr, now) == 0,
+        "the longest name enforced is blocked on its own");
+
+  // Fill the table with short blocks until inserts fail, let them expire,
+  // then block new users into their entries
+  enforcer.reset(new Enforcer(*bus));
+  enforcer->set_policy("BRUTE_FORCE", {ENFORCE_BLOCK_USER, 400});
+  EnforcementStats stats;
+  uint32_t filled = 0;
+  do {
+    enforcer->enforce(make_alert("old" + std::to_string(filled++), nullptr));
+    enforcer->stats(&stats);
+  } while (stats.table_full == 0 && filled < 4 * ENFORCEMENT_CAPACITY);
+  uint64_t full = stats.table_full;
+  check(full > 0, "short blocks fill the table");
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+  enforcer->set_policy("BRUTE_FORCE", {ENFORCE_BLOCK_USER, 60000});
+  for (int i = 0; i < 1000; i++)
+    enforcer->enforce(make_alert("new" + std::to_string(i), nullptr));
+  enforcer->stats(&stats);
+  now = wall_ms();
+  bool blocked = true;
+  for (int i = 0; i < 1000; i++)
+    blocked = blocked && enforcer->blocked_ms(("new" + std::to_string(i)).c_str(),
+                                              nullptr, now) > 0;
+  check(stats.table_full == full && blocked,
+        "new blocks take the entries of expired ones");
+  check(enforcer->blocked_ms("old0", nullptr, now) == 0 &&
+            enforcer->blocked_ms(("old" + std::to_string(filled - 2)).c_str(),
+                                 nullptr, now) == 0,
+        "expired users stay unblocked");
+}
+
+// --- Main ---
+
+struct CheckCommand {
+  const char *name;
+  void (*run)();
+};
+
+static const CheckCommand COMMANDS[] = {
+    {"audit-proofs", check_audit_proofs},
+    {"audit-recovery", check_audit_recovery},
+    {"intrusion-replay", check_intrusion_replay},
+    {"sequence-dfa", check_sequence_dfa},
+    {"sequence-symbols", check_sequence_symbols},
+    {"enforcement", check_enforcement},
+};
+
+static int usage() {
+  fprintf(stderr, "Usage: check_suite [subcommand]\nSubcommands:");
+  for (const CheckCommand &cmd : COMMANDS)
+    fprintf(stderr, " %s", cmd.name);
+  fprintf(stderr, "\n");
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 2)
+    return usage();
+  bool ran = false;
+  for (const CheckCommand &cmd : COMMANDS)
+    if (argc < 2 || strcmp(argv[1], cmd.name) == 0) {
+      cmd.run();
+      ran = true;
+    }
+  if (!ran)
+    return usage();
+  if (g_failures) {
+    printf("%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
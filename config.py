@@ -35,6 +35,69 @@ MAX_LOGIN_ATTEMPTS = 5
 # TOTP window in seconds (strict validation)
 TOTP_WINDOW_SECONDS = 30
 
+# =============================================================================
+# AUDIT LOG SETTINGS
+# =============================================================================
+
+# Events buffered in memory before the native audit writer applies the
+# overflow policy (0 = library default, 8192)
+AUDIT_QUEUE_CAPACITY = 8192
+
+# What log_event does when the buffer is full, per event type:
+#   "BLOCK"  - wait for the writer (never loses the event)
+#   "SPILL"  - write to audit_segments/spill.dat, drained later
+#   "SAMPLE" - keep 1 in 16, count the rest as dropped
+AUDIT_OVERFLOW_POLICY = {
+    "LOCKOUT": "BLOCK",
+    "REGISTRATION": "BLOCK",
+    "ENFORCEMENT": "BLOCK",
+    "LOGIN": "SPILL",
+    "TOTP": "SPILL",
+}
+AUDIT_DEFAULT_POLICY = "SPILL"
+
+# Unix socket for live audit subscribers (audit_viewer.py tail, SIEM
+# forwarders); None disables it. Not available on Windows.
+AUDIT_TAIL_SOCKET = "audit_segments/tail.sock"
+
+# =============================================================================
+# INTRUSION DETECTION
+# =============================================================================
+
+# Sequences of one user's events that raise an alert, followed by the native
+# intrusion engine as events are logged:
+#   ALERT_TYPE: (severity, steps, description)
+# Steps are EVENT:STATUS ("*" matches any); "{n}" repeats a step or a
+# (group). They must be the user's consecutive events among the types the
+# rules name, with no gap over 15 minutes.
+INTRUSION_SEQUENCES = {
+    "MFA_GUESSING": (
+        "HIGH", "LOGIN:SUCCESS TOTP:FAILURE{3}",
+        "Password accepted, then repeated TOTP failures - password likely compromised"),
+    "MFA_GUESSING_RELOGIN": (
+        "HIGH", "(LOGIN:SUCCESS TOTP:FAILURE){3}",
+        "Password accepted again and again, each time followed by a wrong TOTP code"),
+    "NEW_ACCOUNT_PROBING": (
+        "MEDIUM", "REGISTRATION:SUCCESS LOGIN:FAILURE{3}",
+        "Repeated failed logins right after the account was registered"),
+}
+
+# What the native enforcer does the moment an alert is raised, by alert type:
+#   ALERT_TYPE: (actions, seconds blocked)
+# Actions: "BLOCK_USER" and "BLOCK_IP" refuse logins by the user or from
+# the alert's IP until the block expires; "REVOKE" ends the user's sessions;
+# "STEP_UP" makes their sessions pass a TOTP check again. Every action is
+# written to the audit log as an ENFORCEMENT event. Types not listed only
+# alert.
+INTRUSION_ENFORCEMENT = {
+    "BRUTE_FORCE": (["BLOCK_USER", "BLOCK_IP"], 15 * 60),
+    "RAPID_FIRE": (["BLOCK_USER", "BLOCK_IP"], 30 * 60),
+    "MFA_GUESSING": (["BLOCK_USER", "REVOKE", "STEP_UP"], 15 * 60),
+    "MFA_GUESSING_RELOGIN": (["BLOCK_USER", "REVOKE", "STEP_UP"], 30 * 60),
+    "NEW_ACCOUNT_PROBING": (["BLOCK_IP"], 15 * 60),
+    "UNFAMILIAR_NETWORK": (["STEP_UP"], 0),
+}
+
 # =============================================================================
 # NOTES
 # =============================================================================
@@ -0,0 +1,223 @@
+#include "credential_loader.h"
+
+#include "crypto_core.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sqlite3.h>
+
+// --- SqliteCredentialSource ---
+
+SqliteCredentialSource::SqliteCredentialSource()
+    : m_db(nullptr), m_fetch(nullptr), m_fetch_name(nullptr),
+      m_max_rowid(0) {}
+
+SqliteCredentialSource::~SqliteCredentialSource() { close(); }
+
+bool SqliteCredentialSource::open(const char *db_path) {
+  close();
+
+  if (sqlite3_open_v2(db_path, &m_db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX,
+                      nullptr) != SQLITE_OK) {
+    close();
+    return false;
+  }
+
+  // Key index only: secrets stay on disk until first use
+  sqlite3_stmt *scan;
+  if (sqlite3_prepare_v2(m_db, "SELECT rowid, username FROM users", -1, &scan,
+                         nullptr) != SQLITE_OK) {
+    close();
+    return false;
+  }
+  while (sqlite3_step(scan) == SQLITE_ROW) {
+    IndexEntry e;
+    e.rowid = (uint64_t)sqlite3_column_int64(scan, 0);
+    const void *name = sqlite3_column_text(scan, 1);
+    int len = sqlite3_column_bytes(scan, 1);
+    e.key_hash = fnv1a64(name, (size_t)len);
+    m_index.push_back(e);
+    m_max_rowid = std::max(m_max_rowid, e.rowid);
+  }
+  sqlite3_finalize(scan);
+
+  std::sort(m_index.begin(), m_index.end(),
+            [](const IndexEntry &a, const IndexEntry &b) {
+              return a.key_hash < b.key_hash;
+            });
+
+  if (sqlite3_prepare_v2(m_db,
+                         "SELECT username, password_hash, totp_secret "
+                         "FROM users WHERE rowid = ?",
+                         -1, &m_fetch, nullptr) != SQLITE_OK ||
+      sqlite3_prepare_v2(m_db,
+                         "SELECT rowid, username, password_hash, totp_secret "
+                         "FROM users WHERE username = ?",
+                         -1, &m_fetch_name, nullptr) != SQLITE_OK) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void SqliteCredentialSource::close() {
+  if (m_fetch)
+    sqlite3_finalize(m_fetch);
+  if (m_fetch_name)
+    sqlite3_finalize(m_fetch_name);
+  if (m_db)
+    sqlite3_close(m_db);
+  m_fetch = nullptr;
+  m_fetch_name = nullptr;
+  m_db = nullptr;
+  m_index.clear();
+  m_max_rowid = 0;
+}
+
+size_t SqliteCredentialSource::count() {
+  std::lock_guard<std::mutex> guard(m_fetch_lock);
+  return m_index.size();
+}
+
+bool SqliteCredentialSource::fetch(const char *username, size_t len,
+                                   uint64_t key_hash, SnapshotRecord *out) {
+  std::lock_guard<std::mutex> guard(m_fetch_lock);
+  auto it = std::lower_bound(m_index.begin(), m_index.end(), key_hash,
+                             [](const IndexEntry &e, uint64_t h) {
+                               return e.key_hash < h;
+                             });
+  for (; it != m_index.end() && it->key_hash == key_hash; ++it) {
+    sqlite3_reset(m_fetch);
+    sqlite3_bind_int64(m_fetch, 1, (sqlite3_int64)it->rowid);
+    if (sqlite3_step(m_fetch) != SQLITE_ROW)
+      continue;
+
+    const char *name = (const char *)sqlite3_column_text(m_fetch, 0);
+    const char *pwd_hash = (const char *)sqlite3_column_text(m_fetch, 1);
+    const char *secret = (const char *)sqlite3_column_text(m_fetch, 2);
+    if (!name || !pwd_hash || !secret)
+      continue;
+
+    if (snapshot_fill_record(out, it->rowid, name, pwd_hash, secret) &&
+        snapshot_record_matches(*out, username, len)) {
+      sqlite3_reset(m_fetch);
+      return true;
+    }
+  }
+  sqlite3_reset(m_fetch);
+
+  // Not in the index: registered since open(), or unknown
+  bool found = false;
+  sqlite3_bind_text(m_fetch_name, 1, username, (int)len, SQLITE_STATIC);
+  if (sqlite3_step(m_fetch_name) == SQLITE_ROW) {
+    uint64_t rowid = (uint64_t)sqlite3_column_int64(m_fetch_name, 0);
+    const char *name = (const char *)sqlite3_column_text(m_fetch_name, 1);
+    const char *pwd_hash = (const char *)sqlite3_column_text(m_fetch_name, 2);
+    const char *secret = (const char *)sqlite3_column_text(m_fetch_name, 3);
+    found = name && pwd_hash && secret &&
+            snapshot_fill_record(out, rowid, name, pwd_hash, secret) &&
+            snapshot_record_matches(*out, username, len);
+    if (found) {
+      m_index.insert(it, IndexEntry{key_hash, rowid});
+      m_max_rowid = std::max(m_max_rowid, rowid);
+    }
+  }
+  sqlite3_reset(m_fetch_name);
+  sqlite3_clear_bindings(m_fetch_name);
+  return found;
+}
+
+bool load_rows_after(const char *db_path, uint64_t after_rowid,
+                     std::vector<SnapshotRecord> *out, uint64_t *max_rowid) {
+  *max_rowid = after_rowid;
+
+  sqlite3 *db;
+  if (sqlite3_open_v2(db_path, &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+    sqlite3_close(db);
+    return false;
+  }
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(db,
+                         "SELECT rowid, username, password_hash, totp_secret "
+                         "FROM users WHERE rowid > ? ORDER BY rowid",
+                         -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_close(db);
+    return false;
+  }
+  sqlite3_bind_int64(stmt, 1, (sqlite3_int64)after_rowid);
+
+  SnapshotRecord rec;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    uint64_t rowid = (uint64_t)sqlite3_column_int64(stmt, 0);
+    const char *name = (const char *)sqlite3_column_text(stmt, 1);
+    const char *pwd_hash = (const char *)sqlite3_column_text(stmt, 2);
+    const char *secret = (const char *)sqlite3_column_text(stmt, 3);
+    *max_rowid = std::max(*max_rowid, rowid);
+    if (name && pwd_hash && secret &&
+        snapshot_fill_record(&rec, rowid, name, pwd_hash, secret))
+      out->push_back(rec);
+  }
+
+  sqlite3_finalize(stmt);
+  sqlite3_close(db);
+  return true;
+}
+
+// --- Warm List ---
+
+const char WARM_MAGIC[8] = {'S', 'A', 'W', 'A', 'R', 'M', '0', '1'};
+
+bool warm_list_save(const char *path, std::vector<WarmEntry> &entries) {
+  std::sort(entries.begin(), entries.end(),
+            [](const WarmEntry &a, const WarmEntry &b) {
+              return a.hits > b.hits;
+            });
+
+  std::string tmp_path = std::string(path) + ".tmp";
+  FILE *f = fopen(tmp_path.c_str(), "wb");
+  if (!f)
+    return false;
+
+  uint32_t count = (uint32_t)entries.size();
+  bool ok = fwrite(WARM_MAGIC, 8, 1, f) == 1 && fwrite(&count, 4, 1, f) == 1;
+  for (const WarmEntry &e : entries) {
+    if (!ok)
+      break;
+    uint8_t len = (uint8_t)std::min(e.name.size(), SNAPSHOT_MAX_USERNAME);
+    ok = fwrite(&e.hits, 4, 1, f) == 1 && fwrite(&len, 1, 1, f) == 1 &&
+         fwrite(e.name.data(), 1, len, f) == len;
+  }
+  ok = (fclose(f) == 0) && ok;
+
+  if (!ok || !replace_file(tmp_path.c_str(), path)) {
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool warm_list_load(const char *path, std::vector<WarmEntry> *entries) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+
+  char magic[8];
+  uint32_t count;
+  bool ok = fread(magic, 8, 1, f) == 1 && memcmp(magic, WARM_MAGIC, 8) == 0 &&
+            fread(&count, 4, 1, f) == 1;
+  for (uint32_t i = 0; ok && i < count; i++) {
+    WarmEntry e;
+    uint8_t len;
+    char name[256];
+    ok = fread(&e.hits, 4, 1, f) == 1 && fread(&len, 1, 1, f) == 1 &&
+         len <= SNAPSHOT_MAX_USERNAME && fread(name, 1, len, f) == len;
+    if (ok) {
+      e.name.assign(name, len);
+      entries->push_back(e);
+    }
+  }
+  fclose(f);
+  return ok;
+}
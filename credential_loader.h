@@ -0,0 +1,74 @@
+#pragma once
+
+#include "credential_snapshot.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// --- Lazy Credential Loading ---
+// Startup only reads (rowid, username) from users.db to build a key index.
+// Password hashes and TOTP secrets are read and decoded per user on first
+// use. A name the index does not know is looked up by username, so users
+// who register after startup are found (and added to the index).
+
+struct IndexEntry {
+  uint64_t key_hash;
+  uint64_t rowid;
+};
+
+//
+// SqliteCredentialSource - key index over users.db with on-demand fetch
+//
+class SqliteCredentialSource {
+private:
+  sqlite3 *m_db;
+  sqlite3_stmt *m_fetch;
+  sqlite3_stmt *m_fetch_name; // index misses
+  // A prepared statement is not re-entrant; also guards m_index, which
+  // grows on misses
+  std::mutex m_fetch_lock;
+  std::vector<IndexEntry> m_index; // sorted by key_hash
+  uint64_t m_max_rowid;
+
+public:
+  SqliteCredentialSource();
+  ~SqliteCredentialSource();
+
+  SqliteCredentialSource(const SqliteCredentialSource &) = delete;
+  SqliteCredentialSource &operator=(const SqliteCredentialSource &) = delete;
+
+  bool open(const char *db_path);
+  void close();
+
+  bool is_open() const { return m_db != nullptr; }
+  size_t count();
+  uint64_t max_rowid() const { return m_max_rowid; }
+
+  // Read and decode one user's credentials. False for unknown users.
+  bool fetch(const char *username, size_t len, uint64_t key_hash,
+             SnapshotRecord *out);
+};
+
+// Decode every users.db row with rowid > `after_rowid` (registrations made
+// after a snapshot was cut). `max_rowid` receives the highest rowid seen.
+bool load_rows_after(const char *db_path, uint64_t after_rowid,
+                     std::vector<SnapshotRecord> *out, uint64_t *max_rowid);
+
+// --- Warm List ---
+// Usernames of the hot tier at shutdown, most accessed first. Replayed by
+// the background warmer after a restart so the working set is resident
+// before it is asked for.
+
+struct WarmEntry {
+  uint32_t hits;
+  std::string name;
+};
+
+bool warm_list_save(const char *path, std::vector<WarmEntry> &entries);
+bool warm_list_load(const char *path, std::vector<WarmEntry> *entries);
@@ -0,0 +1,290 @@
+#include "credential_snapshot.h"
+
+#include "crypto_core.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// --- Record Helpers ---
+
+bool snapshot_fill_record(SnapshotRecord *rec, uint64_t rowid,
+                          const char *username, const char *password_hash_hex,
+                          const char *totp_secret_b32) {
+  memset(rec, 0, sizeof(*rec));
+
+  size_t len = strlen(username);
+  if (len == 0 || len > SNAPSHOT_MAX_USERNAME)
+    return false;
+
+  if (hex_decode(password_hash_hex, rec->password_sha256,
+                 sizeof(rec->password_sha256)) != 32)
+    return false;
+
+  int secret_len =
+      base32_decode(totp_secret_b32, rec->totp_secret, sizeof(rec->totp_secret));
+  if (secret_len <= 0)
+    return false;
+
+  rec->key_hash = fnv1a64(username, len);
+  rec->name_len = (uint8_t)len;
+  rec->secret_len = (uint8_t)secret_len;
+  rec->rowid = (uint32_t)rowid;
+  memcpy(rec->name, username, len);
+  return true;
+}
+
+bool snapshot_record_matches(const SnapshotRecord &rec, const char *username,
+                             size_t len) {
+  return rec.name_len == len && memcmp(rec.name, username, len) == 0;
+}
+
+// Word-at-a-time mix; cheap enough to verify a multi-GB snapshot on load
+uint64_t snapshot_checksum_update(uint64_t hash, const SnapshotRecord *records,
+                                  size_t count) {
+  const uint8_t *p = (const uint8_t *)records;
+  size_t words = count * sizeof(SnapshotRecord) / 8;
+  for (size_t i = 0; i < words; i++) {
+    uint64_t w;
+    memcpy(&w, p + i * 8, 8);
+    hash ^= w;
+    hash *= 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 29;
+  }
+  return hash;
+}
+
+uint64_t snapshot_checksum(const SnapshotRecord *records, size_t count) {
+  return snapshot_checksum_update(SNAPSHOT_CHECKSUM_SEED, records, count);
+}
+
+static bool record_less(const SnapshotRecord &a, const SnapshotRecord &b) {
+  if (a.key_hash != b.key_hash)
+    return a.key_hash < b.key_hash;
+  return a.rowid < b.rowid;
+}
+
+bool replace_file(const char *from, const char *to) {
+#ifdef _WIN32
+  return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  return std::rename(from, to) == 0;
+#endif
+}
+
+bool snapshot_write(const char *path, std::vector<SnapshotRecord> &records,
+                    uint64_t cutoff_rowid) {
+  std::sort(records.begin(), records.end(), record_less);
+
+  SnapshotWriter writer;
+  return writer.begin(path) && writer.append(records.data(), records.size()) &&
+         writer.finish(cutoff_rowid);
+}
+
+// --- SnapshotWriter ---
+
+SnapshotWriter::SnapshotWriter() : m_file(nullptr), m_count(0), m_checksum(0) {}
+
+SnapshotWriter::~SnapshotWriter() { abort(); }
+
+bool SnapshotWriter::begin(const char *path) {
+  abort();
+  m_path = path;
+  m_tmp_path = m_path + ".tmp";
+  m_count = 0;
+  m_checksum = SNAPSHOT_CHECKSUM_SEED;
+
+  m_file = fopen(m_tmp_path.c_str(), "wb");
+  if (!m_file)
+    return false;
+
+  // Placeholder header, rewritten by finish()
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  if (fwrite(&header, sizeof(header), 1, m_file) != 1) {
+    abort();
+    return false;
+  }
+  return true;
+}
+
+bool SnapshotWriter::append(const SnapshotRecord *records, size_t count) {
+  if (!m_file)
+    return false;
+  if (count == 0)
+    return true;
+  if (fwrite(records, sizeof(SnapshotRecord), count, m_file) != count) {
+    abort();
+    return false;
+  }
+  m_checksum = snapshot_checksum_update(m_checksum, records, count);
+  m_count += count;
+  return true;
+}
+
+bool SnapshotWriter::finish(uint64_t cutoff_rowid) {
+  if (!m_file)
+    return false;
+
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.record_size = sizeof(SnapshotRecord);
+  header.record_count = m_count;
+  header.cutoff_rowid = cutoff_rowid;
+  header.created_at = (uint64_t)std::time(0);
+  header.checksum = m_checksum;
+
+  bool ok = fseek(m_file, 0, SEEK_SET) == 0 &&
+            fwrite(&header, sizeof(header), 1, m_file) == 1;
+  ok = (fflush(m_file) == 0) && ok;
+#ifndef _WIN32
+  ok = ok && fsync(fileno(m_file)) == 0;
+#endif
+  ok = (fclose(m_file) == 0) && ok;
+  m_file = nullptr;
+
+  if (!ok || !replace_file(m_tmp_path.c_str(), m_path.c_str())) {
+    std::remove(m_tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+void SnapshotWriter::abort() {
+  if (!m_file)
+    return;
+  fclose(m_file);
+  m_file = nullptr;
+  std::remove(m_tmp_path.c_str());
+}
+
+// --- SnapshotView ---
+
+SnapshotView::SnapshotView()
+    : m_base(nullptr), m_size(0),
+#ifdef _WIN32
+      m_file(nullptr), m_mapping(nullptr),
+#endif
+      m_header(nullptr), m_records(nullptr), m_count(0) {
+}
+
+SnapshotView::~SnapshotView() { close(); }
+
+bool SnapshotView::open(const char *path, bool verify_checksum) {
+  close();
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(SnapshotHeader)) {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!mapping) {
+    CloseHandle(file);
+    return false;
+  }
+  void *base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!base) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  m_file = file;
+  m_mapping = mapping;
+  m_base = base;
+  m_size = (size_t)size.QuadPart;
+#else
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SnapshotHeader)) {
+    ::close(fd);
+    return false;
+  }
+  void *base = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (base == MAP_FAILED)
+    return false;
+  // Lookups are binary searches: readahead would only pull in cold pages
+  madvise(base, (size_t)st.st_size, MADV_RANDOM);
+  m_base = base;
+  m_size = (size_t)st.st_size;
+#endif
+
+  m_header = (const SnapshotHeader *)m_base;
+  m_records = (const SnapshotRecord *)((const uint8_t *)m_base +
+                                       sizeof(SnapshotHeader));
+  m_count = (size_t)m_header->record_count;
+
+  bool valid = memcmp(m_header->magic, SNAPSHOT_MAGIC, 8) == 0 &&
+               m_header->version == SNAPSHOT_VERSION &&
+               m_header->record_size == sizeof(SnapshotRecord) &&
+               m_count <= (m_size - sizeof(SnapshotHeader)) /
+                              sizeof(SnapshotRecord);
+  if (valid && verify_checksum)
+    valid = snapshot_checksum(m_records, m_count) == m_header->checksum;
+
+  if (!valid) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void SnapshotView::close() {
+  if (!m_base)
+    return;
+#ifdef _WIN32
+  UnmapViewOfFile(m_base);
+  CloseHandle((HANDLE)m_mapping);
+  CloseHandle((HANDLE)m_file);
+  m_file = nullptr;
+  m_mapping = nullptr;
+#else
+  munmap(m_base, m_size);
+#endif
+  m_base = nullptr;
+  m_size = 0;
+  m_header = nullptr;
+  m_records = nullptr;
+  m_count = 0;
+}
+
+const SnapshotRecord *SnapshotView::find(const char *username, size_t len,
+                                         uint64_t key_hash) const {
+  // Lower bound on key hash
+  size_t lo = 0, hi = m_count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (m_records[mid].key_hash < key_hash)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  // Walk hash collisions (practically never more than one record)
+  for (size_t i = lo; i < m_count && m_records[i].key_hash == key_hash; i++) {
+    if (snapshot_record_matches(m_records[i], username, len))
+      return &m_records[i];
+  }
+  return nullptr;
+}
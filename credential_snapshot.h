@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// --- Credential Snapshot Format ---
+// Binary, memory-mappable image of users.db. Fixed-size records sorted by
+// username key hash, so a lookup is a binary search over the mapping and no
+// per-user state has to be resident.
+//
+// Layout: [SnapshotHeader][SnapshotRecord x record_count]
+
+const char SNAPSHOT_MAGIC[8] = {'S', 'A', 'S', 'N', 'A', 'P', '0', '1'};
+const uint32_t SNAPSHOT_VERSION = 1;
+
+const size_t SNAPSHOT_MAX_USERNAME = 48; // bytes, not NUL terminated
+const size_t SNAPSHOT_MAX_SECRET = 32;   // decoded TOTP secret bytes
+
+// SnapshotRecord::flags: the low byte is the user's TotpPolicyId
+// (totp_policy.h), 0 - pyotp's defaults - for every user user_db.py makes
+const uint16_t SNAPSHOT_TOTP_POLICY_MASK = 0x00ff;
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t record_count;
+  uint64_t cutoff_rowid; // highest users.db rowid included
+  uint64_t created_at;   // unix seconds
+  uint64_t checksum;     // snapshot_checksum() over the record area
+  uint8_t reserved[16];
+};
+
+struct SnapshotRecord {
+  uint64_t key_hash; // fnv1a64(username)
+  uint8_t name_len;
+  uint8_t secret_len;
+  uint16_t flags;
+  uint32_t rowid;
+  char name[SNAPSHOT_MAX_USERNAME];
+  uint8_t password_sha256[32];
+  uint8_t totp_secret[SNAPSHOT_MAX_SECRET];
+};
+
+static_assert(sizeof(SnapshotHeader) == 64, "snapshot header must be 64 bytes");
+static_assert(sizeof(SnapshotRecord) == 128, "snapshot record must be 128 bytes");
+
+// Fill a record from the text columns stored by user_db.py
+// (hex SHA-256 password hash, Base32 TOTP secret). False if malformed.
+bool snapshot_fill_record(SnapshotRecord *rec, uint64_t rowid,
+                          const char *username, const char *password_hash_hex,
+                          const char *totp_secret_b32);
+
+bool snapshot_record_matches(const SnapshotRecord &rec, const char *username,
+                             size_t len);
+
+const uint64_t SNAPSHOT_CHECKSUM_SEED = 14695981039346656037ULL;
+
+// Incremental form, for writers that stream records in several batches
+uint64_t snapshot_checksum_update(uint64_t hash, const SnapshotRecord *records,
+                                  size_t count);
+uint64_t snapshot_checksum(const SnapshotRecord *records, size_t count);
+
+// Rename `from` over `to`, replacing any existing file
+bool replace_file(const char *from, const char *to);
+
+// Sort `records` by key hash and write them to `path`.
+// Writes to `path.tmp` first and renames, so readers never see a partial file.
+bool snapshot_write(const char *path, std::vector<SnapshotRecord> &records,
+                    uint64_t cutoff_rowid);
+
+//
+// SnapshotWriter - streams already-sorted records into a snapshot file
+//
+// Same temp + rename protocol as snapshot_write(); the header (count and
+// checksum) is filled in by finish().
+//
+class SnapshotWriter {
+private:
+  FILE *m_file;
+  std::string m_path;
+  std::string m_tmp_path;
+  uint64_t m_count;
+  uint64_t m_checksum;
+
+public:
+  SnapshotWriter();
+  ~SnapshotWriter();
+
+  bool begin(const char *path);
+  bool append(const SnapshotRecord *records, size_t count);
+  bool finish(uint64_t cutoff_rowid);
+  void abort();
+};
+
+//
+// SnapshotView - read-only memory mapping of a snapshot file
+//
+class SnapshotView {
+private:
+  void *m_base;
+  size_t m_size;
+#ifdef _WIN32
+  void *m_file;
+  void *m_mapping;
+#endif
+  const SnapshotHeader *m_header;
+  const SnapshotRecord *m_records;
+  size_t m_count;
+
+public:
+  SnapshotView();
+  ~SnapshotView();
+
+  SnapshotView(const SnapshotView &) = delete;
+  SnapshotView &operator=(const SnapshotView &) = delete;
+
+  // Map the file and check magic/version/size. Checksum verification walks
+  // every page, so it is optional.
+  bool open(const char *path, bool verify_checksum);
+  void close();
+
+  bool is_open() const { return m_base != nullptr; }
+  size_t count() const { return m_count; }
+  const SnapshotHeader *header() const { return m_header; }
+  const SnapshotRecord *records() const { return m_records; }
+
+  const SnapshotRecord *find(const char *username, size_t len,
+                             uint64_t key_hash) const;
+};
@@ -0,0 +1,494 @@
+#include "credential_store.h"
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+
+// Input limit, same as validate_login() in auth_core.cpp
+const size_t MAX_INPUT_LENGTH = 50;
+
+static void wipe(void *p, size_t len) {
+  volatile uint8_t *v = (volatile uint8_t *)p;
+  while (len--)
+    *v++ = 0;
+}
+
+// --- Verification ---
+
+// The whole password is hashed, as user_db.hash_password() does: a cut
+// would let any input that starts with a user's password verify, and a
+// longer registered password never would.
+bool password_matches(const uint8_t stored_sha256[32], const char *password) {
+  uint8_t digest[32];
+  sha256((const uint8_t *)password, strlen(password), digest);
+  bool ok = constant_time_equal(digest, stored_sha256, 32);
+  wipe(digest, sizeof(digest));
+  return ok;
+}
+
+bool totp_matches(const SnapshotRecord &rec, int code, time_t now) {
+  TotpKey key;
+  totp_key_init(&key, (uint8_t)(rec.flags & SNAPSHOT_TOTP_POLICY_MASK),
+                rec.totp_secret, rec.secret_len);
+  bool ok = totp_verify(key, code, now);
+  wipe(&key, sizeof(key));
+  return ok;
+}
+
+// --- HotTier ---
+
+HotTier::HotTier(uint64_t budget_bytes)
+    : m_mask(0), m_size(0), m_max_live(0), m_hand(0) {
+  size_t slots = 16;
+  while ((uint64_t)(slots * 2) * sizeof(HotEntry) <= budget_bytes)
+    slots *= 2;
+
+  m_slots.assign(slots, HotEntry());
+  memset(m_slots.data(), 0, slots * sizeof(HotEntry));
+  m_mask = slots - 1;
+  // Keep linear probe chains short
+  m_max_live = slots - slots / 4;
+}
+
+HotEntry *HotTier::find(const char *username, size_t len, uint64_t key_hash,
+                        uint32_t generation, bool touch) {
+  for (size_t i = key_hash & m_mask;; i = (i + 1) & m_mask) {
+    HotEntry &e = m_slots[i];
+    if (!e.live)
+      return nullptr;
+    if (e.key_hash == key_hash && e.name_len == len &&
+        memcmp(e.name, username, len) == 0) {
+      if (e.generation != generation) {
+        // Promoted from a snapshot that has since been replaced
+        erase_slot(i);
+        return nullptr;
+      }
+      if (touch) {
+        e.referenced = 1;
+        if (e.hits != UINT32_MAX)
+          e.hits++;
+      }
+      return &e;
+    }
+  }
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones
+void HotTier::erase_slot(size_t index) {
+  size_t hole = index;
+  for (size_t j = (hole + 1) & m_mask; m_slots[j].live; j = (j + 1) & m_mask) {
+    size_t home = m_slots[j].key_hash & m_mask;
+    bool stays = (hole <= j) ? (hole < home && home <= j)
+                             : (hole < home || home <= j);
+    if (stays)
+      continue;
+    m_slots[hole] = m_slots[j];
+    hole = j;
+  }
+  wipe(&m_slots[hole], sizeof(HotEntry));
+  m_size--;
+}
+
+HotEntry *HotTier::insert(const SnapshotRecord &rec, uint32_t generation,
+                          bool *evicted) {
+  *evicted = false;
+
+  if (m_size >= m_max_live) {
+    // CLOCK: clear reference bits until an unreferenced entry comes round
+    for (;;) {
+      HotEntry &e = m_slots[m_hand];
+      size_t victim = m_hand;
+      m_hand = (m_hand + 1) & m_mask;
+      if (!e.live)
+        continue;
+      if (e.referenced) {
+        e.referenced = 0;
+        continue;
+      }
+      erase_slot(victim);
+      *evicted = true;
+      break;
+    }
+  }
+
+  size_t i = rec.key_hash & m_mask;
+  while (m_slots[i].live)
+    i = (i + 1) & m_mask;
+
+  HotEntry &e = m_slots[i];
+  e.key_hash = rec.key_hash;
+  e.live = 1;
+  e.referenced = 1;
+  e.name_len = rec.name_len;
+  e.rowid = rec.rowid;
+  e.hits = 0;
+  e.generation = generation;
+  memcpy(e.name, rec.name, sizeof(e.name));
+  memcpy(e.password_sha256, rec.password_sha256, sizeof(e.password_sha256));
+  totp_key_init(&e.totp_key, (uint8_t)(rec.flags & SNAPSHOT_TOTP_POLICY_MASK),
+                rec.totp_secret, rec.secret_len);
+  m_size++;
+  return &e;
+}
+
+void HotTier::collect(std::vector<WarmEntry> *out) const {
+  for (const HotEntry &e : m_slots) {
+    if (!e.live)
+      continue;
+    WarmEntry w;
+    w.hits = e.hits;
+    w.name.assign(e.name, e.name_len);
+    out->push_back(w);
+  }
+}
+
+void HotTier::clear() {
+  wipe(m_slots.data(), m_slots.size() * sizeof(HotEntry));
+  m_size = 0;
+  m_hand = 0;
+}
+
+// --- TieredStore ---
+
+TieredStore::TieredStore(uint64_t budget_bytes)
+    : m_hot(budget_bytes), m_snapshot(nullptr), m_generation(0),
+      m_stop_warmer(false) {
+  memset(&m_stats, 0, sizeof(m_stats));
+  m_stats.budget_bytes = budget_bytes;
+}
+
+TieredStore::~TieredStore() {
+  m_stop_warmer = true;
+  if (m_warmer.joinable())
+    m_warmer.join();
+
+  // Remember the working set for the next start
+  if (!m_warm_path.empty()) {
+    std::vector<WarmEntry> entries;
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_hot.collect(&entries);
+    }
+    warm_list_save(m_warm_path.c_str(), entries);
+  }
+
+  delete m_snapshot.load();
+  for (auto &kv : m_overlay)
+    wipe(&kv.second, sizeof(kv.second));
+}
+
+void TieredStore::delete_generation(void *p) {
+  delete (SnapshotGeneration *)p;
+}
+
+bool TieredStore::open(const char *snapshot_path, const char *delta_db_path) {
+  if (delta_db_path)
+    m_delta_db = delta_db_path;
+  if (!swap_snapshot(snapshot_path))
+    return false;
+  start_warmer(snapshot_path);
+  return true;
+}
+
+bool TieredStore::open_db(const char *db_path) {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_hot.clear();
+    if (!m_db.open(db_path))
+      return false;
+  }
+  start_warmer(db_path);
+  return true;
+}
+
+bool TieredStore::swap_snapshot(const char *snapshot_path) {
+  std::lock_guard<std::mutex> swap_guard(m_swap_lock);
+
+  // Map and checksum the new file before anyone can see it
+  SnapshotGeneration *next = new SnapshotGeneration();
+  if (!next->view.open(snapshot_path, true)) {
+    delete next;
+    return false;
+  }
+  next->generation = m_generation.load() + 1;
+
+  std::vector<SnapshotRecord> delta;
+  uint64_t max_rowid;
+  if (!m_delta_db.empty())
+    load_rows_after(m_delta_db.c_str(), next->view.header()->cutoff_rowid,
+                    &delta, &max_rowid);
+
+  // Publish first, then swap the overlay: a reader checks the overlay
+  // before loading the snapshot, so it never pairs the new overlay with
+  // the old snapshot
+  SnapshotGeneration *prev = m_snapshot.exchange(next);
+  m_generation.store(next->generation);
+
+  {
+    std::unique_lock<std::shared_mutex> guard(m_overlay_lock);
+    std::unordered_map<std::string, SnapshotRecord> overlay;
+    for (const SnapshotRecord &rec : delta)
+      overlay[std::string(rec.name, rec.name_len)] = rec;
+    // Users added through add_user() that the new snapshot doesn't cover
+    for (auto &kv : m_overlay) {
+      const SnapshotRecord &rec = kv.second;
+      if (!overlay.count(kv.first) &&
+          !next->view.find(rec.name, rec.name_len, rec.key_hash))
+        overlay[kv.first] = rec;
+      wipe(&kv.second, sizeof(kv.second));
+    }
+    m_overlay.swap(overlay);
+  }
+  for (SnapshotRecord &rec : delta)
+    wipe(&rec, sizeof(rec));
+
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_stats.swaps++;
+  }
+
+  // Unmap the old snapshot once in-flight logins have left it
+  if (prev) {
+    m_epochs.retire(prev, delete_generation);
+    for (int i = 0; i < 1000 && m_epochs.pending() > 0; i++) {
+      if (m_epochs.reclaim() == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  return true;
+}
+
+bool TieredStore::add_user(const char *username, const char *password_hash_hex,
+                           const char *totp_secret_b32) {
+  SnapshotRecord rec;
+  if (!snapshot_fill_record(&rec, UINT32_MAX, username, password_hash_hex,
+                            totp_secret_b32))
+    return false;
+
+  std::unique_lock<std::shared_mutex> guard(m_overlay_lock);
+  m_overlay[std::string(rec.name, rec.name_len)] = rec;
+  wipe(&rec, sizeof(rec));
+  return true;
+}
+
+void TieredStore::start_warmer(const char *source_path) {
+  m_warm_path = std::string(source_path) + ".warm";
+  m_warmer = std::thread(&TieredStore::warm_loop, this);
+}
+
+// Fault in last run's working set, most accessed users first, until the
+// hot tier is full. Logins are served concurrently the whole time.
+void TieredStore::warm_loop() {
+  std::vector<WarmEntry> entries;
+  warm_list_load(m_warm_path.c_str(), &entries);
+
+  for (const WarmEntry &w : entries) {
+    if (m_stop_warmer)
+      return;
+    const char *name = w.name.c_str();
+    size_t len = w.name.size();
+    uint64_t key_hash = fnv1a64(name, len);
+
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      if (m_hot.size() >= m_hot.capacity())
+        return;
+      if (m_hot.find(name, len, key_hash, m_generation.load(), false))
+        continue;
+    }
+
+    SnapshotRecord rec;
+    uint32_t generation;
+    if (!fetch_cold(name, len, key_hash, &rec, &generation))
+      continue;
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (!m_hot.find(name, len, key_hash, m_generation.load(), false)) {
+      bool evicted;
+      HotEntry *e = m_hot.insert(rec, generation, &evicted);
+      e->referenced = 0; // warmed, not yet asked for
+      m_stats.warmed++;
+    }
+    wipe(&rec, sizeof(rec));
+  }
+}
+
+bool TieredStore::fetch_cold(const char *username, size_t len,
+                             uint64_t key_hash, SnapshotRecord *out,
+                             uint32_t *generation) {
+  {
+    std::shared_lock<std::shared_mutex> guard(m_overlay_lock);
+    if (!m_overlay.empty()) {
+      auto it = m_overlay.find(std::string(username, len));
+      if (it != m_overlay.end()) {
+        *out = it->second;
+        *generation = m_generation.load();
+        return true;
+      }
+    }
+  }
+
+  {
+    EpochGuard guard(m_epochs);
+    SnapshotGeneration *snap = m_snapshot.load();
+    if (snap) {
+      *generation = snap->generation;
+      const SnapshotRecord *rec = snap->view.find(username, len, key_hash);
+      if (!rec)
+        return false;
+      *out = *rec;
+      return true;
+    }
+  }
+
+  *generation = m_generation.load();
+  if (m_db.is_open())
+    return m_db.fetch(username, len, key_hash, out);
+  return false;
+}
+
+bool TieredStore::lookup(const char *username, HotEntry *out) {
+  size_t len = strnlen(username, MAX_INPUT_LENGTH);
+  if (len == 0 || len > SNAPSHOT_MAX_USERNAME)
+    return false;
+  return lookup(username, len, fnv1a64(username, len), out);
+}
+
+bool TieredStore::lookup(const char *username, size_t len, uint64_t key_hash,
+                         HotEntry *out) {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    HotEntry *e = m_hot.find(username, len, key_hash, m_generation.load());
+    if (e) {
+      m_stats.hot_hits++;
+      *out = *e;
+      return true;
+    }
+  }
+
+  // Page faults / SQLite reads happen outside the store lock
+  SnapshotRecord rec;
+  uint32_t generation;
+  bool found = fetch_cold(username, len, key_hash, &rec, &generation);
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (!found) {
+    m_stats.misses++;
+    return false;
+  }
+
+  // Another thread may have promoted the same user meanwhile
+  HotEntry *e = m_hot.find(username, len, key_hash, m_generation.load());
+  if (!e) {
+    bool evicted;
+    e = m_hot.insert(rec, generation, &evicted);
+    m_stats.promotions++;
+    if (evicted)
+      m_stats.evictions++;
+  }
+  m_stats.cold_hits++;
+  *out = *e;
+  wipe(&rec, sizeof(rec));
+  return true;
+}
+
+bool TieredStore::verify_password(const char *username, const char *password) {
+  HotEntry entry;
+  bool ok = lookup(username, &entry) &&
+            password_matches(entry.password_sha256, password);
+  wipe(&entry, sizeof(entry));
+  return ok;
+}
+
+bool TieredStore::verify_totp(const char *username, int code, time_t now) {
+  HotEntry entry;
+  bool ok = lookup(username, &entry) && totp_verify(entry.totp_key, code, now);
+  wipe(&entry, sizeof(entry));
+  return ok;
+}
+
+void TieredStore::stats(StoreStats *out) {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    *out = m_stats;
+    out->hot_entries = m_hot.size();
+    out->hot_capacity = m_hot.capacity();
+  }
+  out->generation = m_generation.load();
+  out->retired_pending = m_epochs.pending();
+  std::shared_lock<std::shared_mutex> guard(m_overlay_lock);
+  out->overlay_entries = m_overlay.size();
+}
+
+// --- Exported Functions for Python ---
+
+// Store calls share the lock; only open/close replace the store itself
+static std::unique_ptr<TieredStore> g_store;
+static std::shared_mutex g_store_lock;
+
+extern "C" {
+
+// Open (or reopen) the credential store over a snapshot file.
+// `budget_bytes` bounds the memory used by the hot tier. `db_path` (may be
+// NULL) is replayed for registrations newer than the snapshot.
+bool tiered_store_open(const char *snapshot_path, const char *db_path,
+                       uint64_t budget_bytes) {
+  std::unique_ptr<TieredStore> store(new TieredStore(budget_bytes));
+  if (!store->open(snapshot_path, db_path))
+    return false;
+
+  std::unique_lock<std::shared_mutex> guard(g_store_lock);
+  g_store = std::move(store);
+  return true;
+}
+
+// Open over users.db directly. Only usernames are read at startup;
+// credentials are decoded on first use and warmed in the background.
+bool tiered_store_open_db(const char *db_path, uint64_t budget_bytes) {
+  std::unique_ptr<TieredStore> store(new TieredStore(budget_bytes));
+  if (!store->open_db(db_path))
+    return false;
+
+  std::unique_lock<std::shared_mutex> guard(g_store_lock);
+  g_store = std::move(store);
+  return true;
+}
+
+void tiered_store_close() {
+  std::unique_lock<std::shared_mutex> guard(g_store_lock);
+  g_store.reset();
+}
+
+// Switch to a freshly built snapshot without pausing logins
+bool tiered_store_swap(const char *snapshot_path) {
+  std::shared_lock<std::shared_mutex> guard(g_store_lock);
+  return g_store && g_store->swap_snapshot(snapshot_path);
+}
+
+// Called after user_db.register_user() so the user can log in immediately
+bool tiered_store_add_user(const char *username, const char *password_hash_hex,
+                           const char *totp_secret_b32) {
+  std::shared_lock<std::shared_mutex> guard(g_store_lock);
+  return g_store &&
+         g_store->add_user(username, password_hash_hex, totp_secret_b32);
+}
+
+bool tiered_validate_login(const char *username, const char *password) {
+  std::shared_lock<std::shared_mutex> guard(g_store_lock);
+  return g_store && g_store->verify_password(username, password);
+}
+
+bool tiered_validate_totp(const char *username, int user_code) {
+  std::shared_lock<std::shared_mutex> guard(g_store_lock);
+  return g_store && g_store->verify_totp(username, user_code, std::time(0));
+}
+
+// Hit-rate counters for the hot/cold tiers
+bool tiered_store_stats(StoreStats *out) {
+  std::shared_lock<std::shared_mutex> guard(g_store_lock);
+  if (!g_store)
+    return false;
+  g_store->stats(out);
+  return true;
+}
+}
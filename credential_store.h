@@ -0,0 +1,176 @@
+#pragma once
+
+#include "credential_loader.h"
+#include "credential_snapshot.h"
+#include "crypto_core.h"
+#include "epoch_reclaim.h"
+#include "totp_policy.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// --- Tiered Credential Store ---
+// Hot tier: bounded open-addressing table of decoded credentials with the
+// HMAC pads for the user's TOTP secret already absorbed, under their TOTP
+// policy (see totp_policy.h).
+// Cold tier: memory-mapped credential snapshot (see credential_snapshot.h),
+// or users.db itself through the lazy key index (see credential_loader.h).
+// A cold hit promotes the user into the hot tier; CLOCK picks the victim
+// when the hot tier is at its memory budget.
+//
+// A new snapshot is published with an atomic pointer swap; readers hold it
+// inside an epoch guard, so the old mapping is unmapped only after the last
+// login using it has finished. Users registered after the snapshot cut-off
+// live in a small overlay replayed from users.db on every swap.
+
+// Resident credential material for one user
+struct HotEntry {
+  uint64_t key_hash;
+  uint8_t live;
+  uint8_t referenced; // CLOCK reference bit
+  uint8_t name_len;
+  uint8_t reserved;
+  uint32_t rowid;
+  uint32_t hits;       // accesses while resident, feeds the warm list
+  uint32_t generation; // snapshot generation it was promoted from
+  char name[SNAPSHOT_MAX_USERNAME];
+  uint8_t password_sha256[32];
+  TotpKey totp_key;
+};
+
+// Layout shared with Python (ctypes.Structure) - keep fields 64-bit
+struct StoreStats {
+  uint64_t hot_hits;
+  uint64_t cold_hits;
+  uint64_t misses;
+  uint64_t promotions;
+  uint64_t evictions;
+  uint64_t hot_entries;
+  uint64_t hot_capacity;
+  uint64_t budget_bytes;
+  uint64_t warmed; // entries faulted in by the background warmer
+  uint64_t generation;
+  uint64_t swaps;
+  uint64_t overlay_entries;
+  uint64_t retired_pending; // old snapshot mappings not yet unmapped
+};
+
+// Shared by every credential backend. SHA-256 of the full password (UTF-8,
+// as user_db.py hashes it) against the stored digest.
+bool password_matches(const uint8_t stored_sha256[32], const char *password);
+
+// RFC 6238 under the user's policy, read from the record's flags
+bool totp_matches(const SnapshotRecord &rec, int code, time_t now);
+
+//
+// HotTier - fixed-size linear-probing table sized from a memory budget
+//
+class HotTier {
+private:
+  std::vector<HotEntry> m_slots;
+  size_t m_mask;
+  size_t m_size;
+  size_t m_max_live;
+  size_t m_hand;
+
+  void erase_slot(size_t index);
+
+public:
+  explicit HotTier(uint64_t budget_bytes);
+
+  size_t size() const { return m_size; }
+  size_t capacity() const { return m_max_live; }
+
+  // Returns the entry, or nullptr. Entries promoted from an older snapshot
+  // generation are dropped. A lookup on behalf of a login (`touch`) sets
+  // the CLOCK reference bit and counts a hit.
+  HotEntry *find(const char *username, size_t len, uint64_t key_hash,
+                 uint32_t generation, bool touch = true);
+
+  // Insert a decoded snapshot record. Evicts one entry with CLOCK if full;
+  // `evicted` is set when that happens.
+  HotEntry *insert(const SnapshotRecord &rec, uint32_t generation,
+                   bool *evicted);
+
+  // Names and hit counts of all resident users
+  void collect(std::vector<WarmEntry> *out) const;
+
+  void clear();
+};
+
+//
+// TieredStore - hot tier in front of a mapped snapshot or users.db
+//
+class TieredStore {
+private:
+  struct SnapshotGeneration {
+    SnapshotView view;
+    uint32_t generation;
+  };
+
+  HotTier m_hot;
+  SqliteCredentialSource m_db;
+  std::mutex m_lock;
+  StoreStats m_stats;
+
+  // Published snapshot, read lock-free under m_epochs
+  EpochDomain m_epochs;
+  std::atomic<SnapshotGeneration *> m_snapshot;
+  std::atomic<uint32_t> m_generation;
+  std::mutex m_swap_lock;
+
+  // Registrations newer than the published snapshot
+  std::string m_delta_db;
+  std::shared_mutex m_overlay_lock;
+  std::unordered_map<std::string, SnapshotRecord> m_overlay;
+
+  std::string m_warm_path;
+  std::thread m_warmer;
+  std::atomic<bool> m_stop_warmer;
+
+  static void delete_generation(void *p);
+  bool fetch_cold(const char *username, size_t len, uint64_t key_hash,
+                  SnapshotRecord *out, uint32_t *generation);
+  void start_warmer(const char *source_path);
+  void warm_loop();
+
+public:
+  explicit TieredStore(uint64_t budget_bytes);
+  ~TieredStore();
+
+  // Cold tier from a snapshot file (checksum verified on open). With
+  // `delta_db_path`, users.db rows past the snapshot cut-off are replayed.
+  bool open(const char *snapshot_path, const char *delta_db_path);
+
+  // Cold tier straight from users.db: only the username index is loaded
+  bool open_db(const char *db_path);
+
+  // Map and verify a new snapshot, replay the delta, then publish it.
+  // Logins keep running against the old mapping until they finish.
+  bool swap_snapshot(const char *snapshot_path);
+
+  // Make a just-registered user visible before the next snapshot
+  bool add_user(const char *username, const char *password_hash_hex,
+                const char *totp_secret_b32);
+
+  // Copy the user's credential material into `out`, promoting on a cold
+  // hit. Returns false for unknown users.
+  bool lookup(const char *username, HotEntry *out);
+  // Same, for a name already bounded and hashed (fnv1a64) by the caller
+  bool lookup(const char *username, size_t len, uint64_t key_hash,
+              HotEntry *out);
+
+  bool verify_password(const char *username, const char *password);
+
+  bool verify_totp(const char *username, int code, time_t now);
+
+  void stats(StoreStats *out);
+};
@@ -0,0 +1,784 @@
+#include "crypto_core.h"
+
+// Every kernel below is constexpr, and the exported functions are thin
+// wrappers around them. The self-tests at the end of the file run those
+// same kernels on the FIPS 180-4, RFC 4226 and RFC 6238 test vectors at
+// compile time, so a kernel that computes a wrong digest or code fails the
+// build instead of failing logins - and costs nothing at startup.
+
+// --- Helpers ---
+
+static constexpr uint32_t rotl32(uint32_t x, int n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+static constexpr uint32_t rotr32(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+static constexpr uint64_t rotl64(uint64_t x, int n) {
+  return (x << n) | (x >> (64 - n));
+}
+
+static constexpr uint64_t load_le64(const uint8_t *p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; i--)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+static constexpr uint32_t load_be32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static constexpr void store_be32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+static constexpr void store_be64(uint8_t *p, uint64_t v) {
+  store_be32(p, (uint32_t)(v >> 32));
+  store_be32(p + 4, (uint32_t)v);
+}
+
+uint64_t fnv1a64(const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= p[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// --- Constant Tables ---
+// Generated from their definitions rather than transcribed. FIPS 180-4:
+// SHA-256's initial hash and round constants are the first 32 bits of the
+// fractional parts of the square and cube roots of the first 8 and 64
+// primes; SHA-1's round constants are 2^30 times the square roots of 2, 3,
+// 5 and 10. floor(root(p) * 2^32) is an integer root of p shifted left,
+// taken exactly in 128-bit arithmetic.
+
+typedef unsigned __int128 u128;
+
+template <size_t N> struct U32Table {
+  uint32_t v[N];
+};
+
+template <size_t N> struct I8Table {
+  int8_t v[N];
+};
+
+// floor(n^(1/k)) for k = 2 or 3 and a root below 2^36
+static constexpr u128 integer_root(u128 n, int k) {
+  u128 lo = 0, hi = (u128)1 << 36;
+  while (lo < hi) {
+    u128 mid = (lo + hi + 1) / 2;
+    u128 p = k == 2 ? mid * mid : mid * mid * mid;
+    if (p <= n)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+template <size_t N> static constexpr U32Table<N> first_primes() {
+  U32Table<N> t = {};
+  uint32_t candidate = 2;
+  for (size_t n = 0; n < N; candidate++) {
+    bool prime = true;
+    for (uint32_t d = 2; d * d <= candidate; d++)
+      prime = prime && candidate % d != 0;
+    if (prime)
+      t.v[n++] = candidate;
+  }
+  return t;
+}
+
+// First 32 fractional bits of the k-th root of each of the first N primes
+template <size_t N> static constexpr U32Table<N> prime_root_fractions(int k) {
+  U32Table<N> primes = first_primes<N>();
+  U32Table<N> t = {};
+  for (size_t i = 0; i < N; i++)
+    t.v[i] = (uint32_t)integer_root((u128)primes.v[i] << (32 * k), k);
+  return t;
+}
+
+static constexpr U32Table<4> sha1_round_constants() {
+  const uint32_t radicands[4] = {2, 3, 5, 10};
+  U32Table<4> t = {};
+  for (int i = 0; i < 4; i++)
+    t.v[i] = (uint32_t)integer_root((u128)radicands[i] << 60, 2);
+  return t;
+}
+
+static constexpr U32Table<5> SHA1_INIT = {
+    {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0}};
+static constexpr U32Table<4> SHA1_K = sha1_round_constants();
+static constexpr U32Table<8> SHA256_INIT = prime_root_fractions<8>(2);
+static constexpr U32Table<64> SHA256_K = prime_root_fractions<64>(3);
+
+// Spot checks; the digest self-tests below cover every entry
+static_assert(SHA1_K.v[0] == 0x5A827999 && SHA1_K.v[3] == 0xCA62C1D6,
+              "SHA-1 round constants");
+static_assert(SHA256_INIT.v[0] == 0x6a09e667 && SHA256_INIT.v[7] == 0x5be0cd19,
+              "SHA-256 initial hash");
+static_assert(SHA256_K.v[0] == 0x428a2f98 && SHA256_K.v[63] == 0xc67178f2,
+              "SHA-256 round constants");
+
+// Decoding tables: character -> value, -1 if invalid
+const int8_t BASE32_PAD = -2;
+
+static constexpr I8Table<256> base32_table() {
+  I8Table<256> t = {};
+  for (int c = 0; c < 256; c++)
+    t.v[c] = -1;
+  for (int i = 0; i < 26; i++) {
+    t.v['A' + i] = (int8_t)i;
+    t.v['a' + i] = (int8_t)i;
+  }
+  for (int i = 0; i < 6; i++)
+    t.v['2' + i] = (int8_t)(26 + i);
+  t.v['='] = BASE32_PAD;
+  return t;
+}
+
+static constexpr I8Table<256> hex_table() {
+  I8Table<256> t = {};
+  for (int c = 0; c < 256; c++)
+    t.v[c] = -1;
+  for (int i = 0; i < 10; i++)
+    t.v['0' + i] = (int8_t)i;
+  for (int i = 0; i < 6; i++) {
+    t.v['a' + i] = (int8_t)(10 + i);
+    t.v['A' + i] = (int8_t)(10 + i);
+  }
+  return t;
+}
+
+static constexpr I8Table<256> BASE32_VALUE = base32_table();
+static constexpr I8Table<256> HEX_VALUE = hex_table();
+
+// --- SHA-1 ---
+
+static constexpr void sha1_block(uint32_t *state, const uint8_t *block) {
+  uint32_t w[80] = {};
+  for (int i = 0; i < 16; i++)
+    w[i] = load_be32(block + 4 * i);
+  for (int i = 16; i < 80; i++)
+    w[i] = rotl32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+           e = state[4];
+
+  for (int i = 0; i < 80; i++) {
+    uint32_t f = 0, k = 0;
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = SHA1_K.v[0];
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = SHA1_K.v[1];
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = SHA1_K.v[2];
+    } else {
+      f = b ^ c ^ d;
+      k = SHA1_K.v[3];
+    }
+    uint32_t t = rotl32(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = rotl32(b, 30);
+    b = a;
+    a = t;
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+}
+
+void sha1_compress(uint32_t state[5], const uint8_t block[64]) {
+  sha1_block(state, block);
+}
+
+// --- SHA-256 ---
+
+static constexpr void sha256_block(uint32_t *state, const uint8_t *block) {
+  uint32_t w[64] = {};
+  for (int i = 0; i < 16; i++)
+    w[i] = load_be32(block + 4 * i);
+  for (int i = 16; i < 64; i++) {
+    uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+  uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+  for (int i = 0; i < 64; i++) {
+    uint32_t s1 = rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25);
+    uint32_t ch = (e & f) ^ (~e & g);
+    uint32_t t1 = h + s1 + ch + SHA256_K.v[i] + w[i];
+    uint32_t s0 = rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22);
+    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+    uint32_t t2 = s0 + maj;
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+void sha256_compress(uint32_t state[8], const uint8_t block[64]) {
+  sha256_block(state, block);
+}
+
+// Merkle-Damgard padding shared by SHA-1 and SHA-256.
+// `prefix_len` counts bytes already absorbed into `state` (used by HMAC).
+template <void (*Block)(uint32_t *, const uint8_t *)>
+static constexpr void md_finish(uint32_t *state, const uint8_t *data,
+                                size_t len, uint64_t prefix_len) {
+  while (len >= 64) {
+    Block(state, data);
+    data += 64;
+    len -= 64;
+    prefix_len += 64;
+  }
+
+  uint8_t block[128] = {};
+  for (size_t i = 0; i < len; i++)
+    block[i] = data[i];
+  block[len] = 0x80;
+  size_t total = (len + 1 + 8 <= 64) ? 64 : 128;
+  store_be64(block + total - 8, (prefix_len + len) * 8);
+
+  Block(state, block);
+  if (total == 128)
+    Block(state, block + 64);
+}
+
+template <void (*Block)(uint32_t *, const uint8_t *), size_t Words>
+static constexpr void md_digest(const U32Table<Words> &init,
+                                const uint8_t *data, size_t len,
+                                uint8_t *out) {
+  uint32_t state[Words] = {};
+  for (size_t i = 0; i < Words; i++)
+    state[i] = init.v[i];
+  md_finish<Block>(state, data, len, 0);
+  for (size_t i = 0; i < Words; i++)
+    store_be32(out + 4 * i, state[i]);
+}
+
+void sha1(const uint8_t *data, size_t len, uint8_t out[20]) {
+  md_digest<sha1_block>(SHA1_INIT, data, len, out);
+}
+
+void sha256(const uint8_t *data, size_t len, uint8_t out[32]) {
+  md_digest<sha256_block>(SHA256_INIT, data, len, out);
+}
+
+// --- Multi-buffer SHA-256 ---
+// SHA256_LANES messages go through the compression function together, the
+// working variables laid out as [word][lane] so that every step is the same
+// operation across a short array - the form compilers turn into SIMD
+// (SSE2/AVX2/NEON) without intrinsics. Lanes that run out of blocks early
+// keep their state.
+
+const size_t SHA256_LANES = 8;
+
+static constexpr uint8_t ZERO_BLOCK[64] = {};
+
+static constexpr void
+sha256_compress_lanes(uint32_t state[8][SHA256_LANES],
+                      const uint8_t *const block[SHA256_LANES],
+                      const bool active[SHA256_LANES]) {
+  uint32_t w[64][SHA256_LANES] = {};
+  for (int i = 0; i < 16; i++)
+    for (size_t l = 0; l < SHA256_LANES; l++)
+      w[i][l] = load_be32(block[l] + 4 * i);
+  for (int i = 16; i < 64; i++)
+    for (size_t l = 0; l < SHA256_LANES; l++) {
+      uint32_t x = w[i - 15][l], y = w[i - 2][l];
+      uint32_t s0 = rotr32(x, 7) ^ rotr32(x, 18) ^ (x >> 3);
+      uint32_t s1 = rotr32(y, 17) ^ rotr32(y, 19) ^ (y >> 10);
+      w[i][l] = w[i - 16][l] + s0 + w[i - 7][l] + s1;
+    }
+
+  uint32_t v[8][SHA256_LANES] = {};
+  for (int j = 0; j < 8; j++)
+    for (size_t l = 0; l < SHA256_LANES; l++)
+      v[j][l] = state[j][l];
+  for (int i = 0; i < 64; i++) {
+    for (size_t l = 0; l < SHA256_LANES; l++) {
+      uint32_t a = v[0][l], b = v[1][l], c = v[2][l], d = v[3][l];
+      uint32_t e = v[4][l], f = v[5][l], g = v[6][l], h = v[7][l];
+      uint32_t s1 = rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25);
+      uint32_t ch = (e & f) ^ (~e & g);
+      uint32_t t1 = h + s1 + ch + SHA256_K.v[i] + w[i][l];
+      uint32_t s0 = rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22);
+      uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+      v[7][l] = g;
+      v[6][l] = f;
+      v[5][l] = e;
+      v[4][l] = d + t1;
+      v[3][l] = c;
+      v[2][l] = b;
+      v[1][l] = a;
+      v[0][l] = t1 + s0 + maj;
+    }
+  }
+
+  for (int j = 0; j < 8; j++)
+    for (size_t l = 0; l < SHA256_LANES; l++)
+      state[j][l] += active[l] ? v[j][l] : 0;
+}
+
+static constexpr void sha256_many_lanes(const uint8_t *const *data,
+                                        const size_t *len, size_t count,
+                                        uint8_t (*out)[32]) {
+  uint8_t tail[SHA256_LANES][128] = {};
+
+  for (size_t base = 0; base < count; base += SHA256_LANES) {
+    size_t lanes = count - base < SHA256_LANES ? count - base : SHA256_LANES;
+    uint32_t state[8][SHA256_LANES] = {};
+    size_t full[SHA256_LANES] = {}, blocks[SHA256_LANES] = {};
+    size_t max_blocks = 0;
+
+    for (size_t l = 0; l < lanes; l++) {
+      // Whole blocks are read in place; the padded tail is one or two more
+      size_t n = len[base + l];
+      size_t rest = n % 64;
+      full[l] = n / 64;
+      size_t tail_len = (rest + 1 + 8 <= 64) ? 64 : 128;
+      for (size_t i = 0; i < rest; i++)
+        tail[l][i] = data[base + l][full[l] * 64 + i];
+      tail[l][rest] = 0x80;
+      for (size_t i = rest + 1; i < tail_len; i++)
+        tail[l][i] = 0;
+      store_be64(tail[l] + tail_len - 8, (uint64_t)n * 8);
+      blocks[l] = full[l] + tail_len / 64;
+      if (blocks[l] > max_blocks)
+        max_blocks = blocks[l];
+    }
+    for (int j = 0; j < 8; j++)
+      for (size_t l = 0; l < SHA256_LANES; l++)
+        state[j][l] = SHA256_INIT.v[j];
+
+    for (size_t b = 0; b < max_blocks; b++) {
+      const uint8_t *block[SHA256_LANES] = {};
+      bool active[SHA256_LANES] = {};
+      for (size_t l = 0; l < SHA256_LANES; l++) {
+        active[l] = l < lanes && b < blocks[l];
+        if (!active[l])
+          block[l] = ZERO_BLOCK;
+        else if (b < full[l])
+          block[l] = data[base + l] + b * 64;
+        else
+          block[l] = tail[l] + (b - full[l]) * 64;
+      }
+      sha256_compress_lanes(state, block, active);
+    }
+
+    for (size_t l = 0; l < lanes; l++)
+      for (int j = 0; j < 8; j++)
+        store_be32(out[base + l] + 4 * j, state[j][l]);
+  }
+}
+
+void sha256_many(const uint8_t *const *data, const size_t *len, size_t count,
+                 uint8_t (*out)[32]) {
+  sha256_many_lanes(data, len, count, out);
+}
+
+// --- HMAC ---
+
+// The HMAC key block: the secret, or its digest if longer than a block
+template <void (*Block)(uint32_t *, const uint8_t *), size_t Words>
+static constexpr void hmac_key_block(const U32Table<Words> &init,
+                                     const uint8_t *secret, size_t secret_len,
+                                     uint8_t k[64]) {
+  for (int i = 0; i < 64; i++)
+    k[i] = 0;
+  if (secret_len > 64)
+    md_digest<Block>(init, secret, secret_len, k);
+  else
+    for (size_t i = 0; i < secret_len; i++)
+      k[i] = secret[i];
+}
+
+template <void (*Block)(uint32_t *, const uint8_t *), size_t Words>
+static constexpr void hmac_pads(const U32Table<Words> &init,
+                                const uint8_t k[64], uint32_t *inner,
+                                uint32_t *outer) {
+  uint8_t pad[64] = {};
+  for (int i = 0; i < 64; i++)
+    pad[i] = k[i] ^ 0x36;
+  for (size_t i = 0; i < Words; i++)
+    inner[i] = init.v[i];
+  Block(inner, pad);
+
+  for (int i = 0; i < 64; i++)
+    pad[i] = k[i] ^ 0x5c;
+  for (size_t i = 0; i < Words; i++)
+    outer[i] = init.v[i];
+  Block(outer, pad);
+}
+
+// Finish HMAC for a short message from the absorbed pads
+template <void (*Block)(uint32_t *, const uint8_t *), size_t Words>
+static constexpr void hmac_finish(const uint32_t *inner, const uint32_t *outer,
+                                  const uint8_t *msg, size_t msg_len,
+                                  uint8_t *out) {
+  uint32_t state[Words] = {};
+  uint8_t inner_digest[4 * Words] = {};
+
+  for (size_t i = 0; i < Words; i++)
+    state[i] = inner[i];
+  md_finish<Block>(state, msg, msg_len, 64);
+  for (size_t i = 0; i < Words; i++)
+    store_be32(inner_digest + 4 * i, state[i]);
+
+  for (size_t i = 0; i < Words; i++)
+    state[i] = outer[i];
+  md_finish<Block>(state, inner_digest, 4 * Words, 64);
+  for (size_t i = 0; i < Words; i++)
+    store_be32(out + 4 * i, state[i]);
+}
+
+// Don't leave key material on the stack
+static void wipe_key_block(uint8_t k[64]) {
+  volatile uint8_t *wipe = k;
+  for (int i = 0; i < 64; i++)
+    wipe[i] = 0;
+}
+
+void hmac_sha1_precompute(HmacSha1Key *key, const uint8_t *secret,
+                          size_t secret_len) {
+  uint8_t k[64];
+  hmac_key_block<sha1_block>(SHA1_INIT, secret, secret_len, k);
+  hmac_pads<sha1_block>(SHA1_INIT, k, key->inner, key->outer);
+  wipe_key_block(k);
+}
+
+void hmac_sha1_finish(const HmacSha1Key &key, const uint8_t *msg,
+                      size_t msg_len, uint8_t out[20]) {
+  hmac_finish<sha1_block, 5>(key.inner, key.outer, msg, msg_len, out);
+}
+
+void hmac_sha256_precompute(HmacSha256Key *key, const uint8_t *secret,
+                            size_t secret_len) {
+  uint8_t k[64];
+  hmac_key_block<sha256_block>(SHA256_INIT, secret, secret_len, k);
+  hmac_pads<sha256_block>(SHA256_INIT, k, key->inner, key->outer);
+  wipe_key_block(k);
+}
+
+void hmac_sha256_finish(const HmacSha256Key &key, const uint8_t *msg,
+                        size_t msg_len, uint8_t out[32]) {
+  hmac_finish<sha256_block, 8>(key.inner, key.outer, msg, msg_len, out);
+}
+
+// --- HOTP ---
+
+template <void (*Block)(uint32_t *, const uint8_t *), size_t Words>
+static constexpr uint32_t hotp_value(const uint32_t *inner,
+                                     const uint32_t *outer, uint64_t counter,
+                                     unsigned digits) {
+  uint8_t msg[8] = {};
+  store_be64(msg, counter);
+  uint8_t mac[4 * Words] = {};
+  hmac_finish<Block, Words>(inner, outer, msg, sizeof(msg), mac);
+  return hotp_truncate(mac, sizeof(mac),
+                       HOTP_POW10.value[digits > 8 ? 8 : digits]);
+}
+
+uint32_t hotp_sha1(const HmacSha1Key &key, uint64_t counter, unsigned digits) {
+  return hotp_value<sha1_block, 5>(key.inner, key.outer, counter, digits);
+}
+
+// --- SipHash ---
+
+static constexpr void sip_round(uint64_t &v0, uint64_t &v1, uint64_t &v2,
+                                uint64_t &v3) {
+  v0 += v1;
+  v1 = rotl64(v1, 13) ^ v0;
+  v0 = rotl64(v0, 32);
+  v2 += v3;
+  v3 = rotl64(v3, 16) ^ v2;
+  v0 += v3;
+  v3 = rotl64(v3, 21) ^ v0;
+  v2 += v1;
+  v1 = rotl64(v1, 17) ^ v2;
+  v2 = rotl64(v2, 32);
+}
+
+static constexpr uint64_t siphash24_kernel(const uint8_t *key,
+                                           const uint8_t *data, size_t len) {
+  uint64_t k0 = load_le64(key), k1 = load_le64(key + 8);
+  uint64_t v0 = k0 ^ 0x736f6d6570736575ULL, v1 = k1 ^ 0x646f72616e646f6dULL,
+           v2 = k0 ^ 0x6c7967656e657261ULL, v3 = k1 ^ 0x7465646279746573ULL;
+  size_t whole = len & ~(size_t)7;
+  for (size_t i = 0; i < whole; i += 8) {
+    uint64_t m = load_le64(data + i);
+    v3 ^= m;
+    sip_round(v0, v1, v2, v3);
+    sip_round(v0, v1, v2, v3);
+    v0 ^= m;
+  }
+  uint64_t last = (uint64_t)len << 56;
+  for (size_t i = whole; i < len; i++)
+    last |= (uint64_t)data[i] << (8 * (i - whole));
+  v3 ^= last;
+  sip_round(v0, v1, v2, v3);
+  sip_round(v0, v1, v2, v3);
+  v0 ^= last;
+  v2 ^= 0xff;
+  for (int i = 0; i < 4; i++)
+    sip_round(v0, v1, v2, v3);
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+uint64_t siphash24(const uint8_t key[16], const void *data, size_t len) {
+  return siphash24_kernel(key, (const uint8_t *)data, len);
+}
+
+// --- Encodings ---
+
+int base32_decode(const char *in, uint8_t *out, size_t out_cap) {
+  uint32_t buffer = 0;
+  int bits = 0;
+  size_t n = 0;
+
+  for (; *in; in++) {
+    int v = BASE32_VALUE.v[(uint8_t)*in];
+    if (v == BASE32_PAD)
+      break;
+    if (v < 0)
+      return -1;
+
+    buffer = (buffer << 5) | (uint32_t)v;
+    bits += 5;
+    if (bits >= 8) {
+      if (n >= out_cap)
+        return -1;
+      bits -= 8;
+      out[n++] = (uint8_t)(buffer >> bits);
+    }
+  }
+  return (int)n;
+}
+
+int hex_decode(const char *in, uint8_t *out, size_t out_cap) {
+  size_t n = 0;
+  while (in[0] && in[1]) {
+    int hi = HEX_VALUE.v[(uint8_t)in[0]];
+    int lo = HEX_VALUE.v[(uint8_t)in[1]];
+    if (hi < 0 || lo < 0 || n >= out_cap)
+      return -1;
+    out[n++] = (uint8_t)((hi << 4) | lo);
+    in += 2;
+  }
+  if (in[0])
+    return -1; // odd length
+  return (int)n;
+}
+
+bool constant_time_equal(const uint8_t *a, const uint8_t *b, size_t len) {
+  uint8_t diff = 0;
+  for (size_t i = 0; i < len; i++)
+    diff |= a[i] ^ b[i];
+  return diff == 0;
+}
+
+// --- Compile-time Self-tests ---
+// Published test vectors run through the kernels above by the compiler.
+
+// Test message as bytes (a string literal less its NUL)
+template <size_t N> struct TestBytes {
+  uint8_t v[N];
+  size_t len;
+};
+
+template <size_t N>
+static constexpr TestBytes<N> test_bytes(const char (&s)[N]) {
+  TestBytes<N> t = {};
+  for (size_t i = 0; i + 1 < N; i++)
+    t.v[i] = (uint8_t)s[i];
+  t.len = N - 1;
+  return t;
+}
+
+static constexpr bool bytes_equal_hex(const uint8_t *bytes, size_t len,
+                                      const char *hex) {
+  for (size_t i = 0; i < len; i++) {
+    int hi = HEX_VALUE.v[(uint8_t)hex[2 * i]];
+    int lo = HEX_VALUE.v[(uint8_t)hex[2 * i + 1]];
+    if (hi < 0 || lo < 0 || bytes[i] != ((hi << 4) | lo))
+      return false;
+  }
+  return hex[2 * len] == 0;
+}
+
+template <size_t N>
+static constexpr bool sha1_is(const char (&msg)[N], const char *hex) {
+  TestBytes<N> m = test_bytes(msg);
+  uint8_t out[20] = {};
+  md_digest<sha1_block>(SHA1_INIT, m.v, m.len, out);
+  return bytes_equal_hex(out, sizeof(out), hex);
+}
+
+template <size_t N>
+static constexpr bool sha256_is(const char (&msg)[N], const char *hex) {
+  TestBytes<N> m = test_bytes(msg);
+  uint8_t out[32] = {};
+  md_digest<sha256_block>(SHA256_INIT, m.v, m.len, out);
+  return bytes_equal_hex(out, sizeof(out), hex);
+}
+
+// FIPS 180-4 examples: one block, and two (padding spills over)
+#define FIPS_ABC "abc"
+#define FIPS_448 "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"
+#define SHA256_ABC                                                             \
+  "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"
+#define SHA256_448                                                             \
+  "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"
+#define SHA256_EMPTY                                                           \
+  "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"
+
+static_assert(sha1_is(FIPS_ABC, "a9993e364706816aba3e25717850c26c9cd0d89d"),
+              "SHA-1 FIPS 180-4 one-block example");
+static_assert(sha1_is(FIPS_448, "84983e441c3bd26ebaae4aa1f95129e5e54670f1"),
+              "SHA-1 FIPS 180-4 two-block example");
+static_assert(sha256_is(FIPS_ABC, SHA256_ABC),
+              "SHA-256 FIPS 180-4 one-block example");
+static_assert(sha256_is(FIPS_448, SHA256_448),
+              "SHA-256 FIPS 180-4 two-block example");
+static_assert(sha256_is("", SHA256_EMPTY), "SHA-256 of the empty message");
+
+// The lanes over a batch spanning two rounds of SHA256_LANES, with
+// messages of different lengths side by side
+static constexpr bool sha256_many_ok() {
+  TestBytes<4> abc = test_bytes(FIPS_ABC);
+  TestBytes<57> m448 = test_bytes(FIPS_448);
+  TestBytes<1> empty = test_bytes("");
+  const char *expected[3] = {SHA256_ABC, SHA256_448, SHA256_EMPTY};
+  const uint8_t *data[11] = {};
+  size_t len[11] = {};
+  for (int i = 0; i < 11; i++) {
+    data[i] = i % 3 == 0 ? abc.v : i % 3 == 1 ? m448.v : empty.v;
+    len[i] = i % 3 == 0 ? abc.len : i % 3 == 1 ? m448.len : empty.len;
+  }
+  uint8_t out[11][32] = {};
+  sha256_many_lanes(data, len, 11, out);
+  for (int i = 0; i < 11; i++)
+    if (!bytes_equal_hex(out[i], 32, expected[i % 3]))
+      return false;
+  return true;
+}
+static_assert(sha256_many_ok(), "multi-buffer SHA-256 matches FIPS 180-4");
+
+template <void (*Block)(uint32_t *, const uint8_t *), size_t Words,
+          size_t N>
+static constexpr uint32_t test_hotp(const U32Table<Words> &init,
+                                    const char (&secret)[N], uint64_t counter,
+                                    unsigned digits) {
+  TestBytes<N> s = test_bytes(secret);
+  uint8_t k[64] = {};
+  uint32_t inner[Words] = {}, outer[Words] = {};
+  hmac_key_block<Block>(init, s.v, s.len, k);
+  hmac_pads<Block>(init, k, inner, outer);
+  return hotp_value<Block, Words>(inner, outer, counter, digits);
+}
+
+// RFC 4226 appendix D: HOTP-SHA1, 6 digits, counters 0-9
+#define RFC_SECRET_20 "12345678901234567890"
+static constexpr bool rfc4226_ok() {
+  const uint32_t expected[10] = {755224, 287082, 359152, 969429, 338314,
+                                 254676, 287922, 162583, 399871, 520489};
+  for (uint64_t c = 0; c < 10; c++)
+    if (test_hotp<sha1_block>(SHA1_INIT, RFC_SECRET_20, c, 6) != expected[c])
+      return false;
+  return true;
+}
+static_assert(rfc4226_ok(), "HOTP RFC 4226 appendix D");
+
+// RFC 6238 appendix B: 8 digits, 30 s steps, at T = 59 and 1111111109
+static_assert(test_hotp<sha1_block>(SHA1_INIT, RFC_SECRET_20, 59 / 30, 8) ==
+                  94287082,
+              "TOTP-SHA1 RFC 6238 appendix B");
+static_assert(test_hotp<sha1_block>(SHA1_INIT, RFC_SECRET_20, 1111111109 / 30,
+                                    8) == 7081804,
+              "TOTP-SHA1 RFC 6238 appendix B");
+static_assert(test_hotp<sha256_block>(SHA256_INIT,
+                                      "12345678901234567890123456789012",
+                                      59 / 30, 8) == 46119246,
+              "TOTP-SHA256 RFC 6238 appendix B");
+static_assert(test_hotp<sha256_block>(SHA256_INIT,
+                                      "12345678901234567890123456789012",
+                                      1111111109 / 30, 8) == 68084774,
+              "TOTP-SHA256 RFC 6238 appendix B");
+
+// HMAC keys longer than a block are hashed first (RFC 4231 case 6)
+static constexpr bool hmac_long_key_ok() {
+  uint8_t key[131] = {};
+  for (int i = 0; i < 131; i++)
+    key[i] = 0xaa;
+  TestBytes<55> msg =
+      test_bytes("Test Using Larger Than Block-Size Key - Hash Key First");
+  uint8_t k[64] = {};
+  uint32_t inner[8] = {}, outer[8] = {};
+  hmac_key_block<sha256_block>(SHA256_INIT, key, sizeof(key), k);
+  hmac_pads<sha256_block>(SHA256_INIT, k, inner, outer);
+  uint8_t mac[32] = {};
+  hmac_finish<sha256_block, 8>(inner, outer, msg.v, msg.len, mac);
+  return bytes_equal_hex(
+      mac, 32,
+      "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54");
+}
+static_assert(hmac_long_key_ok(), "HMAC-SHA256 RFC 4231 test case 6");
+
+// Decoding tables
+static constexpr bool decode_tables_ok() {
+  const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+  for (int i = 0; i < 32; i++)
+    if (BASE32_VALUE.v[(uint8_t)alphabet[i]] != i)
+      return false;
+  return BASE32_VALUE.v['1'] == -1 && BASE32_VALUE.v['z'] == 25 &&
+         HEX_VALUE.v['F'] == 15 && HEX_VALUE.v['g'] == -1;
+}
+static_assert(decode_tables_ok(), "Base32 (RFC 4648) and hex tables");
+
+// SipHash-2-4 reference vectors: key 00..0f over messages 00..(n-1)
+static constexpr uint64_t test_siphash(size_t len) {
+  uint8_t key[16] = {}, msg[64] = {};
+  for (int i = 0; i < 16; i++)
+    key[i] = (uint8_t)i;
+  for (size_t i = 0; i < len; i++)
+    msg[i] = (uint8_t)i;
+  return siphash24_kernel(key, msg, len);
+}
+static_assert(test_siphash(0) == 0x726fdb47dd0e0e31ULL, "SipHash-2-4 vector 0");
+static_assert(test_siphash(15) == 0xa129ca6149be45e5ULL,
+              "SipHash-2-4 vector 15");
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// --- Crypto Primitives ---
+// Native SHA-1 / SHA-256 / HMAC and the text encodings used by user_db.py
+// (hex password hashes, Base32 TOTP secrets). Shared by the credential store
+// and the audit pipeline.
+
+// FNV-1a 64-bit hash, used as the key hash for username lookups
+uint64_t fnv1a64(const void *data, size_t len);
+
+// SipHash-2-4 under a 16-byte secret key. For tables whose keys come from
+// outside: without the key, nobody can aim inputs at the same slots.
+uint64_t siphash24(const uint8_t key[16], const void *data, size_t len);
+
+// SHA-1 block compression (one 64-byte block)
+void sha1_compress(uint32_t state[5], const uint8_t block[64]);
+
+// SHA-256 block compression (one 64-byte block)
+void sha256_compress(uint32_t state[8], const uint8_t block[64]);
+
+// One-shot digests
+void sha1(const uint8_t *data, size_t len, uint8_t out[20]);
+void sha256(const uint8_t *data, size_t len, uint8_t out[32]);
+
+// SHA-256 of `count` independent messages, hashed several at a time in
+// interleaved lanes. Same digests as sha256(); faster for batches of short
+// messages such as audit records and Merkle nodes.
+void sha256_many(const uint8_t *const *data, const size_t *len, size_t count,
+                 uint8_t (*out)[32]);
+
+// HMAC-SHA1 key with the ipad/opad blocks already absorbed.
+// Computing a TOTP code from this costs two compressions instead of four.
+struct HmacSha1Key {
+  uint32_t inner[5];
+  uint32_t outer[5];
+};
+
+void hmac_sha1_precompute(HmacSha1Key *key, const uint8_t *secret,
+                          size_t secret_len);
+
+// Finish HMAC-SHA1 for a short message (at most 55 bytes)
+void hmac_sha1_finish(const HmacSha1Key &key, const uint8_t *msg,
+                      size_t msg_len, uint8_t out[20]);
+
+// Powers of ten for HOTP code moduli, built at compile time
+struct HotpPow10Table {
+  uint32_t value[10];
+};
+
+constexpr HotpPow10Table hotp_make_pow10() {
+  HotpPow10Table t = {};
+  uint32_t p = 1;
+  for (int i = 0; i < 10; i++) {
+    t.value[i] = p;
+    p *= 10;
+  }
+  return t;
+}
+
+constexpr HotpPow10Table HOTP_POW10 = hotp_make_pow10();
+static_assert(HOTP_POW10.value[6] == 1000000, "pow10 table");
+static_assert(HOTP_POW10.value[9] == 1000000000, "pow10 table");
+
+// RFC 4226 dynamic truncation of an HMAC, reduced mod `modulus`
+constexpr uint32_t hotp_truncate(const uint8_t *mac, size_t mac_len,
+                                 uint32_t modulus) {
+  int offset = mac[mac_len - 1] & 0x0f;
+  uint32_t bin = ((uint32_t)(mac[offset] & 0x7f) << 24) |
+                 ((uint32_t)mac[offset + 1] << 16) |
+                 ((uint32_t)mac[offset + 2] << 8) | (uint32_t)mac[offset + 3];
+  return bin % modulus;
+}
+
+// RFC 4226 HOTP value for the given counter (at most 8 digits)
+uint32_t hotp_sha1(const HmacSha1Key &key, uint64_t counter, unsigned digits);
+
+// HMAC-SHA256 key with the ipad/opad blocks already absorbed
+struct HmacSha256Key {
+  uint32_t inner[8];
+  uint32_t outer[8];
+};
+
+void hmac_sha256_precompute(HmacSha256Key *key, const uint8_t *secret,
+                            size_t secret_len);
+
+// Finish HMAC-SHA256 for a short message (at most 55 bytes)
+void hmac_sha256_finish(const HmacSha256Key &key, const uint8_t *msg,
+                        size_t msg_len, uint8_t out[32]);
+
+// Decode RFC 4648 Base32 (padding and lowercase accepted).
+// Returns the number of bytes written, or -1 on invalid input / overflow.
+int base32_decode(const char *in, uint8_t *out, size_t out_cap);
+
+// Decode a hex string. Returns bytes written, or -1 on invalid input.
+int hex_decode(const char *in, uint8_t *out, size_t out_cap);
+
+// Compare without early exit so timing does not leak the mismatch position
+bool constant_time_equal(const uint8_t *a, const uint8_t *b, size_t len);
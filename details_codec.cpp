@@ -0,0 +1,480 @@
+#include "details_codec.h"
+
+#include "symbol_table.h"
+
+#include <cstring>
+
+// Keys logged by user_db.py, by tag (0 = interned key)
+static const char *const DETAILS_KEYS[] = {
+    nullptr, "reason", "error", "stage", "secret_generated", "mfa_completed",
+    "totp_offset",
+};
+const uint32_t DETAILS_KEY_COUNT =
+    sizeof(DETAILS_KEYS) / sizeof(DETAILS_KEYS[0]);
+
+// --- Varints ---
+
+static void put_varint(std::string *out, uint64_t v) {
+  while (v >= 0x80) {
+    out->push_back((char)(v | 0x80));
+    v >>= 7;
+  }
+  out->push_back((char)v);
+}
+
+static bool get_varint(const uint8_t *&p, const uint8_t *end, uint64_t *v) {
+  uint64_t result = 0;
+  for (int shift = 0; shift < 64 && p < end; shift += 7) {
+    uint8_t b = *p++;
+    result |= (uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      *v = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint64_t zigzag(int64_t v) {
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// --- JSON Parsing ---
+
+static void put_utf8(std::string *out, uint32_t cp) {
+  if (cp < 0x80) {
+    out->push_back((char)cp);
+  } else if (cp < 0x800) {
+    out->push_back((char)(0xC0 | (cp >> 6)));
+    out->push_back((char)(0x80 | (cp & 0x3F)));
+  } else if (cp < 0x10000) {
+    out->push_back((char)(0xE0 | (cp >> 12)));
+    out->push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+    out->push_back((char)(0x80 | (cp & 0x3F)));
+  } else {
+    out->push_back((char)(0xF0 | (cp >> 18)));
+    out->push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+    out->push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+    out->push_back((char)(0x80 | (cp & 0x3F)));
+  }
+}
+
+class JsonReader {
+private:
+  const char *m_p;
+  const char *m_end;
+
+  bool hex4(uint32_t *out) {
+    if (m_end - m_p < 4)
+      return false;
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+      char c = *m_p++;
+      v <<= 4;
+      if (c >= '0' && c <= '9')
+        v |= c - '0';
+      else if (c >= 'a' && c <= 'f')
+        v |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+        v |= c - 'A' + 10;
+      else
+        return false;
+    }
+    *out = v;
+    return true;
+  }
+
+public:
+  JsonReader(const char *json, size_t len) : m_p(json), m_end(json + len) {}
+
+  bool at_end() {
+    skip_ws();
+    return m_p == m_end;
+  }
+
+  void skip_ws() {
+    while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' ||
+                           *m_p == '\r'))
+      m_p++;
+  }
+
+  bool consume(char c) {
+    skip_ws();
+    if (m_p < m_end && *m_p == c) {
+      m_p++;
+      return true;
+    }
+    return false;
+  }
+
+  char peek() {
+    skip_ws();
+    return m_p < m_end ? *m_p : '\0';
+  }
+
+  bool string(std::string *out) {
+    if (!consume('"'))
+      return false;
+    while (m_p < m_end && *m_p != '"') {
+      char c = *m_p++;
+      if (c != '\\') {
+        out->push_back(c);
+        continue;
+      }
+      if (m_p >= m_end)
+        return false;
+      char e = *m_p++;
+      uint32_t cp;
+      switch (e) {
+      case 'b':
+        out->push_back('\b');
+        break;
+      case 'f':
+        out->push_back('\f');
+        break;
+      case 'n':
+        out->push_back('\n');
+        break;
+      case 'r':
+        out->push_back('\r');
+        break;
+      case 't':
+        out->push_back('\t');
+        break;
+      case 'u':
+        if (!hex4(&cp))
+          return false;
+        if (cp >= 0xD800 && cp < 0xDC00 && m_end - m_p >= 6 && m_p[0] == '\\' &&
+            m_p[1] == 'u') {
+          const char *save = m_p;
+          uint32_t low;
+          m_p += 2;
+          if (hex4(&low) && low >= 0xDC00 && low < 0xE000)
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+          else
+            m_p = save;
+        }
+        put_utf8(out, cp);
+        break;
+      default:
+        out->push_back(e);
+      }
+    }
+    return m_p++ < m_end;
+  }
+
+  // Skip any value, leaving [start, end) around its text
+  bool value_span(const char **start, const char **end) {
+    skip_ws();
+    *start = m_p;
+    int depth = 0;
+    while (m_p < m_end) {
+      char c = *m_p;
+      if (c == '"') {
+        std::string ignored;
+        if (!string(&ignored))
+          return false;
+      } else if (c == '{' || c == '[') {
+        depth++;
+        m_p++;
+      } else if (c == '}' || c == ']') {
+        if (depth == 0)
+          break;
+        depth--;
+        m_p++;
+      } else if (c == ',' && depth == 0) {
+        break;
+      } else {
+        m_p++;
+      }
+      if (depth == 0 && (c == '}' || c == ']' || c == '"'))
+        break;
+    }
+    *end = m_p;
+    while (*end > *start && ((*end)[-1] == ' ' || (*end)[-1] == '\n' ||
+                             (*end)[-1] == '\t' || (*end)[-1] == '\r'))
+      (*end)--;
+    return depth == 0 && *end > *start;
+  }
+};
+
+static bool parse_scalar(const char *start, const char *end,
+                         DetailsField *field) {
+  std::string lit(start, end);
+  if (lit == "null") {
+    field->type = DETAILS_NULL;
+  } else if (lit == "true") {
+    field->type = DETAILS_TRUE;
+  } else if (lit == "false") {
+    field->type = DETAILS_FALSE;
+  } else {
+    bool integral = !lit.empty() && lit.size() <= 18;
+    for (size_t i = 0; i < lit.size() && integral; i++)
+      integral = (lit[i] >= '0' && lit[i] <= '9') || (i == 0 && lit[i] == '-');
+    if (integral && lit != "-") {
+      field->type = DETAILS_INT;
+      field->ival = std::stoll(lit);
+    } else {
+      if (lit.empty() || !(lit[0] == '-' || (lit[0] >= '0' && lit[0] <= '9')))
+        return false;
+      field->type = DETAILS_NUMBER;
+      field->text = lit;
+    }
+  }
+  return true;
+}
+
+bool details_parse_json(const char *json, size_t len,
+                        std::vector<DetailsField> *fields) {
+  fields->clear();
+  JsonReader r(json, len);
+  if (!r.consume('{'))
+    return false;
+  if (r.consume('}'))
+    return r.at_end();
+
+  do {
+    DetailsField field;
+    field.ival = 0;
+    if (!r.string(&field.key) || !r.consume(':'))
+      return false;
+
+    char c = r.peek();
+    if (c == '"') {
+      field.type = DETAILS_STRING;
+      if (!r.string(&field.text))
+        return false;
+    } else {
+      const char *start, *end;
+      if (!r.value_span(&start, &end))
+        return false;
+      if (c == '{' || c == '[') {
+        field.type = DETAILS_JSON;
+        field.text.assign(start, end);
+      } else if (!parse_scalar(start, end, &field)) {
+        return false;
+      }
+    }
+    fields->push_back(std::move(field));
+  } while (r.consume(','));
+
+  return r.consume('}') && r.at_end();
+}
+
+// --- Binary Form ---
+
+bool details_encode(const std::vector<DetailsField> &fields, std::string *out) {
+  SymbolTable &symbols = global_symbols();
+  out->clear();
+  out->push_back((char)DETAILS_SCHEMA_VERSION);
+  put_varint(out, fields.size());
+
+  for (const DetailsField &f : fields) {
+    uint32_t tag = 0;
+    for (uint32_t t = 1; t < DETAILS_KEY_COUNT; t++)
+      if (f.key == DETAILS_KEYS[t])
+        tag = t;
+    put_varint(out, tag);
+    if (tag == 0) {
+      uint32_t key = symbols.intern(f.key);
+      if (key == SymbolTable::NO_SYMBOL)
+        return false;
+      put_varint(out, key);
+    }
+
+    uint8_t type = f.type;
+    uint32_t sym = SymbolTable::NO_SYMBOL;
+    if (type == DETAILS_STRING && f.text.size() <= DETAILS_INTERN_MAX) {
+      sym = symbols.intern(f.text);
+      if (sym != SymbolTable::NO_SYMBOL)
+        type = DETAILS_SYMBOL;
+    }
+    out->push_back((char)type);
+
+    switch (type) {
+    case DETAILS_INT:
+      put_varint(out, zigzag(f.ival));
+      break;
+    case DETAILS_SYMBOL:
+      put_varint(out, sym);
+      break;
+    case DETAILS_STRING:
+    case DETAILS_NUMBER:
+    case DETAILS_JSON:
+      put_varint(out, f.text.size());
+      out->append(f.text);
+      break;
+    }
+  }
+  return true;
+}
+
+bool details_decode(const char *data, size_t len,
+                    std::vector<DetailsField> *fields) {
+  SymbolTable &symbols = global_symbols();
+  const uint8_t *p = (const uint8_t *)data;
+  const uint8_t *end = p + len;
+  fields->clear();
+
+  uint64_t count;
+  if (len == 0 || *p++ != DETAILS_SCHEMA_VERSION ||
+      !get_varint(p, end, &count) || count > len)
+    return false;
+
+  for (uint64_t i = 0; i < count; i++) {
+    DetailsField f;
+    f.ival = 0;
+    uint64_t tag, v;
+    if (!get_varint(p, end, &tag) || tag >= DETAILS_KEY_COUNT)
+      return false;
+    if (tag == 0) {
+      const std::string *key;
+      if (!get_varint(p, end, &v) || v > UINT32_MAX ||
+          !(key = symbols.name((uint32_t)v)))
+        return false;
+      f.key = *key;
+    } else {
+      f.key = DETAILS_KEYS[tag];
+    }
+
+    if (p >= end)
+      return false;
+    f.type = *p++;
+    switch (f.type) {
+    case DETAILS_NULL:
+    case DETAILS_FALSE:
+    case DETAILS_TRUE:
+      break;
+    case DETAILS_INT:
+      if (!get_varint(p, end, &v))
+        return false;
+      f.ival = unzigzag(v);
+      break;
+    case DETAILS_SYMBOL: {
+      const std::string *s;
+      if (!get_varint(p, end, &v) || v > UINT32_MAX ||
+          !(s = symbols.name((uint32_t)v)))
+        return false;
+      f.type = DETAILS_STRING;
+      f.text = *s;
+      break;
+    }
+    case DETAILS_STRING:
+    case DETAILS_NUMBER:
+    case DETAILS_JSON:
+      if (!get_varint(p, end, &v) || v > (uint64_t)(end - p))
+        return false;
+      f.text.assign((const char *)p, v);
+      p += v;
+      break;
+    default:
+      return false;
+    }
+    fields->push_back(std::move(f));
+  }
+  return p == end;
+}
+
+// --- JSON Output ---
+
+// Escaped like json.dumps(ensure_ascii=True)
+static void json_quote(std::string *out, const std::string &s) {
+  char esc[16];
+  out->push_back('"');
+  for (size_t i = 0; i < s.size();) {
+    uint8_t c = (uint8_t)s[i];
+    if (c < 0x80) {
+      i++;
+      switch (c) {
+      case '"':
+        *out += "\\\"";
+        break;
+      case '\\':
+        *out += "\\\\";
+        break;
+      case '\n':
+        *out += "\\n";
+        break;
+      case '\r':
+        *out += "\\r";
+        break;
+      case '\t':
+        *out += "\\t";
+        break;
+      case '\b':
+        *out += "\\b";
+        break;
+      case '\f':
+        *out += "\\f";
+        break;
+      default:
+        if (c < 0x20) {
+          snprintf(esc, sizeof(esc), "\\u%04x", c);
+          *out += esc;
+        } else {
+          out->push_back((char)c);
+        }
+      }
+      continue;
+    }
+
+    // Decode one UTF-8 sequence; a stray byte is emitted as-is
+    int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+    uint32_t cp = extra == 3 ? c & 0x07 : extra == 2 ? c & 0x0F : c & 0x1F;
+    if (extra == 0 || i + extra >= s.size()) {
+      snprintf(esc, sizeof(esc), "\\u%04x", c);
+      *out += esc;
+      i++;
+      continue;
+    }
+    for (int k = 1; k <= extra; k++)
+      cp = (cp << 6) | ((uint8_t)s[i + k] & 0x3F);
+    i += extra + 1;
+    if (cp >= 0x10000) {
+      cp -= 0x10000;
+      snprintf(esc, sizeof(esc), "\\u%04x\\u%04x", 0xD800 + (cp >> 10),
+               0xDC00 + (cp & 0x3FF));
+    } else {
+      snprintf(esc, sizeof(esc), "\\u%04x", cp);
+    }
+    *out += esc;
+  }
+  out->push_back('"');
+}
+
+std::string details_value_text(const DetailsField &field) {
+  switch (field.type) {
+  case DETAILS_NULL:
+    return "null";
+  case DETAILS_FALSE:
+    return "false";
+  case DETAILS_TRUE:
+    return "true";
+  case DETAILS_INT:
+    return std::to_string(field.ival);
+  default:
+    return field.text;
+  }
+}
+
+void details_to_json(const std::vector<DetailsField> &fields,
+                     std::string *out) {
+  out->clear();
+  out->push_back('{');
+  for (size_t i = 0; i < fields.size(); i++) {
+    const DetailsField &f = fields[i];
+    if (i)
+      *out += ", ";
+    json_quote(out, f.key);
+    *out += ": ";
+    if (f.type == DETAILS_STRING)
+      json_quote(out, f.text);
+    else
+      *out += details_value_text(f);
+  }
+  out->push_back('}');
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// --- Audit Details Codec ---
+// Binary form of the details dict that log_event() used to json.dumps():
+//
+//   [u8 schema version][varint field count]
+//   field: [varint tag][varint key symbol, only if tag == 0][u8 type][value]
+//
+// Keys the application uses are fixed tags (below); any other key is
+// interned. Integers are zigzag varints, short strings are symbol IDs,
+// longer ones length-prefixed bytes. Nested objects and arrays are kept as
+// JSON text. JSON is only rebuilt, in json.dumps() layout, for display and
+// export.
+//
+// Tags are append-only; changing the meaning of a tag or type needs a new
+// schema version.
+
+const uint8_t DETAILS_SCHEMA_VERSION = 1;
+const size_t DETAILS_INTERN_MAX = 32; // longer strings are stored inline
+
+enum DetailsType : uint8_t {
+  DETAILS_NULL,
+  DETAILS_FALSE,
+  DETAILS_TRUE,
+  DETAILS_INT,
+  DETAILS_SYMBOL, // on disk only; decoded as DETAILS_STRING
+  DETAILS_STRING,
+  DETAILS_NUMBER, // non-integer literal, kept as text
+  DETAILS_JSON    // nested object/array, kept as text
+};
+
+struct DetailsField {
+  std::string key;
+  uint8_t type;
+  int64_t ival;     // DETAILS_INT
+  std::string text; // STRING value, NUMBER literal or JSON text
+};
+
+// Top-level JSON object -> fields. False if `json` is not an object.
+bool details_parse_json(const char *json, size_t len,
+                        std::vector<DetailsField> *fields);
+
+bool details_encode(const std::vector<DetailsField> &fields, std::string *out);
+bool details_decode(const char *data, size_t len,
+                    std::vector<DetailsField> *fields);
+
+// json.dumps() layout: {"reason": "invalid_totp_code", "attempt": 3}
+void details_to_json(const std::vector<DetailsField> &fields,
+                     std::string *out);
+
+// Scalar value as text ("true", "42", ...), used for search terms
+std::string details_value_text(const DetailsField &field);
@@ -0,0 +1,461 @@
+#include "enforcement.h"
+
+#include "audit_store.h"
+#include "crypto_core.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+
+static int64_t wall_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+static int64_t steady_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static bool has_text(const char *s) { return s && *s; }
+
+// Raise `value` to at least `v`
+static void store_max(std::atomic<int64_t> &value, int64_t v) {
+  int64_t cur = value.load(std::memory_order_relaxed);
+  while (cur < v && !value.compare_exchange_weak(cur, v))
+    ;
+}
+
+static void store_max(std::atomic<uint64_t> &value, uint64_t v) {
+  uint64_t cur = value.load(std::memory_order_relaxed);
+  while (cur < v && !value.compare_exchange_weak(cur, v))
+    ;
+}
+
+static void json_escape(std::string *out, const char *s) {
+  for (; *s; s++) {
+    char c = *s;
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if ((unsigned char)c >= 0x20) {
+      out->push_back(c);
+    }
+  }
+}
+
+Enforcer::Enforcer(AlertBus &bus)
+    : m_bus(bus), m_entries(ENFORCEMENT_CAPACITY),
+      m_policies(std::make_shared<const PolicyMap>()), m_stop(false),
+      m_subscriber(-1), m_alerts(0), m_actions(0), m_user_blocks(0),
+      m_ip_blocks(0), m_revocations(0), m_step_ups(0), m_table_full(0),
+      m_last_latency_us(0), m_max_latency_us(0) {
+  for (Entry &e : m_entries) {
+    e.seq.store(0);
+    e.key.store(0);
+    e.kind = 0;
+    e.len = 0;
+    e.blocked_until_ms.store(0);
+    e.step_up_since_ms.store(0);
+    e.epoch.store(0);
+  }
+  std::random_device rd;
+  for (size_t i = 0; i < sizeof(m_hash_key); i += 4) {
+    uint32_t r = rd();
+    memcpy(m_hash_key + i, &r, 4);
+  }
+}
+
+Enforcer::~Enforcer() { stop(); }
+
+// --- Table ---
+
+// The key covers the whole name; longer ones are refused rather than cut,
+// so two names never share an entry
+bool Enforcer::make_key(char kind, const char *name, EntryKey *out) const {
+  size_t len = strnlen(name, ENFORCEMENT_MAX_NAME + 1);
+  if (len > ENFORCEMENT_MAX_NAME)
+    return false;
+  out->kind = kind;
+  out->len = (uint8_t)len;
+  memcpy(out->name, name, len);
+  uint8_t buf[1 + ENFORCEMENT_MAX_NAME];
+  buf[0] = (uint8_t)kind; // a user and an IP spelled alike differ
+  memcpy(buf + 1, name, len);
+  out->hash = siphash24(m_hash_key, buf, 1 + len);
+  if (out->hash == 0)
+    out->hash = 1; // 0 marks a free entry
+  return true;
+}
+
+bool Enforcer::key_matches(const Entry &e, const EntryKey &key) {
+  return e.kind == key.kind && e.len == key.len &&
+         memcmp(e.name, key.name, key.len) == 0;
+}
+
+bool Enforcer::lookup(const EntryKey &key, EntryState *out) const {
+  size_t mask = ENFORCEMENT_CAPACITY - 1;
+  for (size_t i = 0; i < ENFORCEMENT_MAX_PROBE; i++) {
+    const Entry &e = m_entries[(key.hash + i) & mask];
+    // Bounded like the other seqlock readers; a writer holds an entry odd
+    // only for a few stores
+    bool consistent = false, match = false;
+    EntryState state = {};
+    for (int attempt = 0; attempt < ENFORCEMENT_SEQ_RETRIES && !consistent;
+         attempt++) {
+      uint32_t before = e.seq.load(std::memory_order_acquire);
+      if (before & 1)
+        continue; // being reused
+      uint64_t k = e.key.load(std::memory_order_acquire);
+      if (k == 0)
+        return false;
+      match = k == key.hash && key_matches(e, key);
+      state.blocked_until_ms = e.blocked_until_ms.load(std::memory_order_acquire);
+      state.step_up_since_ms = e.step_up_since_ms.load(std::memory_order_acquire);
+      state.epoch = e.epoch.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      consistent = e.seq.load(std::memory_order_relaxed) == before;
+    }
+    if (consistent && match) {
+      *out = state;
+      return true;
+    }
+  }
+  return false;
+}
+
+Enforcer::Entry *Enforcer::find_locked(const EntryKey &key) {
+  size_t mask = ENFORCEMENT_CAPACITY - 1;
+  for (size_t i = 0; i < ENFORCEMENT_MAX_PROBE; i++) {
+    Entry &e = m_entries[(key.hash + i) & mask];
+    uint64_t k = e.key.load(std::memory_order_relaxed);
+    if (k == 0)
+      return nullptr;
+    if (k == key.hash && key_matches(e, key))
+      return &e;
+  }
+  return nullptr;
+}
+
+Enforcer::Entry *Enforcer::insert_locked(const EntryKey &key, int64_t now_ms) {
+  size_t mask = ENFORCEMENT_CAPACITY - 1;
+  Entry *target = nullptr;
+  bool reuse = false;
+  for (size_t i = 0; i < ENFORCEMENT_MAX_PROBE; i++) {
+    Entry &e = m_entries[(key.hash + i) & mask];
+    uint64_t k = e.key.load(std::memory_order_relaxed);
+    if (k == 0) {
+      if (!target)
+        target = &e;
+      break;
+    }
+    if (k == key.hash && key_matches(e, key))
+      return &e;
+    // Nothing left to enforce: reading it as absent changes no answer
+    if (!target && e.blocked_until_ms.load() <= now_ms &&
+        e.step_up_since_ms.load() == 0 && e.epoch.load() == 0) {
+      target = &e;
+      reuse = true;
+    }
+  }
+  if (!target) {
+    m_table_full.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  if (!reuse) {
+    // Free: readers stop at key 0, so the name is in place before they
+    // can see the key
+    target->kind = key.kind;
+    target->len = key.len;
+    memcpy(target->name, key.name, key.len);
+    target->key.store(key.hash, std::memory_order_release);
+    return target;
+  }
+  uint32_t seq = target->seq.load(std::memory_order_relaxed);
+  target->seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  target->kind = key.kind;
+  target->len = key.len;
+  memcpy(target->name, key.name, key.len);
+  target->key.store(key.hash, std::memory_order_relaxed);
+  target->blocked_until_ms.store(0, std::memory_order_relaxed);
+  target->seq.store(seq + 2, std::memory_order_release);
+  return target;
+}
+
+// --- Policy ---
+
+void Enforcer::set_policy(const std::string &alert_type,
+                          const EnforcementPolicy &policy) {
+  std::lock_guard<std::mutex> guard(m_policy_lock);
+  std::shared_ptr<PolicyMap> next =
+      std::make_shared<PolicyMap>(*std::atomic_load(&m_policies));
+  if (policy.actions)
+    (*next)[alert_type] = policy;
+  else
+    next->erase(alert_type);
+  std::atomic_store(&m_policies, std::shared_ptr<const PolicyMap>(next));
+}
+
+// --- Enforcing ---
+
+bool Enforcer::start() {
+  std::lock_guard<std::mutex> guard(m_run_lock);
+  if (m_thread.joinable())
+    return true;
+  m_subscriber = m_bus.subscribe();
+  if (m_subscriber < 0)
+    return false;
+  m_stop.store(false);
+  m_thread = std::thread(&Enforcer::run, this);
+  return true;
+}
+
+void Enforcer::stop() {
+  std::lock_guard<std::mutex> guard(m_run_lock);
+  if (!m_thread.joinable())
+    return;
+  m_stop.store(true);
+  m_thread.join();
+  m_bus.unsubscribe(m_subscriber);
+  m_subscriber = -1;
+}
+
+void Enforcer::run() {
+  AlertRecord batch[ENFORCEMENT_BATCH];
+  while (!m_stop.load()) {
+    size_t n = m_bus.poll(m_subscriber, batch, ENFORCEMENT_BATCH,
+                          ENFORCEMENT_POLL_MS);
+    for (size_t i = 0; i < n; i++)
+      apply(batch[i]);
+  }
+}
+
+void Enforcer::apply(const AlertRecord &rec) {
+  m_alerts.fetch_add(1, std::memory_order_relaxed);
+  std::shared_ptr<const PolicyMap> policies = std::atomic_load(&m_policies);
+  auto it = policies->find(rec.alert_type);
+  if (it == policies->end() || !has_text(rec.username))
+    return;
+  const EnforcementPolicy &policy = it->second;
+  int64_t now = wall_ms();
+  int64_t until = now + std::max<int64_t>(policy.duration_ms, 0);
+
+  // Apply everything first, audit after: the log write is the slow part
+  uint32_t applied = 0;
+  EntryKey user_key, ip_key;
+  bool user_ok = make_key('u', rec.username, &user_key);
+  bool ip_ok = has_text(rec.ip_address) &&
+               make_key('i', rec.ip_address, &ip_key);
+  {
+    std::lock_guard<std::mutex> guard(m_write_lock);
+    Entry *user = user_ok ? insert_locked(user_key, now) : nullptr;
+    Entry *ip = nullptr;
+    if (user && (policy.actions & ENFORCE_BLOCK_USER) &&
+        policy.duration_ms > 0) {
+      store_max(user->blocked_until_ms, until);
+      applied |= ENFORCE_BLOCK_USER;
+    }
+    if ((policy.actions & ENFORCE_BLOCK_IP) && policy.duration_ms > 0 &&
+        ip_ok && (ip = insert_locked(ip_key, now))) {
+      store_max(ip->blocked_until_ms, until);
+      applied |= ENFORCE_BLOCK_IP;
+    }
+    if (user && (policy.actions & ENFORCE_REVOKE)) {
+      user->epoch.fetch_add(1);
+      applied |= ENFORCE_REVOKE;
+    }
+    if (user && (policy.actions & ENFORCE_STEP_UP)) {
+      user->step_up_since_ms.store(now);
+      applied |= ENFORCE_STEP_UP;
+    }
+  }
+  if (!applied)
+    return;
+
+  int64_t latency_ns = steady_ns() - rec.published_ns;
+  uint64_t latency_us = latency_ns > 0 ? (uint64_t)latency_ns / 1000 : 0;
+  m_last_latency_us.store(latency_us, std::memory_order_relaxed);
+  store_max(m_max_latency_us, latency_us);
+
+  if (applied & ENFORCE_BLOCK_USER) {
+    m_user_blocks.fetch_add(1, std::memory_order_relaxed);
+    audit(rec, "block_user", "BLOCKED", rec.username, until, now);
+  }
+  if (applied & ENFORCE_BLOCK_IP) {
+    m_ip_blocks.fetch_add(1, std::memory_order_relaxed);
+    audit(rec, "block_ip", "BLOCKED", rec.ip_address, until, now);
+  }
+  if (applied & ENFORCE_REVOKE) {
+    m_revocations.fetch_add(1, std::memory_order_relaxed);
+    audit(rec, "revoke_sessions", "REVOKED", rec.username, 0, now);
+  }
+  if (applied & ENFORCE_STEP_UP) {
+    m_step_ups.fetch_add(1, std::memory_order_relaxed);
+    audit(rec, "step_up", "STEP_UP", rec.username, 0, now);
+  }
+}
+
+void Enforcer::audit(const AlertRecord &rec, const char *action,
+                     const char *status, const char *target, int64_t until_ms,
+                     int64_t now_ms) {
+  m_actions.fetch_add(1, std::memory_order_relaxed);
+  std::string details = "{\"action\": \"";
+  details += action;
+  details += "\", \"target\": \"";
+  json_escape(&details, target);
+  details += "\", \"alert_type\": \"";
+  json_escape(&details, rec.alert_type);
+  details += "\", \"alert_sequence\": " + std::to_string(rec.sequence);
+  if (until_ms)
+    details += ", \"until_ms\": " + std::to_string(until_ms);
+  details += "}";
+  // Dropped quietly if the native log is not open: the action stands
+  audit_enqueue(rec.username, "ENFORCEMENT", status, rec.ip_address,
+                has_text(rec.severity) ? rec.severity : "HIGH",
+                details.c_str(), now_ms);
+}
+
+// --- Checks ---
+
+int64_t Enforcer::blocked_ms(const char *username, const char *ip_address,
+                             int64_t now_ms) const {
+  int64_t until = 0;
+  EntryKey key;
+  EntryState state;
+  if (has_text(username) && make_key('u', username, &key) &&
+      lookup(key, &state))
+    until = state.blocked_until_ms;
+  if (has_text(ip_address) && make_key('i', ip_address, &key) &&
+      lookup(key, &state))
+    until = std::max(until, state.blocked_until_ms);
+  return until > now_ms ? until - now_ms : 0;
+}
+
+bool Enforcer::unblock(const char *username, const char *ip_address) {
+  bool found = false;
+  std::lock_guard<std::mutex> guard(m_write_lock);
+  EntryKey key;
+  Entry *e;
+  if (has_text(username) && make_key('u', username, &key) &&
+      (e = find_locked(key))) {
+    e->blocked_until_ms.store(0);
+    found = true;
+  }
+  if (has_text(ip_address) && make_key('i', ip_address, &key) &&
+      (e = find_locked(key))) {
+    e->blocked_until_ms.store(0);
+    found = true;
+  }
+  return found;
+}
+
+uint32_t Enforcer::session_epoch(const char *username) const {
+  EntryKey key;
+  EntryState state;
+  return has_text(username) && make_key('u', username, &key) &&
+                 lookup(key, &state)
+             ? state.epoch
+             : 0;
+}
+
+int Enforcer::session_check(const char *username, uint32_t epoch) const {
+  EntryKey key;
+  EntryState state;
+  if (!has_text(username) || !make_key('u', username, &key) ||
+      !lookup(key, &state))
+    return ENFORCE_SESSION_VALID;
+  if (state.epoch != epoch)
+    return ENFORCE_SESSION_REVOKED;
+  if (state.step_up_since_ms)
+    return ENFORCE_SESSION_STEP_UP;
+  return ENFORCE_SESSION_VALID;
+}
+
+void Enforcer::step_up_done(const char *username) {
+  EntryKey key;
+  if (!has_text(username) || !make_key('u', username, &key))
+    return;
+  EntryState state;
+  // Called after every TOTP check: only lock when there is a demand to meet
+  if (!lookup(key, &state) || !state.step_up_since_ms)
+    return;
+  std::lock_guard<std::mutex> guard(m_write_lock);
+  Entry *e = find_locked(key);
+  if (e)
+    e->step_up_since_ms.store(0);
+}
+
+void Enforcer::stats(EnforcementStats *out) const {
+  out->alerts = m_alerts.load();
+  out->actions = m_actions.load();
+  out->user_blocks = m_user_blocks.load();
+  out->ip_blocks = m_ip_blocks.load();
+  out->revocations = m_revocations.load();
+  out->step_ups = m_step_ups.load();
+  out->table_full = m_table_full.load();
+  AlertBusStats bus;
+  int sub = m_subscriber.load();
+  out->dropped = sub >= 0 && m_bus.stats(sub, &bus)
+                     ? bus.dropped
+                     : 0;
+  out->last_latency_us = m_last_latency_us.load();
+  out->max_latency_us = m_max_latency_us.load();
+}
+
+Enforcer &global_enforcer() {
+  // The bus is constructed first, so it outlives the enforcer's thread
+  static Enforcer enforcer(global_alert_bus());
+  return enforcer;
+}
+
+// --- Exported Functions for Python ---
+
+extern "C" {
+
+// Follow the alert bus, enforcing the policies set so far and later
+bool enforcement_start() { return global_enforcer().start(); }
+
+void enforcement_stop() { global_enforcer().stop(); }
+
+// ENFORCE_* `actions` for `alert_type` (0 removes it); blocks last
+// `duration_ms`
+bool enforcement_policy(const char *alert_type, uint32_t actions,
+                        int64_t duration_ms) {
+  if (!has_text(alert_type))
+    return false;
+  global_enforcer().set_policy(alert_type, {actions, duration_ms});
+  return true;
+}
+
+// Milliseconds until a login by `username` from `ip_address` may be
+// attempted, 0 if neither is blocked
+int64_t enforcement_blocked(const char *username, const char *ip_address) {
+  return global_enforcer().blocked_ms(username, ip_address, wall_ms());
+}
+
+bool enforcement_unblock(const char *username, const char *ip_address) {
+  return global_enforcer().unblock(username, ip_address);
+}
+
+uint32_t enforcement_session_epoch(const char *username) {
+  return global_enforcer().session_epoch(username);
+}
+
+int enforcement_session_check(const char *username, uint32_t epoch) {
+  return global_enforcer().session_check(username, epoch);
+}
+
+void enforcement_step_up_done(const char *username) {
+  global_enforcer().step_up_done(username);
+}
+
+bool enforcement_stats(EnforcementStats *out) {
+  global_enforcer().stats(out);
+  return true;
+}
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "alert_bus.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// --- Enforcement ---
+// Acts on intrusion alerts as they are raised instead of leaving them for
+// an administrator. A thread subscribed to the alert bus (alert_bus.h)
+// applies the policy configured for each alert type:
+//
+//   ENFORCE_BLOCK_USER  refuse the user's logins until the block expires
+//   ENFORCE_BLOCK_IP    ... and any login from the alert's IP address
+//   ENFORCE_REVOKE      end the user's sessions: a session carries the
+//                       revocation epoch it was issued under and stops
+//                       checking once the user's epoch moves on
+//   ENFORCE_STEP_UP     the user's sessions need a fresh TOTP check
+//
+// Login and session checks read a fixed open-addressing table with atomic
+// loads only - no lock, no allocation - so an action is seen by every
+// thread as soon as it is applied, microseconds after the alert was
+// published. Entries hold the full username or IP and are placed by a
+// SipHash under a random per-process key, so names from outside can
+// neither collide with nor crowd out a chosen user. Usernames longer than
+// an alert is sure to carry whole are not enforced on (their IPs still
+// are): the alert bus cuts them, and a cut name would stand for every
+// username sharing its prefix. An entry with nothing
+// left to enforce (block expired, epoch never moved, no step-up pending) is
+// reused, and updates to it are guarded by a sequence counter. Each action is
+// written to the native audit log as an ENFORCEMENT event naming the alert
+// that caused it.
+
+const uint32_t ENFORCE_BLOCK_USER = 1;
+const uint32_t ENFORCE_BLOCK_IP = 2;
+const uint32_t ENFORCE_REVOKE = 4;
+const uint32_t ENFORCE_STEP_UP = 8;
+
+const size_t ENFORCEMENT_CAPACITY = 1 << 16; // users and IPs; power of two
+const size_t ENFORCEMENT_MAX_PROBE = 64;
+// Longest username or IP enforced on, in bytes: one short of what an
+// AlertRecord holds, so a name the bus had to cut is never one of them
+const size_t ENFORCEMENT_MAX_NAME = 62;
+const int ENFORCEMENT_SEQ_RETRIES = 1 << 10;
+const int ENFORCEMENT_POLL_MS = 100; // how quickly stop() is noticed
+const size_t ENFORCEMENT_BATCH = 64;
+
+// enforcement_session_check() results
+const int ENFORCE_SESSION_VALID = 0;
+const int ENFORCE_SESSION_STEP_UP = 1;
+const int ENFORCE_SESSION_REVOKED = 2;
+
+static_assert((ENFORCEMENT_CAPACITY & (ENFORCEMENT_CAPACITY - 1)) == 0,
+              "capacity must be a power of two");
+
+struct EnforcementPolicy {
+  uint32_t actions;    // ENFORCE_* bits
+  int64_t duration_ms; // of blocks
+};
+
+// Layout shared with Python (ctypes.Structure) - keep fields 64-bit
+struct EnforcementStats {
+  uint64_t alerts;      // read from the bus
+  uint64_t actions;     // applied, all kinds
+  uint64_t user_blocks;
+  uint64_t ip_blocks;
+  uint64_t revocations;
+  uint64_t step_ups;
+  uint64_t table_full;  // actions lost for want of a free entry
+  uint64_t dropped;     // alerts overwritten before the enforcer read them
+  uint64_t last_latency_us; // alert published to action applied
+  uint64_t max_latency_us;
+};
+
+//
+// Enforcer - alert-driven blocks, revocations and step-up demands
+//
+class Enforcer {
+private:
+  // Keyed by `kind` ('u' user, 'i' IP) and the name, placed at their keyed
+  // hash (0 while free). `seq` is odd while the entry is being reused.
+  struct Entry {
+    std::atomic<uint32_t> seq;
+    std::atomic<uint64_t> key;
+    char kind;
+    uint8_t len;
+    char name[ENFORCEMENT_MAX_NAME];
+    std::atomic<int64_t> blocked_until_ms;
+    std::atomic<int64_t> step_up_since_ms; // 0 = none pending
+    std::atomic<uint32_t> epoch;           // revocation epoch (users)
+  };
+
+  struct EntryKey {
+    uint64_t hash;
+    char kind;
+    uint8_t len;
+    char name[ENFORCEMENT_MAX_NAME];
+  };
+
+  // What a lookup copies out of an entry
+  struct EntryState {
+    int64_t blocked_until_ms;
+    int64_t step_up_since_ms;
+    uint32_t epoch;
+  };
+
+  typedef std::unordered_map<std::string, EnforcementPolicy> PolicyMap;
+
+  AlertBus &m_bus;
+  std::vector<Entry> m_entries;
+  uint8_t m_hash_key[16]; // random per process
+  std::mutex m_write_lock; // entries change only under it
+
+  // Replaced whole on change, so the enforcer reads it without a lock
+  std::shared_ptr<const PolicyMap> m_policies;
+  std::mutex m_policy_lock; // writers only
+
+  std::mutex m_run_lock; // start() and stop()
+  std::thread m_thread;
+  std::atomic<bool> m_stop;
+  std::atomic<int> m_subscriber;
+
+  std::atomic<uint64_t> m_alerts, m_actions, m_user_blocks, m_ip_blocks,
+      m_revocations, m_step_ups, m_table_full, m_last_latency_us,
+      m_max_latency_us;
+
+  // False if `name` is longer than ENFORCEMENT_MAX_NAME
+  bool make_key(char kind, const char *name, EntryKey *out) const;
+  static bool key_matches(const Entry &e, const EntryKey &key);
+  // Lock-free: copy out the entry for `key`, false if there is none
+  bool lookup(const EntryKey &key, EntryState *out) const;
+  // Under m_write_lock
+  Entry *find_locked(const EntryKey &key);
+  Entry *insert_locked(const EntryKey &key, int64_t now_ms); // nullptr if full
+
+  void run();
+  void apply(const AlertRecord &rec);
+  void audit(const AlertRecord &rec, const char *action, const char *status,
+             const char *target, int64_t until_ms, int64_t now_ms);
+
+public:
+  explicit Enforcer(AlertBus &bus);
+  ~Enforcer();
+
+  Enforcer(const Enforcer &) = delete;
+  Enforcer &operator=(const Enforcer &) = delete;
+
+  // Actions for an alert type; no actions removes it
+  void set_policy(const std::string &alert_type,
+                  const EnforcementPolicy &policy);
+
+  // Follow the bus on a thread of its own; false if no subscriber slot
+  bool start();
+  void stop();
+  bool running() const { return m_thread.joinable(); }
+
+  // Apply an alert's policy now (what the thread does for each alert)
+  void enforce(const AlertRecord &rec) { apply(rec); }
+
+  // Milliseconds left on a block of the user or the IP (either may be
+  // NULL or empty), 0 if neither is blocked at `now_ms`
+  int64_t blocked_ms(const char *username, const char *ip_address,
+                     int64_t now_ms) const;
+  bool unblock(const char *username, const char *ip_address);
+
+  // Revocation epoch to issue a new session of the user under
+  uint32_t session_epoch(const char *username) const;
+  // ENFORCE_SESSION_* for a session issued under `epoch`
+  int session_check(const char *username, uint32_t epoch) const;
+  // The user passed a TOTP check: pending step-up demands are met
+  void step_up_done(const char *username);
+
+  void stats(EnforcementStats *out) const;
+};
+
+// The process-wide enforcer behind the C API, on global_alert_bus()
+Enforcer &global_enforcer();
@@ -0,0 +1,151 @@
+#include "epoch_reclaim.h"
+
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
+
+// --- Thread Slot Bookkeeping ---
+// Domains register here by ID so a thread exiting after its domain was
+// destroyed does not touch freed memory. IDs come from a counter and are
+// never reused, unlike addresses.
+
+static std::mutex g_domains_lock;
+static std::unordered_map<uint64_t, EpochDomain *> g_domains;
+static std::atomic<uint64_t> g_next_domain_id(1);
+static std::atomic<uint64_t> g_next_thread_token(1);
+
+struct ThreadSlots {
+  struct Entry {
+    uint64_t domain_id;
+    size_t slot;
+  };
+  uint64_t token; // this thread's mark on the slots it claims
+  std::vector<Entry> entries;
+
+  ThreadSlots() : token(g_next_thread_token.fetch_add(1)) {}
+
+  ~ThreadSlots() {
+    std::lock_guard<std::mutex> guard(g_domains_lock);
+    for (const Entry &e : entries) {
+      auto it = g_domains.find(e.domain_id);
+      if (it != g_domains.end())
+        it->second->release_slot(e.slot);
+    }
+  }
+
+  // Forget slots of domains that no longer exist
+  void prune() {
+    std::lock_guard<std::mutex> guard(g_domains_lock);
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [](const Entry &e) {
+                                   return !g_domains.count(e.domain_id);
+                                 }),
+                  entries.end());
+  }
+};
+
+static thread_local ThreadSlots t_slots;
+
+// --- EpochDomain ---
+
+EpochDomain::EpochDomain()
+    : m_id(g_next_domain_id.fetch_add(1)), m_epoch(1) {
+  for (ReaderSlot &s : m_slots) {
+    s.epoch.store(0);
+    s.in_use.store(false);
+    s.owner.store(0);
+  }
+  std::lock_guard<std::mutex> guard(g_domains_lock);
+  g_domains[m_id] = this;
+}
+
+EpochDomain::~EpochDomain() {
+  {
+    std::lock_guard<std::mutex> guard(g_domains_lock);
+    g_domains.erase(m_id);
+  }
+  // No readers can be left once the owner is being destroyed
+  for (const Retired &r : m_retired)
+    r.deleter(r.object);
+}
+
+size_t EpochDomain::slot() {
+  ThreadSlots &mine = t_slots;
+  for (size_t k = 0; k < mine.entries.size(); k++) {
+    const ThreadSlots::Entry &e = mine.entries[k];
+    if (e.domain_id != m_id)
+      continue;
+    // Only this thread releases its slots, so this holds unless the cache
+    // is wrong; then the slot is someone else's and must not be shared
+    if (m_slots[e.slot].owner.load(std::memory_order_relaxed) == mine.token)
+      return e.slot;
+    mine.entries.erase(mine.entries.begin() + k);
+    break;
+  }
+
+  mine.prune();
+  for (;;) {
+    for (size_t i = 0; i < MAX_READERS; i++) {
+      bool expected = false;
+      if (m_slots[i].in_use.compare_exchange_strong(expected, true)) {
+        m_slots[i].owner.store(mine.token);
+        mine.entries.push_back({m_id, i});
+        return i;
+      }
+    }
+    // More concurrent reader threads than slots: wait for one to exit
+    std::this_thread::yield();
+  }
+}
+
+void EpochDomain::release_slot(size_t index) {
+  m_slots[index].epoch.store(0);
+  m_slots[index].owner.store(0);
+  m_slots[index].in_use.store(false);
+}
+
+void EpochDomain::enter(size_t index) {
+  // seq_cst store then load: the swap-side increment is ordered against it
+  m_slots[index].epoch.store(m_epoch.load());
+}
+
+void EpochDomain::exit(size_t index) {
+  m_slots[index].epoch.store(0, std::memory_order_release);
+}
+
+void EpochDomain::retire(void *object, void (*deleter)(void *)) {
+  // Readers entering from now on announce a later epoch and cannot have
+  // loaded the object, which the caller already unpublished
+  uint64_t epoch = m_epoch.fetch_add(1);
+  std::lock_guard<std::mutex> guard(m_retire_lock);
+  m_retired.push_back({object, deleter, epoch});
+}
+
+size_t EpochDomain::reclaim() {
+  uint64_t oldest = UINT64_MAX;
+  for (const ReaderSlot &s : m_slots) {
+    uint64_t e = s.epoch.load();
+    if (e != 0)
+      oldest = std::min(oldest, e);
+  }
+
+  std::vector<Retired> ready;
+  {
+    std::lock_guard<std::mutex> guard(m_retire_lock);
+    auto it = std::partition(m_retired.begin(), m_retired.end(),
+                             [oldest](const Retired &r) {
+                               return r.epoch >= oldest;
+                             });
+    ready.assign(it, m_retired.end());
+    m_retired.erase(it, m_retired.end());
+  }
+
+  for (const Retired &r : ready)
+    r.deleter(r.object);
+  return ready.size();
+}
+
+size_t EpochDomain::pending() {
+  std::lock_guard<std::mutex> guard(m_retire_lock);
+  return m_retired.size();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// --- Epoch-Based Reclamation ---
+// Lets readers dereference a shared pointer without locks while a writer
+// swaps it. Readers announce the global epoch on entry; a retired object is
+// freed once every active reader entered after it was retired.
+
+class EpochDomain {
+public:
+  static const size_t MAX_READERS = 256;
+
+private:
+  struct alignas(64) ReaderSlot {
+    std::atomic<uint64_t> epoch; // 0 = not reading
+    std::atomic<bool> in_use;
+    std::atomic<uint64_t> owner; // token of the claiming thread, 0 = free
+  };
+
+  struct Retired {
+    void *object;
+    void (*deleter)(void *);
+    uint64_t epoch;
+  };
+
+  // Unique for the life of the process, never reused: threads cache their
+  // slot under it, and a later domain at the same address must not match
+  const uint64_t m_id;
+  ReaderSlot m_slots[MAX_READERS];
+  std::atomic<uint64_t> m_epoch;
+  std::mutex m_retire_lock;
+  std::vector<Retired> m_retired;
+
+public:
+  EpochDomain();
+  ~EpochDomain();
+
+  EpochDomain(const EpochDomain &) = delete;
+  EpochDomain &operator=(const EpochDomain &) = delete;
+
+  // Per-thread reader slot, claimed on first use and released at thread exit
+  size_t slot();
+  void release_slot(size_t index);
+
+  uint64_t id() const { return m_id; }
+
+  void enter(size_t index);
+  void exit(size_t index);
+
+  // Hand over an object that is no longer reachable from the shared pointer
+  void retire(void *object, void (*deleter)(void *));
+
+  // Free retired objects no reader can still hold. Returns how many.
+  size_t reclaim();
+  size_t pending();
+};
+
+// RAII read-side critical section
+class EpochGuard {
+private:
+  EpochDomain &m_domain;
+  size_t m_slot;
+
+public:
+  explicit EpochGuard(EpochDomain &domain)
+      : m_domain(domain), m_slot(domain.slot()) {
+    m_domain.enter(m_slot);
+  }
+  ~EpochGuard() { m_domain.exit(m_slot); }
+
+  EpochGuard(const EpochGuard &) = delete;
+  EpochGuard &operator=(const EpochGuard &) = delete;
+};
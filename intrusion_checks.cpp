@@ -0,0 +1,112 @@
+#include "intrusion_checks.h"
+
+#include <algorithm>
+#include <ctime>
+
+static int local_hour(int64_t ts_ms) {
+  time_t secs = (time_t)(ts_ms / 1000);
+  struct tm t;
+#ifdef _WIN32
+  localtime_s(&t, &secs);
+#else
+  localtime_r(&secs, &t);
+#endif
+  return t.tm_hour;
+}
+
+IntrusionChecks::IntrusionChecks(const IntrusionThresholds &thresholds)
+    : m_thresholds(thresholds) {
+  m_thresholds.window_minutes = std::max<int64_t>(thresholds.window_minutes, 1);
+  SymbolTable &symbols = global_symbols();
+  m_login = symbols.intern("LOGIN");
+  m_totp = symbols.intern("TOTP");
+  m_success = symbols.intern("SUCCESS");
+  m_failure = symbols.intern("FAILURE");
+  m_enforcement = symbols.intern("ENFORCEMENT");
+  m_state.set_window(m_thresholds.window_minutes * 60000);
+}
+
+bool IntrusionChecks::set_rules(const std::string &rules, std::string *error) {
+  return m_rules.compile(rules, error) && m_state.set_sequences(rules, error);
+}
+
+void IntrusionChecks::alert(const IntrusionEvent &ev, const std::string &type,
+                            const char *severity,
+                            const std::string &description,
+                            std::vector<IntrusionAlert> *out) {
+  uint64_t key = ((uint64_t)ev.user << 32) | global_symbols().intern(type);
+  auto it = m_last_alert.find(key);
+  if (it != m_last_alert.end() && ev.ts_ms - it->second < ALERT_REPEAT_MS)
+    return;
+  m_last_alert[key] = ev.ts_ms;
+  out->push_back({ev.ts_ms, ev.user, type, severity, description});
+}
+
+size_t IntrusionChecks::check(const IntrusionEvent &ev,
+                              std::vector<IntrusionAlert> *out) {
+  // Blocks and revocations would otherwise count towards the windows and
+  // profiles that raised them
+  if (ev.event_type == m_enforcement)
+    return 0;
+  size_t before = out->size();
+  m_state.note(ev.user, ev.status, ev.ts_ms);
+  uint64_t matched =
+      m_state.advance(ev.user, ev.event_type, ev.status, ev.ts_ms);
+
+  // Brute force and rapid fire; the database query counts timestamps
+  // strictly after now - window
+  int64_t window_ms = m_thresholds.window_minutes * 60000;
+  uint64_t failures =
+      m_state.count(ev.user, m_failure, ev.ts_ms - window_ms + 1);
+  if (failures >= m_thresholds.failed_attempts)
+    alert(ev, "BRUTE_FORCE", "HIGH",
+          "Detected " + std::to_string(failures) +
+              " failed login attempts in " +
+              std::to_string(m_thresholds.window_minutes) + " minutes",
+          out);
+  uint64_t rapid =
+      m_state.count(ev.user, SymbolTable::NO_SYMBOL, ev.ts_ms - 60000 + 1);
+  if (rapid >= m_thresholds.rapid_attempts)
+    alert(ev, "RAPID_FIRE", "CRITICAL",
+          "Detected " + std::to_string(rapid) +
+              " attempts in 1 minute - possible automated attack",
+          out);
+
+  // Against the user's profile once it has enough history, as it was
+  // before this event: it is learned only after the checks below
+  IntrusionScore score;
+  int offset = ev.event_type == m_totp ? ev.totp_offset : PROFILE_NO_TOTP;
+  bool profiled =
+      m_state.score(ev.user, ev.ts_ms, ev.ip_prefix, offset, &score);
+  bool known = profiled && score.logins >= PROFILE_MIN_LOGINS;
+  if (failures >= 2) {
+    int hour = local_hour(ev.ts_ms);
+    if (known ? score.hour >= UNUSUAL_HOUR_BITS : hour < 6 || hour > 22)
+      alert(ev, "UNUSUAL_TIMING", "MEDIUM",
+            "Multiple failed attempts detected at unusual hour (" +
+                std::to_string(hour) + ":00)",
+            out);
+  }
+  if (known && ev.status == m_success && ev.event_type == m_login &&
+      score.network >= UNFAMILIAR_NETWORK_BITS)
+    alert(ev, "UNFAMILIAR_NETWORK", "MEDIUM",
+          "Successful login from a network unusual for this user", out);
+  if (profiled && offset != PROFILE_NO_TOTP &&
+      score.totp_count >= PROFILE_MIN_TOTP && score.totp >= TOTP_DRIFT_SPREADS)
+    alert(ev, "TOTP_DRIFT", "LOW",
+          "TOTP code accepted at step offset " + std::to_string(offset) +
+              ", unusual for this user's device",
+          out);
+
+  for (size_t i = 0; matched && i < m_rules.rule_count(); i++)
+    if (matched >> i & 1)
+      alert(ev, m_rules.rule_name(i), nullptr,
+            "Matched sequence rule " + m_rules.rule_name(i), out);
+
+  if (ev.status == m_success && ev.event_type == m_login)
+    m_state.learn_login(ev.user, ev.ts_ms, ev.ip_prefix);
+  if (ev.status == m_success && ev.event_type == m_totp &&
+      ev.totp_offset != PROFILE_NO_TOTP)
+    m_state.learn_totp(ev.user, ev.totp_offset);
+  return out->size() - before;
+}
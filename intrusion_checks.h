@@ -0,0 +1,76 @@
+#pragma once
+
+#include "intrusion_state.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// --- Intrusion Checks ---
+// The checks audit_log.check_intrusion_patterns() makes as each event is
+// logged, over an IntrusionState fed by the events themselves with each
+// event's own time as "now". Used by the tools that run detection outside
+// the service: audit_replay over recorded history, attack_sim over
+// synthetic traffic. Thresholds are those of audit_log.py.
+
+const double UNUSUAL_HOUR_BITS = 3.0;
+const double UNFAMILIAR_NETWORK_BITS = 4.0;
+const double TOTP_DRIFT_SPREADS = 6.0;
+const uint32_t PROFILE_MIN_TOTP = 5;
+const int64_t ALERT_REPEAT_MS = 3600 * 1000; // create_alert() de-duplication
+
+struct IntrusionThresholds {
+  uint32_t failed_attempts; // FAILED_ATTEMPTS_THRESHOLD
+  int64_t window_minutes;   // TIME_WINDOW_MINUTES
+  uint32_t rapid_attempts;  // RAPID_ATTEMPTS_THRESHOLD, per minute
+};
+
+// Symbol IDs as interned in global_symbols()
+struct IntrusionEvent {
+  int64_t ts_ms;
+  uint32_t user;
+  uint32_t event_type;
+  uint32_t status;
+  uint32_t ip_prefix; // intrusion_ip_prefix(), 0 if unknown
+  int totp_offset;    // PROFILE_NO_TOTP unless a successful TOTP check
+};
+
+struct IntrusionAlert {
+  int64_t ts_ms;
+  uint32_t user;
+  std::string type;     // e.g. "BRUTE_FORCE", or a sequence rule's name
+  const char *severity; // nullptr for sequence rules (set by the caller)
+  std::string description;
+};
+
+//
+// IntrusionChecks - alerts raised by a stream of events
+//
+class IntrusionChecks {
+private:
+  IntrusionThresholds m_thresholds;
+  IntrusionState m_state;
+  SequenceDetector m_rules; // names of the rules m_state follows
+  uint32_t m_login, m_totp, m_success, m_failure;
+  uint32_t m_enforcement; // the enforcer's own actions, not attempts
+  std::unordered_map<uint64_t, int64_t> m_last_alert; // by user, type
+
+  void alert(const IntrusionEvent &ev, const std::string &type,
+             const char *severity, const std::string &description,
+             std::vector<IntrusionAlert> *out);
+
+public:
+  explicit IntrusionChecks(const IntrusionThresholds &thresholds);
+
+  // Sequence rules (sequence_detector.h syntax). False, with the reason in
+  // `error`, if they do not compile.
+  bool set_rules(const std::string &rules, std::string *error);
+
+  // Feed one event, in time order, and append the alerts it raises. An
+  // alert repeating one of the same type for the same user within
+  // ALERT_REPEAT_MS is dropped. ENFORCEMENT events are skipped, as
+  // AuditStore::observe() skips them. Returns the number appended.
+  size_t check(const IntrusionEvent &ev, std::vector<IntrusionAlert> *out);
+};
@@ -0,0 +1,579 @@
+#include "intrusion_state.h"
+
+#include "credential_snapshot.h"
+#include "crypto_core.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+static int64_t now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+static void put_varint(std::string *out, uint64_t v) {
+  while (v >= 0x80) {
+    out->push_back((char)(v | 0x80));
+    v >>= 7;
+  }
+  out->push_back((char)v);
+}
+
+static bool get_varint(const uint8_t *&p, const uint8_t *end, uint64_t *v) {
+  uint64_t result = 0;
+  for (int shift = 0; shift < 64 && p < end; shift += 7) {
+    uint8_t b = *p++;
+    result |= (uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      *v = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint64_t window_key(uint32_t user, uint32_t status) {
+  return ((uint64_t)user << 32) | status;
+}
+
+// Local hour and day of week, the way the user sees their own habits
+static void local_time(int64_t ts_ms, int *hour, int *day) {
+  time_t secs = (time_t)(ts_ms / 1000);
+  struct tm tm_local;
+#ifdef _WIN32
+  localtime_s(&tm_local, &secs);
+#else
+  localtime_r(&secs, &tm_local);
+#endif
+  *hour = tm_local.tm_hour;
+  *day = tm_local.tm_wday;
+}
+
+uint32_t intrusion_ip_prefix(const char *ip) {
+  if (!ip || !*ip)
+    return 0;
+  unsigned a, b, c, d;
+  char tail;
+  if (sscanf(ip, "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) == 4 && a < 256 &&
+      b < 256 && c < 256 && d < 256)
+    return ((a << 16) | (b << 8) | c) + 1;
+  if (!strchr(ip, ':'))
+    return 0;
+  // First three IPv6 groups as written; the high bit keeps them apart
+  // from IPv4 prefixes
+  const char *end = ip;
+  for (int colons = 0; *end && colons < 3; end++)
+    colons += *end == ':';
+  return (uint32_t)fnv1a64(ip, (size_t)(end - ip)) | 0x80000000u;
+}
+
+IntrusionState::IntrusionState()
+    : m_window_ms(INTRUSION_WINDOW_MS), m_latest_ms(0), m_sweep_ms(0),
+      m_restored_ms(0), m_restored_id(0), m_written_id(0), m_stop(false) {}
+
+IntrusionState::~IntrusionState() { stop_checkpoints(); }
+
+// --- Windows ---
+
+// Each event goes under (user, status) and (user, any status)
+void IntrusionState::note(uint32_t user, uint32_t status, int64_t ts_ms) {
+  if (user == SymbolTable::NO_SYMBOL)
+    return;
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (ts_ms > m_latest_ms)
+    m_latest_ms = ts_ms;
+  int64_t oldest = m_latest_ms - m_window_ms;
+  if (ts_ms < oldest)
+    return;
+
+  uint64_t keys[2] = {window_key(user, SymbolTable::NO_SYMBOL),
+                      window_key(user, status)};
+  for (int k = 0; k < (status == SymbolTable::NO_SYMBOL ? 1 : 2); k++) {
+    std::deque<int64_t> &times = m_windows[keys[k]];
+    // Events arrive nearly in order, so this is almost always push_back
+    times.insert(std::upper_bound(times.begin(), times.end(), ts_ms), ts_ms);
+    while (times.front() < oldest)
+      times.pop_front();
+  }
+
+  // Users who went quiet are only dropped by a sweep
+  if (m_latest_ms - m_sweep_ms < INTRUSION_SWEEP_MS)
+    return;
+  m_sweep_ms = m_latest_ms;
+  for (auto it = m_windows.begin(); it != m_windows.end();) {
+    std::deque<int64_t> &times = it->second;
+    while (!times.empty() && times.front() < oldest)
+      times.pop_front();
+    if (times.empty())
+      it = m_windows.erase(it);
+    else
+      ++it;
+  }
+}
+
+void IntrusionState::set_written(uint64_t event_id) {
+  m_written_id.store(event_id);
+}
+
+// Events are noted before their record is written, so every record up to
+// the checkpoint's event ID is in it. A later record was either noted after
+// the checkpoint or still queued (or in an open burst) when it was taken;
+// the latter are stamped before its latest time, and one stamped in that
+// very millisecond is counted again rather than risk missing it.
+bool IntrusionState::covers(uint64_t event_id, int64_t ts_ms) const {
+  std::lock_guard<std::mutex> guard(m_lock);
+  return (event_id && event_id <= m_restored_id) || ts_ms < m_restored_ms;
+}
+
+uint64_t IntrusionState::count(uint32_t user, uint32_t status,
+                               int64_t since_ms) const {
+  std::lock_guard<std::mutex> guard(m_lock);
+  auto it = m_windows.find(window_key(user, status));
+  if (it == m_windows.end())
+    return 0;
+  const std::deque<int64_t> &times = it->second;
+  return times.end() - std::lower_bound(times.begin(), times.end(), since_ms);
+}
+
+// --- Profiles ---
+
+// Count a hit in `bins`, halving them all when one saturates: O(count) but
+// once in ~128 hits
+static void bump(uint8_t *bins, size_t count, size_t i) {
+  if (++bins[i] < 255)
+    return;
+  for (size_t k = 0; k < count; k++)
+    bins[k] >>= 1;
+}
+
+static uint32_t total(const uint8_t *bins, size_t count) {
+  uint32_t sum = 0;
+  for (size_t k = 0; k < count; k++)
+    sum += bins[k];
+  return sum;
+}
+
+// Bits for an event with `share` of the profile, against a uniform guess
+// spread over `bins` (0 if the share is at least that)
+static double surprise(double share, int bins) {
+  return share * bins >= 1 ? 0 : -std::log2(share * bins);
+}
+
+void IntrusionState::learn_login(uint32_t user, int64_t ts_ms,
+                                 uint32_t ip_prefix) {
+  if (user == SymbolTable::NO_SYMBOL)
+    return;
+  int hour, day;
+  local_time(ts_ms, &hour, &day);
+  std::lock_guard<std::mutex> guard(m_lock);
+  IntrusionProfile &p = m_profiles[user];
+  bump(p.hours, 24, hour);
+  bump(p.days, 7, day);
+  if (p.logins < 255)
+    p.logins++;
+  if (!ip_prefix)
+    return;
+
+  // Misra-Gries: count a held prefix, else take a free slot, else wear
+  // every slot down by one
+  int free = -1;
+  for (int i = 0; i < 3; i++) {
+    if (p.weights[i] && p.prefixes[i] == ip_prefix) {
+      if (++p.weights[i] >= PROFILE_PREFIX_CAP)
+        for (uint8_t &w : p.weights)
+          w >>= 1;
+      return;
+    }
+    if (!p.weights[i] && free < 0)
+      free = i;
+  }
+  if (free >= 0) {
+    p.prefixes[free] = ip_prefix;
+    p.weights[free] = 1;
+    return;
+  }
+  for (uint8_t &w : p.weights)
+    w--;
+}
+
+// Averages move 1/8 of the way to each new offset
+void IntrusionState::learn_totp(uint32_t user, int offset) {
+  if (user == SymbolTable::NO_SYMBOL)
+    return;
+  int x = std::max(-1, std::min(1, offset)) * 64;
+  std::lock_guard<std::mutex> guard(m_lock);
+  IntrusionProfile &p = m_profiles[user];
+  if (p.totp_count == 0) {
+    p.totp_mean = (int8_t)x;
+    p.totp_spread = 0;
+  } else {
+    int dev = x - p.totp_mean;
+    p.totp_mean = (int8_t)(p.totp_mean + dev / 8);
+    p.totp_spread = (uint8_t)(p.totp_spread + (abs(dev) - p.totp_spread) / 8);
+  }
+  if (p.totp_count < 255)
+    p.totp_count++;
+}
+
+bool IntrusionState::score(uint32_t user, int64_t ts_ms, uint32_t ip_prefix,
+                           int totp_offset, IntrusionScore *out) const {
+  int hour, day;
+  local_time(ts_ms, &hour, &day);
+  std::lock_guard<std::mutex> guard(m_lock);
+  auto it = m_profiles.find(user);
+  if (it == m_profiles.end())
+    return false;
+  const IntrusionProfile &p = it->second;
+  const double prior = 0.5; // per bin, so nothing is ever impossible
+
+  // A login counts once at its hour and half at each neighbour (two in
+  // all), so a 9:00 habit also covers 8:59
+  double hits = p.hours[hour] +
+                0.5 * (p.hours[(hour + 23) % 24] + p.hours[(hour + 1) % 24]);
+  out->hour = surprise((hits + prior) / (2.0 * total(p.hours, 24) + 24 * prior),
+                       24);
+  out->day =
+      surprise((p.days[day] + prior) / (total(p.days, 7) + 7 * prior), 7);
+
+  out->network = 0;
+  if (ip_prefix) {
+    double weight = 0;
+    for (int i = 0; i < 3; i++)
+      if (p.weights[i] && p.prefixes[i] == ip_prefix)
+        weight = p.weights[i];
+    out->network =
+        -std::log2((weight + prior) / (total(p.weights, 3) + 4 * prior));
+  }
+
+  out->totp = 0;
+  if (totp_offset != PROFILE_NO_TOTP && p.totp_count) {
+    int x = std::max(-1, std::min(1, totp_offset)) * 64;
+    out->totp = abs(x - p.totp_mean) / (double)std::max(16, (int)p.totp_spread);
+  }
+  out->logins = p.logins;
+  out->totp_count = p.totp_count;
+  return true;
+}
+
+// --- Sequences ---
+
+bool IntrusionState::set_sequences(const std::string &rules,
+                                   std::string *error) {
+  std::shared_ptr<SequenceDetector> detector(new SequenceDetector());
+  if (!detector->compile(rules, error))
+    return false;
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (m_sequences && m_sequences->spec() == rules)
+    return true;
+  m_sequences = detector;
+  for (auto &entry : m_profiles)
+    entry.second.sequence = 0;
+  return true;
+}
+
+// Caller holds m_lock. States restored from a checkpoint for `rules` stay
+// valid only under the same rules; with none configured yet, take them.
+void IntrusionState::adopt_sequences_locked(const std::string &rules) {
+  if (!m_sequences && !rules.empty()) {
+    std::shared_ptr<SequenceDetector> detector(new SequenceDetector());
+    std::string error;
+    if (detector->compile(rules, &error))
+      m_sequences = detector;
+  }
+  if (m_sequences && m_sequences->spec() == rules)
+    return;
+  for (auto &entry : m_profiles)
+    entry.second.sequence = 0;
+}
+
+uint64_t IntrusionState::advance(uint32_t user, uint32_t event_type,
+                                 uint32_t status, int64_t ts_ms) {
+  if (user == SymbolTable::NO_SYMBOL)
+    return 0;
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (!m_sequences || !m_sequences->consumes(event_type))
+    return 0;
+  IntrusionProfile &p = m_profiles[user];
+  int64_t minute = ts_ms / 60000;
+  if (minute - p.sequence_minute > INTRUSION_WINDOW_MS / 60000)
+    p.sequence = 0;
+  p.sequence = m_sequences->step(p.sequence, event_type, status);
+  p.sequence_minute = (uint32_t)minute;
+  return m_sequences->accepted(p.sequence);
+}
+
+void IntrusionState::sequence_matches(uint32_t user, uint32_t event_type,
+                                      std::vector<std::string> *out) const {
+  out->clear();
+  std::lock_guard<std::mutex> guard(m_lock);
+  auto it = m_profiles.find(user);
+  if (!m_sequences || !m_sequences->consumes(event_type) ||
+      it == m_profiles.end())
+    return;
+  uint64_t matched = m_sequences->accepted(it->second.sequence);
+  for (size_t i = 0; i < m_sequences->rule_count(); i++)
+    if (matched >> i & 1)
+      out->push_back(m_sequences->rule_name(i));
+}
+
+void IntrusionState::set_window(int64_t window_ms) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_window_ms = window_ms;
+}
+
+int64_t IntrusionState::window_ms() const {
+  std::lock_guard<std::mutex> guard(m_lock);
+  return m_window_ms;
+}
+
+void IntrusionState::clear() {
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_windows.clear();
+  m_profiles.clear();
+  m_latest_ms = m_sweep_ms = m_restored_ms = 0;
+  m_restored_id = 0;
+  m_written_id = 0;
+}
+
+// --- Checkpoints ---
+
+// Append a section header for end_section() to fill in
+static size_t begin_section(std::string *out, uint32_t tag) {
+  IntrusionSection section;
+  memset(&section, 0, sizeof(section));
+  section.tag = tag;
+  out->append((const char *)&section, sizeof(section));
+  return out->size() - sizeof(section);
+}
+
+static void end_section(std::string *out, size_t start) {
+  uint64_t bytes = out->size() - start - sizeof(IntrusionSection);
+  memcpy(&(*out)[start + offsetof(IntrusionSection, bytes)], &bytes,
+         sizeof(bytes));
+}
+
+// Caller holds m_lock. Only copies, into `out`'s reused buffers; encode()
+// does the rest off the lock.
+void IntrusionState::snapshot_locked(Snapshot *out) const {
+  out->latest_ms = m_latest_ms;
+  out->event_id = m_written_id.load();
+  out->windows.clear();
+  out->times.clear();
+  int64_t oldest = m_latest_ms - m_window_ms;
+  for (const auto &entry : m_windows) {
+    const std::deque<int64_t> &times = entry.second;
+    auto first = std::lower_bound(times.begin(), times.end(), oldest);
+    if (first == times.end())
+      continue;
+    out->windows.emplace_back(entry.first, (uint32_t)(times.end() - first));
+    out->times.insert(out->times.end(), first, times.end());
+  }
+  out->profiles.assign(m_profiles.begin(), m_profiles.end());
+  out->sequences = m_sequences;
+}
+
+// Appends the sections
+void IntrusionState::encode(const Snapshot &snap, std::string *out) {
+  size_t start = begin_section(out, INTRUSION_SECTION_WINDOWS);
+  const int64_t *times = snap.times.data();
+  for (const auto &window : snap.windows) {
+    put_varint(out, window.first);
+    put_varint(out, window.second);
+    int64_t prev = snap.latest_ms;
+    for (uint32_t i = window.second; i-- > 0;) {
+      put_varint(out, (uint64_t)(prev - times[i]));
+      prev = times[i];
+    }
+    times += window.second;
+  }
+  end_section(out, start);
+
+  start = begin_section(out, INTRUSION_SECTION_PROFILES);
+  for (const auto &entry : snap.profiles) {
+    put_varint(out, entry.first);
+    out->append((const char *)&entry.second, sizeof(entry.second));
+  }
+  end_section(out, start);
+
+  if (snap.sequences) {
+    start = begin_section(out, INTRUSION_SECTION_SEQUENCES);
+    out->append(snap.sequences->spec());
+    end_section(out, start);
+  }
+}
+
+// Sections of a checked checkpoint; m_latest_ms is already set. `rules`
+// gets the sequence rules the profiles were saved under.
+bool IntrusionState::decode(const uint8_t *p, size_t len,
+                            std::string *rules) {
+  const uint8_t *end = p + len;
+  while (p < end) {
+    IntrusionSection section;
+    if ((size_t)(end - p) < sizeof(section))
+      return false;
+    memcpy(&section, p, sizeof(section));
+    p += sizeof(section);
+    if (section.bytes > (uint64_t)(end - p))
+      return false;
+    const uint8_t *section_end = p + section.bytes;
+    if (section.tag == INTRUSION_SECTION_SEQUENCES) {
+      rules->assign((const char *)p, (size_t)section.bytes);
+      p = section_end;
+      continue;
+    }
+    if (section.tag == INTRUSION_SECTION_PROFILES) {
+      while (p < section_end) {
+        uint64_t user;
+        IntrusionProfile profile;
+        if (!get_varint(p, section_end, &user) ||
+            (size_t)(section_end - p) < sizeof(profile))
+          return false;
+        memcpy(&profile, p, sizeof(profile));
+        p += sizeof(profile);
+        m_profiles[(uint32_t)user] = profile;
+      }
+      continue;
+    }
+    if (section.tag != INTRUSION_SECTION_WINDOWS) {
+      p = section_end;
+      continue;
+    }
+
+    while (p < section_end) {
+      uint64_t key, count, gap;
+      if (!get_varint(p, section_end, &key) ||
+          !get_varint(p, section_end, &count) || count == 0 ||
+          count > (uint64_t)(section_end - p))
+        return false;
+      std::deque<int64_t> &times = m_windows[key];
+      int64_t t = m_latest_ms;
+      for (uint64_t i = 0; i < count; i++) {
+        if (!get_varint(p, section_end, &gap))
+          return false;
+        t -= (int64_t)gap;
+        times.push_front(t);
+      }
+    }
+  }
+  return true;
+}
+
+bool IntrusionState::load(const char *path) {
+  clear();
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  std::vector<uint8_t> data;
+  fseek(f, 0, SEEK_END);
+  data.resize((size_t)std::max(0L, ftell(f)));
+  rewind(f);
+  bool read = fread(data.data(), 1, data.size(), f) == data.size();
+  fclose(f);
+
+  IntrusionCheckpointHeader header;
+  if (!read || data.size() < sizeof(header))
+    return false;
+  memcpy(&header, data.data(), sizeof(header));
+  const uint8_t *sections = data.data() + sizeof(header);
+  if (memcmp(header.magic, INTRUSION_CHECKPOINT_MAGIC, 8) != 0 ||
+      header.version != INTRUSION_CHECKPOINT_VERSION ||
+      header.bytes != data.size() - sizeof(header) ||
+      fnv1a64(sections, (size_t)header.bytes) != header.check)
+    return false;
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_latest_ms = m_sweep_ms = m_restored_ms = header.latest_ms;
+  m_restored_id = header.event_id;
+  std::string rules;
+  if (!decode(sections, (size_t)header.bytes, &rules)) {
+    m_windows.clear();
+    m_profiles.clear();
+    m_latest_ms = m_sweep_ms = m_restored_ms = 0;
+    m_restored_id = 0;
+    return false;
+  }
+  adopt_sequences_locked(rules);
+  return true;
+}
+
+bool IntrusionState::save(const char *path) {
+  std::lock_guard<std::mutex> save_guard(m_save_lock);
+  IntrusionCheckpointHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, INTRUSION_CHECKPOINT_MAGIC, 8);
+  header.version = INTRUSION_CHECKPOINT_VERSION;
+  header.written_ms = now_ms();
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    snapshot_locked(&m_snapshot);
+  }
+  header.latest_ms = m_snapshot.latest_ms;
+  header.event_id = m_snapshot.event_id;
+  header.sections = m_snapshot.sequences ? 3 : 2;
+  m_buffer.clear();
+  encode(m_snapshot, &m_buffer);
+  header.bytes = m_buffer.size();
+  header.check = fnv1a64(m_buffer.data(), m_buffer.size());
+
+  std::string tmp = std::string(path) + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (!f)
+    return false;
+  bool ok = fwrite(&header, 1, sizeof(header), f) == sizeof(header) &&
+            fwrite(m_buffer.data(), 1, m_buffer.size(), f) ==
+                m_buffer.size() &&
+            fflush(f) == 0;
+#ifndef _WIN32
+  ok = ok && fsync(fileno(f)) == 0;
+#endif
+  ok = fclose(f) == 0 && ok;
+  if (!ok || !replace_file(tmp.c_str(), path)) {
+    remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool IntrusionState::start_checkpoints(const char *path,
+                                       int64_t interval_ms) {
+  stop_checkpoints();
+  if (!path || interval_ms <= 0)
+    return false;
+  m_path = path;
+  m_stop = false;
+  m_thread = std::thread(&IntrusionState::checkpoint_loop, this, interval_ms);
+  return true;
+}
+
+void IntrusionState::stop_checkpoints() {
+  if (!m_thread.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> guard(m_thread_lock);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  m_thread.join();
+  save(m_path.c_str());
+}
+
+void IntrusionState::checkpoint_loop(int64_t interval_ms) {
+  std::unique_lock<std::mutex> guard(m_thread_lock);
+  while (!m_wake.wait_for(guard, std::chrono::milliseconds(interval_ms),
+                          [&] { return m_stop; })) {
+    guard.unlock();
+    save(m_path.c_str());
+    guard.lock();
+  }
+}
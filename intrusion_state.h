@@ -0,0 +1,235 @@
+#pragma once
+
+#include "sequence_detector.h"
+#include "symbol_table.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// --- Intrusion State ---
+// In-memory state that brute-force and rapid-fire detection count from,
+// fed as events are logged (see audit_store.h). It is checkpointed to one
+// file in the audit directory so a restart does not hand an attacker a
+// clean slate, including events that were sampled out or still queued
+// when the process stopped:
+//
+//   [IntrusionCheckpointHeader][section]...
+//   section: [IntrusionSection][bytes]
+//
+// Each kind of state is a tagged section; unknown tags are skipped. A
+// checkpoint copies the state into flat buffers under the state lock (no
+// encoding, no allocation once they have grown), then a background thread
+// encodes, writes, fsyncs and renames it into place off the lock. It
+// records the last audit record written when it was taken; on open the
+// store restores it and replays only the records it does not cover (see
+// covers()).
+//
+// Alongside the windows each user has a fixed-size behavioural profile
+// (IntrusionProfile), learned from their successful logins and TOTP checks
+// in O(1) per event, that events are scored against instead of fixed rules.
+// The profile also holds the user's state in the sequence rules (see
+// sequence_detector.h), advanced by their LOGIN/TOTP/REGISTRATION events.
+
+const char INTRUSION_CHECKPOINT_MAGIC[8] = {'S', 'A', 'I', 'D', 'S', 'C',
+                                            'K', '1'};
+const uint32_t INTRUSION_CHECKPOINT_VERSION = 3;
+const int64_t INTRUSION_WINDOW_MS = 15 * 60 * 1000; // default history per user
+const int64_t INTRUSION_SWEEP_MS = 60 * 1000;
+const int64_t INTRUSION_CHECKPOINT_MS = 30 * 1000; // background interval
+
+// IntrusionSection::tag
+const uint32_t INTRUSION_SECTION_WINDOWS = 1;
+const uint32_t INTRUSION_SECTION_PROFILES = 2;
+const uint32_t INTRUSION_SECTION_SEQUENCES = 3;
+
+const uint32_t PROFILE_MIN_LOGINS = 10; // before login scores mean anything
+const uint8_t PROFILE_PREFIX_CAP = 63;  // prefix weights halve at this
+const int PROFILE_NO_TOTP = -128;       // score() without a TOTP offset
+
+struct IntrusionCheckpointHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t sections;
+  int64_t latest_ms;  // newest event time the state includes
+  int64_t written_ms; // wall clock when taken
+  uint64_t event_id;  // last audit record written when taken
+  uint64_t bytes;     // of the sections
+  uint64_t check;     // fnv1a64 of the sections
+};
+
+struct IntrusionSection {
+  uint32_t tag;
+  uint32_t reserved;
+  uint64_t bytes;
+};
+
+// Windows section: per key [varint key][varint count][varint
+// latest_ms - newest][varint gaps to each older time, newest first]
+
+// Profiles section: per user [varint user][IntrusionProfile]
+// Sequences section: the rule text the profiles' sequence states are for
+
+// Hour-of-week is kept as its two marginals (24 + 7 bins rather than 168).
+// Bins count up and the whole histogram halves when one saturates, so old
+// habits fade as new ones are learned. 56 bytes with no padding, the last
+// 6 holding the sequence state.
+struct IntrusionProfile {
+  uint8_t hours[24];        // successful logins by local hour
+  uint8_t days[7];          // ... by local day of week (0 = Sunday)
+  uint8_t logins;           // seen, saturating at 255
+  uint32_t prefixes[3];     // frequent network prefixes (Misra-Gries)
+  uint8_t weights[3];       // of each prefix; 0 = free slot
+  uint8_t totp_count;       // TOTP offsets seen, saturating at 255
+  int8_t totp_mean;         // moving average of the TOTP step offset, x64
+  uint8_t totp_spread;      // moving average of |offset - mean|, x64
+  uint16_t sequence;        // SequenceDetector state
+  uint32_t sequence_minute; // of the last event it took (Unix minutes)
+};
+
+// Surprise of an event against its user's profile, in bits (-log2 of its
+// share); hour and day relative to a uniform guess, so 0 is at least as
+// typical as that
+struct IntrusionScore {
+  double hour;         // local hour, smoothed over neighbouring hours
+  double day;          // local day of week
+  double network;      // IP prefix among the frequent ones
+  double totp;         // TOTP offset, in spreads from the usual one
+  uint32_t logins;     // behind the hour/day/network scores
+  uint32_t totp_count; // behind the TOTP score
+};
+
+static_assert(sizeof(IntrusionCheckpointHeader) == 56, "checkpoint layout");
+static_assert(sizeof(IntrusionSection) == 16, "section layout");
+static_assert(sizeof(IntrusionProfile) == 56, "profile layout");
+static_assert(offsetof(IntrusionProfile, sequence_minute) == 52,
+              "profile has no padding");
+
+// IPv4 /24 or IPv6 /48 of an address as a nonzero key, 0 if unparseable
+uint32_t intrusion_ip_prefix(const char *ip);
+
+//
+// IntrusionState - recent per-user event times, with checkpoints
+//
+class IntrusionState {
+private:
+  // Sorted event times by window_key(user, status), for the last
+  // m_window_ms; status NO_SYMBOL holds every status
+  std::unordered_map<uint64_t, std::deque<int64_t>> m_windows;
+  int64_t m_window_ms;
+  int64_t m_latest_ms;
+  int64_t m_sweep_ms;
+  int64_t m_restored_ms; // latest_ms of the checkpoint loaded, or 0
+  uint64_t m_restored_id; // ... and its event_id
+  std::unordered_map<uint32_t, IntrusionProfile> m_profiles; // by user
+  // Replaced whole by set_sequences(); states of other rules are reset
+  std::shared_ptr<const SequenceDetector> m_sequences;
+  mutable std::mutex m_lock;
+  std::atomic<uint64_t> m_written_id; // see set_written()
+
+  // The state as a checkpoint copies it out of the live maps
+  struct Snapshot {
+    int64_t latest_ms;
+    uint64_t event_id;
+    std::vector<std::pair<uint64_t, uint32_t>> windows; // key, times
+    std::vector<int64_t> times; // each window's in turn, oldest first
+    std::vector<std::pair<uint32_t, IntrusionProfile>> profiles;
+    std::shared_ptr<const SequenceDetector> sequences;
+  };
+
+  std::string m_path;
+  Snapshot m_snapshot;    // reused between checkpoints
+  std::string m_buffer;   // serialised checkpoint, reused
+  std::mutex m_save_lock; // one save at a time; guards the two above
+  std::thread m_thread;
+  std::mutex m_thread_lock;
+  std::condition_variable m_wake;
+  bool m_stop;
+
+  void checkpoint_loop(int64_t interval_ms);
+  void snapshot_locked(Snapshot *out) const;
+  static void encode(const Snapshot &snap, std::string *out);
+  bool decode(const uint8_t *p, size_t len, std::string *rules);
+  void adopt_sequences_locked(const std::string &rules);
+
+public:
+  IntrusionState();
+  ~IntrusionState();
+
+  IntrusionState(const IntrusionState &) = delete;
+  IntrusionState &operator=(const IntrusionState &) = delete;
+
+  // Record one event. `user` NO_SYMBOL is ignored.
+  void note(uint32_t user, uint32_t status, int64_t ts_ms);
+
+  // Audit records up to `event_id` are written (so their events have been
+  // noted); the next checkpoint covers them
+  void set_written(uint64_t event_id);
+
+  // Whether the restored checkpoint already includes an event being
+  // replayed on startup: one of record `event_id` (0 if not written yet,
+  // e.g. from the spill file) stamped at `ts_ms`
+  bool covers(uint64_t event_id, int64_t ts_ms) const;
+
+  // Events of `user` (with `status`, unless NO_SYMBOL) at or after
+  // `since_ms`, which must be within window_ms() of the latest
+  uint64_t count(uint32_t user, uint32_t status, int64_t since_ms) const;
+
+  // Learn from a successful login at `ts_ms` from `ip_prefix`
+  // (intrusion_ip_prefix(), 0 if unknown)
+  void learn_login(uint32_t user, int64_t ts_ms, uint32_t ip_prefix);
+
+  // Learn the step offset a successful TOTP code was accepted at
+  void learn_totp(uint32_t user, int offset);
+
+  // Score an event against the user's profile; `totp_offset`
+  // PROFILE_NO_TOTP leaves out the TOTP score. False if `user` has none.
+  bool score(uint32_t user, int64_t ts_ms, uint32_t ip_prefix,
+             int totp_offset, IntrusionScore *out) const;
+
+  // Sequence rules to follow, replacing the current ones (and resetting
+  // every user's progress if they differ). False, with the reason in
+  // `error`, if `rules` do not compile.
+  bool set_sequences(const std::string &rules, std::string *error);
+
+  // Advance the user's sequence state by an event; bit i of the result set
+  // if rule i has just matched. Events further apart than
+  // INTRUSION_WINDOW_MS do not make a sequence.
+  uint64_t advance(uint32_t user, uint32_t event_type, uint32_t status,
+                   int64_t ts_ms);
+
+  // Names of the rules the user's latest event of `event_type` matched
+  // (none if no rule follows that type)
+  void sequence_matches(uint32_t user, uint32_t event_type,
+                        std::vector<std::string> *out) const;
+
+  // History kept per user (INTRUSION_WINDOW_MS by default). Set before
+  // noting events; tools replaying old logs use it to try longer windows.
+  void set_window(int64_t window_ms);
+  int64_t window_ms() const;
+
+
+  // Drop all state; the sequence rules stay
+  void clear();
+
+  // Load a checkpoint, replacing the current state. False (and empty) if
+  // it is missing or damaged.
+  bool load(const char *path);
+
+  // Write a checkpoint now
+  bool save(const char *path);
+
+  // Save to `path` every `interval_ms` on a background thread, and once
+  // more on stop_checkpoints()
+  bool start_checkpoints(const char *path,
+                         int64_t interval_ms = INTRUSION_CHECKPOINT_MS);
+  void stop_checkpoints();
+};
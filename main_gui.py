@@ -4,6 +4,7 @@ import ctypes
 import os
 import sys
 import platform
+import socket
 import time
 import math
 import qrcode
@@ -438,7 +439,9 @@ class SecureAuthApp:
         self.max_attempts = 5
         self.animation_alpha = 0
         self.current_username = None  # Store logged-in username
+        self.session_epoch = 0  # Revocation epoch of the password-stage session
         self.pending_signup_secret = None  # Store secret during signup
+        self.client_ip = self.get_client_ip()  # Audited with every attempt
         
         # Animated gradient background
         self.setup_animated_background()
@@ -457,6 +460,13 @@ class SecureAuthApp:
         # Start background animation
         self.animate_background()
 
+    def get_client_ip(self):
+        """Address of this machine as intrusion detection sees it"""
+        try:
+            return socket.gethostbyname(socket.gethostname())
+        except OSError:
+            return "127.0.0.1"
+
     def setup_animated_background(self):
         """Create animated gradient background"""
         self.bg_canvas = tk.Canvas(self.root, highlightthickness=0)
@@ -1054,14 +1064,22 @@ class SecureAuthApp:
         else:
             self.log_label.config(text="● Processing authentication...", fg="#0078D4")
 
-        # Validate credentials using database
+        # Validate credentials using database (refused, and audited as
+        # BLOCKED, while an intrusion block on the user or this IP lasts)
         try:
-            if user_db.validate_credentials(username, password):
+            if user_db.validate_credentials(username, password, self.client_ip):
                 self.login_attempts = 0  # Reset on success
                 self.current_username = username  # Store for TOTP verification
+                self.session_epoch = user_db.session_epoch(username)
                 self.current_stage = 2
                 self.setup_ui()
             else:
+                retry_after = user_db.login_retry_after(username, self.client_ip)
+                if retry_after > 0:
+                    messagebox.showerror("Account Locked",
+                        f"Suspicious activity detected on this account.\n"
+                        f"Please try again in {math.ceil(retry_after / 60)} minutes.")
+                    return
                 self.login_attempts += 1
                 remaining = self.max_attempts - self.login_attempts
                 messagebox.showerror("Authentication Failed", 
@@ -1087,9 +1105,18 @@ class SecureAuthApp:
             messagebox.showerror("Invalid Code", "Code must be exactly 6 digits.")
             return
             
+        # An alert may have revoked the session since the password stage;
+        # a pending step-up is met by the code being checked here
+        if user_db.session_status(self.current_username, self.session_epoch) == "REVOKED":
+            messagebox.showerror("Session Ended",
+                "Suspicious activity ended this session.\nPlease log in again.")
+            self.current_username = None
+            self.switch_to_login()
+            return
+            
         try:
             # Verify TOTP using database
-            if user_db.verify_totp(self.current_username, code_str):
+            if user_db.verify_totp(self.current_username, code_str, self.client_ip):
                 # Success animation
                 self.log_label.config(text="✓ Authentication Complete!", fg="#107C10")
                 messagebox.showinfo("Success", f"✓ Authentication Complete!\n\nAccess Granted.\n\nWelcome, {self.current_username}!")
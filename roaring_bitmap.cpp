@@ -0,0 +1,417 @@
+#include "roaring_bitmap.h"
+
+#include <algorithm>
+#include <cstring>
+
+// --- Containers ---
+
+RoaringBitmap::Container *RoaringBitmap::find_container(uint16_t key) {
+  return const_cast<Container *>(
+      static_cast<const RoaringBitmap *>(this)->find_container(key));
+}
+
+const RoaringBitmap::Container *
+RoaringBitmap::find_container(uint16_t key) const {
+  // Appends land in the last container
+  if (!m_containers.empty() && m_containers.back().key == key)
+    return &m_containers.back();
+  auto it = std::lower_bound(
+      m_containers.begin(), m_containers.end(), key,
+      [](const Container &c, uint16_t k) { return c.key < k; });
+  return (it != m_containers.end() && it->key == key) ? &*it : nullptr;
+}
+
+RoaringBitmap::Container &RoaringBitmap::container_for(uint16_t key) {
+  if (m_containers.empty() || m_containers.back().key < key) {
+    m_containers.emplace_back();
+    m_containers.back().key = key;
+    m_containers.back().cardinality = 0;
+    return m_containers.back();
+  }
+  if (m_containers.back().key == key)
+    return m_containers.back();
+
+  auto it = std::lower_bound(
+      m_containers.begin(), m_containers.end(), key,
+      [](const Container &c, uint16_t k) { return c.key < k; });
+  if (it == m_containers.end() || it->key != key) {
+    it = m_containers.emplace(it);
+    it->key = key;
+    it->cardinality = 0;
+  }
+  return *it;
+}
+
+void RoaringBitmap::to_bitmap(Container &c) {
+  c.words.assign(BITMAP_WORDS, 0);
+  for (uint16_t low : c.array)
+    c.words[low >> 6] |= uint64_t(1) << (low & 63);
+  std::vector<uint16_t>().swap(c.array);
+}
+
+void RoaringBitmap::to_array(Container &c) {
+  c.array.clear();
+  c.array.reserve(c.cardinality);
+  for (uint32_t w = 0; w < BITMAP_WORDS; w++) {
+    uint64_t bits = c.words[w];
+    while (bits) {
+      c.array.push_back((uint16_t)((w << 6) | __builtin_ctzll(bits)));
+      bits &= bits - 1;
+    }
+  }
+  std::vector<uint64_t>().swap(c.words);
+}
+
+bool RoaringBitmap::add_to(Container &c, uint16_t low) {
+  if (c.is_bitmap()) {
+    uint64_t bit = uint64_t(1) << (low & 63);
+    uint64_t &word = c.words[low >> 6];
+    if (word & bit)
+      return false;
+    word |= bit;
+    c.cardinality++;
+    return true;
+  }
+
+  if (c.array.empty() || c.array.back() < low) {
+    c.array.push_back(low);
+  } else {
+    auto it = std::lower_bound(c.array.begin(), c.array.end(), low);
+    if (*it == low)
+      return false;
+    c.array.insert(it, low);
+  }
+  if (++c.cardinality > ARRAY_MAX)
+    to_bitmap(c);
+  return true;
+}
+
+// --- Intersection ---
+
+// First position in [lo, n) with arr[pos] >= value, probing 1, 2, 4, ...
+// elements ahead before binary searching. Cheap when the other side is
+// much smaller and matches are spread out.
+static size_t gallop(const uint16_t *arr, size_t lo, size_t n,
+                     uint16_t value) {
+  if (lo >= n || arr[lo] >= value)
+    return lo;
+  size_t step = 1;
+  size_t hi = lo + 1;
+  while (hi < n && arr[hi] < value) {
+    lo = hi;
+    step <<= 1;
+    hi = lo + step;
+  }
+  if (hi > n)
+    hi = n;
+  return std::lower_bound(arr + lo + 1, arr + hi, value) - arr;
+}
+
+static void intersect_arrays(const std::vector<uint16_t> &a,
+                             const std::vector<uint16_t> &b,
+                             std::vector<uint16_t> &out) {
+  const std::vector<uint16_t> &small = a.size() <= b.size() ? a : b;
+  const std::vector<uint16_t> &large = a.size() <= b.size() ? b : a;
+  out.clear();
+
+  if (small.size() * 32 < large.size()) {
+    size_t pos = 0;
+    for (uint16_t v : small) {
+      pos = gallop(large.data(), pos, large.size(), v);
+      if (pos == large.size())
+        break;
+      if (large[pos] == v)
+        out.push_back(v);
+    }
+    return;
+  }
+
+  size_t i = 0, j = 0;
+  while (i < small.size() && j < large.size()) {
+    if (small[i] < large[j]) {
+      i++;
+    } else if (small[i] > large[j]) {
+      j++;
+    } else {
+      out.push_back(small[i]);
+      i++;
+      j++;
+    }
+  }
+}
+
+bool RoaringBitmap::intersect_into(const Container &a, const Container &b,
+                                   Container &out) {
+  out.key = a.key;
+  if (a.is_bitmap() && b.is_bitmap()) {
+    // Branch-free word loop; the compiler vectorises it
+    out.words.resize(BITMAP_WORDS);
+    const uint64_t *wa = a.words.data();
+    const uint64_t *wb = b.words.data();
+    uint64_t *wo = out.words.data();
+    for (uint32_t w = 0; w < BITMAP_WORDS; w++)
+      wo[w] = wa[w] & wb[w];
+    uint32_t card = 0;
+    for (uint32_t w = 0; w < BITMAP_WORDS; w++)
+      card += (uint32_t)__builtin_popcountll(wo[w]);
+    out.cardinality = card;
+    if (card <= ARRAY_MAX)
+      to_array(out);
+    return card != 0;
+  }
+
+  if (a.is_bitmap() || b.is_bitmap()) {
+    const Container &arr = a.is_bitmap() ? b : a;
+    const Container &bmp = a.is_bitmap() ? a : b;
+    out.array.clear();
+    for (uint16_t low : arr.array)
+      if (bmp.words[low >> 6] & (uint64_t(1) << (low & 63)))
+        out.array.push_back(low);
+    out.cardinality = (uint32_t)out.array.size();
+    return out.cardinality != 0;
+  }
+
+  intersect_arrays(a.array, b.array, out.array);
+  out.cardinality = (uint32_t)out.array.size();
+  return out.cardinality != 0;
+}
+
+void RoaringBitmap::intersect(const RoaringBitmap &a, const RoaringBitmap &b,
+                              RoaringBitmap *out) {
+  out->m_containers.clear();
+  size_t i = 0, j = 0;
+  while (i < a.m_containers.size() && j < b.m_containers.size()) {
+    const Container &ca = a.m_containers[i];
+    const Container &cb = b.m_containers[j];
+    if (ca.key < cb.key) {
+      i++;
+    } else if (ca.key > cb.key) {
+      j++;
+    } else {
+      out->m_containers.emplace_back();
+      if (!intersect_into(ca, cb, out->m_containers.back()))
+        out->m_containers.pop_back();
+      i++;
+      j++;
+    }
+  }
+}
+
+// --- Union ---
+
+void RoaringBitmap::unite_into(const Container &a, const Container &b,
+                               Container &out) {
+  out.key = a.key;
+  if (!a.is_bitmap() && !b.is_bitmap() &&
+      a.cardinality + b.cardinality <= ARRAY_MAX) {
+    out.array.resize(a.array.size() + b.array.size());
+    auto end = std::set_union(a.array.begin(), a.array.end(), b.array.begin(),
+                              b.array.end(), out.array.begin());
+    out.array.resize(end - out.array.begin());
+    out.cardinality = (uint32_t)out.array.size();
+    return;
+  }
+
+  out.array.clear();
+  out.words.assign(BITMAP_WORDS, 0);
+  uint64_t *wo = out.words.data();
+  for (const Container *c : {&a, &b}) {
+    if (c->is_bitmap()) {
+      const uint64_t *wc = c->words.data();
+      for (uint32_t w = 0; w < BITMAP_WORDS; w++)
+        wo[w] |= wc[w];
+    } else {
+      for (uint16_t low : c->array)
+        wo[low >> 6] |= uint64_t(1) << (low & 63);
+    }
+  }
+  uint32_t card = 0;
+  for (uint32_t w = 0; w < BITMAP_WORDS; w++)
+    card += (uint32_t)__builtin_popcountll(wo[w]);
+  out.cardinality = card;
+  if (card <= ARRAY_MAX)
+    to_array(out);
+}
+
+void RoaringBitmap::unite(const RoaringBitmap &a, const RoaringBitmap &b,
+                          RoaringBitmap *out) {
+  out->m_containers.clear();
+  size_t i = 0, j = 0;
+  while (i < a.m_containers.size() || j < b.m_containers.size()) {
+    if (j == b.m_containers.size() ||
+        (i < a.m_containers.size() &&
+         a.m_containers[i].key < b.m_containers[j].key)) {
+      out->m_containers.push_back(a.m_containers[i++]);
+    } else if (i == a.m_containers.size() ||
+               b.m_containers[j].key < a.m_containers[i].key) {
+      out->m_containers.push_back(b.m_containers[j++]);
+    } else {
+      out->m_containers.emplace_back();
+      unite_into(a.m_containers[i++], b.m_containers[j++],
+                 out->m_containers.back());
+    }
+  }
+}
+
+void RoaringBitmap::unite_with(const RoaringBitmap &other) {
+  for (const Container &oc : other.m_containers) {
+    if (m_containers.empty() || m_containers.back().key < oc.key) {
+      m_containers.push_back(oc);
+      continue;
+    }
+    Container *c = find_container(oc.key);
+    if (!c) {
+      auto it = std::lower_bound(
+          m_containers.begin(), m_containers.end(), oc.key,
+          [](const Container &x, uint16_t k) { return x.key < k; });
+      m_containers.insert(it, oc);
+      continue;
+    }
+    Container merged;
+    unite_into(*c, oc, merged);
+    *c = std::move(merged);
+  }
+}
+
+// --- Serialization ---
+
+void RoaringBitmap::encode(std::vector<uint8_t> *out) const {
+  uint32_t count = (uint32_t)m_containers.size();
+  out->insert(out->end(), (const uint8_t *)&count,
+              (const uint8_t *)&count + 4);
+  for (const Container &c : m_containers) {
+    uint16_t head[2] = {c.key, 0};
+    out->insert(out->end(), (const uint8_t *)head, (const uint8_t *)head + 4);
+    out->insert(out->end(), (const uint8_t *)&c.cardinality,
+                (const uint8_t *)&c.cardinality + 4);
+    const uint8_t *values = c.is_bitmap() ? (const uint8_t *)c.words.data()
+                                          : (const uint8_t *)c.array.data();
+    size_t bytes = c.is_bitmap() ? BITMAP_WORDS * sizeof(uint64_t)
+                                 : c.array.size() * sizeof(uint16_t);
+    out->insert(out->end(), values, values + bytes);
+  }
+}
+
+const uint8_t *RoaringBitmap::decode(const uint8_t *p, const uint8_t *end) {
+  m_containers.clear();
+  uint32_t count;
+  if (end - p < 4)
+    return nullptr;
+  memcpy(&count, p, 4);
+  p += 4;
+  if (count > 65536 || (size_t)(end - p) / 8 < count)
+    return nullptr;
+  m_containers.resize(count);
+
+  for (uint32_t i = 0; i < count; i++) {
+    Container &c = m_containers[i];
+    uint16_t head[2];
+    if (end - p < 8)
+      break;
+    memcpy(head, p, 4);
+    memcpy(&c.cardinality, p + 4, 4);
+    p += 8;
+    c.key = head[0];
+    if ((i > 0 && c.key <= m_containers[i - 1].key) || c.cardinality == 0 ||
+        c.cardinality > 65536)
+      break;
+
+    if (c.cardinality <= ARRAY_MAX) {
+      size_t bytes = c.cardinality * sizeof(uint16_t);
+      if ((size_t)(end - p) < bytes)
+        break;
+      c.array.resize(c.cardinality);
+      memcpy(c.array.data(), p, bytes);
+      p += bytes;
+      if (std::adjacent_find(c.array.begin(), c.array.end(),
+                             [](uint16_t a, uint16_t b) { return a >= b; }) !=
+          c.array.end())
+        break;
+    } else {
+      size_t bytes = BITMAP_WORDS * sizeof(uint64_t);
+      if ((size_t)(end - p) < bytes)
+        break;
+      c.words.resize(BITMAP_WORDS);
+      memcpy(c.words.data(), p, bytes);
+      p += bytes;
+      uint32_t card = 0;
+      for (uint32_t w = 0; w < BITMAP_WORDS; w++)
+        card += (uint32_t)__builtin_popcountll(c.words[w]);
+      if (card != c.cardinality)
+        break;
+    }
+    if (i + 1 == count)
+      return p;
+  }
+  m_containers.clear();
+  return count == 0 ? p : nullptr;
+}
+
+// --- Queries ---
+
+void RoaringBitmap::add(uint32_t value) {
+  add_to(container_for((uint16_t)(value >> 16)), (uint16_t)value);
+}
+
+bool RoaringBitmap::contains(uint32_t value) const {
+  const Container *c = find_container((uint16_t)(value >> 16));
+  if (!c)
+    return false;
+  uint16_t low = (uint16_t)value;
+  if (c->is_bitmap())
+    return (c->words[low >> 6] >> (low & 63)) & 1;
+  return std::binary_search(c->array.begin(), c->array.end(), low);
+}
+
+uint64_t RoaringBitmap::cardinality() const {
+  uint64_t n = 0;
+  for (const Container &c : m_containers)
+    n += c.cardinality;
+  return n;
+}
+
+size_t RoaringBitmap::bytes() const {
+  size_t n = m_containers.capacity() * sizeof(Container);
+  for (const Container &c : m_containers)
+    n += c.array.capacity() * sizeof(uint16_t) +
+         c.words.capacity() * sizeof(uint64_t);
+  return n;
+}
+
+uint32_t RoaringBitmap::minimum() const {
+  if (m_containers.empty())
+    return 0;
+  const Container &c = m_containers.front();
+  uint32_t low = 0;
+  if (!c.is_bitmap()) {
+    low = c.array.front();
+  } else {
+    uint32_t w = 0;
+    while (!c.words[w])
+      w++;
+    low = (w << 6) | (uint32_t)__builtin_ctzll(c.words[w]);
+  }
+  return ((uint32_t)c.key << 16) | low;
+}
+
+uint32_t RoaringBitmap::maximum() const {
+  if (m_containers.empty())
+    return 0;
+  const Container &c = m_containers.back();
+  uint32_t low = 0;
+  if (!c.is_bitmap()) {
+    low = c.array.back();
+  } else {
+    uint32_t w = BITMAP_WORDS - 1;
+    while (!c.words[w])
+      w--;
+    low = (w << 6) | (63 - (uint32_t)__builtin_clzll(c.words[w]));
+  }
+  return ((uint32_t)c.key << 16) | low;
+}
+
+void RoaringBitmap::to_vector(std::vector<uint32_t> *out) const {
+  out->clear();
+  out->reserve(cardinality());
+  for_each([out](uint32_t v) { out->push_back(v); });
+}
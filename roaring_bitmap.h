@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// --- Roaring Bitmap ---
+// Compressed set of 32-bit IDs (audit event IDs). Values are split by their
+// high 16 bits into containers; a container holding up to 4096 values is a
+// sorted uint16 array, a denser one is a 65536-bit bitmap. Appending IDs in
+// increasing order (the audit writer's case) is amortised O(1).
+
+class RoaringBitmap {
+public:
+  static const uint32_t ARRAY_MAX = 4096;
+  static const uint32_t BITMAP_WORDS = 1024;
+
+private:
+  struct Container {
+    uint16_t key;       // high 16 bits of every value in the container
+    uint32_t cardinality;
+    std::vector<uint16_t> array; // sorted, used while cardinality <= ARRAY_MAX
+    std::vector<uint64_t> words; // BITMAP_WORDS words once converted
+
+    bool is_bitmap() const { return !words.empty(); }
+  };
+
+  std::vector<Container> m_containers; // sorted by key
+
+  Container *find_container(uint16_t key);
+  const Container *find_container(uint16_t key) const;
+  Container &container_for(uint16_t key);
+
+  static void to_bitmap(Container &c);
+  static void to_array(Container &c);
+  static bool add_to(Container &c, uint16_t low);
+  static bool intersect_into(const Container &a, const Container &b,
+                             Container &out);
+  static void unite_into(const Container &a, const Container &b,
+                         Container &out);
+
+public:
+  void add(uint32_t value);
+  bool contains(uint32_t value) const;
+  void clear() { m_containers.clear(); }
+
+  uint64_t cardinality() const;
+  bool empty() const { return m_containers.empty(); }
+  size_t bytes() const; // heap memory held by the containers
+
+  // Smallest and largest value; 0 if empty
+  uint32_t minimum() const;
+  uint32_t maximum() const;
+
+  // Set algebra; `out` may not alias an input
+  static void intersect(const RoaringBitmap &a, const RoaringBitmap &b,
+                        RoaringBitmap *out);
+  static void unite(const RoaringBitmap &a, const RoaringBitmap &b,
+                    RoaringBitmap *out);
+
+  // In-place union; cheapest when `other` holds only larger IDs
+  void unite_with(const RoaringBitmap &other);
+
+  // Append the bitmap to `out` as [uint32 containers], then per container
+  // [uint16 key][uint16 0][uint32 cardinality] and its values: cardinality
+  // uint16s for an array, BITMAP_WORDS uint64s for a bitmap
+  void encode(std::vector<uint8_t> *out) const;
+
+  // Replace the contents with one encoded bitmap read from [p, end).
+  // Returns the byte after it, or nullptr (and an empty bitmap) if it is
+  // malformed.
+  const uint8_t *decode(const uint8_t *p, const uint8_t *end);
+
+  // Ascending
+  void to_vector(std::vector<uint32_t> *out) const;
+
+  template <typename F> void for_each(F f) const {
+    for (const Container &c : m_containers) {
+      uint32_t high = (uint32_t)c.key << 16;
+      if (!c.is_bitmap()) {
+        for (uint16_t low : c.array)
+          f(high | low);
+        continue;
+      }
+      for (uint32_t w = 0; w < BITMAP_WORDS; w++) {
+        uint64_t bits = c.words[w];
+        while (bits) {
+          f(high | (w << 6) | (uint32_t)__builtin_ctzll(bits));
+          bits &= bits - 1;
+        }
+      }
+    }
+  }
+};
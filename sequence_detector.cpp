@@ -0,0 +1,293 @@
+#include "sequence_detector.h"
+
+#include "symbol_table.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <map>
+
+const uint32_t SEQUENCE_ANY = UINT32_MAX;
+
+struct SequenceStep {
+  std::string event; // "*" = any
+  std::string status;
+};
+
+// --- Parsing ---
+
+static void skip_spaces(const char *&p) {
+  while (*p == ' ' || *p == '\t')
+    p++;
+}
+
+static bool is_name_char(char c) {
+  return isalnum((unsigned char)c) || c == '_' || c == '*';
+}
+
+// Optional "{n}" after a step or group; 1 without one
+static bool parse_repeat(const char *&p, size_t *n) {
+  *n = 1;
+  if (*p != '{')
+    return true;
+  char *end;
+  unsigned long v = strtoul(p + 1, &end, 10);
+  if (end == p + 1 || *end != '}' || v == 0 || v > SEQUENCE_MAX_REPEAT)
+    return false;
+  *n = v;
+  p = end + 1;
+  return true;
+}
+
+// Steps up to the end of the line, or the ')' closing a group
+static bool parse_steps(const char *&p, int depth,
+                        std::vector<SequenceStep> *out, std::string *error) {
+  for (;;) {
+    skip_spaces(p);
+    if (!*p) {
+      if (depth)
+        *error = "unclosed '('";
+      return !depth;
+    }
+    if (*p == ')') {
+      if (!depth) {
+        *error = "unmatched ')'";
+        return false;
+      }
+      p++;
+      return true;
+    }
+
+    std::vector<SequenceStep> steps;
+    if (*p == '(') {
+      p++;
+      if (!parse_steps(p, depth + 1, &steps, error))
+        return false;
+    } else {
+      const char *start = p;
+      while (is_name_char(*p))
+        p++;
+      SequenceStep step;
+      step.event.assign(start, p);
+      if (*p == ':') {
+        const char *status = ++p;
+        while (is_name_char(*p))
+          p++;
+        step.status.assign(status, p);
+      }
+      if (step.event.empty() || step.status.empty()) {
+        *error = "expected EVENT:STATUS at \"" + std::string(start) + "\"";
+        return false;
+      }
+      steps.push_back(step);
+    }
+
+    size_t n;
+    if (!parse_repeat(p, &n)) {
+      *error = "bad repeat count";
+      return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+      if (out->size() + steps.size() > SEQUENCE_MAX_STEPS) {
+        *error = "rule longer than " + std::to_string(SEQUENCE_MAX_STEPS) +
+                 " steps";
+        return false;
+      }
+      out->insert(out->end(), steps.begin(), steps.end());
+    }
+  }
+}
+
+// "NAME: steps"; false with `error` set if malformed, `name` empty if the
+// line is blank or a comment
+static bool parse_rule(const std::string &line, std::string *name,
+                       std::vector<SequenceStep> *steps, std::string *error) {
+  const char *p = line.c_str();
+  name->clear();
+  steps->clear();
+  skip_spaces(p);
+  if (!*p || *p == '#')
+    return true;
+  const char *start = p;
+  while (isalnum((unsigned char)*p) || *p == '_')
+    p++;
+  name->assign(start, p);
+  skip_spaces(p);
+  if (name->empty() || *p++ != ':') {
+    *error = "expected NAME: at \"" + line + "\"";
+    return false;
+  }
+  if (!parse_steps(p, 0, steps, error))
+    return false;
+  if (steps->empty()) {
+    *error = "rule " + *name + " has no steps";
+    return false;
+  }
+  return true;
+}
+
+// --- Compilation ---
+
+SequenceDetector::SequenceDetector() : m_status_classes(1), m_classes(0) {}
+
+// Index of `name` in `names`, adding it; SEQUENCE_ANY for "*"
+static uint32_t alphabet_index(const std::string &name,
+                               std::vector<std::string> *names) {
+  if (name == "*")
+    return SEQUENCE_ANY;
+  auto it = std::find(names->begin(), names->end(), name);
+  if (it != names->end())
+    return (uint32_t)(it - names->begin());
+  names->push_back(name);
+  return (uint32_t)names->size() - 1;
+}
+
+bool SequenceDetector::build(const std::string &spec,
+                             std::vector<std::string> *events,
+                             std::vector<std::string> *statuses,
+                             std::string *error) {
+  std::vector<std::string> names;
+  std::vector<std::vector<SequenceStep>> rules;
+  size_t start = 0;
+  while (start <= spec.size()) {
+    size_t end = spec.find('\n', start);
+    if (end == std::string::npos)
+      end = spec.size();
+    std::string line = spec.substr(start, end - start);
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    start = end + 1;
+
+    std::string name;
+    std::vector<SequenceStep> steps;
+    if (!parse_rule(line, &name, &steps, error))
+      return false;
+    if (name.empty())
+      continue;
+    if (std::find(names.begin(), names.end(), name) != names.end()) {
+      *error = "rule " + name + " defined twice";
+      return false;
+    }
+    names.push_back(name);
+    rules.push_back(steps);
+  }
+  if (rules.size() > SEQUENCE_MAX_RULES) {
+    *error = "more than " + std::to_string(SEQUENCE_MAX_RULES) + " rules";
+    return false;
+  }
+
+  // Steps as (event, status) indexes into the rules' own alphabet
+  events->clear();
+  statuses->clear();
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> steps(rules.size());
+  for (size_t r = 0; r < rules.size(); r++)
+    for (const SequenceStep &step : rules[r])
+      steps[r].push_back({alphabet_index(step.event, events),
+                          alphabet_index(step.status, statuses)});
+  if (!rules.empty() && events->empty()) {
+    *error = "no rule names an event type";
+    return false;
+  }
+  uint32_t status_classes = (uint32_t)statuses->size() + 1;
+  uint32_t classes = (uint32_t)events->size() * status_classes;
+
+  // Subset construction. A DFA state is the sorted set of rule positions
+  // (rule << 8 | steps matched) live after the events so far; every rule
+  // implicitly restarts at position 0 on each event.
+  std::map<std::vector<uint32_t>, uint16_t> ids;
+  std::vector<std::vector<uint32_t>> sets(1);
+  std::vector<uint16_t> next;
+  std::vector<uint64_t> accept(1, 0);
+  ids[sets[0]] = 0;
+  for (size_t s = 0; s < sets.size(); s++) {
+    for (uint32_t c = 0; c < classes; c++) {
+      uint32_t event = c / status_classes, status = c % status_classes;
+      std::vector<uint32_t> target;
+      auto advance = [&](uint32_t r, uint32_t k) {
+        if (k >= steps[r].size())
+          return;
+        const auto &step = steps[r][k];
+        if ((step.first == SEQUENCE_ANY || step.first == event) &&
+            (step.second == SEQUENCE_ANY || step.second == status))
+          target.push_back(r << 8 | (k + 1));
+      };
+      for (uint32_t r = 0; r < steps.size(); r++)
+        advance(r, 0);
+      for (uint32_t pos : sets[s])
+        advance(pos >> 8, pos & 0xFF);
+      std::sort(target.begin(), target.end());
+      target.erase(std::unique(target.begin(), target.end()), target.end());
+
+      auto it = ids.find(target);
+      if (it != ids.end()) {
+        next.push_back(it->second);
+        continue;
+      }
+      if (sets.size() >= SEQUENCE_MAX_STATES) {
+        *error = "rules need more than " +
+                 std::to_string(SEQUENCE_MAX_STATES) + " states";
+        return false;
+      }
+      uint64_t mask = 0;
+      for (uint32_t pos : target)
+        if ((pos & 0xFF) == steps[pos >> 8].size())
+          mask |= 1ull << (pos >> 8);
+      uint16_t id = (uint16_t)sets.size();
+      ids.emplace(target, id);
+      sets.push_back(target);
+      accept.push_back(mask);
+      next.push_back(id);
+    }
+  }
+
+  m_spec = spec;
+  m_names = names;
+  m_status_classes = status_classes;
+  m_classes = classes;
+  m_next.swap(next);
+  m_accept.swap(accept);
+  return true;
+}
+
+bool SequenceDetector::compile(const std::string &spec, std::string *error) {
+  std::vector<std::string> events, statuses;
+  if (!build(spec, &events, &statuses, error))
+    return false;
+  m_events.clear();
+  m_statuses.clear();
+  SymbolTable &symbols = global_symbols();
+  for (uint32_t i = 0; i < events.size(); i++)
+    m_events[symbols.intern(events[i])] = i;
+  for (uint32_t i = 0; i < statuses.size(); i++)
+    m_statuses[symbols.intern(statuses[i])] = i;
+  return true;
+}
+
+bool SequenceDetector::validate(const std::string &spec, std::string *error) {
+  SequenceDetector check;
+  std::vector<std::string> events, statuses;
+  return check.build(spec, &events, &statuses, error);
+}
+
+// --- Matching ---
+
+uint16_t SequenceDetector::step(uint16_t state, uint32_t event_type,
+                                uint32_t status) const {
+  auto event = m_events.find(event_type);
+  if (event == m_events.end())
+    return state;
+  auto it = m_statuses.find(status);
+  uint32_t cls = event->second * m_status_classes +
+                 (it == m_statuses.end() ? m_status_classes - 1 : it->second);
+  if (state >= m_accept.size())
+    state = 0; // from other rules
+  return m_next[(size_t)state * m_classes + cls];
+}
+
+bool SequenceDetector::consumes(uint32_t event_type) const {
+  return m_events.count(event_type) != 0;
+}
+
+uint64_t SequenceDetector::accepted(uint16_t state) const {
+  return state < m_accept.size() ? m_accept[state] : 0;
+}
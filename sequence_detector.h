@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// --- Sequence Detector ---
+// Alerts on orders of events rather than counts, such as a password
+// accepted and then TOTP codes guessed. Rules are text, one per line:
+//
+//   NAME: STEP STEP ...
+//   STEP: EVENT:STATUS, either side "*" for any, "{n}" after it repeats it
+//         n times; "(STEP ...){n}" repeats a group
+//
+//   MFA_GUESSING: LOGIN:SUCCESS TOTP:FAILURE{3}
+//
+// Blank lines and lines starting with '#' are skipped. A rule matches when
+// its steps are a user's latest events of the types the rules name; other
+// event types pass through unseen ("*" stands for any of the named ones).
+//
+// All rules compile into one DFA by subset construction over their step
+// positions, so an event costs one table lookup however many rules there
+// are, and a user's progress through all of them is one 16-bit state
+// (0 = nothing under way).
+
+const size_t SEQUENCE_MAX_RULES = 64;
+const size_t SEQUENCE_MAX_STEPS = 64; // per rule, after repeats
+const size_t SEQUENCE_MAX_REPEAT = 32;
+const size_t SEQUENCE_MAX_STATES = 4096;
+
+//
+// SequenceDetector - compiled sequence rules
+//
+class SequenceDetector {
+private:
+  std::string m_spec;
+  std::vector<std::string> m_names; // by rule
+  // Symbol IDs of the named event types and statuses -> index
+  std::unordered_map<uint32_t, uint32_t> m_events;
+  std::unordered_map<uint32_t, uint32_t> m_statuses;
+  uint32_t m_status_classes; // statuses + 1, the last for any other
+  uint32_t m_classes;        // events x status classes
+  std::vector<uint16_t> m_next;   // by state * m_classes + class
+  std::vector<uint64_t> m_accept; // rules matched on entering each state
+
+  // compile() up to binding the alphabet to symbol IDs
+  bool build(const std::string &spec, std::vector<std::string> *events,
+             std::vector<std::string> *statuses, std::string *error);
+
+public:
+  SequenceDetector();
+
+  // Parse and compile `spec`, replacing any earlier rules. False (with the
+  // reason in `error`) if it is malformed or too large.
+  bool compile(const std::string &spec, std::string *error);
+
+  // compile() without interning the names it uses, for checking rules
+  // before the symbol log is open (IDs interned then are never saved)
+  static bool validate(const std::string &spec, std::string *error);
+
+  // The state after an event, or `state` itself if no rule names
+  // `event_type`
+  uint16_t step(uint16_t state, uint32_t event_type, uint32_t status) const;
+
+  // True if some rule names `event_type`
+  bool consumes(uint32_t event_type) const;
+
+  // Bit i set: rule i has just matched on entering `state`
+  uint64_t accepted(uint16_t state) const;
+
+  const std::string &rule_name(size_t i) const { return m_names[i]; }
+  size_t rule_count() const { return m_names.size(); }
+  size_t state_count() const { return m_accept.size(); }
+  const std::string &spec() const { return m_spec; }
+};
@@ -0,0 +1,667 @@
+#include "shm_index.h"
+
+#include "credential_loader.h"
+#include "credential_store.h"
+#include "crypto_core.h"
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char SHM_MAGIC[8] = {'S', 'A', 'S', 'H', 'M', 'I', 'X', '2'};
+const char SHM_CONTROL_MAGIC[8] = {'S', 'A', 'S', 'H', 'M', 'C', 'T', '2'};
+const int SEQLOCK_RETRIES = 1 << 16;
+const int SWITCH_RETRIES = 3;
+
+static uint64_t round_up_pow2(uint64_t v) {
+  uint64_t p = 16;
+  while (p < v)
+    p *= 2;
+  return p;
+}
+
+static uint64_t current_pid() {
+#ifdef _WIN32
+  return (uint64_t)GetCurrentProcessId();
+#else
+  return (uint64_t)getpid();
+#endif
+}
+
+static std::string generation_name(const std::string &name, uint64_t number) {
+  return name + "." + std::to_string(number);
+}
+
+static ShmGeometry geometry_for(uint64_t capacity) {
+  ShmGeometry geo;
+  geo.slot_count = round_up_pow2(capacity + capacity / 3);
+  geo.slots_offset = (sizeof(ShmHeader) + 63) & ~(uint64_t)63;
+  geo.record_capacity = capacity;
+  geo.records_offset = geo.slots_offset + geo.slot_count * sizeof(ShmSlot);
+  geo.total_size = geo.records_offset + capacity * sizeof(ShmRecord);
+  return geo;
+}
+
+// Read a published header into `geo`, checking every offset and size
+// against the `mapped` bytes actually there. The header is written by
+// another process; nothing in it is used unchecked.
+static bool read_geometry(const uint8_t *base, size_t mapped, uint64_t number,
+                          ShmGeometry *geo) {
+  if (mapped < sizeof(ShmHeader))
+    return false;
+  const ShmHeader *h = (const ShmHeader *)base;
+  if (memcmp(h->magic, SHM_MAGIC, 8) != 0 || h->version != SHM_INDEX_VERSION ||
+      h->ready.load(std::memory_order_acquire) != 1 || h->generation != number)
+    return false;
+
+  ShmGeometry g;
+  g.slot_count = h->slot_count;
+  g.slots_offset = h->slots_offset;
+  g.record_capacity = h->record_capacity;
+  g.records_offset = h->records_offset;
+  g.total_size = h->total_size;
+
+  // Each bound is checked before it is multiplied or added, so none of
+  // these can wrap
+  if (g.slot_count == 0 || (g.slot_count & (g.slot_count - 1)) != 0)
+    return false;
+  if (g.slots_offset < sizeof(ShmHeader) || g.slots_offset > mapped ||
+      g.slots_offset % alignof(ShmSlot) != 0 ||
+      g.slot_count > (mapped - g.slots_offset) / sizeof(ShmSlot))
+    return false;
+  uint64_t slots_end = g.slots_offset + g.slot_count * sizeof(ShmSlot);
+  if (g.records_offset < slots_end || g.records_offset > mapped ||
+      g.records_offset % alignof(ShmRecord) != 0 ||
+      g.record_capacity > (mapped - g.records_offset) / sizeof(ShmRecord))
+    return false;
+  uint64_t records_end =
+      g.records_offset + g.record_capacity * sizeof(ShmRecord);
+  if (g.total_size < records_end || g.total_size > mapped ||
+      h->record_count.load(std::memory_order_acquire) > g.record_capacity)
+    return false;
+
+  *geo = g;
+  return true;
+}
+
+// --- Segments ---
+
+enum ShmMapMode {
+  SHM_MAP_READ,    // existing segment, read-only
+  SHM_MAP_WRITE,   // existing segment, read-write
+  SHM_MAP_CREATE,  // new segment of `size` bytes; fails if the name exists
+  SHM_MAP_CONTROL, // control segment: created at `size` if missing
+};
+
+static void unmap_segment(ShmMapping *m) {
+#ifdef _WIN32
+  if (m->base)
+    UnmapViewOfFile(m->base);
+  if (m->handle)
+    CloseHandle((HANDLE)m->handle);
+  m->handle = nullptr;
+#else
+  if (m->base)
+    munmap(m->base, m->size);
+  if (m->fd >= 0)
+    ::close(m->fd); // also drops the writer lock
+  m->fd = -1;
+#endif
+  m->base = nullptr;
+  m->size = 0;
+}
+
+// Map the named segment. An existing segment is never resized: its size is
+// whatever it already has.
+static bool map_segment(const std::string &name, uint64_t size,
+                        ShmMapMode mode, ShmMapping *out) {
+  bool writable = mode != SHM_MAP_READ;
+#ifdef _WIN32
+  std::string win_name = "Local\\" + name;
+  HANDLE mapping;
+  if (mode == SHM_MAP_CREATE || mode == SHM_MAP_CONTROL) {
+    mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                 (DWORD)(size >> 32), (DWORD)size,
+                                 win_name.c_str());
+    if (mapping && mode == SHM_MAP_CREATE &&
+        GetLastError() == ERROR_ALREADY_EXISTS) {
+      CloseHandle(mapping); // still held open by some process
+      return false;
+    }
+  } else {
+    mapping = OpenFileMappingA(writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ,
+                               FALSE, win_name.c_str());
+  }
+  if (!mapping)
+    return false;
+  void *base =
+      MapViewOfFile(mapping, writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ,
+                    0, 0, 0);
+  if (!base) {
+    CloseHandle(mapping);
+    return false;
+  }
+  MEMORY_BASIC_INFORMATION info;
+  VirtualQuery(base, &info, sizeof(info));
+  out->handle = mapping;
+  out->base = (uint8_t *)base;
+  out->size = info.RegionSize;
+  return true;
+#else
+  std::string shm_name = "/" + name;
+  int flags = writable ? O_RDWR : O_RDONLY;
+  if (mode == SHM_MAP_CREATE)
+    flags |= O_CREAT | O_EXCL;
+  else if (mode == SHM_MAP_CONTROL)
+    flags |= O_CREAT;
+  int fd = shm_open(shm_name.c_str(), flags, 0600); // credential material
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  bool sized = fstat(fd, &st) == 0;
+  if (sized && st.st_size == 0 &&
+      (mode == SHM_MAP_CREATE || mode == SHM_MAP_CONTROL)) {
+    // Only a segment nobody could have mapped yet gets its size set
+    sized = ftruncate(fd, (off_t)size) == 0;
+    st.st_size = (off_t)size;
+  }
+  if (!sized || st.st_size <= 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void *base = mmap(nullptr, (size_t)st.st_size,
+                    writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                    MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    ::close(fd);
+    return false;
+  }
+  out->fd = fd;
+  out->base = (uint8_t *)base;
+  out->size = (size_t)st.st_size;
+  return true;
+#endif
+}
+
+static void remove_segment(const std::string &name) {
+#ifdef _WIN32
+  (void)name; // named mappings disappear with their last handle
+#else
+  shm_unlink(("/" + name).c_str());
+#endif
+}
+
+// --- Index Tables ---
+
+static bool index_publish(uint8_t *base, const ShmGeometry &geo,
+                          const SnapshotRecord &rec) {
+  ShmHeader *h = (ShmHeader *)base;
+  ShmSlot *table = (ShmSlot *)(base + geo.slots_offset);
+  uint64_t mask = geo.slot_count - 1;
+
+  for (uint64_t i = rec.key_hash & mask;; i = (i + 1) & mask) {
+    uint64_t offset = table[i].record_offset.load(std::memory_order_relaxed);
+
+    if (offset == 0) {
+      // New user: fill the record, then link it into the slot
+      uint64_t n = h->record_count.load(std::memory_order_relaxed);
+      if (n >= geo.record_capacity)
+        return false;
+      uint64_t rec_offset = geo.records_offset + n * sizeof(ShmRecord);
+      ShmRecord *r = (ShmRecord *)(base + rec_offset);
+      r->rec = rec;
+      r->seq.store(0, std::memory_order_relaxed);
+      h->record_count.store(n + 1, std::memory_order_release);
+
+      table[i].key_hash.store(rec.key_hash, std::memory_order_relaxed);
+      table[i].record_offset.store(rec_offset, std::memory_order_release);
+      return true;
+    }
+
+    ShmRecord *r = (ShmRecord *)(base + offset);
+    if (table[i].key_hash.load(std::memory_order_relaxed) == rec.key_hash &&
+        snapshot_record_matches(r->rec, rec.name, rec.name_len)) {
+      // Existing user: seqlock write
+      uint32_t seq = r->seq.load(std::memory_order_relaxed);
+      r->seq.store(seq + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      r->rec = rec;
+      r->seq.store(seq + 2, std::memory_order_release);
+      return true;
+    }
+  }
+}
+
+static bool index_find(const uint8_t *base, const ShmGeometry &geo,
+                       const char *username, size_t len, uint64_t key_hash,
+                       SnapshotRecord *out) {
+  const ShmSlot *table = (const ShmSlot *)(base + geo.slots_offset);
+  uint64_t mask = geo.slot_count - 1;
+  uint64_t records_end =
+      geo.records_offset + geo.record_capacity * sizeof(ShmRecord);
+
+  // Bounded by the table size, in case it was filled without an empty slot
+  uint64_t i = key_hash & mask;
+  for (uint64_t probes = 0; probes < geo.slot_count;
+       probes++, i = (i + 1) & mask) {
+    uint64_t offset = table[i].record_offset.load(std::memory_order_acquire);
+    if (offset == 0)
+      return false;
+    if (table[i].key_hash.load(std::memory_order_relaxed) != key_hash)
+      continue;
+    // Only follow offsets that land on a record inside the mapping
+    if (offset < geo.records_offset || offset >= records_end ||
+        (offset - geo.records_offset) % sizeof(ShmRecord) != 0)
+      return false;
+
+    const ShmRecord *r = (const ShmRecord *)(base + offset);
+    bool consistent = false;
+    // Bounded: a writer that died mid-update must not hang every reader
+    for (int attempt = 0; attempt < SEQLOCK_RETRIES && !consistent; attempt++) {
+      uint32_t before = r->seq.load(std::memory_order_acquire);
+      if (before & 1)
+        continue; // writer mid-update
+      memcpy((void *)out, (const void *)&r->rec, sizeof(SnapshotRecord));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      consistent = r->seq.load(std::memory_order_relaxed) == before;
+    }
+    if (consistent && snapshot_record_matches(*out, username, len))
+      return true;
+  }
+  return false;
+}
+
+// --- ShmCredentialIndex ---
+
+ShmCredentialIndex::ShmCredentialIndex()
+    : m_control(), m_writer(false),
+#ifdef _WIN32
+      m_writer_mutex(nullptr),
+#endif
+      m_current(nullptr), m_current_number(0), m_retired(0) {
+#ifndef _WIN32
+  m_control.fd = -1;
+#endif
+}
+
+ShmCredentialIndex::~ShmCredentialIndex() { detach(); }
+
+void ShmCredentialIndex::delete_generation(void *p) {
+  Generation *gen = (Generation *)p;
+  unmap_segment(&gen->map);
+  delete gen;
+}
+
+bool ShmCredentialIndex::open_generation(uint64_t number, bool writable,
+                                         Generation **out) {
+  Generation *gen = new Generation();
+#ifndef _WIN32
+  gen->map.fd = -1;
+#endif
+  gen->number = number;
+  if (!map_segment(generation_name(m_name, number), 0,
+                   writable ? SHM_MAP_WRITE : SHM_MAP_READ, &gen->map) ||
+      !read_geometry(gen->map.base, gen->map.size, number, &gen->geo)) {
+    delete_generation(gen);
+    return false;
+  }
+  *out = gen;
+  return true;
+}
+
+bool ShmCredentialIndex::create(const char *name, uint64_t capacity) {
+  detach();
+  m_name = name;
+
+#ifdef _WIN32
+  std::string mutex_name = "Local\\" + m_name + "_writer";
+  HANDLE mutex = CreateMutexA(NULL, FALSE, mutex_name.c_str());
+  if (!mutex)
+    return false;
+  DWORD wait = WaitForSingleObject(mutex, 0);
+  if (wait != WAIT_OBJECT_0 && wait != WAIT_ABANDONED) {
+    CloseHandle(mutex);
+    return false;
+  }
+  m_writer_mutex = mutex;
+#endif
+
+  if (!map_segment(m_name, sizeof(ShmControl), SHM_MAP_CONTROL, &m_control) ||
+      m_control.size < sizeof(ShmControl)) {
+    detach();
+    return false;
+  }
+#ifndef _WIN32
+  // Single writer: the lock dies with the process that holds it
+  if (flock(m_control.fd, LOCK_EX | LOCK_NB) != 0) {
+    detach();
+    return false;
+  }
+#endif
+
+  ShmControl *c = (ShmControl *)m_control.base;
+  if (memcmp(c->magic, SHM_CONTROL_MAGIC, 8) != 0 ||
+      c->version != SHM_INDEX_VERSION) {
+    // Only a freshly created (all-zero) control block is ours to set up
+    static const char zero[8] = {};
+    if (memcmp(c->magic, zero, 8) != 0 || c->version != 0) {
+      detach();
+      return false;
+    }
+    c->generation.store(0);
+    c->version = SHM_INDEX_VERSION;
+    memcpy(c->magic, SHM_CONTROL_MAGIC, 8);
+  }
+
+  ShmGeometry geo = geometry_for(capacity);
+  uint64_t old_number = c->generation.load(std::memory_order_acquire);
+  Generation *old = nullptr;
+  if (old_number != 0 && !open_generation(old_number, true, &old))
+    old = nullptr; // lost or damaged: replaced below
+
+  if (old && memcmp(&old->geo, &geo, sizeof(geo)) == 0) {
+    m_writer = true;
+    m_current.store(old);
+    m_current_number.store(old_number);
+    c->writer_pid.store(current_pid());
+    return true;
+  }
+
+  // Build the next generation beside the current one. Its name is not
+  // published yet, so whatever holds it was left by a writer that died.
+  uint64_t number = old_number + 1;
+  std::string next_name = generation_name(m_name, number);
+  remove_segment(next_name);
+
+  Generation *gen = new Generation();
+#ifndef _WIN32
+  gen->map.fd = -1;
+#endif
+  gen->number = number;
+  gen->geo = geo;
+  if (!map_segment(next_name, geo.total_size, SHM_MAP_CREATE, &gen->map) ||
+      gen->map.size < geo.total_size) {
+    delete_generation(gen);
+    if (old)
+      delete_generation(old);
+    remove_segment(next_name);
+    detach();
+    return false;
+  }
+
+  // A new segment is zero-filled: only the header needs writing
+  ShmHeader *h = (ShmHeader *)gen->map.base;
+  memcpy(h->magic, SHM_MAGIC, 8);
+  h->version = SHM_INDEX_VERSION;
+  h->total_size = geo.total_size;
+  h->slot_count = geo.slot_count;
+  h->slots_offset = geo.slots_offset;
+  h->record_capacity = geo.record_capacity;
+  h->records_offset = geo.records_offset;
+  h->record_count.store(0);
+  h->generation = number;
+
+  // Readers switch over with the users they had, as many as now fit
+  if (old) {
+    uint64_t n = ((ShmHeader *)old->map.base)->record_count.load();
+    for (uint64_t i = 0; i < n; i++) {
+      const ShmRecord *r =
+          (const ShmRecord *)(old->map.base + old->geo.records_offset +
+                              i * sizeof(ShmRecord));
+      if (!index_publish(gen->map.base, geo, r->rec))
+        break;
+    }
+  }
+
+  h->ready.store(1, std::memory_order_release);
+  c->generation.store(number, std::memory_order_release);
+  c->writer_pid.store(current_pid());
+
+  // Readers still mapping the old generation keep it until they switch
+  if (old_number != 0)
+    remove_segment(generation_name(m_name, old_number));
+  if (old)
+    delete_generation(old);
+
+  m_writer = true;
+  m_current.store(gen);
+  m_current_number.store(number);
+  return true;
+}
+
+bool ShmCredentialIndex::attach(const char *name) {
+  detach();
+  m_name = name;
+  bool valid = map_segment(m_name, 0, SHM_MAP_READ, &m_control) &&
+               m_control.size >= sizeof(ShmControl) &&
+               memcmp(control()->magic, SHM_CONTROL_MAGIC, 8) == 0 &&
+               control()->version == SHM_INDEX_VERSION && refresh();
+  if (!valid) {
+    detach();
+    return false;
+  }
+  return true;
+}
+
+// Move to the generation the control block names, if it is not the one in
+// use. Lookups in flight finish on the old mapping; it is unmapped once
+// they have all left it.
+bool ShmCredentialIndex::refresh() {
+  std::lock_guard<std::mutex> guard(m_switch_lock);
+  for (int attempt = 0; attempt < SWITCH_RETRIES; attempt++) {
+    uint64_t number = control()->generation.load(std::memory_order_acquire);
+    if (number == 0)
+      return false;
+    if (number == m_current_number.load())
+      return true;
+
+    Generation *gen;
+    if (!open_generation(number, false, &gen))
+      continue; // superseded and removed before we got to it: look again
+    Generation *prev = m_current.exchange(gen, std::memory_order_acq_rel);
+    m_current_number.store(number);
+    if (prev) {
+      m_epochs.retire(prev, delete_generation);
+      m_retired.fetch_add(1);
+    }
+    reclaim_retired();
+    return true;
+  }
+  return false;
+}
+
+void ShmCredentialIndex::reclaim_retired() {
+  size_t freed = m_epochs.reclaim();
+  if (freed)
+    m_retired.fetch_sub((uint32_t)freed);
+}
+
+void ShmCredentialIndex::detach() {
+  Generation *gen = m_current.exchange(nullptr);
+  if (gen)
+    delete_generation(gen);
+  // No lookups are in flight once the owner detaches
+  reclaim_retired();
+  unmap_segment(&m_control);
+#ifdef _WIN32
+  if (m_writer_mutex) {
+    ReleaseMutex((HANDLE)m_writer_mutex);
+    CloseHandle((HANDLE)m_writer_mutex);
+  }
+  m_writer_mutex = nullptr;
+#endif
+  m_current_number.store(0);
+  m_name.clear();
+  m_writer = false;
+}
+
+uint64_t ShmCredentialIndex::count() {
+  EpochGuard guard(m_epochs);
+  Generation *gen = m_current.load(std::memory_order_acquire);
+  return gen ? ((const ShmHeader *)gen->map.base)
+                   ->record_count.load(std::memory_order_acquire)
+             : 0;
+}
+
+bool ShmCredentialIndex::publish(const SnapshotRecord &rec) {
+  Generation *gen = m_current.load();
+  if (!m_writer || !gen)
+    return false;
+  return index_publish(gen->map.base, gen->geo, rec);
+}
+
+bool ShmCredentialIndex::find(const char *username, size_t len,
+                              uint64_t key_hash, SnapshotRecord *out) {
+  // One load per lookup notices a switch; on failure keep the old mapping
+  if (!m_writer && m_control.base &&
+      control()->generation.load(std::memory_order_acquire) !=
+          m_current_number.load(std::memory_order_relaxed))
+    refresh();
+
+  bool found;
+  {
+    EpochGuard guard(m_epochs);
+    Generation *gen = m_current.load(std::memory_order_acquire);
+    found = gen && index_find(gen->map.base, gen->geo, username, len,
+                              key_hash, out);
+  }
+  if (m_retired.load(std::memory_order_relaxed) != 0)
+    reclaim_retired();
+  return found;
+}
+
+// --- Exported Functions for Python ---
+
+// Lookups share the lock; it only guards replacing the mapping itself
+static std::unique_ptr<ShmCredentialIndex> g_shm;
+static std::shared_mutex g_shm_lock;
+
+static bool shm_lookup(const char *username, SnapshotRecord *out) {
+  size_t len = strnlen(username, SNAPSHOT_MAX_USERNAME + 1);
+  if (!g_shm || len == 0 || len > SNAPSHOT_MAX_USERNAME)
+    return false;
+  return g_shm->find(username, len, fnv1a64(username, len), out);
+}
+
+extern "C" {
+
+// Writer process: create (or take over) the segment
+bool shm_index_create(const char *name, uint64_t capacity) {
+  std::unique_ptr<ShmCredentialIndex> index(new ShmCredentialIndex());
+  if (!index->create(name, capacity))
+    return false;
+  std::unique_lock<std::shared_mutex> guard(g_shm_lock);
+  g_shm = std::move(index);
+  return true;
+}
+
+// Worker processes: map the segment read-only. No data is copied.
+bool shm_index_attach(const char *name) {
+  std::unique_ptr<ShmCredentialIndex> index(new ShmCredentialIndex());
+  if (!index->attach(name))
+    return false;
+  std::unique_lock<std::shared_mutex> guard(g_shm_lock);
+  g_shm = std::move(index);
+  return true;
+}
+
+void shm_index_detach() {
+  std::unique_lock<std::shared_mutex> guard(g_shm_lock);
+  g_shm.reset();
+}
+
+// Remove the segment names; processes that have them mapped keep working
+bool shm_index_unlink(const char *name) {
+#ifdef _WIN32
+  (void)name;
+  return true; // named mappings disappear with their last handle
+#else
+  ShmMapping control = {nullptr, 0, -1};
+  if (map_segment(name, 0, SHM_MAP_READ, &control)) {
+    const ShmControl *c = (const ShmControl *)control.base;
+    if (control.size >= sizeof(ShmControl) &&
+        memcmp(c->magic, SHM_CONTROL_MAGIC, 8) == 0 &&
+        c->generation.load() != 0)
+      remove_segment(generation_name(name, c->generation.load()));
+    unmap_segment(&control);
+  }
+  return shm_unlink((std::string("/") + name).c_str()) == 0;
+#endif
+}
+
+// Writer only: publish every user in users.db
+int64_t shm_index_load_db(const char *db_path) {
+  std::vector<SnapshotRecord> rows;
+  uint64_t max_rowid;
+  if (!load_rows_after(db_path, 0, &rows, &max_rowid))
+    return -1;
+
+  std::unique_lock<std::shared_mutex> guard(g_shm_lock);
+  if (!g_shm || !g_shm->is_writer())
+    return -1;
+  int64_t published = 0;
+  for (SnapshotRecord &rec : rows) {
+    if (g_shm->publish(rec))
+      published++;
+    memset(&rec, 0, sizeof(rec));
+  }
+  return published;
+}
+
+// Writer only: add or update one user (e.g. after register_user)
+bool shm_index_publish_user(const char *username, const char *password_hash_hex,
+                            const char *totp_secret_b32) {
+  SnapshotRecord rec;
+  if (!snapshot_fill_record(&rec, 0, username, password_hash_hex,
+                            totp_secret_b32))
+    return false;
+  std::unique_lock<std::shared_mutex> guard(g_shm_lock);
+  bool ok = g_shm && g_shm->publish(rec);
+  memset(&rec, 0, sizeof(rec));
+  return ok;
+}
+
+uint64_t shm_index_count() {
+  std::shared_lock<std::shared_mutex> guard(g_shm_lock);
+  return g_shm ? g_shm->count() : 0;
+}
+
+bool shm_validate_login(const char *username, const char *password) {
+  SnapshotRecord rec;
+  bool ok;
+  {
+    std::shared_lock<std::shared_mutex> guard(g_shm_lock);
+    ok = shm_lookup(username, &rec);
+  }
+  ok = ok && password_matches(rec.password_sha256, password);
+  memset(&rec, 0, sizeof(rec));
+  return ok;
+}
+
+bool shm_validate_totp(const char *username, int user_code) {
+  SnapshotRecord rec;
+  bool ok;
+  {
+    std::shared_lock<std::shared_mutex> guard(g_shm_lock);
+    ok = shm_lookup(username, &rec);
+  }
+  ok = ok && totp_matches(rec, user_code, std::time(0));
+  memset(&rec, 0, sizeof(rec));
+  return ok;
+}
+}
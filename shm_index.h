@@ -0,0 +1,152 @@
+#pragma once
+
+#include "credential_snapshot.h"
+#include "epoch_reclaim.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// --- Shared-Memory Credential Index ---
+// Named segments hold the resident credential index for every process on
+// the machine (GUI instances, API workers). All links inside a segment are
+// byte offsets from its base, so each process may map it anywhere.
+//
+// One writer process at a time (enforced with a lock on the control
+// segment); readers never lock: hash slots are published with release
+// stores and each record carries a sequence counter (seqlock) for in-place
+// updates.
+//
+// The segment `<name>` is a small control block naming the current
+// generation; the index itself lives in `<name>.<generation>`. A segment is
+// never resized or cleared once readers can see it: a writer that needs a
+// different geometry builds the next generation beside the current one,
+// copies the users across and then switches the control block over with one
+// store. Readers keep a valid mapping throughout and move to the new
+// generation on their next lookup.
+//
+// Index layout: [ShmHeader][ShmSlot x slot_count][ShmRecord x record_capacity]
+
+const uint32_t SHM_INDEX_VERSION = 2;
+
+struct ShmControl {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  std::atomic<uint64_t> generation; // current index segment, 0 = none yet
+  std::atomic<uint64_t> writer_pid;
+};
+
+struct ShmHeader {
+  char magic[8];
+  uint32_t version;
+  std::atomic<uint32_t> ready; // set once the writer finished initialising
+  uint64_t total_size;
+  uint64_t slot_count; // power of two
+  uint64_t slots_offset;
+  uint64_t record_capacity;
+  uint64_t records_offset;
+  std::atomic<uint64_t> record_count;
+  uint64_t generation; // must match the segment name
+};
+
+struct ShmSlot {
+  std::atomic<uint64_t> key_hash;
+  std::atomic<uint64_t> record_offset; // 0 = empty
+};
+
+struct ShmRecord {
+  std::atomic<uint32_t> seq; // odd while the writer is updating
+  uint32_t reserved;
+  SnapshotRecord rec;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared-memory atomics must be address-free");
+
+// Where the tables of one index segment are, checked against its mapping
+struct ShmGeometry {
+  uint64_t slot_count;
+  uint64_t slots_offset;
+  uint64_t record_capacity;
+  uint64_t records_offset;
+  uint64_t total_size;
+};
+
+// One mapped segment
+struct ShmMapping {
+  uint8_t *base;
+  size_t size;
+#ifdef _WIN32
+  void *handle;
+#else
+  int fd;
+#endif
+};
+
+//
+// ShmCredentialIndex - one process's view of the shared index
+//
+class ShmCredentialIndex {
+private:
+  struct Generation {
+    ShmMapping map;
+    ShmGeometry geo;
+    uint64_t number;
+  };
+
+  std::string m_name;
+  ShmMapping m_control;
+  bool m_writer;
+#ifdef _WIN32
+  void *m_writer_mutex;
+#endif
+
+  // Generation in use, read lock-free under m_epochs. Only readers switch
+  // it; the writer keeps the one it created or adopted.
+  EpochDomain m_epochs;
+  std::atomic<Generation *> m_current;
+  std::atomic<uint64_t> m_current_number;
+  std::atomic<uint32_t> m_retired;
+  std::mutex m_switch_lock;
+
+  const ShmControl *control() const {
+    return (const ShmControl *)m_control.base;
+  }
+  static void delete_generation(void *p);
+  bool open_generation(uint64_t number, bool writable, Generation **out);
+  bool refresh();
+  void reclaim_retired();
+
+public:
+  ShmCredentialIndex();
+  ~ShmCredentialIndex();
+
+  ShmCredentialIndex(const ShmCredentialIndex &) = delete;
+  ShmCredentialIndex &operator=(const ShmCredentialIndex &) = delete;
+
+  // Become the writer for `name`. Fails if another live process is the
+  // writer. A valid current generation with the same geometry is adopted,
+  // so a restarted writer keeps its data; otherwise a new generation is
+  // built, seeded with the users of the current one, and switched in.
+  bool create(const char *name, uint64_t capacity);
+
+  // Map the current generation read-only
+  bool attach(const char *name);
+  void detach();
+
+  bool is_attached() const { return m_current.load() != nullptr; }
+  bool is_writer() const { return m_writer; }
+  uint64_t generation() const { return m_current_number.load(); }
+  uint64_t count();
+
+  // Writer only: insert a user or update their credentials in place
+  bool publish(const SnapshotRecord &rec);
+
+  // Any process: copy the user's record out of the index, first moving to
+  // a newer generation if the writer switched since the last lookup
+  bool find(const char *username, size_t len, uint64_t key_hash,
+            SnapshotRecord *out);
+};
@@ -0,0 +1,402 @@
+/*
+ * Credential Snapshot Builder
+ *
+ * Builds a binary credential snapshot (see credential_snapshot.h) from
+ * users.db. The rowid range is split across threads, each decoding hex
+ * password hashes and Base32 TOTP secrets on its own SQLite connection.
+ * Records are ordered with a parallel LSD radix sort on the key hash; when
+ * they do not fit the memory budget, sorted runs are spilled next to the
+ * output and k-way merged. The output is written to a temp file and renamed,
+ * so a running daemon can hot-swap it at any time.
+ *
+ * Usage: snapshot_builder <users.db> <output.snap> [--threads N] [--memory-mb M]
+ */
+
+#include "credential_snapshot.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <queue>
+#include <sqlite3.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records read from SQLite per spill check
+const size_t SCAN_BATCH = 4096;
+
+// Records buffered per run during the merge
+const size_t MERGE_BUFFER = 8192;
+
+struct BuildOptions {
+  const char *db_path;
+  const char *out_path;
+  unsigned threads;
+  uint64_t memory_bytes;
+};
+
+// --- Parallel Radix Sort ---
+
+// LSD radix sort on key_hash, 8 bits per pass. Each pass: per-thread
+// histograms over contiguous chunks, a global prefix sum, then a stable
+// parallel scatter into the other buffer.
+static void radix_sort(std::vector<SnapshotRecord> &records, unsigned threads) {
+  size_t n = records.size();
+  if (n < 2)
+    return;
+  if (threads < 1 || n < 65536)
+    threads = 1;
+
+  std::vector<SnapshotRecord> scratch(n);
+  SnapshotRecord *src = records.data();
+  SnapshotRecord *dst = scratch.data();
+  std::vector<size_t> counts(threads * 256);
+
+  size_t chunk = (n + threads - 1) / threads;
+
+  for (int shift = 0; shift < 64; shift += 8) {
+    auto histogram = [&](unsigned t) {
+      size_t *c = &counts[t * 256];
+      std::fill(c, c + 256, 0);
+      size_t begin = t * chunk, end = std::min(n, begin + chunk);
+      for (size_t i = begin; i < end; i++)
+        c[(src[i].key_hash >> shift) & 0xff]++;
+    };
+    auto scatter = [&](unsigned t) {
+      size_t *c = &counts[t * 256];
+      size_t begin = t * chunk, end = std::min(n, begin + chunk);
+      for (size_t i = begin; i < end; i++)
+        dst[c[(src[i].key_hash >> shift) & 0xff]++] = src[i];
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; t++)
+      workers.emplace_back(histogram, t);
+    histogram(0);
+    for (std::thread &w : workers)
+      w.join();
+    workers.clear();
+
+    // Skip passes where every key shares the same byte
+    bool single_bucket = false;
+    for (int b = 0; b < 256 && !single_bucket; b++) {
+      size_t total = 0;
+      for (unsigned t = 0; t < threads; t++)
+        total += counts[t * 256 + b];
+      single_bucket = total == n;
+    }
+    if (single_bucket)
+      continue;
+
+    // Bucket-major, thread-minor offsets keep the scatter stable
+    size_t offset = 0;
+    for (int b = 0; b < 256; b++) {
+      for (unsigned t = 0; t < threads; t++) {
+        size_t c = counts[t * 256 + b];
+        counts[t * 256 + b] = offset;
+        offset += c;
+      }
+    }
+
+    for (unsigned t = 1; t < threads; t++)
+      workers.emplace_back(scatter, t);
+    scatter(0);
+    for (std::thread &w : workers)
+      w.join();
+
+    std::swap(src, dst);
+  }
+
+  if (src != records.data())
+    memcpy(records.data(), src, n * sizeof(SnapshotRecord));
+}
+
+// --- Spill Runs ---
+
+class RunSet {
+private:
+  std::string m_prefix;
+  std::vector<std::string> m_paths;
+  std::mutex m_lock;
+
+public:
+  explicit RunSet(const char *out_path) : m_prefix(std::string(out_path) + ".run") {}
+
+  ~RunSet() {
+    for (const std::string &p : m_paths)
+      std::remove(p.c_str());
+  }
+
+  size_t size() const { return m_paths.size(); }
+  const std::string &path(size_t i) const { return m_paths[i]; }
+
+  // Sort and write one run. Called concurrently by scan workers.
+  bool spill(std::vector<SnapshotRecord> &records) {
+    radix_sort(records, 1);
+
+    std::string path;
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      path = m_prefix + std::to_string(m_paths.size());
+      m_paths.push_back(path);
+    }
+
+    FILE *f = fopen(path.c_str(), "wb");
+    if (!f)
+      return false;
+    bool ok = fwrite(records.data(), sizeof(SnapshotRecord), records.size(), f) ==
+              records.size();
+    ok = (fclose(f) == 0) && ok;
+    records.clear();
+    return ok;
+  }
+};
+
+struct RunReader {
+  FILE *file;
+  std::vector<SnapshotRecord> buffer;
+  size_t pos;
+
+  bool refill() {
+    buffer.resize(MERGE_BUFFER);
+    size_t n = fread(buffer.data(), sizeof(SnapshotRecord), MERGE_BUFFER, file);
+    buffer.resize(n);
+    pos = 0;
+    return n > 0;
+  }
+};
+
+static bool merge_runs(const RunSet &runs, SnapshotWriter &writer) {
+  std::vector<RunReader> readers(runs.size());
+  auto greater = [&](size_t a, size_t b) {
+    return readers[a].buffer[readers[a].pos].key_hash >
+           readers[b].buffer[readers[b].pos].key_hash;
+  };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(
+      greater);
+
+  bool ok = true;
+  for (size_t i = 0; i < runs.size(); i++) {
+    readers[i].file = fopen(runs.path(i).c_str(), "rb");
+    if (!readers[i].file) {
+      ok = false;
+      continue;
+    }
+    if (readers[i].refill())
+      heap.push(i);
+  }
+
+  std::vector<SnapshotRecord> out;
+  out.reserve(MERGE_BUFFER);
+  while (ok && !heap.empty()) {
+    size_t i = heap.top();
+    heap.pop();
+    out.push_back(readers[i].buffer[readers[i].pos++]);
+    if (readers[i].pos < readers[i].buffer.size() || readers[i].refill())
+      heap.push(i);
+
+    if (out.size() == MERGE_BUFFER) {
+      ok = writer.append(out.data(), out.size());
+      out.clear();
+    }
+  }
+  if (ok)
+    ok = writer.append(out.data(), out.size());
+
+  for (RunReader &r : readers)
+    if (r.file)
+      fclose(r.file);
+  return ok;
+}
+
+// --- Parallel Scan ---
+
+struct ScanResult {
+  std::vector<SnapshotRecord> records;
+  uint64_t rows;
+  uint64_t rejected;
+  bool ok;
+};
+
+static void scan_range(const BuildOptions &opts, int64_t first, int64_t last,
+                       size_t spill_threshold, RunSet *runs,
+                       ScanResult *result) {
+  result->rows = 0;
+  result->rejected = 0;
+  result->ok = false;
+
+  sqlite3 *db;
+  if (sqlite3_open_v2(opts.db_path, &db, SQLITE_OPEN_READONLY, nullptr) !=
+      SQLITE_OK) {
+    sqlite3_close(db);
+    return;
+  }
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(db,
+                         "SELECT rowid, username, password_hash, totp_secret "
+                         "FROM users WHERE rowid BETWEEN ? AND ?",
+                         -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_close(db);
+    return;
+  }
+  sqlite3_bind_int64(stmt, 1, first);
+  sqlite3_bind_int64(stmt, 2, last);
+
+  result->ok = true;
+  SnapshotRecord rec;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    const char *name = (const char *)sqlite3_column_text(stmt, 1);
+    const char *pwd_hash = (const char *)sqlite3_column_text(stmt, 2);
+    const char *secret = (const char *)sqlite3_column_text(stmt, 3);
+    result->rows++;
+
+    if (!name || !pwd_hash || !secret ||
+        !snapshot_fill_record(&rec, (uint64_t)sqlite3_column_int64(stmt, 0),
+                              name, pwd_hash, secret)) {
+      result->rejected++;
+      continue;
+    }
+    result->records.push_back(rec);
+
+    if (result->records.size() % SCAN_BATCH == 0 &&
+        result->records.size() >= spill_threshold && !runs->spill(result->records)) {
+      result->ok = false;
+      break;
+    }
+  }
+
+  sqlite3_finalize(stmt);
+  sqlite3_close(db);
+}
+
+static bool rowid_bounds(const char *db_path, int64_t *min_rowid,
+                         int64_t *max_rowid) {
+  sqlite3 *db;
+  if (sqlite3_open_v2(db_path, &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+    sqlite3_close(db);
+    return false;
+  }
+  sqlite3_stmt *stmt;
+  bool ok = sqlite3_prepare_v2(db, "SELECT MIN(rowid), MAX(rowid) FROM users",
+                               -1, &stmt, nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW;
+  if (ok) {
+    *min_rowid = sqlite3_column_int64(stmt, 0);
+    *max_rowid = sqlite3_column_int64(stmt, 1);
+  }
+  sqlite3_finalize(stmt);
+  sqlite3_close(db);
+  return ok;
+}
+
+// --- Main ---
+
+static int usage() {
+  fprintf(stderr, "Usage: snapshot_builder <users.db> <output.snap> "
+                  "[--threads N] [--memory-mb M]\n");
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3)
+    return usage();
+
+  BuildOptions opts;
+  opts.db_path = argv[1];
+  opts.out_path = argv[2];
+  opts.threads = std::max(1u, std::thread::hardware_concurrency());
+  opts.memory_bytes = 512ULL << 20;
+
+  for (int i = 3; i < argc; i++) {
+    if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+      opts.threads = (unsigned)std::max(1, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--memory-mb") == 0 && i + 1 < argc)
+      opts.memory_bytes = (uint64_t)std::max(1, atoi(argv[++i])) << 20;
+    else
+      return usage();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  int64_t min_rowid = 0, max_rowid = 0;
+  if (!rowid_bounds(opts.db_path, &min_rowid, &max_rowid)) {
+    fprintf(stderr, "Error: cannot read users table from %s\n", opts.db_path);
+    return 1;
+  }
+
+  // Radix sort needs a scratch copy, so budget two buffers per record
+  size_t budget_records = opts.memory_bytes / (2 * sizeof(SnapshotRecord));
+  size_t spill_threshold = std::max<size_t>(SCAN_BATCH, budget_records / opts.threads);
+
+  RunSet runs(opts.out_path);
+  std::vector<ScanResult> results(opts.threads);
+  std::vector<std::thread> workers;
+
+  int64_t span = max_rowid - min_rowid + 1;
+  for (unsigned t = 0; t < opts.threads; t++) {
+    int64_t first = min_rowid + span * t / opts.threads;
+    int64_t last = min_rowid + span * (t + 1) / opts.threads - 1;
+    workers.emplace_back(scan_range, std::cref(opts), first, last,
+                         spill_threshold, &runs, &results[t]);
+  }
+  for (std::thread &w : workers)
+    w.join();
+
+  uint64_t rows = 0, rejected = 0, resident = 0;
+  for (const ScanResult &r : results) {
+    if (!r.ok) {
+      fprintf(stderr, "Error: scan failed\n");
+      return 1;
+    }
+    rows += r.rows;
+    rejected += r.rejected;
+    resident += r.records.size();
+  }
+
+  SnapshotWriter writer;
+  if (!writer.begin(opts.out_path)) {
+    fprintf(stderr, "Error: cannot create %s\n", opts.out_path);
+    return 1;
+  }
+
+  bool ok;
+  if (runs.size() == 0 && resident <= budget_records) {
+    // Everything fits: one parallel sort, one write
+    std::vector<SnapshotRecord> all;
+    all.reserve(resident);
+    for (ScanResult &r : results) {
+      all.insert(all.end(), r.records.begin(), r.records.end());
+      std::vector<SnapshotRecord>().swap(r.records);
+    }
+    radix_sort(all, opts.threads);
+    ok = writer.append(all.data(), all.size());
+  } else {
+    // Spill what is left and merge all runs into the output
+    ok = true;
+    for (ScanResult &r : results)
+      if (ok && !r.records.empty())
+        ok = runs.spill(r.records);
+    ok = ok && merge_runs(runs, writer);
+  }
+
+  if (!ok || !writer.finish((uint64_t)max_rowid)) {
+    fprintf(stderr, "Error: failed to write %s\n", opts.out_path);
+    return 1;
+  }
+
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                              start)
+                    .count();
+  printf("Snapshot written: %s\n", opts.out_path);
+  printf("  rows: %llu, records: %llu, rejected: %llu, runs: %zu\n",
+         (unsigned long long)rows, (unsigned long long)(rows - rejected),
+         (unsigned long long)rejected, runs.size());
+  printf("  threads: %u, time: %.2fs\n", opts.threads, secs);
+  return 0;
+}
@@ -0,0 +1,258 @@
+#include "symbol_table.h"
+
+#include "crypto_core.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Log record: [u32 id][u16 len][u32 check][len bytes]
+const size_t SYMBOL_RECORD_HEADER = 10;
+
+static uint32_t symbol_check(uint32_t id, std::string_view s) {
+  uint64_t h = fnv1a64(s.data(), s.size());
+  return (uint32_t)(h ^ (h >> 32)) ^ id;
+}
+
+static bool truncate_file(FILE *f, long size) {
+#ifdef _WIN32
+  return _chsize(_fileno(f), size) == 0;
+#else
+  return ftruncate(fileno(f), (off_t)size) == 0;
+#endif
+}
+
+// --- SymbolTable ---
+
+SymbolTable::SymbolTable() : m_next_id(1), m_count(0), m_file(nullptr) {
+  for (auto &c : m_chunks)
+    c.store(nullptr, std::memory_order_relaxed);
+}
+
+SymbolTable::~SymbolTable() {
+  close();
+  for (auto &c : m_chunks)
+    delete[] c.load();
+}
+
+SymbolTable::Shard &SymbolTable::shard_for(std::string_view s) {
+  return m_shards[fnv1a64(s.data(), s.size()) % SHARDS];
+}
+
+void SymbolTable::set_name(uint32_t id, const std::string *s) {
+  std::atomic<NameSlot *> &chunk = m_chunks[id >> CHUNK_BITS];
+  NameSlot *slots = chunk.load(std::memory_order_acquire);
+  if (!slots) {
+    NameSlot *fresh = new NameSlot[CHUNK_SIZE];
+    for (size_t i = 0; i < CHUNK_SIZE; i++)
+      fresh[i].store(nullptr, std::memory_order_relaxed);
+    if (chunk.compare_exchange_strong(slots, fresh))
+      slots = fresh;
+    else
+      delete[] fresh; // another thread installed it first
+  }
+  slots[id & (CHUNK_SIZE - 1)].store(s, std::memory_order_release);
+}
+
+uint32_t SymbolTable::insert_locked(Shard &shard, std::string_view s,
+                                    uint32_t id) {
+  shard.strings.emplace_back(s);
+  const std::string &stored = shard.strings.back();
+  shard.ids.emplace(std::string_view(stored), id);
+  set_name(id, &stored);
+  m_count.fetch_add(1);
+  return id;
+}
+
+// Intern the records of a log; returns the end of the last good one
+long SymbolTable::replay_log(FILE *f) {
+  long good = 0;
+  uint32_t max_id = m_next_id.load() - 1;
+  std::vector<char> buf;
+  for (;;) {
+    uint8_t hdr[SYMBOL_RECORD_HEADER];
+    if (fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr))
+      break;
+    uint32_t id, check;
+    uint16_t len;
+    memcpy(&id, hdr, 4);
+    memcpy(&len, hdr + 4, 2);
+    memcpy(&check, hdr + 6, 4);
+    buf.resize(len);
+    if (id == NO_SYMBOL || (id >> CHUNK_BITS) >= MAX_CHUNKS ||
+        fread(buf.data(), 1, len, f) != len)
+      break;
+    std::string_view s(buf.data(), len);
+    if (symbol_check(id, s) != check)
+      break;
+
+    Shard &shard = shard_for(s);
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    if (!shard.ids.count(s))
+      insert_locked(shard, s, id);
+    if (id > max_id)
+      max_id = id;
+    good = ftell(f);
+  }
+  m_next_id.store(max_id + 1);
+  return good;
+}
+
+bool SymbolTable::open(const char *path) {
+  close();
+
+  FILE *f = fopen(path, "r+b");
+  if (!f)
+    f = fopen(path, "w+b");
+  if (!f)
+    return false;
+  long good = replay_log(f);
+
+  // Drop a record torn by a crash mid-append
+  if (fseek(f, 0, SEEK_END) == 0 && ftell(f) != good) {
+    fflush(f);
+    truncate_file(f, good);
+  }
+  fseek(f, good, SEEK_SET);
+  m_file = f;
+  return true;
+}
+
+bool SymbolTable::load(const char *path) {
+  close();
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  replay_log(f);
+  fclose(f);
+  return true;
+}
+
+void SymbolTable::close() {
+  std::lock_guard<std::mutex> guard(m_file_lock);
+  if (m_file)
+    fclose(m_file);
+  m_file = nullptr;
+}
+
+bool SymbolTable::append_to_log(uint32_t id, std::string_view s) {
+  std::lock_guard<std::mutex> guard(m_file_lock);
+  if (!m_file)
+    return true;
+
+  uint8_t hdr[SYMBOL_RECORD_HEADER];
+  uint16_t len = (uint16_t)s.size();
+  uint32_t check = symbol_check(id, s);
+  memcpy(hdr, &id, 4);
+  memcpy(hdr + 4, &len, 2);
+  memcpy(hdr + 6, &check, 4);
+  // Flushed per record so a failure is seen here, not by a later append.
+  // Symbols are new rarely enough for that to cost nothing measurable.
+  long start = ftell(m_file);
+  if (start >= 0 && fwrite(hdr, 1, sizeof(hdr), m_file) == sizeof(hdr) &&
+      fwrite(s.data(), 1, len, m_file) == len && fflush(m_file) == 0)
+    return true;
+
+  // Cut a partly written record off again: replay stops at the first bad
+  // record, which would lose every symbol appended after it
+  clearerr(m_file);
+  if (start >= 0) {
+    truncate_file(m_file, start);
+    fseek(m_file, start, SEEK_SET);
+  }
+  return false;
+}
+
+uint32_t SymbolTable::find(std::string_view s) {
+  Shard &shard = shard_for(s);
+  std::shared_lock<std::shared_mutex> guard(shard.lock);
+  auto it = shard.ids.find(s);
+  return it == shard.ids.end() ? NO_SYMBOL : it->second;
+}
+
+uint32_t SymbolTable::intern(std::string_view s) {
+  if (s.size() > UINT16_MAX)
+    s = s.substr(0, UINT16_MAX);
+
+  Shard &shard = shard_for(s);
+  {
+    std::shared_lock<std::shared_mutex> guard(shard.lock);
+    auto it = shard.ids.find(s);
+    if (it != shard.ids.end())
+      return it->second;
+  }
+
+  std::unique_lock<std::shared_mutex> guard(shard.lock);
+  auto it = shard.ids.find(s);
+  if (it != shard.ids.end())
+    return it->second;
+
+  uint32_t id = m_next_id.fetch_add(1);
+  if ((id >> CHUNK_BITS) >= MAX_CHUNKS)
+    return NO_SYMBOL;
+  // Logged before anyone can see the ID: a record written with an ID that
+  // never reached the log would decode to nothing after a restart. The ID
+  // of a failed write is left unused.
+  if (!append_to_log(id, s))
+    return NO_SYMBOL;
+  insert_locked(shard, s, id);
+  return id;
+}
+
+const std::string *SymbolTable::name(uint32_t id) const {
+  if (id == NO_SYMBOL || (id >> CHUNK_BITS) >= MAX_CHUNKS)
+    return nullptr;
+  NameSlot *slots = m_chunks[id >> CHUNK_BITS].load(std::memory_order_acquire);
+  if (!slots)
+    return nullptr;
+  return slots[id & (CHUNK_SIZE - 1)].load(std::memory_order_acquire);
+}
+
+bool SymbolTable::sync() {
+  std::lock_guard<std::mutex> guard(m_file_lock);
+  if (!m_file)
+    return true;
+  if (fflush(m_file) != 0)
+    return false;
+#ifndef _WIN32
+  return fsync(fileno(m_file)) == 0;
+#else
+  return true;
+#endif
+}
+
+SymbolTable &global_symbols() {
+  static SymbolTable table;
+  return table;
+}
+
+// --- Exported Functions for Python ---
+
+extern "C" {
+
+// Persist symbols to `path` (normally inside the audit segment directory)
+bool symbol_table_open(const char *path) { return global_symbols().open(path); }
+
+uint32_t symbol_intern(const char *s) { return global_symbols().intern(s); }
+
+uint32_t symbol_find(const char *s) { return global_symbols().find(s); }
+
+// Copy the string for `id` into `buf`. Returns its length, or -1.
+int symbol_name(uint32_t id, char *buf, int buf_size) {
+  const std::string *s = global_symbols().name(id);
+  if (!s || buf_size <= 0)
+    return -1;
+  int n = (int)std::min(s->size(), (size_t)buf_size - 1);
+  memcpy(buf, s->data(), n);
+  buf[n] = '\0';
+  return n;
+}
+
+uint32_t symbol_count() { return global_symbols().count(); }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// --- Symbol Table ---
+// Interns usernames, event types, statuses, risk levels, IPs and detail
+// strings into dense 32-bit IDs (0 is never assigned), so audit records and
+// in-memory detection state key on integers instead of re-hashing text.
+//
+// New symbols are appended to an on-disk log next to the audit segments;
+// IDs stay stable across restarts.
+
+class SymbolTable {
+public:
+  static const uint32_t NO_SYMBOL = 0;
+
+private:
+  static const size_t SHARDS = 64;
+  static const size_t CHUNK_BITS = 12;
+  static const size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+  static const size_t MAX_CHUNKS = 1 << 16; // 256M symbols
+
+  struct Shard {
+    std::shared_mutex lock;
+    std::deque<std::string> strings; // stable storage for the map keys
+    std::unordered_map<std::string_view, uint32_t> ids;
+  };
+
+  Shard m_shards[SHARDS];
+
+  // id -> string, readable without locks
+  typedef std::atomic<const std::string *> NameSlot;
+  std::atomic<NameSlot *> m_chunks[MAX_CHUNKS];
+  std::atomic<uint32_t> m_next_id;
+  // Symbols published; IDs of failed log writes are skipped, not counted
+  std::atomic<uint32_t> m_count;
+
+  std::mutex m_file_lock;
+  FILE *m_file;
+
+  Shard &shard_for(std::string_view s);
+  void set_name(uint32_t id, const std::string *s);
+  uint32_t insert_locked(Shard &shard, std::string_view s, uint32_t id);
+  bool append_to_log(uint32_t id, std::string_view s);
+  long replay_log(FILE *f);
+
+public:
+  SymbolTable();
+  ~SymbolTable();
+
+  SymbolTable(const SymbolTable &) = delete;
+  SymbolTable &operator=(const SymbolTable &) = delete;
+
+  // Load the symbol log (truncating a torn tail) and append to it from now
+  // on. Without a file the table is memory-only.
+  bool open(const char *path);
+
+  // Load the symbol log read-only; symbols interned later stay in memory.
+  // For tools reading a directory another process may be writing.
+  bool load(const char *path);
+  void close();
+
+  // ID for `s`, assigning the next free one on first sight. NO_SYMBOL if
+  // the new symbol could not be written to the log.
+  uint32_t intern(std::string_view s);
+
+  // ID for `s` if already interned, else NO_SYMBOL
+  uint32_t find(std::string_view s);
+
+  // String for `id`, or nullptr. The pointer stays valid for the table's
+  // lifetime.
+  const std::string *name(uint32_t id) const;
+
+  // Symbols that can be looked up (not the highest ID handed out)
+  uint32_t count() const { return m_count.load(); }
+
+  // Flush appended symbols to disk; call before making records that
+  // reference them durable
+  bool sync();
+};
+
+// Process-wide table shared by audit, intrusion and session subsystems
+SymbolTable &global_symbols();
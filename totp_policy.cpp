@@ -0,0 +1,75 @@
+#include "totp_policy.h"
+
+#include <cstring>
+
+// Indexed by TotpPolicyId; must agree with the typedefs in totp_policy.h
+static const TotpPolicyInfo POLICIES[TOTP_POLICY_COUNT] = {
+    {TOTP_HASH_SHA1, 6, 30, 1},   {TOTP_HASH_SHA1, 8, 30, 1},
+    {TOTP_HASH_SHA1, 6, 60, 1},   {TOTP_HASH_SHA256, 6, 30, 1},
+    {TOTP_HASH_SHA256, 8, 30, 1},
+};
+
+bool totp_policy_info(uint8_t policy, TotpPolicyInfo *out) {
+  if (policy >= TOTP_POLICY_COUNT)
+    return false;
+  *out = POLICIES[policy];
+  return true;
+}
+
+int totp_policy_find(TotpHash hash, unsigned digits, unsigned period,
+                     unsigned window) {
+  for (int i = 0; i < TOTP_POLICY_COUNT; i++) {
+    const TotpPolicyInfo &p = POLICIES[i];
+    if (p.hash == hash && p.digits == digits && p.period == period &&
+        p.window == window)
+      return i;
+  }
+  return -1;
+}
+
+bool totp_key_init(TotpKey *key, uint8_t policy, const uint8_t *secret,
+                   size_t secret_len) {
+  memset(key, 0, sizeof(*key));
+  if (policy >= TOTP_POLICY_COUNT) {
+    key->policy = TOTP_POLICY_COUNT; // totp_verify() rejects every code
+    return false;
+  }
+  key->policy = policy;
+  if (POLICIES[policy].hash == TOTP_HASH_SHA256)
+    hmac_sha256_precompute(&key->sha256, secret, secret_len);
+  else
+    hmac_sha1_precompute(&key->sha1, secret, secret_len);
+  return true;
+}
+
+uint32_t totp_code(const TotpKey &key, uint64_t step) {
+  switch (key.policy) {
+  case TOTP_POLICY_DEFAULT:
+    return TotpPolicyDefault::code(key, step);
+  case TOTP_POLICY_SHA1_8:
+    return TotpPolicySha1x8::code(key, step);
+  case TOTP_POLICY_SHA1_6_60:
+    return TotpPolicySha1x6x60::code(key, step);
+  case TOTP_POLICY_SHA256_6:
+    return TotpPolicySha256x6::code(key, step);
+  case TOTP_POLICY_SHA256_8:
+    return TotpPolicySha256x8::code(key, step);
+  }
+  return UINT32_MAX;
+}
+
+bool totp_verify(const TotpKey &key, int code, time_t now) {
+  switch (key.policy) {
+  case TOTP_POLICY_DEFAULT:
+    return TotpPolicyDefault::matches(key, code, now);
+  case TOTP_POLICY_SHA1_8:
+    return TotpPolicySha1x8::matches(key, code, now);
+  case TOTP_POLICY_SHA1_6_60:
+    return TotpPolicySha1x6x60::matches(key, code, now);
+  case TOTP_POLICY_SHA256_6:
+    return TotpPolicySha256x6::matches(key, code, now);
+  case TOTP_POLICY_SHA256_8:
+    return TotpPolicySha256x8::matches(key, code, now);
+  }
+  return false;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "crypto_core.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <utility>
+
+// --- TOTP Policies ---
+// RFC 6238 verification specialised at compile time. Hash, digits, period
+// and skew window are template parameters of TotpPolicy, so the code
+// modulus and the step division are constants the compiler strength-reduces
+// to multiplies, the window is unrolled into straight-line HMACs, and no
+// branch depends on configuration.
+//
+// The configurations in use are instantiated once each and numbered
+// (TotpPolicyId). A user's credentials carry the ID of theirs - every user
+// user_db.py registers gets TOTP_POLICY_DEFAULT, pyotp's defaults - and
+// totp_verify() switches on it once per check, not once per step.
+
+enum TotpHash : uint8_t { TOTP_HASH_SHA1 = 0, TOTP_HASH_SHA256 = 1 };
+
+enum TotpPolicyId : uint8_t {
+  TOTP_POLICY_DEFAULT = 0, // SHA1, 6 digits, 30 s, +/-1 step (pyotp)
+  TOTP_POLICY_SHA1_8 = 1,  // SHA1, 8 digits, 30 s, +/-1 step
+  TOTP_POLICY_SHA1_6_60 = 2, // SHA1, 6 digits, 60 s, +/-1 step
+  TOTP_POLICY_SHA256_6 = 3,  // SHA256, 6 digits, 30 s, +/-1 step
+  TOTP_POLICY_SHA256_8 = 4,  // SHA256, 8 digits, 30 s, +/-1 step
+  TOTP_POLICY_COUNT
+};
+
+// A user's TOTP secret with the HMAC pads of their policy's hash absorbed
+struct TotpKey {
+  uint8_t policy; // TotpPolicyId
+  uint8_t reserved[3];
+  union {
+    HmacSha1Key sha1;
+    HmacSha256Key sha256;
+  };
+};
+
+// --- Hashes ---
+
+struct TotpSha1 {
+  static const size_t DIGEST = 20;
+  static void mac(const TotpKey &k, const uint8_t msg[8], uint8_t *out) {
+    hmac_sha1_finish(k.sha1, msg, 8, out);
+  }
+};
+
+struct TotpSha256 {
+  static const size_t DIGEST = 32;
+  static void mac(const TotpKey &k, const uint8_t msg[8], uint8_t *out) {
+    hmac_sha256_finish(k.sha256, msg, 8, out);
+  }
+};
+
+//
+// TotpPolicy - code generation and verification for one configuration
+//
+template <typename Hash, unsigned Digits, unsigned Period, unsigned Window>
+struct TotpPolicy {
+  static_assert(Digits >= 6 && Digits <= 9, "RFC 4226 allows 6 to 9 digits");
+  static_assert(Period > 0, "period must be positive");
+  static_assert(Window <= 4, "a wide window accepts stale codes");
+
+  static const uint32_t MODULUS = HOTP_POW10.value[Digits];
+  static const unsigned STEPS = 2 * Window + 1;
+
+  // RFC 4226 HOTP value of `step`
+  static uint32_t code(const TotpKey &key, uint64_t step) {
+    uint8_t msg[8];
+    for (int i = 7; i >= 0; i--, step >>= 8)
+      msg[i] = (uint8_t)step;
+    uint8_t mac[Hash::DIGEST];
+    Hash::mac(key, msg, mac);
+    return hotp_truncate(mac, Hash::DIGEST, MODULUS);
+  }
+
+  // Whether `user_code` is the code of any step within the window of
+  // `now`. Every step is computed: the time taken does not depend on which
+  // one (if any) matched.
+  static bool matches(const TotpKey &key, int user_code, time_t now) {
+    if (user_code < 0 || (uint32_t)user_code >= MODULUS)
+      return false;
+    return match_steps(key, (uint32_t)user_code, (uint64_t)now / Period,
+                       std::make_integer_sequence<unsigned, STEPS>());
+  }
+
+private:
+  template <unsigned... I>
+  static bool match_steps(const TotpKey &key, uint32_t user_code,
+                          uint64_t step, std::integer_sequence<unsigned, I...>) {
+    uint32_t found = 0;
+    // Unrolled by the fold; `|` rather than `||` so none is skipped
+    ((found |= (uint32_t)(code(key, step + I - Window) == user_code)), ...);
+    return found != 0;
+  }
+};
+
+typedef TotpPolicy<TotpSha1, 6, 30, 1> TotpPolicyDefault;
+typedef TotpPolicy<TotpSha1, 8, 30, 1> TotpPolicySha1x8;
+typedef TotpPolicy<TotpSha1, 6, 60, 1> TotpPolicySha1x6x60;
+typedef TotpPolicy<TotpSha256, 6, 30, 1> TotpPolicySha256x6;
+typedef TotpPolicy<TotpSha256, 8, 30, 1> TotpPolicySha256x8;
+
+// --- Runtime Selection ---
+
+// Parameters of a policy, for configuration and reporting
+struct TotpPolicyInfo {
+  TotpHash hash;
+  unsigned digits;
+  unsigned period;
+  unsigned window;
+};
+
+// TotpPolicyInfo of `policy`; false if there is no such policy
+bool totp_policy_info(uint8_t policy, TotpPolicyInfo *out);
+
+// ID of the policy with these parameters, or -1 if none is compiled in
+int totp_policy_find(TotpHash hash, unsigned digits, unsigned period,
+                     unsigned window);
+
+// Absorb `secret` into a key for `policy`. False if there is no such
+// policy, leaving a key no code verifies against.
+bool totp_key_init(TotpKey *key, uint8_t policy, const uint8_t *secret,
+                   size_t secret_len);
+
+// Code of `step` / check against the window of `now`, under the key's policy
+uint32_t totp_code(const TotpKey &key, uint64_t step);
+bool totp_verify(const TotpKey &key, int code, time_t now);
@@ -7,6 +7,7 @@ import sqlite3
 import hashlib
 import pyotp
 import os
+import time
 import audit_log  # Audit logging integration
 
 DB_FILENAME = "users.db"
@@ -92,7 +93,28 @@ def register_user(username, password):
         return False, f"Database error: {str(e)}", None
 
 
-def validate_credentials(username, password):
+def login_retry_after(username, ip_address=None):
+    """
+    Seconds until the user (or anyone from ip_address) may try to log in
+    again after an intrusion alert blocked them, 0 if not blocked.
+    """
+    return audit_log.login_blocked(username, ip_address)
+
+
+def session_epoch(username):
+    """Revocation epoch to keep with the session a password login opens"""
+    return audit_log.session_epoch(username)
+
+
+def session_status(username, epoch):
+    """
+    "VALID", "STEP_UP" or "REVOKED" for a session of the user opened under
+    epoch (see audit_log.session_status)
+    """
+    return audit_log.session_status(username, epoch)
+
+
+def validate_credentials(username, password, ip_address=None):
     """
     Validate username and password.
     Returns True if credentials are valid, False otherwise.
@@ -102,10 +124,23 @@ def validate_credentials(username, password):
             username=username or "EMPTY",
             event_type="LOGIN",
             status="FAILURE",
+            ip_address=ip_address,
             details={"reason": "empty_credentials"}
         )
         return False
     
+    # Refused without looking at the password while an alert's block lasts
+    retry_after = login_retry_after(username, ip_address)
+    if retry_after > 0:
+        audit_log.log_event(
+            username=username,
+            event_type="LOGIN",
+            status="BLOCKED",
+            ip_address=ip_address,
+            details={"reason": "enforced_block", "retry_after_s": int(retry_after)}
+        )
+        return False
+    
     pwd_hash = hash_password(password)
     
     try:
@@ -124,6 +159,7 @@ def validate_credentials(username, password):
                 username=username,
                 event_type="LOGIN",
                 status="SUCCESS",
+                ip_address=ip_address,
                 details={"stage": "password_verified"}
             )
             return True
@@ -133,6 +169,7 @@ def validate_credentials(username, password):
                 username=username,
                 event_type="LOGIN",
                 status="FAILURE",
+                ip_address=ip_address,
                 details={"reason": "invalid_credentials"}
             )
             return False
@@ -141,6 +178,7 @@ def validate_credentials(username, password):
             username=username,
             event_type="LOGIN",
             status="FAILURE",
+            ip_address=ip_address,
             details={"reason": "database_error", "error": str(e)}
         )
         return False
@@ -184,7 +222,7 @@ def user_exists(username):
         return False
 
 
-def verify_totp(username, totp_code):
+def verify_totp(username, totp_code, ip_address=None):
     """
     Verify a TOTP code for a given user.
     Returns True if valid, False otherwise.
@@ -195,21 +233,44 @@ def verify_totp(username, totp_code):
             username=username,
             event_type="TOTP",
             status="FAILURE",
+            ip_address=ip_address,
             details={"reason": "no_secret_found"}
         )
         return False
     
+    # No more code guesses while an alert's block lasts
+    retry_after = login_retry_after(username, ip_address)
+    if retry_after > 0:
+        audit_log.log_event(
+            username=username,
+            event_type="TOTP",
+            status="BLOCKED",
+            ip_address=ip_address,
+            details={"reason": "enforced_block", "retry_after_s": int(retry_after)}
+        )
+        return False
+    
     try:
         totp = pyotp.TOTP(secret)
-        is_valid = totp.verify(totp_code, valid_window=1)
+        # Same window as totp.verify(totp_code, valid_window=1), but noting
+        # the step the code matched so the user's profile learns how far
+        # their authenticator's clock usually is off
+        now = time.time()
+        offset = next((step for step in (0, -1, 1)
+                       if pyotp.utils.strings_equal(str(totp_code),
+                                                    totp.at(now, step))), None)
+        is_valid = offset is not None
         
         if is_valid:
+            # A fresh second factor meets any step-up an alert demanded
+            audit_log.step_up_completed(username)
             # Audit log: Successful TOTP verification
             audit_log.log_event(
                 username=username,
                 event_type="TOTP",
                 status="SUCCESS",
-                details={"mfa_completed": True}
+                ip_address=ip_address,
+                details={"mfa_completed": True, "totp_offset": offset}
             )
         else:
             # Audit log: Failed TOTP verification
@@ -217,6 +278,7 @@ def verify_totp(username, totp_code):
                 username=username,
                 event_type="TOTP",
                 status="FAILURE",
+                ip_address=ip_address,
                 details={"reason": "invalid_totp_code"}
             )
         
@@ -226,6 +288,7 @@ def verify_totp(username, totp_code):
             username=username,
             event_type="TOTP",
             status="FAILURE",
+            ip_address=ip_address,
             details={"reason": "verification_error", "error": str(e)}
         )
         return False